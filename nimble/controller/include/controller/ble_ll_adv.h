@@ -48,6 +48,10 @@ extern "C" {
 #define BLE_LL_ADV_PDU_ITVL_HD_MS_MAX   (3750)          /* usecs */
 #define BLE_LL_ADV_STATE_HD_MAX         (1280)          /* msecs */
 
+/* Periodic advertising interval */
+#define BLE_LL_ADV_PERIODIC_ITVL        (1250)          /* usecs */
+#define BLE_LL_ADV_PERIODIC_ITVL_MIN    (6)             /* units */
+
 /* Maximum advertisement data length */
 #define BLE_ADV_LEGACY_DATA_MAX_LEN     (31)
 #define BLE_ADV_LEGACY_MAX_PKT_LEN      (37)
@@ -185,6 +189,25 @@ int ble_ll_adv_ext_set_adv_data(uint8_t *cmdbuf, uint8_t cmdlen);
 int ble_ll_adv_ext_set_scan_rsp(uint8_t *cmdbuf, uint8_t cmdlen);
 int ble_ll_adv_ext_set_enable(uint8_t *cmdbuf, uint8_t len);
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+int ble_ll_adv_periodic_set_param(uint8_t *cmdbuf);
+int ble_ll_adv_periodic_set_data(uint8_t *cmdbuf, uint8_t cmdlen);
+int ble_ll_adv_periodic_enable(uint8_t *cmdbuf);
+
+/*
+ * Called when a periodic advertising event has been removed from the
+ * scheduler without being run.
+ */
+void ble_ll_adv_periodic_rmvd_from_sched(struct ble_ll_adv_sm *advsm);
+#endif
+
+#if MYNEWT_VAL(SELFTEST)
+void ble_ll_adv_test_set_enabled(uint8_t instance, uint8_t enabled);
+void ble_ll_adv_test_set_aux_active(uint8_t instance, uint8_t aux_active);
+void ble_ll_adv_test_event_end(uint8_t instance);
+struct os_mbuf *ble_ll_adv_test_get_adv_data(uint8_t instance, int staged);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -74,6 +74,7 @@ extern uint8_t g_ble_ll_sched_offset_ticks;
 #define BLE_LL_SCHED_TYPE_CONN      (3)
 #define BLE_LL_SCHED_TYPE_AUX_SCAN  (4)
 #define BLE_LL_SCHED_TYPE_DTM       (5)
+#define BLE_LL_SCHED_TYPE_PERIODIC  (6)
 
 /* Return values for schedule callback. */
 #define BLE_LL_SCHED_STATE_RUNNING  (0)
@@ -163,6 +164,11 @@ int ble_ll_sched_adv_new(struct ble_ll_sched_item *sch,
 int ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch, uint32_t *start,
                                 uint32_t max_delay_ticks);
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+/* Schedule a periodic advertising event at its anchor point */
+int ble_ll_sched_periodic_adv(struct ble_ll_sched_item *sch);
+#endif
+
 /* Reschedule and advertising pdu */
 int ble_ll_sched_adv_resched_pdu(struct ble_ll_sched_item *sch);
 
@@ -76,6 +76,21 @@ struct ble_ll_adv_aux {
  *      generate. We reserve space in the advsm to save time when creating
  *      the ADV_DIRECT_IND. If own address type is not 2 or 3, this is simply
  *      the peer address from the set advertising parameters.
+ *
+ *  new_adv_data:
+ *      Advertising data set by the host while advertising is enabled. The
+ *      PDUs of an advertising event (including its auxiliary chain) are
+ *      built from adv_data at transmit time, so new data is staged here and
+ *      swapped into adv_data between advertising events.
+ *
+ *  periodic_adv_anchor:
+ *      Start time of the next periodic advertising event (AUX_SYNC_IND)
+ *      identified by periodic_event_cntr. Read from interrupt context when
+ *      SyncInfo is built so it is only updated with interrupts disabled.
+ *
+ *  periodic_new_adv_data:
+ *      Periodic advertising data staged while the periodic advertising train
+ *      is running; swapped into periodic_adv_data between periodic events.
  */
 struct ble_ll_adv_sm
 {
@@ -103,6 +118,7 @@ struct ble_ll_adv_sm
     uint8_t peer_addr[BLE_DEV_ADDR_LEN];
     uint8_t initiator_addr[BLE_DEV_ADDR_LEN];
     struct os_mbuf *adv_data;
+    struct os_mbuf *new_adv_data;
     struct os_mbuf *scan_rsp_data;
     uint8_t *conn_comp_ev;
     struct os_event adv_txdone_ev;
@@ -125,6 +141,30 @@ struct ble_ll_adv_sm
     uint8_t pri_phy;
     uint8_t sec_phy;
 #endif
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    uint8_t periodic_adv_enabled : 1;
+    uint8_t periodic_adv_active : 1;
+    uint8_t periodic_adv_data_incomplete : 1;
+    uint8_t periodic_include_txpwr : 1;
+    uint8_t periodic_chanmap[BLE_LL_CONN_CHMAP_LEN];
+    uint8_t periodic_num_used_chans;
+    uint8_t periodic_chan;
+    uint8_t periodic_adv_itvl_usecs;
+    uint8_t periodic_adv_anchor_usecs;
+    uint16_t periodic_adv_itvl_min;
+    uint16_t periodic_adv_itvl_max;
+    uint16_t periodic_adv_itvl;
+    uint16_t periodic_channel_id;
+    uint16_t periodic_event_cntr;
+    uint32_t periodic_access_addr;
+    uint32_t periodic_crcinit;
+    uint32_t periodic_adv_itvl_ticks;
+    uint32_t periodic_adv_anchor;
+    struct os_mbuf *periodic_adv_data;
+    struct os_mbuf *periodic_new_adv_data;
+    struct ble_ll_sched_item periodic_sch;
+    struct os_event adv_periodic_txdone_ev;
+#endif
 };
 
 #define BLE_LL_ADV_SM_FLAG_TX_ADD               0x01
@@ -142,6 +182,15 @@ struct ble_ll_adv_sm
 #define AUX_DATA_LEN(_advsm) \
                 (*(_advsm->aux_data) ? OS_MBUF_PKTLEN(*advsm->aux_data) : 0)
 
+/*
+ * Periodic advertising data is sent in a single AUX_SYNC_IND (no chaining),
+ * so it is limited to what fits after extended header with TxPower.
+ */
+#define BLE_LL_ADV_PERIODIC_DATA_MAX    (BLE_LL_MAX_PAYLOAD_LEN - \
+                                         BLE_LL_EXT_ADV_HDR_LEN - \
+                                         BLE_LL_EXT_ADV_FLAGS_SIZE - \
+                                         BLE_LL_EXT_ADV_TX_POWER_SIZE)
+
 #define AUX_CURRENT(_advsm)     (&(_advsm->aux[_advsm->aux_index]))
 #define AUX_NEXT(_advsm)        (&(_advsm->aux[_advsm->aux_index ^ 1]))
 
@@ -157,6 +206,12 @@ ble_ll_adv_active_chanset_is_sec(struct ble_ll_adv_sm *advsm)
     return (advsm->flags & BLE_LL_ADV_SM_FLAG_ACTIVE_CHANSET_MASK) == 0x20;
 }
 
+static inline int
+ble_ll_adv_active_chanset_is_periodic(struct ble_ll_adv_sm *advsm)
+{
+    return (advsm->flags & BLE_LL_ADV_SM_FLAG_ACTIVE_CHANSET_MASK) == 0x30;
+}
+
 static inline void
 ble_ll_adv_active_chanset_clear(struct ble_ll_adv_sm *advsm)
 {
@@ -179,12 +234,23 @@ ble_ll_adv_active_chanset_set_sec(struct ble_ll_adv_sm *advsm)
     advsm->flags |= 0x20;
 }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+static inline void
+ble_ll_adv_active_chanset_set_periodic(struct ble_ll_adv_sm *advsm)
+{
+    assert((advsm->flags & BLE_LL_ADV_SM_FLAG_ACTIVE_CHANSET_MASK) == 0);
+    advsm->flags &= ~BLE_LL_ADV_SM_FLAG_ACTIVE_CHANSET_MASK;
+    advsm->flags |= 0x30;
+}
+#endif
+
 /* The advertising state machine global object */
 struct ble_ll_adv_sm g_ble_ll_adv_sm[BLE_ADV_INSTANCES];
 struct ble_ll_adv_sm *g_ble_ll_cur_adv_sm;
 
 static void ble_ll_adv_make_done(struct ble_ll_adv_sm *advsm, struct ble_mbuf_hdr *hdr);
 static void ble_ll_adv_sm_init(struct ble_ll_adv_sm *advsm);
+static void ble_ll_adv_flip_adv_data(struct ble_ll_adv_sm *advsm);
 
 #if (MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY) == 1)
 static void
@@ -397,6 +463,78 @@ ble_ll_adv_put_aux_ptr(struct ble_ll_adv_sm *advsm, uint32_t offset,
     dptr[2] = ((offset >> 8) & 0x0000001f) | (advsm->sec_phy - 1) << 5; //TODO;
 }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+static void
+ble_ll_adv_periodic_next_anchor(struct ble_ll_adv_sm *advsm, uint32_t *anchor,
+                                uint8_t *anchor_usecs)
+{
+    *anchor += advsm->periodic_adv_itvl_ticks;
+    *anchor_usecs += advsm->periodic_adv_itvl_usecs;
+    if (*anchor_usecs >= 31) {
+        ++*anchor;
+        *anchor_usecs -= 31;
+    }
+}
+
+/**
+ * Put SyncInfo field pointing at the first periodic advertising event that
+ * starts after the PDU starting at given time.
+ *
+ * Context: Interrupt
+ */
+static void
+ble_ll_adv_put_syncinfo(struct ble_ll_adv_sm *advsm, uint32_t start_time,
+                        uint8_t *dptr)
+{
+    uint32_t anchor;
+    uint32_t offset;
+    uint16_t event_cntr;
+    uint8_t anchor_usecs;
+    uint8_t units;
+
+    if (!advsm->periodic_adv_active) {
+        /* Offset of zero means periodic advertising event is not described */
+        memset(dptr, 0, BLE_LL_EXT_ADV_SYNC_INFO_SIZE);
+        return;
+    }
+
+    anchor = advsm->periodic_adv_anchor;
+    anchor_usecs = advsm->periodic_adv_anchor_usecs;
+    event_cntr = advsm->periodic_event_cntr;
+
+    while ((int32_t)(anchor - start_time) <= 0) {
+        ble_ll_adv_periodic_next_anchor(advsm, &anchor, &anchor_usecs);
+        event_cntr++;
+    }
+
+    offset = os_cputime_ticks_to_usecs(anchor - start_time) + anchor_usecs;
+
+    /* Round down so scanner starts listening before the packet */
+    if (offset >= 245760) {
+        units = 1;
+        offset = offset / 300;
+    } else {
+        units = 0;
+        offset = offset / 30;
+    }
+
+    if (offset > 0x1fff) {
+        offset = 0;
+        units = 0;
+    }
+
+    put_le16(&dptr[0], offset | (units << 13));
+    put_le16(&dptr[2], advsm->periodic_adv_itvl);
+    memcpy(&dptr[4], advsm->periodic_chanmap, BLE_LL_CONN_CHMAP_LEN);
+    dptr[8] |= MYNEWT_VAL(BLE_LL_MASTER_SCA) << 5;
+    put_le32(&dptr[9], advsm->periodic_access_addr);
+    dptr[13] = advsm->periodic_crcinit & 0xff;
+    dptr[14] = (advsm->periodic_crcinit >> 8) & 0xff;
+    dptr[15] = (advsm->periodic_crcinit >> 16) & 0xff;
+    put_le16(&dptr[16], event_cntr);
+}
+#endif
+
 /**
  * Create the advertising PDU
  */
@@ -536,6 +674,13 @@ ble_ll_adv_aux_pdu_make(uint8_t *dptr, void *pducb_arg, uint8_t *hdr_byte)
         dptr += BLE_LL_EXT_ADV_AUX_PTR_SIZE;
     }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    if (aux->ext_hdr & (1 << BLE_LL_EXT_ADV_SYNC_INFO_BIT)) {
+        ble_ll_adv_put_syncinfo(advsm, aux->start_time, dptr);
+        dptr += BLE_LL_EXT_ADV_SYNC_INFO_SIZE;
+    }
+#endif
+
     if (aux->ext_hdr & (1 << BLE_LL_EXT_ADV_TX_POWER_BIT)) {
         dptr[0] = advsm->adv_txpwr;
         dptr += BLE_LL_EXT_ADV_TX_POWER_SIZE;
@@ -761,6 +906,10 @@ ble_ll_adv_tx_done(void *arg)
         os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_txdone_ev);
     } else if (ble_ll_adv_active_chanset_is_sec(advsm)) {
         os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_sec_txdone_ev);
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    } else if (ble_ll_adv_active_chanset_is_periodic(advsm)) {
+        os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_periodic_txdone_ev);
+#endif
     } else {
         assert(0);
     }
@@ -1101,6 +1250,14 @@ ble_ll_adv_aux_calculate(struct ble_ll_adv_sm *advsm,
         hdr_len += BLE_LL_EXT_ADV_TARGETA_SIZE;
     }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    /* SyncInfo in AUX_ADV_IND if periodic advertising train is running */
+    if ((aux_data_offset == 0) && advsm->periodic_adv_active) {
+        aux->ext_hdr |= (1 << BLE_LL_EXT_ADV_SYNC_INFO_BIT);
+        hdr_len += BLE_LL_EXT_ADV_SYNC_INFO_SIZE;
+    }
+#endif
+
     /* TxPower if configured */
     if (advsm->props & BLE_HCI_LE_SET_EXT_ADV_PROP_INC_TX_PWR) {
         aux->ext_hdr |= (1 << BLE_LL_EXT_ADV_TX_POWER_BIT);
@@ -1305,6 +1462,322 @@ ble_ll_adv_aux_schedule(struct ble_ll_adv_sm *advsm)
 }
 #endif
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+static uint8_t
+ble_ll_adv_periodic_pdu_payload_len(struct ble_ll_adv_sm *advsm)
+{
+    uint8_t len;
+
+    len = BLE_LL_EXT_ADV_HDR_LEN;
+
+    /* TxPower if configured */
+    if (advsm->periodic_include_txpwr) {
+        len += BLE_LL_EXT_ADV_FLAGS_SIZE + BLE_LL_EXT_ADV_TX_POWER_SIZE;
+    }
+
+    if (advsm->periodic_adv_data) {
+        len += OS_MBUF_PKTLEN(advsm->periodic_adv_data);
+    }
+
+    return len;
+}
+
+/**
+ * Create the AUX_SYNC_IND PDU
+ */
+static uint8_t
+ble_ll_adv_periodic_pdu_make(uint8_t *dptr, void *pducb_arg, uint8_t *hdr_byte)
+{
+    struct ble_ll_adv_sm *advsm;
+    uint8_t pdulen;
+    uint8_t hdr_len;
+
+    advsm = pducb_arg;
+
+    assert(ble_ll_adv_active_chanset_is_periodic(advsm));
+
+    /* TxAdd is RFU for AUX_SYNC_IND */
+    *hdr_byte = BLE_ADV_PDU_TYPE_AUX_SYNC_IND;
+
+    pdulen = ble_ll_adv_periodic_pdu_payload_len(advsm);
+
+    /* AdvMode is always non-connectable and non-scannable */
+    if (advsm->periodic_include_txpwr) {
+        hdr_len = BLE_LL_EXT_ADV_FLAGS_SIZE + BLE_LL_EXT_ADV_TX_POWER_SIZE;
+        dptr[0] = hdr_len;
+        dptr[1] = (1 << BLE_LL_EXT_ADV_TX_POWER_BIT);
+        dptr[2] = advsm->adv_txpwr;
+    } else {
+        hdr_len = 0;
+        dptr[0] = 0;
+    }
+    dptr += BLE_LL_EXT_ADV_HDR_LEN + hdr_len;
+
+    if (advsm->periodic_adv_data) {
+        os_mbuf_copydata(advsm->periodic_adv_data, 0,
+                         OS_MBUF_PKTLEN(advsm->periodic_adv_data), dptr);
+    }
+
+    return pdulen;
+}
+
+static int
+ble_ll_adv_periodic_tx_start_cb(struct ble_ll_sched_item *sch)
+{
+    int rc;
+    uint32_t txstart;
+    struct ble_ll_adv_sm *advsm;
+
+    /* Get the state machine for the event */
+    advsm = (struct ble_ll_adv_sm *)sch->cb_arg;
+
+    /* Set the current advertiser */
+    g_ble_ll_cur_adv_sm = advsm;
+
+    ble_ll_adv_active_chanset_set_periodic(advsm);
+
+    /* Set the power */
+    ble_phy_txpwr_set(advsm->adv_txpwr);
+
+    /* Periodic advertising train uses its own access address and CRC init */
+    rc = ble_phy_setchan(advsm->periodic_chan, advsm->periodic_access_addr,
+                         advsm->periodic_crcinit);
+    assert(rc == 0);
+
+#if (BLE_LL_BT5_PHY_SUPPORTED == 1)
+    /* Set phy mode */
+    ble_phy_mode_set(advsm->sec_phy, advsm->sec_phy);
+#endif
+
+    /* Set transmit start time. */
+    txstart = sch->start_time + g_ble_ll_sched_offset_ticks;
+    rc = ble_phy_tx_set_start_time(txstart, sch->remainder);
+    if (rc) {
+        STATS_INC(ble_ll_stats, adv_late_starts);
+        goto adv_tx_done;
+    }
+
+#if (MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_ENCRYPTION) == 1)
+    ble_phy_encrypt_disable();
+#endif
+
+#if (MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PRIVACY) == 1)
+    ble_phy_resolv_list_disable();
+#endif
+
+    /* Nothing is received in periodic advertising event */
+    ble_phy_set_txend_cb(ble_ll_adv_tx_done, advsm);
+
+    rc = ble_phy_tx(ble_ll_adv_periodic_pdu_make, advsm,
+                    BLE_PHY_TRANSITION_NONE);
+    if (rc) {
+        goto adv_tx_done;
+    }
+
+    /* Set link layer state to advertising */
+    ble_ll_state_set(BLE_LL_STATE_ADV);
+
+    /* Count # of adv. sent */
+    STATS_INC(ble_ll_stats, adv_txg);
+
+    return BLE_LL_SCHED_STATE_RUNNING;
+
+adv_tx_done:
+    ble_ll_adv_tx_done(advsm);
+    return BLE_LL_SCHED_STATE_DONE;
+}
+
+/**
+ * Schedules periodic advertising event at current anchor point. Periodic
+ * advertising events cannot be moved, so if the scheduler has no room at the
+ * anchor point the event is skipped and the following one is tried.
+ *
+ * Context: Link Layer task.
+ *
+ * @param advsm Pointer to advertising state machine
+ * @param first True if current anchor point was not used yet
+ */
+static void
+ble_ll_adv_periodic_schedule(struct ble_ll_adv_sm *advsm, bool first)
+{
+    struct ble_ll_sched_item *sch;
+    uint32_t max_usecs;
+    os_sr_t sr;
+
+    sch = &advsm->periodic_sch;
+
+    max_usecs = ble_ll_pdu_tx_time_get(ble_ll_adv_periodic_pdu_payload_len(advsm),
+                                       advsm->sec_phy);
+    max_usecs += XCVR_PROC_DELAY_USECS;
+
+    while (1) {
+        if (!first) {
+            OS_ENTER_CRITICAL(sr);
+            ble_ll_adv_periodic_next_anchor(advsm, &advsm->periodic_adv_anchor,
+                                            &advsm->periodic_adv_anchor_usecs);
+            advsm->periodic_event_cntr++;
+            OS_EXIT_CRITICAL(sr);
+        }
+        first = false;
+
+        advsm->periodic_chan =
+            ble_ll_conn_calc_dci_csa2_chan(advsm->periodic_event_cntr,
+                                           advsm->periodic_channel_id,
+                                           advsm->periodic_num_used_chans,
+                                           advsm->periodic_chanmap);
+
+        sch->start_time = advsm->periodic_adv_anchor -
+                          g_ble_ll_sched_offset_ticks;
+        sch->remainder = advsm->periodic_adv_anchor_usecs;
+        sch->end_time = advsm->periodic_adv_anchor +
+                        ble_ll_usecs_to_ticks_round_up(max_usecs);
+
+        if (ble_ll_sched_periodic_adv(sch) == 0) {
+            break;
+        }
+
+        STATS_INC(ble_ll_stats, adv_drop_event);
+    }
+}
+
+/**
+ * Swaps in periodic advertising data staged while periodic advertising train
+ * was running. Must only be called between periodic advertising events.
+ *
+ * Context: Link Layer task
+ */
+static void
+ble_ll_adv_periodic_flip_data(struct ble_ll_adv_sm *advsm)
+{
+    if (!advsm->periodic_new_adv_data) {
+        return;
+    }
+
+    if (advsm->periodic_adv_data) {
+        os_mbuf_free_chain(advsm->periodic_adv_data);
+    }
+    advsm->periodic_adv_data = advsm->periodic_new_adv_data;
+    advsm->periodic_new_adv_data = NULL;
+}
+
+/**
+ * Starts periodic advertising train. This is called once both periodic
+ * advertising and advertising set are enabled.
+ *
+ * Context: Link Layer task.
+ */
+static void
+ble_ll_adv_periodic_start(struct ble_ll_adv_sm *advsm)
+{
+    uint32_t usecs;
+    uint32_t ticks;
+
+    assert(!advsm->periodic_adv_active);
+    assert(!advsm->periodic_sch.enqueued);
+
+    ble_ll_adv_periodic_flip_data(advsm);
+
+    advsm->periodic_access_addr = ble_ll_conn_calc_access_addr();
+    advsm->periodic_channel_id = ((advsm->periodic_access_addr >> 16) ^
+                                  advsm->periodic_access_addr) & 0xffff;
+    advsm->periodic_crcinit = rand() & 0xffffff;
+    advsm->periodic_num_used_chans = g_ble_ll_conn_params.num_used_chans;
+    memcpy(advsm->periodic_chanmap, g_ble_ll_conn_params.master_chan_map,
+           BLE_LL_CONN_CHMAP_LEN);
+    advsm->periodic_event_cntr = 0;
+
+    /* XXX: for now, use maximum interval (same as for advertising events) */
+    advsm->periodic_adv_itvl = advsm->periodic_adv_itvl_max;
+    usecs = (uint32_t)advsm->periodic_adv_itvl * BLE_LL_ADV_PERIODIC_ITVL;
+    ticks = os_cputime_usecs_to_ticks(usecs);
+    advsm->periodic_adv_itvl_usecs = (uint8_t)(usecs -
+                                               os_cputime_ticks_to_usecs(ticks));
+    if (advsm->periodic_adv_itvl_usecs == 31) {
+        advsm->periodic_adv_itvl_usecs = 0;
+        ++ticks;
+    }
+    advsm->periodic_adv_itvl_ticks = ticks;
+
+    /* Same as for advertising, start first event some time in the future */
+    advsm->periodic_adv_anchor = os_cputime_get32() +
+                                 os_cputime_usecs_to_ticks(5000);
+    advsm->periodic_adv_anchor_usecs = 0;
+
+    advsm->periodic_adv_active = 1;
+
+    ble_ll_adv_periodic_schedule(advsm, true);
+}
+
+/**
+ * Stops periodic advertising train.
+ *
+ * Context: Link Layer task.
+ */
+static void
+ble_ll_adv_periodic_stop(struct ble_ll_adv_sm *advsm)
+{
+    os_sr_t sr;
+
+    if (!advsm->periodic_adv_active) {
+        return;
+    }
+
+    ble_ll_sched_rmv_elem(&advsm->periodic_sch);
+
+    OS_ENTER_CRITICAL(sr);
+    advsm->periodic_adv_active = 0;
+    if ((g_ble_ll_cur_adv_sm == advsm) &&
+        ble_ll_adv_active_chanset_is_periodic(advsm)) {
+        ble_phy_disable();
+        ble_ll_state_set(BLE_LL_STATE_STANDBY);
+        ble_ll_adv_active_chanset_clear(advsm);
+        g_ble_ll_cur_adv_sm = NULL;
+        ble_ll_scan_chk_resume();
+    }
+#ifdef BLE_XCVR_RFCLK
+    ble_ll_sched_rfclk_chk_restart();
+#endif
+    OS_EXIT_CRITICAL(sr);
+
+    os_eventq_remove(&g_ble_ll_data.ll_evq, &advsm->adv_periodic_txdone_ev);
+
+    ble_ll_adv_periodic_flip_data(advsm);
+}
+
+/**
+ * Called when periodic advertising event is over (or was skipped).
+ *
+ * Context: Link Layer task.
+ */
+static void
+ble_ll_adv_periodic_event_done(struct os_event *ev)
+{
+    struct ble_ll_adv_sm *advsm;
+
+    advsm = ev->ev_arg;
+
+    if (!advsm->periodic_adv_active) {
+        return;
+    }
+
+    ble_ll_sched_rmv_elem(&advsm->periodic_sch);
+
+    /* Check if we need to resume scanning */
+    ble_ll_scan_chk_resume();
+
+    /* Next event uses most recent data from host */
+    ble_ll_adv_periodic_flip_data(advsm);
+
+    ble_ll_adv_periodic_schedule(advsm, false);
+}
+
+void
+ble_ll_adv_periodic_rmvd_from_sched(struct ble_ll_adv_sm *advsm)
+{
+    os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_periodic_txdone_ev);
+}
+#endif
+
 /**
  * Called when advertising need to be halted. This normally should not be called
  * and is only called when a scheduled item executes but advertising is still
@@ -1322,11 +1795,24 @@ ble_ll_adv_halt(void)
 
         ble_phy_txpwr_set(MYNEWT_VAL(BLE_LL_TX_PWR_DBM));
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+        if (ble_ll_adv_active_chanset_is_periodic(advsm)) {
+            os_eventq_put(&g_ble_ll_data.ll_evq,
+                          &advsm->adv_periodic_txdone_ev);
+        } else {
+            os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_txdone_ev);
+            if (!(advsm->props & BLE_HCI_LE_SET_EXT_ADV_PROP_LEGACY)) {
+                os_eventq_put(&g_ble_ll_data.ll_evq,
+                              &advsm->adv_sec_txdone_ev);
+            }
+        }
+#else
         os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_txdone_ev);
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
         if (!(advsm->props & BLE_HCI_LE_SET_EXT_ADV_PROP_LEGACY)) {
             os_eventq_put(&g_ble_ll_data.ll_evq, &advsm->adv_sec_txdone_ev);
         }
+#endif
 #endif
 
         ble_ll_log(BLE_LL_LOG_ID_ADV_TXDONE, ble_ll_state_get(),
@@ -1493,7 +1979,9 @@ ble_ll_adv_sm_stop(struct ble_ll_adv_sm *advsm)
         /* Set to standby if we are no longer advertising */
         OS_ENTER_CRITICAL(sr);
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
-        if (g_ble_ll_cur_adv_sm == advsm) {
+        /* Periodic advertising is not stopped with advertising set */
+        if ((g_ble_ll_cur_adv_sm == advsm) &&
+            !ble_ll_adv_active_chanset_is_periodic(advsm)) {
             ble_phy_disable();
             ble_ll_wfr_disable();
             ble_ll_state_set(BLE_LL_STATE_STANDBY);
@@ -1525,10 +2013,15 @@ ble_ll_adv_sm_stop(struct ble_ll_adv_sm *advsm)
             advsm->conn_comp_ev = NULL;
         }
 
-        ble_ll_adv_active_chanset_clear(advsm);
+        if (!ble_ll_adv_active_chanset_is_periodic(advsm)) {
+            ble_ll_adv_active_chanset_clear(advsm);
+        }
 
         /* Disable advertising */
         advsm->adv_enabled = 0;
+
+        /* Staged data becomes current once there are no more events */
+        ble_ll_adv_flip_adv_data(advsm);
     }
 }
 
@@ -1637,6 +2130,12 @@ ble_ll_adv_sm_start(struct ble_ll_adv_sm *advsm)
     }
 #endif
 
+    /*
+     * Advertising may have been disabled (timeout, events limit) with new
+     * data still staged; it becomes current now.
+     */
+    ble_ll_adv_flip_adv_data(advsm);
+
     /* Set flag telling us that advertising is enabled */
     advsm->adv_enabled = 1;
 
@@ -1666,6 +2165,16 @@ ble_ll_adv_sm_start(struct ble_ll_adv_sm *advsm)
     advsm->adv_pdu_start_time = os_cputime_get32() +
                                 os_cputime_usecs_to_ticks(5000);
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    /*
+     * Periodic advertising enabled before advertising set starts with it.
+     * This is done before scheduling aux so AUX_ADV_IND includes SyncInfo.
+     */
+    if (advsm->periodic_adv_enabled && !advsm->periodic_adv_active) {
+        ble_ll_adv_periodic_start(advsm);
+    }
+#endif
+
     /*
      * Schedule advertising. We set the initial schedule start and end
      * times to the earliest possible start/end.
@@ -1792,6 +2301,47 @@ done:
     *omp = om;
 }
 
+/**
+ * Swaps in advertising data staged while advertising was enabled. Must only
+ * be called between advertising events, when no PDU of this advertising set
+ * is being built.
+ *
+ * Context: Link Layer task
+ *
+ * @param advsm Pointer to advertising state machine
+ */
+static void
+ble_ll_adv_flip_adv_data(struct ble_ll_adv_sm *advsm)
+{
+    if (!advsm->new_adv_data) {
+        return;
+    }
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+    /* Auxiliary chain of this event still refers to current data */
+    if (advsm->aux_active) {
+        return;
+    }
+#endif
+
+    if (advsm->adv_data) {
+        os_mbuf_free_chain(advsm->adv_data);
+    }
+    advsm->adv_data = advsm->new_adv_data;
+    advsm->new_adv_data = NULL;
+
+    /* Schedule item duration for legacy PDUs depends on data length */
+    if (!(advsm->props & BLE_HCI_LE_SET_EXT_ADV_PROP_DIRECTED)) {
+        advsm->adv_pdu_len = BLE_LL_PDU_HDR_LEN + BLE_DEV_ADDR_LEN +
+                             ADV_DATA_LEN(advsm);
+    }
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+    /* DID shall be updated when host provides new advertising data */
+    advsm->adi = (advsm->adi & 0xf000) | (rand() & 0x0fff);
+#endif
+}
+
 /**
  * Set the scan response data that the controller will send.
  *
@@ -1984,9 +2534,31 @@ ble_ll_adv_set_adv_data(uint8_t *cmd, uint8_t instance, uint8_t operation)
         return BLE_ERR_INV_HCI_CMD_PARMS;
     }
 
+    /*
+     * Complete data set while advertising is staged and takes effect at the
+     * next advertising event; the current event keeps sending the old data.
+     * Only the most recent staged data is kept.
+     */
+    if (advsm->adv_enabled &&
+        (operation == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE)) {
+        ble_ll_adv_update_data_mbuf(&advsm->new_adv_data, true,
+                                    BLE_ADV_DATA_MAX_LEN, cmd + 1, datalen);
+        if (!advsm->new_adv_data) {
+            return BLE_ERR_MEM_CAPACITY;
+        }
+
+        return BLE_ERR_SUCCESS;
+    }
+
     new_data = (operation == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE) ||
                (operation == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_FIRST);
 
+    /* Data staged before advertising was disabled is superseded */
+    if (new_data && advsm->new_adv_data) {
+        os_mbuf_free_chain(advsm->new_adv_data);
+        advsm->new_adv_data = NULL;
+    }
+
     ble_ll_adv_update_data_mbuf(&advsm->adv_data, new_data, BLE_ADV_DATA_MAX_LEN,
                                 cmd + 1, datalen);
     if (!advsm->adv_data) {
@@ -2001,6 +2573,21 @@ ble_ll_adv_set_adv_data(uint8_t *cmd, uint8_t instance, uint8_t operation)
     return BLE_ERR_SUCCESS;
 }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+/*
+ * Periodic advertising can only be done with non-connectable, non-scannable
+ * and non-anonymous extended advertising.
+ */
+static bool
+ble_ll_adv_periodic_props_valid(uint16_t props)
+{
+    return !(props & (BLE_HCI_LE_SET_EXT_ADV_PROP_LEGACY |
+                      BLE_HCI_LE_SET_EXT_ADV_PROP_CONNECTABLE |
+                      BLE_HCI_LE_SET_EXT_ADV_PROP_SCANNABLE |
+                      BLE_HCI_LE_SET_EXT_ADV_PROP_ANON_ADV));
+}
+#endif
+
 #if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
 int
 ble_ll_adv_ext_set_param(uint8_t *cmdbuf, uint8_t *rspbuf, uint8_t *rsplen)
@@ -2042,6 +2629,14 @@ ble_ll_adv_ext_set_param(uint8_t *cmdbuf, uint8_t *rspbuf, uint8_t *rsplen)
         goto done;
     }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    if (advsm->periodic_adv_enabled &&
+        !ble_ll_adv_periodic_props_valid(props)) {
+        rc = BLE_ERR_INV_HCI_CMD_PARMS;
+        goto done;
+    }
+#endif
+
     if (props & BLE_HCI_LE_SET_EXT_ADV_PROP_LEGACY) {
         if (ADV_DATA_LEN(advsm) > BLE_ADV_LEGACY_DATA_MAX_LEN ||
             SCAN_RSP_DATA_LEN(advsm) > BLE_SCAN_RSP_LEGACY_DATA_MAX_LEN) {
@@ -2339,6 +2934,209 @@ ble_ll_adv_ext_set_enable(uint8_t *cmd, uint8_t len)
     return BLE_ERR_SUCCESS;
 }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+/**
+ * HCI LE set periodic advertising parameters command
+ *
+ * @param cmdbuf Pointer to command data
+ *
+ * @return int BLE error code
+ */
+int
+ble_ll_adv_periodic_set_param(uint8_t *cmdbuf)
+{
+    struct ble_ll_adv_sm *advsm;
+    uint16_t adv_itvl_min;
+    uint16_t adv_itvl_max;
+    uint16_t props;
+
+    if (cmdbuf[0] >= BLE_ADV_INSTANCES) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    advsm = &g_ble_ll_adv_sm[cmdbuf[0]];
+
+    adv_itvl_min = get_le16(&cmdbuf[1]);
+    adv_itvl_max = get_le16(&cmdbuf[3]);
+    props = get_le16(&cmdbuf[5]);
+
+    if (advsm->periodic_adv_enabled) {
+        return BLE_ERR_CMD_DISALLOWED;
+    }
+
+    if (!ble_ll_adv_periodic_props_valid(advsm->props)) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    if ((adv_itvl_min > adv_itvl_max) ||
+        (adv_itvl_min < BLE_LL_ADV_PERIODIC_ITVL_MIN)) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    /* Only TxPower can be included in AUX_SYNC_IND */
+    if (props & ~BLE_HCI_LE_SET_EXT_ADV_PROP_INC_TX_PWR) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    advsm->periodic_adv_itvl_min = adv_itvl_min;
+    advsm->periodic_adv_itvl_max = adv_itvl_max;
+    advsm->periodic_include_txpwr =
+                            !!(props & BLE_HCI_LE_SET_EXT_ADV_PROP_INC_TX_PWR);
+
+    return BLE_ERR_SUCCESS;
+}
+
+/**
+ * HCI LE set periodic advertising data command
+ *
+ * @param cmdbuf Pointer to command data
+ * @param cmdlen Command data length
+ *
+ * @return int BLE error code
+ */
+int
+ble_ll_adv_periodic_set_data(uint8_t *cmdbuf, uint8_t cmdlen)
+{
+    struct ble_ll_adv_sm *advsm;
+    uint8_t operation;
+    uint8_t datalen;
+    bool new_data;
+
+    if (cmdlen < 3 || cmdlen != 3 + cmdbuf[2]) {
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    if (cmdbuf[0] >= BLE_ADV_INSTANCES) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    advsm = &g_ble_ll_adv_sm[cmdbuf[0]];
+    operation = cmdbuf[1];
+    datalen = cmdbuf[2];
+
+    switch (operation) {
+    case BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE:
+        advsm->periodic_adv_data_incomplete = 0;
+        break;
+    case BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_LAST:
+        advsm->periodic_adv_data_incomplete = 0;
+        /* fall through */
+    case BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_INT:
+        if (!advsm->periodic_adv_data || !datalen) {
+            return BLE_ERR_INV_HCI_CMD_PARMS;
+        }
+
+        if (advsm->periodic_adv_enabled) {
+            return BLE_ERR_CMD_DISALLOWED;
+        }
+        break;
+    case BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_FIRST:
+        if (advsm->periodic_adv_enabled) {
+            return BLE_ERR_CMD_DISALLOWED;
+        }
+
+        if (!datalen) {
+            return BLE_ERR_INV_HCI_CMD_PARMS;
+        }
+
+        advsm->periodic_adv_data_incomplete = 1;
+        break;
+    default:
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    /*
+     * Complete data set while periodic advertising train is running is
+     * staged and takes effect at the next periodic advertising event.
+     */
+    if (advsm->periodic_adv_active &&
+        (operation == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE)) {
+        ble_ll_adv_update_data_mbuf(&advsm->periodic_new_adv_data, true,
+                                    BLE_LL_ADV_PERIODIC_DATA_MAX, cmdbuf + 3,
+                                    datalen);
+        if (!advsm->periodic_new_adv_data) {
+            return BLE_ERR_MEM_CAPACITY;
+        }
+
+        return BLE_ERR_SUCCESS;
+    }
+
+    new_data = (operation == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE) ||
+               (operation == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_FIRST);
+
+    if (new_data && advsm->periodic_new_adv_data) {
+        os_mbuf_free_chain(advsm->periodic_new_adv_data);
+        advsm->periodic_new_adv_data = NULL;
+    }
+
+    ble_ll_adv_update_data_mbuf(&advsm->periodic_adv_data, new_data,
+                                BLE_LL_ADV_PERIODIC_DATA_MAX, cmdbuf + 3,
+                                datalen);
+    if (!advsm->periodic_adv_data) {
+        return BLE_ERR_MEM_CAPACITY;
+    }
+
+    return BLE_ERR_SUCCESS;
+}
+
+/**
+ * HCI LE periodic advertising enable command. Periodic advertising train is
+ * started once the advertising set is enabled as well and is not affected
+ * by disabling advertising set.
+ *
+ * @param cmdbuf Pointer to command data
+ *
+ * @return int BLE error code
+ */
+int
+ble_ll_adv_periodic_enable(uint8_t *cmdbuf)
+{
+    struct ble_ll_adv_sm *advsm;
+
+    if (cmdbuf[1] >= BLE_ADV_INSTANCES) {
+        return BLE_ERR_UNK_ADV_INDENT;
+    }
+
+    advsm = &g_ble_ll_adv_sm[cmdbuf[1]];
+
+    switch (cmdbuf[0]) {
+    case 0x01:
+        if (advsm->periodic_adv_data_incomplete) {
+            return BLE_ERR_CMD_DISALLOWED;
+        }
+
+        /* Periodic advertising parameters were not set */
+        if (!advsm->periodic_adv_itvl_max) {
+            return BLE_ERR_CMD_DISALLOWED;
+        }
+
+        if (!ble_ll_adv_periodic_props_valid(advsm->props)) {
+            return BLE_ERR_CMD_DISALLOWED;
+        }
+
+        /* If already enabled, do nothing */
+        if (advsm->periodic_adv_enabled) {
+            break;
+        }
+
+        advsm->periodic_adv_enabled = 1;
+
+        if (advsm->adv_enabled) {
+            ble_ll_adv_periodic_start(advsm);
+        }
+        break;
+    case 0x00:
+        ble_ll_adv_periodic_stop(advsm);
+        advsm->periodic_adv_enabled = 0;
+        break;
+    default:
+        return BLE_ERR_INV_HCI_CMD_PARMS;
+    }
+
+    return BLE_ERR_SUCCESS;
+}
+#endif
+
 int
 ble_ll_adv_set_random_addr(uint8_t *addr, uint8_t instance)
 {
@@ -2389,9 +3187,25 @@ ble_ll_adv_remove(uint8_t instance)
         return BLE_ERR_CMD_DISALLOWED;
     }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    if (advsm->periodic_adv_enabled) {
+        return BLE_ERR_CMD_DISALLOWED;
+    }
+
+    if (advsm->periodic_adv_data) {
+        os_mbuf_free_chain(advsm->periodic_adv_data);
+    }
+    if (advsm->periodic_new_adv_data) {
+        os_mbuf_free_chain(advsm->periodic_new_adv_data);
+    }
+#endif
+
     if (advsm->adv_data) {
         os_mbuf_free_chain(advsm->adv_data);
     }
+    if (advsm->new_adv_data) {
+        os_mbuf_free_chain(advsm->new_adv_data);
+    }
     if (advsm->scan_rsp_data) {
         os_mbuf_free_chain(advsm->scan_rsp_data);
     }
@@ -2415,6 +3229,11 @@ ble_ll_adv_clear_all(void)
         if (g_ble_ll_adv_sm[i].adv_enabled) {
             return BLE_ERR_CMD_DISALLOWED;
         }
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+        if (g_ble_ll_adv_sm[i].periodic_adv_enabled) {
+            return BLE_ERR_CMD_DISALLOWED;
+        }
+#endif
     }
 
     ble_ll_adv_reset();
@@ -2958,6 +3777,9 @@ ble_ll_adv_done(struct ble_ll_adv_sm *advsm)
         /* This event is over. Set adv channel to first one */
         advsm->adv_chan = ble_ll_adv_first_chan(advsm);
 
+        /* Next event uses most recent data from host */
+        ble_ll_adv_flip_adv_data(advsm);
+
         /*
          * Calculate start time of next advertising event. NOTE: we do not
          * add the random advDelay as the scheduling code will do that.
@@ -3188,6 +4010,10 @@ ble_ll_adv_sec_done(struct ble_ll_adv_sm *advsm)
     }
 
     advsm->aux_active = 0;
+
+    /* Next event uses most recent data from host */
+    ble_ll_adv_flip_adv_data(advsm);
+
     ble_ll_adv_reschedule_event(advsm);
 }
 
@@ -3345,6 +4171,15 @@ ble_ll_adv_reset(void)
         /* Stop advertising state machine */
         advsm = &g_ble_ll_adv_sm[i];
         ble_ll_adv_sm_stop(advsm);
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+        ble_ll_adv_periodic_stop(advsm);
+        if (advsm->periodic_adv_data) {
+            os_mbuf_free_chain(advsm->periodic_adv_data);
+        }
+        if (advsm->periodic_new_adv_data) {
+            os_mbuf_free_chain(advsm->periodic_new_adv_data);
+        }
+#endif
     }
 
     /* re-initialize the advertiser state machine */
@@ -3398,6 +4233,14 @@ ble_ll_adv_sm_init(struct ble_ll_adv_sm *advsm)
     advsm->aux[1].sch.sched_type = BLE_LL_SCHED_TYPE_ADV;
 #endif
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    advsm->adv_periodic_txdone_ev.ev_cb = ble_ll_adv_periodic_event_done;
+    advsm->adv_periodic_txdone_ev.ev_arg = advsm;
+    advsm->periodic_sch.cb_arg = advsm;
+    advsm->periodic_sch.sched_cb = ble_ll_adv_periodic_tx_start_cb;
+    advsm->periodic_sch.sched_type = BLE_LL_SCHED_TYPE_PERIODIC;
+#endif
+
     /*XXX Configure instances to be legacy on start */
     advsm->props |= BLE_HCI_LE_SET_EXT_ADV_PROP_SCANNABLE;
     advsm->props |= BLE_HCI_LE_SET_EXT_ADV_PROP_LEGACY;
@@ -3419,3 +4262,39 @@ ble_ll_adv_init(void)
     }
 }
 
+
+#if MYNEWT_VAL(SELFTEST)
+/*
+ * Unit test hooks. These let a test move an advertising set through its
+ * event boundaries without the scheduler or the radio.
+ */
+void
+ble_ll_adv_test_set_enabled(uint8_t instance, uint8_t enabled)
+{
+    g_ble_ll_adv_sm[instance].adv_enabled = enabled;
+}
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+void
+ble_ll_adv_test_set_aux_active(uint8_t instance, uint8_t aux_active)
+{
+    g_ble_ll_adv_sm[instance].aux_active = aux_active;
+}
+#endif
+
+/* Does what the end of an advertising event or auxiliary chain does */
+void
+ble_ll_adv_test_event_end(uint8_t instance)
+{
+    ble_ll_adv_flip_adv_data(&g_ble_ll_adv_sm[instance]);
+}
+
+struct os_mbuf *
+ble_ll_adv_test_get_adv_data(uint8_t instance, int staged)
+{
+    struct ble_ll_adv_sm *advsm;
+
+    advsm = &g_ble_ll_adv_sm[instance];
+    return staged ? advsm->new_adv_data : advsm->adv_data;
+}
+#endif
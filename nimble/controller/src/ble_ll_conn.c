@@ -497,7 +497,7 @@ ble_ll_conn_calc_used_chans(uint8_t *chmap)
     return used_channels;
 }
 
-static uint32_t
+uint32_t
 ble_ll_conn_calc_access_addr(void)
 {
     uint32_t aa;
@@ -683,8 +683,20 @@ ble_ll_conn_csa2_prng(uint16_t counter, uint16_t ch_id)
     return prn_e;
 }
 
-static uint8_t
-ble_ll_conn_calc_dci_csa2(struct ble_ll_conn_sm *conn)
+/**
+ * Determine data channel index using Channel Selection Algorithm #2. This is
+ * shared by connections and periodic advertising trains.
+ *
+ * @param event_cntr    Event counter
+ * @param channel_id    Channel identifier (derived from access address)
+ * @param num_used_chans Number of used channels in channel map
+ * @param chanmap       Channel map
+ *
+ * @return uint8_t Data channel index
+ */
+uint8_t
+ble_ll_conn_calc_dci_csa2_chan(uint16_t event_cntr, uint16_t channel_id,
+                               uint8_t num_used_chans, const uint8_t *chanmap)
 {
     uint16_t channel_unmapped;
     uint8_t remap_index;
@@ -692,7 +704,7 @@ ble_ll_conn_calc_dci_csa2(struct ble_ll_conn_sm *conn)
     uint16_t prn_e;
     uint8_t bitpos;
 
-    prn_e = ble_ll_conn_csa2_prng(conn->event_cntr, conn->channel_id);
+    prn_e = ble_ll_conn_csa2_prng(event_cntr, channel_id);
 
     channel_unmapped = prn_e % 37;
 
@@ -701,13 +713,20 @@ ble_ll_conn_calc_dci_csa2(struct ble_ll_conn_sm *conn)
      * as channel index.
      */
     bitpos = 1 << (channel_unmapped & 0x07);
-    if (conn->chanmap[channel_unmapped >> 3] & bitpos) {
+    if (chanmap[channel_unmapped >> 3] & bitpos) {
         return channel_unmapped;
     }
 
-    remap_index = (conn->num_used_chans * prn_e) / 0x10000;
+    remap_index = (num_used_chans * prn_e) / 0x10000;
 
-    return ble_ll_conn_remapped_channel(remap_index, conn->chanmap);
+    return ble_ll_conn_remapped_channel(remap_index, chanmap);
+}
+
+static uint8_t
+ble_ll_conn_calc_dci_csa2(struct ble_ll_conn_sm *conn)
+{
+    return ble_ll_conn_calc_dci_csa2_chan(conn->event_cntr, conn->channel_id,
+                                          conn->num_used_chans, conn->chanmap);
 }
 #endif
 
@@ -135,6 +135,12 @@ int ble_ll_conn_is_lru(struct ble_ll_conn_sm *s1, struct ble_ll_conn_sm *s2);
 uint32_t ble_ll_conn_get_ce_end_time(void);
 void ble_ll_conn_event_halt(void);
 uint8_t ble_ll_conn_calc_used_chans(uint8_t *chmap);
+uint32_t ble_ll_conn_calc_access_addr(void);
+#if (MYNEWT_VAL(BLE_LL_CFG_FEAT_LE_CSA2) == 1)
+uint8_t ble_ll_conn_calc_dci_csa2_chan(uint16_t event_cntr, uint16_t channel_id,
+                                       uint8_t num_used_chans,
+                                       const uint8_t *chanmap);
+#endif
 void ble_ll_conn_reset_pending_aux_conn_rsp(void);
 bool ble_ll_conn_init_pending_aux_conn_rsp(void);
 /* HCI */
@@ -663,6 +663,9 @@ ble_ll_is_valid_adv_mode(uint8_t ocf)
     case BLE_HCI_OCF_LE_SET_EXT_SCAN_ENABLE:
     case BLE_HCI_OCF_LE_SET_EXT_SCAN_PARAM:
     case BLE_HCI_OCF_LE_SET_EXT_SCAN_RSP_DATA:
+    case BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS:
+    case BLE_HCI_OCF_LE_SET_PER_ADV_DATA:
+    case BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE:
         if (hci_adv_mode == ADV_MODE_LEGACY) {
             return false;
         }
@@ -908,6 +911,17 @@ ble_ll_hci_le_cmd_proc(uint8_t *cmdbuf, uint16_t ocf, uint8_t *rsplen)
         rc =  ble_ll_adv_clear_all();
         break;
 #endif
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+    case BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS:
+        rc = ble_ll_adv_periodic_set_param(cmdbuf);
+        break;
+    case BLE_HCI_OCF_LE_SET_PER_ADV_DATA:
+        rc = ble_ll_adv_periodic_set_data(cmdbuf, len);
+        break;
+    case BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE:
+        rc = ble_ll_adv_periodic_enable(cmdbuf);
+        break;
+#endif
 #if (BLE_LL_BT5_PHY_SUPPORTED == 1)
     case BLE_HCI_OCF_LE_RD_PHY:
         rc = ble_ll_conn_hci_le_rd_phy(cmdbuf, rspbuf, rsplen);
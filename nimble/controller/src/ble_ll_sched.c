@@ -252,6 +252,12 @@ ble_ll_sched_conn_reschedule(struct ble_ll_conn_sm *connsm)
                 ble_ll_scan_aux_data_free((struct ble_ll_aux_data *)
                                           entry->cb_arg);
                 break;
+#endif
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+            case BLE_LL_SCHED_TYPE_PERIODIC:
+                ble_ll_adv_periodic_rmvd_from_sched((struct ble_ll_adv_sm *)
+                                                    entry->cb_arg);
+                break;
 #endif
             default:
                 assert(0);
@@ -900,6 +906,85 @@ ble_ll_sched_adv_new(struct ble_ll_sched_item *sch, ble_ll_sched_adv_new_cb cb,
     return rc;
 }
 
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_PERIODIC_ADV)
+/**
+ * Schedule a periodic advertising event. Unlike other advertising events,
+ * periodic advertising events cannot be moved as scanners synchronized to the
+ * train expect them at the anchor point; if the event overlaps anything
+ * already scheduled it is not scheduled and the caller shall skip it.
+ *
+ * Context: Link Layer task
+ *
+ * @param sch Schedule item with start and end time set
+ *
+ * @return int 0: scheduled; -1: event skipped
+ */
+int
+ble_ll_sched_periodic_adv(struct ble_ll_sched_item *sch)
+{
+    int rc;
+    os_sr_t sr;
+    struct ble_ll_sched_item *entry;
+
+    /* Better be past current time or we just leave */
+    if ((int32_t)(sch->start_time - os_cputime_get32()) < 0) {
+        return -1;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+
+    if (ble_ll_sched_overlaps_current(sch)) {
+        OS_EXIT_CRITICAL(sr);
+        return -1;
+    }
+
+    if (!ble_ll_sched_insert_if_empty(sch)) {
+        rc = 0;
+        goto done;
+    }
+
+    os_cputime_timer_stop(&g_ble_ll_sched_timer);
+
+    rc = 0;
+    TAILQ_FOREACH(entry, &g_ble_ll_sched_q, link) {
+        /* We can insert if before entry in list */
+        if ((int32_t)(sch->end_time - entry->start_time) <= 0) {
+            TAILQ_INSERT_BEFORE(entry, sch, link);
+            sch->enqueued = 1;
+            break;
+        }
+
+        if (ble_ll_sched_is_overlap(sch, entry)) {
+            rc = -1;
+            break;
+        }
+    }
+
+    if (!entry) {
+        TAILQ_INSERT_TAIL(&g_ble_ll_sched_q, sch, link);
+        sch->enqueued = 1;
+    }
+
+done:
+    /* Get head of list to restart timer */
+    entry = TAILQ_FIRST(&g_ble_ll_sched_q);
+
+#ifdef BLE_XCVR_RFCLK
+    if (!rc && (entry == sch)) {
+        ble_ll_xcvr_rfclk_timer_start(sch->start_time);
+    }
+#endif
+
+    OS_EXIT_CRITICAL(sr);
+
+    /* Restart timer */
+    assert(entry != NULL);
+    os_cputime_timer_start(&g_ble_ll_sched_timer, entry->start_time);
+
+    return rc;
+}
+#endif
+
 int
 ble_ll_sched_adv_reschedule(struct ble_ll_sched_item *sch, uint32_t *start,
                             uint32_t max_delay_ticks)
@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "os/os.h"
+#include "testutil/testutil.h"
+#include "nimble/hci_common.h"
+#include "controller/ble_ll_test.h"
+#include "controller/ble_ll_adv.h"
+
+/**
+ * Sets the advertising data of instance 0 from a single HCI command
+ * carrying the specified number of bytes of the specified value.
+ */
+static int
+ble_ll_adv_test_util_set_data(uint8_t val, uint8_t len)
+{
+    uint8_t cmd[1 + BLE_ADV_LEGACY_DATA_MAX_LEN];
+
+    cmd[0] = len;
+    memset(cmd + 1, val, len);
+
+    return ble_ll_adv_set_adv_data(cmd, 0,
+                                   BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE);
+}
+
+static void
+ble_ll_adv_test_util_verify_data(int staged, uint8_t val, uint8_t len)
+{
+    struct os_mbuf *om;
+    uint8_t buf[BLE_ADV_LEGACY_DATA_MAX_LEN];
+    int i;
+
+    om = ble_ll_adv_test_get_adv_data(0, staged);
+    TEST_ASSERT_FATAL(om != NULL);
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) == len);
+
+    os_mbuf_copydata(om, 0, len, buf);
+    for (i = 0; i < len; i++) {
+        TEST_ASSERT(buf[i] == val);
+    }
+}
+
+static void
+ble_ll_adv_test_util_init(void)
+{
+    int rc;
+
+    ble_ll_adv_test_set_enabled(0, 0);
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+    ble_ll_adv_test_set_aux_active(0, 0);
+#endif
+
+    rc = ble_ll_adv_test_util_set_data(0x11, 10);
+    TEST_ASSERT_FATAL(rc == BLE_ERR_SUCCESS);
+    TEST_ASSERT_FATAL(ble_ll_adv_test_get_adv_data(0, 1) == NULL);
+}
+
+TEST_CASE(ble_ll_adv_test_case_data_swap)
+{
+    int num_free;
+    int rc;
+
+    ble_ll_adv_test_util_init();
+    num_free = os_msys_num_free();
+
+    ble_ll_adv_test_set_enabled(0, 1);
+
+    /* Data set while advertising is staged; the current event keeps the old
+     * data.
+     */
+    rc = ble_ll_adv_test_util_set_data(0x22, 20);
+    TEST_ASSERT_FATAL(rc == BLE_ERR_SUCCESS);
+    ble_ll_adv_test_util_verify_data(0, 0x11, 10);
+    ble_ll_adv_test_util_verify_data(1, 0x22, 20);
+
+    /* Only the most recent staged data is kept. */
+    rc = ble_ll_adv_test_util_set_data(0x33, 30);
+    TEST_ASSERT_FATAL(rc == BLE_ERR_SUCCESS);
+    ble_ll_adv_test_util_verify_data(0, 0x11, 10);
+    ble_ll_adv_test_util_verify_data(1, 0x33, 30);
+
+    /* The next event uses the new data. */
+    ble_ll_adv_test_event_end(0);
+    ble_ll_adv_test_util_verify_data(0, 0x33, 30);
+    TEST_ASSERT(ble_ll_adv_test_get_adv_data(0, 1) == NULL);
+
+    /* An event boundary with nothing staged changes nothing. */
+    ble_ll_adv_test_event_end(0);
+    ble_ll_adv_test_util_verify_data(0, 0x33, 30);
+
+    /* The replaced data was freed. */
+    TEST_ASSERT(os_msys_num_free() == num_free);
+}
+
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+TEST_CASE(ble_ll_adv_test_case_data_swap_aux)
+{
+    int rc;
+
+    ble_ll_adv_test_util_init();
+    ble_ll_adv_test_set_enabled(0, 1);
+
+    rc = ble_ll_adv_test_util_set_data(0x22, 20);
+    TEST_ASSERT_FATAL(rc == BLE_ERR_SUCCESS);
+
+    /* The primary event is over, but its auxiliary chain still sends the
+     * current data.
+     */
+    ble_ll_adv_test_set_aux_active(0, 1);
+    ble_ll_adv_test_event_end(0);
+    ble_ll_adv_test_util_verify_data(0, 0x11, 10);
+    ble_ll_adv_test_util_verify_data(1, 0x22, 20);
+
+    /* The chain is done. */
+    ble_ll_adv_test_set_aux_active(0, 0);
+    ble_ll_adv_test_event_end(0);
+    ble_ll_adv_test_util_verify_data(0, 0x22, 20);
+    TEST_ASSERT(ble_ll_adv_test_get_adv_data(0, 1) == NULL);
+}
+#endif
+
+TEST_CASE(ble_ll_adv_test_case_data_superseded)
+{
+    int num_free;
+    int rc;
+
+    ble_ll_adv_test_util_init();
+    num_free = os_msys_num_free();
+
+    ble_ll_adv_test_set_enabled(0, 1);
+    rc = ble_ll_adv_test_util_set_data(0x22, 20);
+    TEST_ASSERT_FATAL(rc == BLE_ERR_SUCCESS);
+
+    /* Advertising stops without reaching an event boundary; data set
+     * afterwards replaces both the current and the staged data.
+     */
+    ble_ll_adv_test_set_enabled(0, 0);
+    rc = ble_ll_adv_test_util_set_data(0x33, 30);
+    TEST_ASSERT_FATAL(rc == BLE_ERR_SUCCESS);
+    ble_ll_adv_test_util_verify_data(0, 0x33, 30);
+    TEST_ASSERT(ble_ll_adv_test_get_adv_data(0, 1) == NULL);
+
+    TEST_ASSERT(os_msys_num_free() == num_free);
+}
+
+TEST_SUITE(ble_ll_adv_test_suite)
+{
+    ble_ll_adv_test_case_data_swap();
+#if MYNEWT_VAL(BLE_LL_CFG_FEAT_LL_EXT_ADV)
+    ble_ll_adv_test_case_data_swap_aux();
+#endif
+    ble_ll_adv_test_case_data_superseded();
+}
+
+int
+ble_ll_adv_test_all(void)
+{
+    ble_ll_adv_test_suite();
+
+    return tu_any_failed;
+}
@@ -31,6 +31,7 @@ main(int argc, char **argv)
     sysinit();
 
     ble_ll_csa2_test_all();
+    ble_ll_adv_test_all();
 
     return tu_any_failed;
 }
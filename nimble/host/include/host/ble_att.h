@@ -77,6 +77,7 @@ struct os_mbuf;
 #define BLE_ATT_OP_INDICATE_REQ             0x1d
 #define BLE_ATT_OP_INDICATE_RSP             0x1e
 #define BLE_ATT_OP_WRITE_CMD                0x52
+#define BLE_ATT_OP_SIGNED_WRITE_CMD         0xd2
 
 #define BLE_ATT_ATTR_MAX_LEN                512
 
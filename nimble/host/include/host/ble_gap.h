@@ -116,6 +116,11 @@ struct hci_conn_update;
 #define BLE_GAP_EVENT_REPEAT_PAIRING        17
 #define BLE_GAP_EVENT_PHY_UPDATE_COMPLETE   18
 #define BLE_GAP_EVENT_EXT_DISC              19
+#define BLE_GAP_EVENT_DISC_BATCH            20
+#define BLE_GAP_EVENT_RECONNECT             21
+#define BLE_GAP_EVENT_PERIODIC_SYNC         22
+#define BLE_GAP_EVENT_PERIODIC_REPORT       23
+#define BLE_GAP_EVENT_PERIODIC_SYNC_LOST    24
 
 /*** Reason codes for the subscribe GAP event. */
 
@@ -225,9 +230,21 @@ struct ble_gap_passkey_params {
 };
 
 #if MYNEWT_VAL(BLE_EXT_ADV)
+/*** Data status of an extended advertising report. */
+#define BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE    0
+#define BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE  1
+#define BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED   2
+
 struct ble_gap_ext_disc_desc {
     /*** Common fields. */
     uint8_t props;
+
+    /**
+     * One of the BLE_GAP_EXT_ADV_DATA_STATUS_[...] values.  If chained
+     * advertising data is reassembled by the host
+     * (BLE_GAP_EXT_ADV_RSM_MAX > 0), reports are only delivered once
+     * complete or truncated.
+     */
     uint8_t data_status;
     uint8_t legacy_event_type;
     ble_addr_t addr;
@@ -236,7 +253,7 @@ struct ble_gap_ext_disc_desc {
     uint8_t sid;
     uint8_t prim_phy;
     uint8_t sec_phy;
-    uint8_t length_data;
+    uint16_t length_data;
     uint8_t *data;
     /***
      * LE direct advertising report fields; direct_addr is BLE_ADDR_ANY if
@@ -347,6 +364,43 @@ struct ble_gap_event {
         struct ble_gap_ext_disc_desc ext_disc;
 #endif
 
+        /**
+         * Represents a batch of advertising reports received during a
+         * discovery procedure, if batching was enabled with
+         * ble_gap_disc_batch_set().  The descriptors, and the advertising
+         * data they point to, are owned by the host and are only valid for
+         * the duration of the callback.  Valid for the following event
+         * types:
+         *     o BLE_GAP_EVENT_DISC_BATCH
+         */
+        struct {
+            /** The reports, in the order they were received. */
+            const struct ble_gap_disc_desc *descs;
+
+            /** The number of reports in the batch. */
+            uint8_t num_descs;
+        } disc_batch;
+
+        /**
+         * Represents progress of a reconnect procedure.  Valid for the
+         * following event types:
+         *     o BLE_GAP_EVENT_RECONNECT
+         */
+        struct {
+            /** The number of target peers connected so far. */
+            uint8_t num_connected;
+
+            /** The total number of target peers. */
+            uint8_t num_targets;
+
+            /**
+             * 0 if the procedure is progressing normally or all peers are
+             * connected; nonzero if the procedure was aborted because the
+             * initiator could not be restarted.
+             */
+            int status;
+        } reconnect;
+
         /**
          * Represents a completed discovery procedure.  Valid for the following
          * event types:
@@ -655,11 +709,112 @@ struct ble_gap_event {
             uint8_t tx_phy;
             uint8_t rx_phy;
         } phy_updated;
+
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+        /**
+         * Represents the outcome of a periodic advertising sync procedure
+         * started with ble_gap_periodic_adv_create_sync().
+         *
+         * Valid for the following event types:
+         *     o BLE_GAP_EVENT_PERIODIC_SYNC
+         */
+        struct {
+            /**
+             * 0 if the sync was established; BLE_HS_EAPP if the procedure
+             * was cancelled; other error codes on failure.
+             */
+            int status;
+
+            /** The handle of the sync; valid if status=0. */
+            uint16_t sync_handle;
+
+            /** Advertising set ID of the periodic advertiser. */
+            uint8_t sid;
+
+            /** Address of the periodic advertiser. */
+            ble_addr_t adv_addr;
+
+            /** PHY used by the periodic advertising train. */
+            uint8_t adv_phy;
+
+            /** Periodic advertising interval (units of 1.25 ms). */
+            uint16_t per_adv_itvl;
+
+            /** Clock accuracy of the periodic advertiser. */
+            uint8_t adv_clk_accuracy;
+        } periodic_sync;
+
+        /**
+         * Represents a periodic advertising report received on an
+         * established sync.  The data is owned by the host and is only valid
+         * for the duration of the callback.
+         *
+         * Valid for the following event types:
+         *     o BLE_GAP_EVENT_PERIODIC_REPORT
+         */
+        struct {
+            /** The handle of the sync the report was received on. */
+            uint16_t sync_handle;
+
+            /** Advertiser's transmit power (127 if not available). */
+            int8_t tx_power;
+
+            /** Received signal strength indication (127 if not available). */
+            int8_t rssi;
+
+            /** One of the BLE_GAP_EXT_ADV_DATA_STATUS_[...] values. */
+            uint8_t data_status;
+
+            /** Length of the advertising data. */
+            uint8_t data_length;
+
+            /** Advertising data. */
+            const uint8_t *data;
+        } periodic_report;
+
+        /**
+         * Represents the loss of an established periodic advertising sync.
+         * The sync handle is no longer valid when this event is reported.
+         *
+         * Valid for the following event types:
+         *     o BLE_GAP_EVENT_PERIODIC_SYNC_LOST
+         */
+        struct {
+            /** The handle of the sync that was lost. */
+            uint16_t sync_handle;
+
+            /**
+             * The reason the sync was lost:
+             *     o BLE_HS_ETIMEOUT: Sync timeout expired.
+             *     o BLE_HS_EDONE: Sync terminated by the host.
+             */
+            int reason;
+        } periodic_sync_lost;
+#endif
     };
 };
 
 typedef int ble_gap_event_fn(struct ble_gap_event *event, void *arg);
 
+/** Converts a BLE_GAP_EVENT_[...] code into a listener event mask bit. */
+#define BLE_GAP_EVENT_MASK(type)            (1UL << (type))
+
+/** Listener event mask matching all GAP event types. */
+#define BLE_GAP_EVENT_MASK_ALL              0xffffffffUL
+
+/**
+ * A GAP event listener.  Listeners receive GAP events in addition to the
+ * callback associated with the relevant procedure or connection; only the
+ * event types selected by the listener's mask are delivered.  The structure
+ * is owned by the application and must remain valid until unregistered.
+ */
+struct ble_gap_event_listener {
+    ble_gap_event_fn *fn;
+    void *arg;
+    uint32_t event_mask;
+    SLIST_ENTRY(ble_gap_event_listener) link;
+};
+
 #define BLE_GAP_CONN_MODE_NON               0
 #define BLE_GAP_CONN_MODE_DIR               1
 #define BLE_GAP_CONN_MODE_UND               2
@@ -671,6 +826,10 @@ typedef int ble_gap_event_fn(struct ble_gap_event *event, void *arg);
 int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc);
 int ble_gap_set_event_cb(uint16_t conn_handle,
                          ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_event_listener_register(struct ble_gap_event_listener *listener,
+                                    uint32_t event_mask,
+                                    ble_gap_event_fn *fn, void *arg);
+int ble_gap_event_listener_unregister(struct ble_gap_event_listener *listener);
 
 int ble_gap_adv_start(uint8_t own_addr_type, const ble_addr_t *direct_addr,
                       int32_t duration_ms,
@@ -682,6 +841,8 @@ int ble_gap_adv_set_data(const uint8_t *data, int data_len);
 int ble_gap_adv_rsp_set_data(const uint8_t *data, int data_len);
 int ble_gap_adv_set_fields(const struct ble_hs_adv_fields *rsp_fields);
 int ble_gap_adv_rsp_set_fields(const struct ble_hs_adv_fields *rsp_fields);
+int ble_gap_adv_update_data(uint8_t instance, const uint8_t *data,
+                            uint8_t data_len);
 
 #if MYNEWT_VAL(BLE_EXT_ADV)
 struct ble_gap_ext_adv_params {
@@ -718,6 +879,43 @@ int ble_gap_ext_adv_rsp_set_data(uint8_t instance, struct os_mbuf *data);
 int ble_gap_ext_adv_remove(uint8_t instance);
 #endif
 
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+/** Periodic advertising parameters. */
+struct ble_gap_periodic_adv_params {
+    /** If set, the advertiser's TX power is included in each PDU. */
+    unsigned int include_tx_power:1;
+
+    /** Minimum periodic advertising interval (units of 1.25 ms). */
+    uint16_t itvl_min;
+
+    /** Maximum periodic advertising interval (units of 1.25 ms). */
+    uint16_t itvl_max;
+};
+
+/** Periodic advertising sync parameters. */
+struct ble_gap_periodic_sync_params {
+    /**
+     * The maximum number of periodic advertising events that can be
+     * skipped after a successful receive.
+     */
+    uint16_t skip;
+
+    /** Synchronization timeout (units of 10 ms). */
+    uint16_t sync_timeout;
+};
+
+int ble_gap_periodic_adv_configure(uint8_t instance,
+                                   const struct ble_gap_periodic_adv_params *params);
+int ble_gap_periodic_adv_set_data(uint8_t instance, struct os_mbuf *data);
+int ble_gap_periodic_adv_start(uint8_t instance);
+int ble_gap_periodic_adv_stop(uint8_t instance);
+int ble_gap_periodic_adv_create_sync(const ble_addr_t *addr, uint8_t adv_sid,
+                                     const struct ble_gap_periodic_sync_params *params,
+                                     ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_periodic_adv_create_sync_cancel(void);
+int ble_gap_periodic_adv_terminate_sync(uint16_t sync_handle);
+#endif
+
 int ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms,
                  const struct ble_gap_disc_params *disc_params,
                  ble_gap_event_fn *cb, void *cb_arg);
@@ -729,6 +927,7 @@ int ble_gap_ext_disc(uint8_t own_addr_type, uint16_t duration, uint16_t period,
                      ble_gap_event_fn *cb, void *cb_arg);
 int ble_gap_disc_cancel(void);
 int ble_gap_disc_active(void);
+int ble_gap_disc_batch_set(uint8_t max_reports, uint32_t window_ms);
 int ble_gap_connect(uint8_t own_addr_type, const ble_addr_t *peer_addr,
                     int32_t duration_ms,
                     const struct ble_gap_conn_params *params,
@@ -740,11 +939,40 @@ int ble_gap_ext_connect(uint8_t own_addr_type, const ble_addr_t *peer_addr,
                         const struct ble_gap_conn_params *phy_coded_conn_params,
                         ble_gap_event_fn *cb, void *cb_arg);
 int ble_gap_conn_cancel(void);
+int ble_gap_reconnect_start(uint8_t own_addr_type, const ble_addr_t *addrs,
+                            uint8_t num_addrs,
+                            const struct ble_gap_conn_params *conn_params,
+                            ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_reconnect_stop(void);
 int ble_gap_conn_active(void);
 int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason);
 int ble_gap_wl_set(const ble_addr_t *addrs, uint8_t white_list_count);
 int ble_gap_update_params(uint16_t conn_handle,
                           const struct ble_gap_upd_params *params);
+
+/** Statistics of a link managed by the connection parameter planner. */
+struct ble_gap_plan_link_stats {
+    /** The interval assigned by the planner, in 1.25 ms units. */
+    uint16_t planned_itvl;
+
+    /** The interval currently in effect, in 1.25 ms units. */
+    uint16_t conn_itvl;
+
+    /**
+     * The number of parameter updates completed since the link was planned.
+     */
+    uint16_t num_updates;
+
+    /** The number of those updates that landed on the planned interval. */
+    uint16_t num_on_plan;
+};
+
+int ble_gap_plan_configure(uint16_t base_itvl, uint16_t ce_len);
+int ble_gap_plan_link(uint16_t conn_handle, uint16_t max_itvl,
+                      uint16_t latency, uint16_t supervision_timeout);
+int ble_gap_plan_unlink(uint16_t conn_handle);
+int ble_gap_plan_link_stats(uint16_t conn_handle,
+                            struct ble_gap_plan_link_stats *out_stats);
 int ble_gap_security_initiate(uint16_t conn_handle);
 int ble_gap_pair_initiate(uint16_t conn_handle);
 int ble_gap_encryption_initiate(uint16_t conn_handle, const uint8_t *ltk,
@@ -172,6 +172,8 @@ int ble_gattc_write_no_rsp(uint16_t conn_handle, uint16_t attr_handle,
                            struct os_mbuf *om);
 int ble_gattc_write_no_rsp_flat(uint16_t conn_handle, uint16_t attr_handle,
                                 const void *data, uint16_t data_len);
+int ble_gattc_signed_write(uint16_t conn_handle, uint16_t attr_handle,
+                           struct os_mbuf *om);
 int ble_gattc_write(uint16_t conn_handle, uint16_t attr_handle,
                     struct os_mbuf *om,
                     ble_gatt_attr_fn *cb, void *cb_arg);
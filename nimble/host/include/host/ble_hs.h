@@ -158,6 +158,18 @@ struct ble_hs_cfg {
     ble_store_write_fn *store_write_cb;
     ble_store_delete_fn *store_delete_cb;
 
+    /**
+     * Optional.  Lets the store visit all matching CCCD records in a single
+     * pass when a characteristic changes.  If not set, the host falls back
+     * to repeated reads with increasing key indices.
+     */
+    ble_store_iterate_fn *store_iterate_cb;
+
+    /**
+     * Optional.  Writes objects whose persistence the store has deferred.
+     */
+    ble_store_flush_fn *store_flush_cb;
+
     /**
      * This callback gets executed when a persistence operation cannot be
      * performed or a persistence failure is imminent.  For example, if is
@@ -171,11 +183,32 @@ struct ble_hs_cfg {
 
 extern struct ble_hs_cfg ble_hs_cfg;
 
+/**
+ * Lock contention statistics for a single call site.  Only collected when
+ * BLE_HS_LOCK_STATS is enabled.
+ */
+struct ble_hs_lock_stats {
+    /** Name of the function that acquired the lock. */
+    const char *site;
+
+    /** Number of times the lock was acquired at this site. */
+    uint32_t acquisitions;
+
+    /** Number of acquisitions that had to wait for another task. */
+    uint32_t contended;
+
+    /** Total and worst-case wait time, in OS ticks. */
+    uint32_t wait_ticks;
+    uint32_t max_wait_ticks;
+};
+
 int ble_hs_synced(void);
 int ble_hs_start(void);
 void ble_hs_sched_reset(int reason);
 void ble_hs_evq_set(struct os_eventq *evq);
 void ble_hs_init(void);
+int ble_hs_lock_stats_get(int idx, struct ble_hs_lock_stats *out_stats);
+void ble_hs_lock_stats_clear(void);
 
 #ifdef __cplusplus
 }
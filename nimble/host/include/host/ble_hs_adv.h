@@ -21,6 +21,7 @@
 #define H_BLE_HS_ADV_
 
 #include <inttypes.h>
+#include "nimble/ble.h"
 #include "host/ble_uuid.h"
 
 #ifdef __cplusplus
@@ -167,9 +168,96 @@ int ble_hs_adv_set_fields(const struct ble_hs_adv_fields *adv_fields,
 int ble_hs_adv_parse_fields(struct ble_hs_adv_fields *adv_fields, uint8_t *src,
                             uint8_t src_len);
 
-int ble_hs_adv_parse(const uint8_t *data, uint8_t length,
+int ble_hs_adv_parse(const uint8_t *data, uint16_t length,
                      ble_hs_adv_parse_func_t func, void *user_data);
 
+/*** Lazy AD parsing. */
+
+/**
+ * Cursor over the AD structures of a raw advertising payload.  The iterator
+ * holds no state besides its position, and the fields it yields point into
+ * the payload, so it can be used from any task without copying.
+ */
+struct ble_hs_adv_iter {
+    const uint8_t *data;
+    uint16_t length;
+    uint16_t off;
+};
+
+void ble_hs_adv_iter_init(struct ble_hs_adv_iter *iter, const uint8_t *data,
+                          uint16_t length);
+int ble_hs_adv_iter_next(struct ble_hs_adv_iter *iter,
+                         const struct ble_hs_adv_field **out_field);
+
+int ble_hs_adv_field_num_uuids(const struct ble_hs_adv_field *field,
+                               int *out_num);
+int ble_hs_adv_field_uuid(const struct ble_hs_adv_field *field, int idx,
+                          ble_uuid_any_t *out_uuid);
+
+/** One entry of a multi-field extract request. */
+struct ble_hs_adv_extract {
+    /** The AD type to look for. */
+    uint8_t type;
+
+    /**
+     * Filled in with the first structure of the requested type, or NULL if
+     * the payload does not contain one.
+     */
+    const struct ble_hs_adv_field *field;
+};
+
+int ble_hs_adv_extract(const uint8_t *data, uint16_t length,
+                       struct ble_hs_adv_extract *reqs, int num_reqs);
+
+/*** Advertising report filters. */
+
+/** Filter criteria.  A filter matches a report if all of its criteria do. */
+#define BLE_HS_ADV_FILT_F_ADDR                  0x01
+#define BLE_HS_ADV_FILT_F_AD_TYPE               0x02
+#define BLE_HS_ADV_FILT_F_MFG                   0x04
+#define BLE_HS_ADV_FILT_F_UUID                  0x08
+#define BLE_HS_ADV_FILT_F_RSSI                  0x10
+
+#define BLE_HS_ADV_FILT_MFG_PREFIX_MAX          8
+
+struct ble_hs_adv_filt {
+    /** The criteria to check (BLE_HS_ADV_FILT_F_[...]). */
+    uint8_t criteria;
+
+    /**
+     * The advertiser's address must start with the first addr_len bytes of
+     * this address, as it is normally written (most significant byte first).
+     * A length of 6 requires an exact match.  The address type is ignored.
+     */
+    ble_addr_t addr;
+    uint8_t addr_len;
+
+    /** An AD structure of this type must be present. */
+    uint8_t ad_type;
+
+    /**
+     * Manufacturer specific data must be present, carry this company
+     * identifier, and start with the specified prefix (may be empty).
+     */
+    uint16_t mfg_id;
+    uint8_t mfg_prefix[BLE_HS_ADV_FILT_MFG_PREFIX_MAX];
+    uint8_t mfg_prefix_len;
+
+    /**
+     * This service UUID must be listed in a service UUID list, or be the
+     * UUID of a service data structure.
+     */
+    ble_uuid_any_t uuid;
+
+    /** The report's RSSI must be at least this value, in dBm. */
+    int8_t rssi_min;
+};
+
+int ble_hs_adv_filt_set(const struct ble_hs_adv_filt *filts, int num_filts);
+int ble_hs_adv_filt_hits(int idx, uint32_t *out_hits);
+
+int ble_hs_adv_dedup_set(int enable, uint32_t expiry_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,7 @@ int ble_hs_id_set_rnd(const uint8_t *rnd_addr);
 int ble_hs_id_copy_addr(uint8_t id_addr_type, uint8_t *out_id_addr,
                         int *out_is_nrpa);
 int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type);
+int ble_hs_id_resolve_rpa(const ble_addr_t *addr, ble_addr_t *out_id_addr);
 
 #ifdef __cplusplus
 }
@@ -41,6 +41,7 @@ int ble_gatts_notify_test_all(void);
 int ble_gatts_read_test_suite(void);
 int ble_gatts_reg_test_all(void);
 int ble_hs_adv_test_all(void);
+int ble_hs_aes_cache_test_all(void);
 int ble_hs_conn_test_all(void);
 int ble_hs_hci_test_all(void);
 int ble_hs_id_test_all(void);
@@ -85,6 +85,14 @@ struct ble_store_value_sec {
 
     unsigned authenticated:1;
     uint8_t sc:1;
+
+    /**
+     * Data signing counter (CSRK).  In an our_sec record, this is the first
+     * SignCounter not yet reserved for outgoing signed writes.  In a peer_sec
+     * record, it is the lowest SignCounter that will still be accepted from
+     * the peer.
+     */
+    uint32_t sign_counter;
 };
 
 /**
@@ -249,6 +257,7 @@ int ble_store_read(int obj_type, const union ble_store_key *key,
                    union ble_store_value *val);
 int ble_store_write(int obj_type, const union ble_store_value *val);
 int ble_store_delete(int obj_type, const union ble_store_key *key);
+int ble_store_flush(void);
 int ble_store_overflow_event(int obj_type, const union ble_store_value *value);
 int ble_store_full_event(int obj_type, uint16_t conn_handle);
 
@@ -279,6 +288,37 @@ typedef int ble_store_iterator_fn(int obj_type,
                                   union ble_store_value *val,
                                   void *cookie);
 
+/**
+ * Calls the specified function for each object in the store matching the
+ * specified criteria.  The idx field of the key is ignored.  Iteration stops
+ * early if the callback returns nonzero.
+ *
+ * The host calls this with its store lock held, and only for its own
+ * per-characteristic CCCD walks; ble_store_iterate() does not use it.  The
+ * callback may rewrite the object it is passed, but must not add or delete
+ * objects of the type being iterated.
+ *
+ * @param obj_type              The type of object to iterate; one of the
+ *                                  BLE_STORE_OBJ_TYPE_[...] codes.
+ * @param key                   Specifies properties of the objects to visit.
+ * @param cb                    The function to call for each match.
+ * @param cookie                Optional argument passed to the callback.
+ *
+ * @return                      0 on success;
+ *                              Other nonzero on error.
+ */
+typedef int ble_store_iterate_fn(int obj_type, const union ble_store_key *key,
+                                 ble_store_iterator_fn *cb, void *cookie);
+
+/**
+ * Writes any modified objects the store is holding in RAM to persistent
+ * storage.
+ *
+ * @return                      0 on success;
+ *                              Other nonzero on error.
+ */
+typedef int ble_store_flush_fn(void);
+
 int ble_store_iterate(int obj_type,
                       ble_store_iterator_fn *callback,
                       void *cookie);
@@ -36,6 +36,7 @@
 #include "host/ble_uuid.h"
 #include "../src/ble_sm_priv.h"
 #include "../src/ble_hs_hci_priv.h"
+#include "../src/ble_hs_aes_cache_priv.h"
 
 #include "tinycrypt/aes.h"
 #include "tinycrypt/constants.h"
@@ -31,7 +31,7 @@ int bt_mesh_aes_cmac(const u8_t key[16], struct bt_mesh_sg *sg,
 	struct tc_aes_key_sched_struct sched;
 	struct tc_cmac_struct state;
 
-	if (tc_cmac_setup(&state, key, &sched) == TC_CRYPTO_FAIL) {
+	if (ble_hs_aes_cache_cmac_setup(&state, key, &sched) != 0) {
 		return -EIO;
 	}
 
@@ -195,6 +195,17 @@ int bt_mesh_id128(const u8_t n[16], const char *s, u8_t out[16])
 	return bt_mesh_k1(n, 16, salt, id128, out);
 }
 
+/* Encrypts one CCM block with a key schedule expanded once per message. */
+static int bt_mesh_ccm_block(struct tc_aes_key_sched_struct *sched,
+			     const u8_t plaintext[16], u8_t enc_data[16])
+{
+	if (tc_aes_encrypt(enc_data, plaintext, sched) == TC_CRYPTO_FAIL) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
 static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 			       const u8_t *enc_msg, size_t msg_len,
 			       const u8_t *aad, size_t aad_len,
@@ -203,18 +214,24 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 	u8_t msg[16], pmsg[16], cmic[16], cmsg[16], Xn[16], mic[16];
 	u16_t last_blk, blk_cnt;
 	size_t i, j;
+	struct tc_aes_key_sched_struct sched;
 	int err;
 
 	if (msg_len < 1 || aad_len >= 0xff00) {
 		return -EINVAL;
 	}
 
+	err = ble_hs_aes_cache_sched(key, &sched);
+	if (err) {
+		return -EIO;
+	}
+
 	/* C_mic = e(AppKey, 0x01 || nonce || 0x0000) */
 	pmsg[0] = 0x01;
 	memcpy(pmsg + 1, nonce, 13);
 	sys_put_be16(0x0000, pmsg + 14);
 
-	err = bt_encrypt_be(key, pmsg, cmic);
+	err = bt_mesh_ccm_block(&sched, pmsg, cmic);
 	if (err) {
 		return err;
 	}
@@ -229,7 +246,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 	memcpy(pmsg + 1, nonce, 13);
 	sys_put_be16(msg_len, pmsg + 14);
 
-	err = bt_encrypt_be(key, pmsg, Xn);
+	err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 	if (err) {
 		return err;
 	}
@@ -253,7 +270,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 			aad_len -= 16;
 			i = 0;
 
-			err = bt_encrypt_be(key, pmsg, Xn);
+			err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 			if (err) {
 				return err;
 			}
@@ -267,7 +284,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 			pmsg[i] = Xn[i];
 		}
 
-		err = bt_encrypt_be(key, pmsg, Xn);
+		err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 		if (err) {
 			return err;
 		}
@@ -286,7 +303,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 			memcpy(pmsg + 1, nonce, 13);
 			sys_put_be16(j + 1, pmsg + 14);
 
-			err = bt_encrypt_be(key, pmsg, cmsg);
+			err = bt_mesh_ccm_block(&sched, pmsg, cmsg);
 			if (err) {
 				return err;
 			}
@@ -307,7 +324,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 				pmsg[i] = Xn[i] ^ 0x00;
 			}
 
-			err = bt_encrypt_be(key, pmsg, Xn);
+			err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 			if (err) {
 				return err;
 			}
@@ -322,7 +339,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 			memcpy(pmsg + 1, nonce, 13);
 			sys_put_be16(j + 1, pmsg + 14);
 
-			err = bt_encrypt_be(key, pmsg, cmsg);
+			err = bt_mesh_ccm_block(&sched, pmsg, cmsg);
 			if (err) {
 				return err;
 			}
@@ -339,7 +356,7 @@ static int bt_mesh_ccm_decrypt(const u8_t key[16], u8_t nonce[13],
 				pmsg[i] = Xn[i] ^ msg[i];
 			}
 
-			err = bt_encrypt_be(key, pmsg, Xn);
+			err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 			if (err) {
 				return err;
 			}
@@ -361,6 +378,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 	u8_t pmsg[16], cmic[16], cmsg[16], mic[16], Xn[16];
 	u16_t blk_cnt, last_blk;
 	size_t i, j;
+	struct tc_aes_key_sched_struct sched;
 	int err;
 
 	BT_DBG("key %s", bt_hex(key, 16));
@@ -373,12 +391,17 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 		return -EINVAL;
 	}
 
+	err = ble_hs_aes_cache_sched(key, &sched);
+	if (err) {
+		return -EIO;
+	}
+
 	/* C_mic = e(AppKey, 0x01 || nonce || 0x0000) */
 	pmsg[0] = 0x01;
 	memcpy(pmsg + 1, nonce, 13);
 	sys_put_be16(0x0000, pmsg + 14);
 
-	err = bt_encrypt_be(key, pmsg, cmic);
+	err = bt_mesh_ccm_block(&sched, pmsg, cmic);
 	if (err) {
 		return err;
 	}
@@ -393,7 +416,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 	memcpy(pmsg + 1, nonce, 13);
 	sys_put_be16(msg_len, pmsg + 14);
 
-	err = bt_encrypt_be(key, pmsg, Xn);
+	err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 	if (err) {
 		return err;
 	}
@@ -417,7 +440,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 			aad_len -= 16;
 			i = 0;
 
-			err = bt_encrypt_be(key, pmsg, Xn);
+			err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 			if (err) {
 				return err;
 			}
@@ -431,7 +454,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 			pmsg[i] = Xn[i];
 		}
 
-		err = bt_encrypt_be(key, pmsg, Xn);
+		err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 		if (err) {
 			return err;
 		}
@@ -453,7 +476,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 				pmsg[i] = Xn[i] ^ 0x00;
 			}
 
-			err = bt_encrypt_be(key, pmsg, Xn);
+			err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 			if (err) {
 				return err;
 			}
@@ -468,7 +491,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 			memcpy(pmsg + 1, nonce, 13);
 			sys_put_be16(j + 1, pmsg + 14);
 
-			err = bt_encrypt_be(key, pmsg, cmsg);
+			err = bt_mesh_ccm_block(&sched, pmsg, cmsg);
 			if (err) {
 				return err;
 			}
@@ -484,7 +507,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 				pmsg[i] = Xn[i] ^ msg[(j * 16) + i];
 			}
 
-			err = bt_encrypt_be(key, pmsg, Xn);
+			err = bt_mesh_ccm_block(&sched, pmsg, Xn);
 			if (err) {
 				return err;
 			}
@@ -494,7 +517,7 @@ static int bt_mesh_ccm_encrypt(const u8_t key[16], u8_t nonce[13],
 			memcpy(pmsg + 1, nonce, 13);
 			sys_put_be16(j + 1, pmsg + 14);
 
-			err = bt_encrypt_be(key, pmsg, cmsg);
+			err = bt_mesh_ccm_block(&sched, pmsg, cmsg);
 			if (err) {
 				return err;
 			}
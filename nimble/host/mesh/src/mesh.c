@@ -133,6 +133,8 @@ void bt_mesh_reset(void)
 
 	memset(bt_mesh.dev_key, 0, sizeof(bt_mesh.dev_key));
 
+	ble_hs_aes_cache_clear();
+
 	memset(bt_mesh.rpl, 0, sizeof(bt_mesh.rpl));
 
 	provisioned = false;
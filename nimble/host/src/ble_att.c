@@ -59,6 +59,7 @@ static const struct ble_att_rx_dispatch_entry ble_att_rx_dispatch[] = {
     { BLE_ATT_OP_INDICATE_REQ,         ble_att_svr_rx_indicate },
     { BLE_ATT_OP_INDICATE_RSP,         ble_att_clt_rx_indicate },
     { BLE_ATT_OP_WRITE_CMD,            ble_att_svr_rx_write_no_rsp },
+    { BLE_ATT_OP_SIGNED_WRITE_CMD,     ble_att_svr_rx_signed_write },
 };
 
 #define BLE_ATT_RX_DISPATCH_SZ \
@@ -120,6 +121,8 @@ STATS_NAME_START(ble_att_stats)
     STATS_NAME(ble_att_stats, indicate_rsp_tx)
     STATS_NAME(ble_att_stats, write_cmd_rx)
     STATS_NAME(ble_att_stats, write_cmd_tx)
+    STATS_NAME(ble_att_stats, signed_write_cmd_rx)
+    STATS_NAME(ble_att_stats, signed_write_cmd_tx)
 STATS_NAME_END(ble_att_stats)
 
 static const struct ble_att_rx_dispatch_entry *
@@ -262,6 +265,10 @@ ble_att_inc_tx_stat(uint8_t att_op)
         STATS_INC(ble_att_stats, write_cmd_tx);
         break;
 
+    case BLE_ATT_OP_SIGNED_WRITE_CMD:
+        STATS_INC(ble_att_stats, signed_write_cmd_tx);
+        break;
+
     default:
         break;
     }
@@ -379,6 +386,10 @@ ble_att_inc_rx_stat(uint8_t att_op)
         STATS_INC(ble_att_stats, write_cmd_rx);
         break;
 
+    case BLE_ATT_OP_SIGNED_WRITE_CMD:
+        STATS_INC(ble_att_stats, signed_write_cmd_rx);
+        break;
+
     default:
         break;
     }
@@ -779,6 +779,51 @@ ble_att_clt_tx_write_cmd(uint16_t conn_handle, uint16_t handle,
     return ble_att_tx(conn_handle, txom2);
 }
 
+int
+ble_att_clt_tx_signed_write_cmd(uint16_t conn_handle, uint16_t handle,
+                                struct os_mbuf *txom)
+{
+#if !NIMBLE_BLE_ATT_CLT_SIGNED_WRITE
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct ble_att_write_cmd *cmd;
+    struct os_mbuf *txom2;
+    int rc;
+
+    /* The signature must not be truncated to fit the MTU. */
+    if (OS_MBUF_PKTLEN(txom) >
+        ble_att_mtu(conn_handle) - BLE_ATT_SIGNED_WRITE_CMD_BASE_SZ -
+                                   BLE_ATT_SIGNATURE_SZ) {
+        rc = BLE_HS_EMSGSIZE;
+        goto err;
+    }
+
+    cmd = ble_att_cmd_get(BLE_ATT_OP_SIGNED_WRITE_CMD, sizeof(*cmd), &txom2);
+    if (cmd == NULL) {
+        rc = BLE_HS_ENOMEM;
+        goto err;
+    }
+
+    cmd->handle = htole16(handle);
+    os_mbuf_concat(txom2, txom);
+
+    BLE_ATT_LOG_CMD(1, "signed write cmd", conn_handle,
+                    ble_att_write_cmd_log, cmd);
+
+    rc = ble_sm_sign_tx(conn_handle, txom2);
+    if (rc != 0) {
+        os_mbuf_free_chain(txom2);
+        return rc;
+    }
+
+    return ble_att_tx(conn_handle, txom2);
+
+err:
+    os_mbuf_free_chain(txom);
+    return rc;
+}
+
 int
 ble_att_clt_rx_write(uint16_t conn_handle, struct os_mbuf **rxom)
 {
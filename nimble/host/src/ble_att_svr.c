@@ -240,9 +240,18 @@ ble_att_svr_get_sec_state(uint16_t conn_handle,
     ble_hs_unlock();
 }
 
+/**
+ * Checks whether the specified attribute may be accessed over a connection.
+ *
+ * @param sig_sec_state         If the request was authenticated by a data
+ *                                  signature, the security state granted by
+ *                                  the signature; NULL to check against the
+ *                                  link's own security state.
+ */
 static int
 ble_att_svr_check_perms(uint16_t conn_handle, int is_read,
                         struct ble_att_svr_entry *entry,
+                        const struct ble_gap_sec_state *sig_sec_state,
                         uint8_t *out_att_err)
 {
     struct ble_gap_sec_state sec_state;
@@ -280,7 +289,11 @@ ble_att_svr_check_perms(uint16_t conn_handle, int is_read,
         return 0;
     }
 
-    ble_att_svr_get_sec_state(conn_handle, &sec_state);
+    if (sig_sec_state != NULL) {
+        sec_state = *sig_sec_state;
+    } else {
+        ble_att_svr_get_sec_state(conn_handle, &sec_state);
+    }
     if ((enc || authen) && !sec_state.encrypted) {
         ble_hs_lock();
         conn = ble_hs_conn_find(conn_handle);
@@ -385,7 +398,7 @@ ble_att_svr_read(uint16_t conn_handle,
     att_err = 0;    /* Silence gcc warning. */
 
     if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
-        rc = ble_att_svr_check_perms(conn_handle, 1, entry, &att_err);
+        rc = ble_att_svr_check_perms(conn_handle, 1, entry, NULL, &att_err);
         if (rc != 0) {
             goto err;
         }
@@ -519,7 +532,9 @@ err:
 
 static int
 ble_att_svr_write(uint16_t conn_handle, struct ble_att_svr_entry *entry,
-                  uint16_t offset, struct os_mbuf **om, uint8_t *out_att_err)
+                  uint16_t offset, struct os_mbuf **om,
+                  const struct ble_gap_sec_state *sig_sec_state,
+                  uint8_t *out_att_err)
 {
     uint8_t att_err = 0;
     int rc;
@@ -527,7 +542,8 @@ ble_att_svr_write(uint16_t conn_handle, struct ble_att_svr_entry *entry,
     BLE_HS_DBG_ASSERT(!ble_hs_locked_by_cur_task());
 
     if (conn_handle != BLE_HS_CONN_HANDLE_NONE) {
-        rc = ble_att_svr_check_perms(conn_handle, 0, entry, &att_err);
+        rc = ble_att_svr_check_perms(conn_handle, 0, entry, sig_sec_state,
+                                     &att_err);
         if (rc != 0) {
             goto done;
         }
@@ -565,7 +581,7 @@ ble_att_svr_write_handle(uint16_t conn_handle, uint16_t attr_handle,
         return BLE_HS_ENOENT;
     }
 
-    rc = ble_att_svr_write(conn_handle, entry, offset, om, out_att_err);
+    rc = ble_att_svr_write(conn_handle, entry, offset, om, NULL, out_att_err);
     if (rc != 0) {
         return rc;
     }
@@ -2091,6 +2107,51 @@ ble_att_svr_rx_write_no_rsp(uint16_t conn_handle, struct os_mbuf **rxom)
     return ble_att_svr_write_handle(conn_handle, handle, 0, rxom, &att_err);
 }
 
+int
+ble_att_svr_rx_signed_write(uint16_t conn_handle, struct os_mbuf **rxom)
+{
+#if !MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct ble_gap_sec_state sig_sec_state;
+    struct ble_att_svr_entry *entry;
+    struct ble_att_write_cmd *cmd;
+    uint16_t handle;
+    int rc;
+
+    rc = ble_att_svr_pullup_req_base(rxom,
+                                     sizeof(*cmd) + BLE_ATT_SIGNATURE_SZ,
+                                     NULL);
+    if (rc != 0) {
+        return rc;
+    }
+
+    cmd = (struct ble_att_write_cmd *)(*rxom)->om_data;
+    BLE_ATT_LOG_CMD(0, "signed write cmd", conn_handle,
+                    ble_att_write_cmd_log, cmd);
+
+    handle = le16toh(cmd->handle);
+
+    /* Commands get no response; a PDU that fails verification is dropped. */
+    rc = ble_sm_sign_rx(conn_handle, BLE_ATT_OP_SIGNED_WRITE_CMD, *rxom,
+                        &sig_sec_state);
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* Strip the command base from the front of the mbuf. */
+    os_mbuf_adj(*rxom, sizeof(*cmd));
+
+    entry = ble_att_svr_find_by_handle(handle);
+    if (entry == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    return ble_att_svr_write(conn_handle, entry, 0, rxom, &sig_sec_state,
+                             NULL);
+}
+
 /**
  * Writes a locally registered attribute.  This function consumes the supplied
  * mbuf regardless of the outcome.  If the specified attribute handle
@@ -2297,7 +2358,7 @@ ble_att_svr_prep_write(uint16_t conn_handle,
         attr = ble_att_svr_find_by_handle(attr_handle);
         BLE_HS_DBG_ASSERT(attr != NULL);
 
-        rc = ble_att_svr_write(conn_handle, attr, 0, &om, &att_err);
+        rc = ble_att_svr_write(conn_handle, attr, 0, &om, NULL, &att_err);
         os_mbuf_free_chain(om);
         if (rc != 0) {
             *err_handle = attr_handle;
@@ -2415,7 +2476,7 @@ ble_att_svr_rx_prep_write(uint16_t conn_handle, struct os_mbuf **rxom)
     }
 
     /* <1>, <2>, <4>, <6> */
-    rc = ble_att_svr_check_perms(conn_handle, 0, attr_entry, &att_err);
+    rc = ble_att_svr_check_perms(conn_handle, 0, attr_entry, NULL, &att_err);
     if (rc != 0) {
         goto done;
     }
@@ -154,6 +154,11 @@ struct ble_gap_slave_state {
     unsigned int legacy_pdu:1;
     unsigned int rnd_addr_set:1;
 
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    unsigned int periodic_configured:1;
+    unsigned int periodic_op:1; /** Set to 1 if periodic adv is enabled. */
+#endif
+
 /* timer is used only with legacy advertising */
 #if !MYNEWT_VAL(BLE_EXT_ADV)
     unsigned int exp_set:1;
@@ -180,12 +185,103 @@ struct ble_gap_snapshot {
     void *cb_arg;
 };
 
+static SLIST_HEAD(ble_gap_event_listener_list, ble_gap_event_listener)
+    ble_gap_event_listener_list;
+static uint8_t ble_gap_event_listener_num;
+
+/**
+ * Union of the event masks of all registered listeners.  Lets the dispatch
+ * path reject event types no listener is interested in without walking the
+ * listener list.
+ */
+static uint32_t ble_gap_event_listener_mask;
+
 static os_membuf_t ble_gap_update_entry_mem[
                         OS_MEMPOOL_SIZE(BLE_GAP_MAX_UPDATE_ENTRIES,
                                         sizeof (struct ble_gap_update_entry))];
 static struct os_mempool ble_gap_update_entry_pool;
 static struct ble_gap_update_entry_list ble_gap_update_entries;
 
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+/**
+ * A periodic advertising sync.  An entry is allocated when a sync procedure
+ * is started, so that a successful procedure always has a place to live.
+ */
+struct ble_gap_sync {
+    SLIST_ENTRY(ble_gap_sync) next;
+    uint16_t sync_handle;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+};
+SLIST_HEAD(ble_gap_sync_list, ble_gap_sync);
+
+static os_membuf_t ble_gap_sync_mem[
+                        OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_MAX_PERIODIC_SYNCS),
+                                        sizeof (struct ble_gap_sync))];
+static struct os_mempool ble_gap_sync_pool;
+static struct ble_gap_sync_list ble_gap_syncs;
+
+/** The sync procedure in progress, or NULL if there is none. */
+static struct ble_gap_sync *ble_gap_sync_pending;
+#endif
+
+#define BLE_GAP_EXT_RSM (MYNEWT_VAL(BLE_EXT_ADV) &&                   \
+                         MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_MAX) > 0)
+
+#if BLE_GAP_EXT_RSM
+/* Largest amount of data an extended advertisement can carry, across all of
+ * its chained fragments.
+ */
+#define BLE_GAP_EXT_ADV_DATA_MAX_LEN    1650
+
+#if MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_LEN) > BLE_GAP_EXT_ADV_DATA_MAX_LEN
+#error "BLE_GAP_EXT_ADV_RSM_LEN must not exceed 1650"
+#endif
+
+/**
+ * An extended advertisement whose data is still arriving in chained
+ * fragments.  Fragments are matched to the advertisement by advertiser
+ * address and advertising set ID.
+ */
+struct ble_gap_ext_rsm {
+    SLIST_ENTRY(ble_gap_ext_rsm) next;
+    os_time_t exp_os_ticks;
+    ble_addr_t addr;
+    uint16_t len;
+    uint8_t sid;
+    uint8_t truncated:1;
+    uint8_t buf[MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_LEN)];
+};
+SLIST_HEAD(ble_gap_ext_rsm_list, ble_gap_ext_rsm);
+
+static os_membuf_t ble_gap_ext_rsm_mem[
+                        OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_MAX),
+                                        sizeof (struct ble_gap_ext_rsm))];
+static struct os_mempool ble_gap_ext_rsm_pool;
+static struct ble_gap_ext_rsm_list ble_gap_ext_rsms;
+
+/**
+ * A chained advertisement whose reassembly was abandoned, either because no
+ * buffer was free when its first fragment arrived or because it timed out.
+ * Its remaining fragments are ignored until the last one arrives, so that
+ * they are not mistaken for the start of a new advertisement or, in the
+ * case of the last fragment, for an unchained one.
+ */
+struct ble_gap_ext_rsm_drop {
+    os_time_t exp_os_ticks;
+    ble_addr_t addr;
+    uint8_t sid;
+    uint8_t in_use:1;
+};
+
+#if MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_DROP_MAX) < 1
+#error "BLE_GAP_EXT_ADV_RSM_DROP_MAX must be at least 1"
+#endif
+
+static struct ble_gap_ext_rsm_drop
+    ble_gap_ext_rsm_drops[MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_DROP_MAX)];
+#endif
+
 static void ble_gap_update_entry_free(struct ble_gap_update_entry *entry);
 static struct ble_gap_update_entry *
 ble_gap_update_entry_find(uint16_t conn_handle,
@@ -230,6 +326,10 @@ STATS_NAME_START(ble_gap_stats)
     STATS_NAME(ble_gap_stats, rx_disconnect)
     STATS_NAME(ble_gap_stats, rx_update_complete)
     STATS_NAME(ble_gap_stats, rx_adv_report)
+    STATS_NAME(ble_gap_stats, rx_adv_report_filtered)
+    STATS_NAME(ble_gap_stats, rx_ext_adv_rsm_drop)
+    STATS_NAME(ble_gap_stats, rx_ext_adv_rsm_trunc)
+    STATS_NAME(ble_gap_stats, rx_ext_adv_rsm_timeout)
     STATS_NAME(ble_gap_stats, rx_conn_complete)
     STATS_NAME(ble_gap_stats, discover_cancel)
     STATS_NAME(ble_gap_stats, discover_cancel_fail)
@@ -577,6 +677,55 @@ ble_gap_mesh_cb_register(ble_gap_event_fn *cb, void *cb_arg)
  * $misc                                                                     *
  *****************************************************************************/
 
+/**
+ * Delivers an event to the registered listeners.  The interested listeners
+ * are copied while the host lock is held and called after it is released,
+ * so listeners may be registered and unregistered from any task, including
+ * from within a listener callback.
+ */
+static void
+ble_gap_event_listener_call(struct ble_gap_event *event)
+{
+    struct {
+        ble_gap_event_fn *fn;
+        void *arg;
+    } snap[MYNEWT_VAL(BLE_GAP_EVENT_LISTENER_MAX)];
+    struct ble_gap_event_listener *evl;
+    uint32_t type_mask;
+    int num;
+    int i;
+
+    type_mask = BLE_GAP_EVENT_MASK(event->type);
+
+    /* Cheap unlocked check for the common case of no interested listener.
+     * A listener registered concurrently may miss this event, as it could
+     * have anyway had it registered a moment later.
+     */
+    if (!(ble_gap_event_listener_mask & type_mask)) {
+        return;
+    }
+
+    ble_hs_lock();
+
+    num = 0;
+    SLIST_FOREACH(evl, &ble_gap_event_listener_list, link) {
+        if (num >= MYNEWT_VAL(BLE_GAP_EVENT_LISTENER_MAX)) {
+            break;
+        }
+        if (evl->event_mask & type_mask) {
+            snap[num].fn = evl->fn;
+            snap[num].arg = evl->arg;
+            num++;
+        }
+    }
+
+    ble_hs_unlock();
+
+    for (i = 0; i < num; i++) {
+        snap[i].fn(event, snap[i].arg);
+    }
+}
+
 static int
 ble_gap_call_event_cb(struct ble_gap_event *event,
                       ble_gap_event_fn *cb, void *cb_arg)
@@ -596,9 +745,126 @@ ble_gap_call_event_cb(struct ble_gap_event *event,
         rc = 0;
     }
 
+    ble_gap_event_listener_call(event);
+
     return rc;
 }
 
+static void
+ble_gap_event_listener_mask_update(void)
+{
+    struct ble_gap_event_listener *evl;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    ble_gap_event_listener_mask = 0;
+    ble_gap_event_listener_num = 0;
+    SLIST_FOREACH(evl, &ble_gap_event_listener_list, link) {
+        ble_gap_event_listener_mask |= evl->event_mask;
+        ble_gap_event_listener_num++;
+    }
+}
+
+/**
+ * Registers a GAP event listener.  The listener is called for every GAP
+ * event whose type is selected by the specified mask, after the callback of
+ * the relevant procedure or connection.  Its return code is ignored.
+ *
+ * @param listener              The listener to register.
+ * @param event_mask            Mask of event types to deliver; built with
+ *                                  BLE_GAP_EVENT_MASK(), or
+ *                                  BLE_GAP_EVENT_MASK_ALL.
+ * @param fn                    The callback to execute for each event.
+ * @param arg                   The optional argument to pass to the callback.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if the listener is already
+ *                                  registered;
+ *                              BLE_HS_ENOMEM if
+ *                                  BLE_GAP_EVENT_LISTENER_MAX listeners are
+ *                                  already registered;
+ *                              BLE_HS_EINVAL on invalid arguments.
+ */
+int
+ble_gap_event_listener_register(struct ble_gap_event_listener *listener,
+                                uint32_t event_mask,
+                                ble_gap_event_fn *fn, void *arg)
+{
+    struct ble_gap_event_listener *evl;
+
+    if (listener == NULL || fn == NULL || event_mask == 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    SLIST_FOREACH(evl, &ble_gap_event_listener_list, link) {
+        if (evl == listener) {
+            ble_hs_unlock();
+            return BLE_HS_EALREADY;
+        }
+    }
+
+    if (ble_gap_event_listener_num >= MYNEWT_VAL(BLE_GAP_EVENT_LISTENER_MAX)) {
+        ble_hs_unlock();
+        return BLE_HS_ENOMEM;
+    }
+
+    memset(listener, 0, sizeof(*listener));
+    listener->fn = fn;
+    listener->arg = arg;
+    listener->event_mask = event_mask;
+    SLIST_INSERT_HEAD(&ble_gap_event_listener_list, listener, link);
+
+    ble_gap_event_listener_mask |= event_mask;
+    ble_gap_event_listener_num++;
+
+    ble_hs_unlock();
+
+    return 0;
+}
+
+/**
+ * Unregisters a GAP event listener.
+ *
+ * @param listener              The listener to unregister.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if the listener is not
+ *                                  registered;
+ *                              BLE_HS_EINVAL on invalid arguments.
+ */
+int
+ble_gap_event_listener_unregister(struct ble_gap_event_listener *listener)
+{
+    struct ble_gap_event_listener *evl;
+
+    if (listener == NULL) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    SLIST_FOREACH(evl, &ble_gap_event_listener_list, link) {
+        if (evl == listener) {
+            break;
+        }
+    }
+
+    if (evl == NULL) {
+        ble_hs_unlock();
+        return BLE_HS_ENOENT;
+    }
+
+    SLIST_REMOVE(&ble_gap_event_listener_list, listener,
+                 ble_gap_event_listener, link);
+    ble_gap_event_listener_mask_update();
+
+    ble_hs_unlock();
+
+    return 0;
+}
+
 
 static int
 ble_gap_call_conn_event_cb(struct ble_gap_event *event, uint16_t conn_handle)
@@ -708,16 +974,15 @@ ble_gap_adv_finished(uint8_t instance, int reason, uint16_t conn_handle)
     void *cb_arg;
 
     ble_gap_slave_extract_cb(instance, &cb, &cb_arg);
-    if (cb != NULL) {
-        memset(&event, 0, sizeof event);
-        event.type = BLE_GAP_EVENT_ADV_COMPLETE;
-        event.adv_complete.reason = reason;
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_ADV_COMPLETE;
+    event.adv_complete.reason = reason;
 #if MYNEWT_VAL(BLE_EXT_ADV)
-        event.adv_complete.instance = instance;
-        event.adv_complete.conn_handle = conn_handle;
+    event.adv_complete.instance = instance;
+    event.adv_complete.conn_handle = conn_handle;
 #endif
-        cb(&event, cb_arg);
-    }
+    ble_gap_call_event_cb(&event, cb, cb_arg);
 }
 
 static int
@@ -728,15 +993,12 @@ ble_gap_master_connect_failure(int status)
     int rc;
 
     ble_gap_master_extract_state(&state, 1);
-    if (ble_gap_has_client(&state)) {
-        memset(&event, 0, sizeof event);
-        event.type = BLE_GAP_EVENT_CONNECT;
-        event.connect.status = status;
 
-        rc = state.cb(&event, state.cb_arg);
-    } else {
-        rc = 0;
-    }
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_CONNECT;
+    event.connect.status = status;
+
+    rc = ble_gap_call_event_cb(&event, state.cb, state.cb_arg);
 
     return rc;
 }
@@ -748,19 +1010,18 @@ ble_gap_master_connect_cancelled(void)
     struct ble_gap_event event;
 
     ble_gap_master_extract_state(&state, 1);
-    if (state.cb != NULL) {
-        memset(&event, 0, sizeof event);
-        event.type = BLE_GAP_EVENT_CONNECT;
-        event.connect.conn_handle = BLE_HS_CONN_HANDLE_NONE;
-        if (state.conn.cancel) {
-            /* Connect procedure successfully cancelled. */
-            event.connect.status = BLE_HS_EAPP;
-        } else {
-            /* Connect procedure timed out. */
-            event.connect.status = BLE_HS_ETIMEOUT;
-        }
-        state.cb(&event, state.cb_arg);
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_CONNECT;
+    event.connect.conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    if (state.conn.cancel) {
+        /* Connect procedure successfully cancelled. */
+        event.connect.status = BLE_HS_EAPP;
+    } else {
+        /* Connect procedure timed out. */
+        event.connect.status = BLE_HS_ETIMEOUT;
     }
+    ble_gap_call_event_cb(&event, state.cb, state.cb_arg);
 }
 
 
@@ -770,12 +1031,168 @@ ble_gap_is_extended_disc(void)
     return ble_gap_master.disc.extended;
 }
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) > 0
+/**
+ * Advertising reports waiting to be delivered to the application in a single
+ * BLE_GAP_EVENT_DISC_BATCH event.  Entries are only added and delivered by
+ * the host task; other tasks may discard them (with the host lock held) when
+ * they cancel discovery.
+ */
+static struct {
+    struct ble_gap_disc_desc descs[MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX)];
+    uint8_t data[MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX)][BLE_HS_ADV_MAX_SZ];
+    os_time_t exp_os_ticks;
+    uint32_t window_ticks;
+
+    /** Batch size configured by the application; 0 means disabled. */
+    uint8_t max;
+    uint8_t num;
+} ble_gap_disc_batch;
+
+static void
+ble_gap_disc_batch_flush(void)
+{
+    struct ble_gap_event event;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+    uint8_t num;
+
+    ble_hs_lock();
+
+    num = ble_gap_disc_batch.num;
+    ble_gap_disc_batch.num = 0;
+    cb = ble_gap_master.cb;
+    cb_arg = ble_gap_master.cb_arg;
+
+    ble_hs_unlock();
+
+    if (num == 0 || cb == NULL) {
+        return;
+    }
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_DISC_BATCH;
+    event.disc_batch.descs = ble_gap_disc_batch.descs;
+    event.disc_batch.num_descs = num;
+    ble_gap_call_event_cb(&event, cb, cb_arg);
+}
+
+/**
+ * Adds a report to the pending batch, delivering the batch if this fills it.
+ *
+ * @return                      1 if the report was batched;
+ *                              0 if batching is disabled and the report
+ *                                  should be delivered on its own.
+ */
+static int
+ble_gap_disc_batch_add(const struct ble_gap_disc_desc *desc)
+{
+    struct ble_gap_disc_desc *entry;
+    int full;
+
+    ble_hs_lock();
+
+    if (ble_gap_disc_batch.max == 0) {
+        ble_hs_unlock();
+        return 0;
+    }
+
+    entry = ble_gap_disc_batch.descs + ble_gap_disc_batch.num;
+    *entry = *desc;
+    entry->data = ble_gap_disc_batch.data[ble_gap_disc_batch.num];
+    memcpy(entry->data, desc->data,
+           min(desc->length_data, BLE_HS_ADV_MAX_SZ));
+    entry->length_data = min(desc->length_data, BLE_HS_ADV_MAX_SZ);
+
+    ble_gap_disc_batch.num++;
+    if (ble_gap_disc_batch.num == 1 && ble_gap_disc_batch.window_ticks != 0) {
+        ble_gap_disc_batch.exp_os_ticks =
+            os_time_get() + ble_gap_disc_batch.window_ticks;
+        ble_hs_timer_resched();
+    }
+
+    full = ble_gap_disc_batch.num >= ble_gap_disc_batch.max;
+
+    ble_hs_unlock();
+
+    if (full) {
+        ble_gap_disc_batch_flush();
+    }
+
+    return 1;
+}
+
+/**
+ * Delivers the pending batch if its time window has elapsed.
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+static int32_t
+ble_gap_disc_batch_timer(void)
+{
+    int32_t ticks;
+
+    ble_hs_lock();
+
+    if (ble_gap_disc_batch.num == 0 || ble_gap_disc_batch.window_ticks == 0) {
+        ticks = BLE_HS_FOREVER;
+    } else {
+        ticks = ble_gap_disc_batch.exp_os_ticks - os_time_get();
+        if (ticks < 0) {
+            ticks = 0;
+        }
+    }
+
+    ble_hs_unlock();
+
+    if (ticks == 0) {
+        ble_gap_disc_batch_flush();
+        ticks = BLE_HS_FOREVER;
+    }
+
+    return ticks;
+}
+#endif
+
+/**
+ * Passes an advertising report to the application and, if mesh is enabled,
+ * to mesh.  The host's report filters, duplicate filter and batching only
+ * shape what the application sees.  Mesh does its own filtering of
+ * advertising data, so it gets every report that passes the sanity checks,
+ * one at a time, as soon as it arrives.
+ *
+ * @param desc                  The report; a ble_gap_disc_desc, or a
+ *                                  ble_gap_ext_disc_desc if extended
+ *                                  discovery is in progress.
+ * @param filtered              1 if the report is to be withheld from the
+ *                                  application; 0 otherwise.
+ */
 static void
-ble_gap_disc_report(void *desc)
+ble_gap_disc_report(void *desc, int filtered)
 {
     struct ble_gap_master_state state;
     struct ble_gap_event event;
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) > 0
+    if (!filtered && !ble_gap_is_extended_disc() &&
+        ble_gap_disc_batch_add(desc)) {
+
+        /* The application gets the report with the rest of its batch. */
+        filtered = 1;
+    }
+#endif
+
+    if (filtered) {
+#if MYNEWT_VAL(BLE_MESH)
+        if (ble_gap_mesh.cb == NULL) {
+            return;
+        }
+#else
+        return;
+#endif
+    }
+
     memset(&event, 0, sizeof event);
     if (ble_gap_is_extended_disc()) {
 #if MYNEWT_VAL(BLE_EXT_ADV)
@@ -790,8 +1207,8 @@ ble_gap_disc_report(void *desc)
     }
 
     ble_gap_master_extract_state(&state, 0);
-    if (ble_gap_has_client(&state)) {
-        state.cb(&event, state.cb_arg);
+    if (!filtered) {
+        ble_gap_call_event_cb(&event, state.cb, state.cb_arg);
     }
 
 #if MYNEWT_VAL(BLE_MESH)
@@ -808,6 +1225,11 @@ ble_gap_disc_complete(void)
     struct ble_gap_master_state state;
     struct ble_gap_event event;
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) > 0
+    /* Deliver whatever is pending before reporting completion. */
+    ble_gap_disc_batch_flush();
+#endif
+
     memset(&event, 0, sizeof event);
     event.type = BLE_GAP_EVENT_DISC_COMPLETE;
     event.disc_complete.reason = 0;
@@ -1012,6 +1434,7 @@ ble_gap_conn_broken(uint16_t conn_handle, int reason)
 
     ble_gap_update_notify(conn_handle, reason);
     ble_gap_update_entry_free(entry);
+    ble_gap_plan_conn_broken(conn_handle);
 
     /* Indicate the connection termination to each module.  The order matters
      * here: gatts must come before gattc to ensure the application does not
@@ -1025,6 +1448,9 @@ ble_gap_conn_broken(uint16_t conn_handle, int reason)
 
     ble_hs_atomic_conn_delete(conn_handle);
 
+    /* Don't leave the peer's subscription state pending in RAM. */
+    ble_store_flush();
+
     event.type = BLE_GAP_EVENT_DISCONNECT;
     event.disconnect.reason = reason;
     ble_gap_call_event_cb(&event, snap.cb, snap.cb_arg);
@@ -1144,6 +1570,8 @@ ble_gap_rx_update_complete(struct hci_le_conn_upd_complete *evt)
     }
 
     if (call_cb) {
+        ble_gap_plan_rx_update(evt->connection_handle, cb_status,
+                               evt->conn_itvl);
         ble_gap_update_notify(evt->connection_handle, cb_status);
     }
 }
@@ -1217,7 +1645,7 @@ ble_gap_accept_slave_conn(uint8_t instance)
 }
 
 static int
-ble_gap_rx_adv_report_sanity_check(uint8_t *adv_data, uint8_t adv_data_len)
+ble_gap_rx_adv_report_sanity_check(uint8_t *adv_data, uint16_t adv_data_len)
 {
     const struct ble_hs_adv_field *flags;
     int rc;
@@ -1246,6 +1674,8 @@ ble_gap_rx_adv_report_sanity_check(uint8_t *adv_data, uint8_t adv_data_len)
 void
 ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc)
 {
+    int filtered;
+
 #if !NIMBLE_BLE_SCAN
     return;
 #endif
@@ -1254,34 +1684,396 @@ ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc)
         return;
     }
 
-    ble_gap_disc_report(desc);
+    filtered = !ble_hs_adv_filt_match(&desc->addr, desc->rssi, desc->data,
+                                      desc->length_data);
+    if (filtered) {
+        STATS_INC(ble_gap_stats, rx_adv_report_filtered);
+    } else if (ble_hs_adv_dedup_check(&desc->addr, desc->event_type,
+                                      desc->data, desc->length_data)) {
+        filtered = 1;
+    }
+
+    ble_gap_disc_report(desc, filtered);
 }
 
 #if MYNEWT_VAL(BLE_EXT_ADV)
-void
-ble_gap_rx_ext_adv_report(struct ble_gap_ext_disc_desc *desc)
+#if BLE_GAP_EXT_RSM
+/**
+ * Discards all partially received extended advertisements.  Must be called
+ * with the host lock held.
+ */
+static void
+ble_gap_ext_rsm_clear(void)
 {
-    if (ble_gap_rx_adv_report_sanity_check(desc->data, desc->length_data)) {
-        return;
+    struct ble_gap_ext_rsm *rsm;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    while ((rsm = SLIST_FIRST(&ble_gap_ext_rsms)) != NULL) {
+        SLIST_REMOVE_HEAD(&ble_gap_ext_rsms, next);
+        os_memblock_put(&ble_gap_ext_rsm_pool, rsm);
     }
 
-    ble_gap_disc_report(desc);
+    memset(ble_gap_ext_rsm_drops, 0, sizeof ble_gap_ext_rsm_drops);
 }
 
-void
-ble_gap_rx_adv_set_terminated(struct hci_le_adv_set_terminated *evt)
+static os_time_t
+ble_gap_ext_rsm_exp_ticks(void)
 {
-    uint16_t conn_handle;
-    int reason;
+    uint32_t timeout_ticks;
+    int rc;
 
-    /* Currently spec allows only 0x3c and 0x43 when advertising was stopped
-     * due to timeout or events limit, mp this for timeout error for now */
-    if (evt->status) {
-        reason = BLE_HS_ETIMEOUT;
-        conn_handle = 0;
-    } else {
-        reason = 0;
-        conn_handle = evt->conn_handle;
+    rc = os_time_ms_to_ticks(MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_TIMEOUT),
+                             &timeout_ticks);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    return os_time_get() + timeout_ticks;
+}
+
+/**
+ * Looks up the abandoned advertisement with the specified address and SID.
+ * Entries that have not seen a fragment within the reassembly timeout are
+ * forgotten.  Must be called with the host lock held.
+ */
+static struct ble_gap_ext_rsm_drop *
+ble_gap_ext_rsm_drop_find(const ble_addr_t *addr, uint8_t sid)
+{
+    struct ble_gap_ext_rsm_drop *drop;
+    os_time_t now;
+    int i;
+
+    now = os_time_get();
+
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_DROP_MAX); i++) {
+        drop = ble_gap_ext_rsm_drops + i;
+        if (!drop->in_use) {
+            continue;
+        }
+
+        if ((int32_t)(drop->exp_os_ticks - now) <= 0) {
+            drop->in_use = 0;
+            continue;
+        }
+
+        if (drop->sid == sid && ble_addr_cmp(&drop->addr, addr) == 0) {
+            return drop;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Records that the remaining fragments of the specified advertisement are to
+ * be ignored.  Reuses the entry closest to expiry if the table is full.
+ * Must be called with the host lock held.
+ */
+static void
+ble_gap_ext_rsm_drop_add(const ble_addr_t *addr, uint8_t sid)
+{
+    struct ble_gap_ext_rsm_drop *victim;
+    struct ble_gap_ext_rsm_drop *drop;
+    int i;
+
+    drop = ble_gap_ext_rsm_drop_find(addr, sid);
+    if (drop == NULL) {
+        victim = NULL;
+        for (i = 0; i < MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_DROP_MAX); i++) {
+            drop = ble_gap_ext_rsm_drops + i;
+            if (!drop->in_use) {
+                break;
+            }
+            if (victim == NULL ||
+                (int32_t)(drop->exp_os_ticks - victim->exp_os_ticks) < 0) {
+
+                victim = drop;
+            }
+        }
+        if (i == MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_DROP_MAX)) {
+            drop = victim;
+        }
+
+        drop->addr = *addr;
+        drop->sid = sid;
+        drop->in_use = 1;
+    }
+
+    drop->exp_os_ticks = ble_gap_ext_rsm_exp_ticks();
+}
+
+static void
+ble_gap_ext_rsm_append(struct ble_gap_ext_rsm *rsm,
+                       const struct ble_gap_ext_disc_desc *desc)
+{
+    int copy_len;
+
+    copy_len = min(desc->length_data, sizeof rsm->buf - rsm->len);
+    memcpy(rsm->buf + rsm->len, desc->data, copy_len);
+    rsm->len += copy_len;
+
+    if (copy_len < desc->length_data ||
+        desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED) {
+
+        rsm->truncated = 1;
+    }
+}
+
+/**
+ * Feeds an extended advertising report fragment to the reassembler.
+ *
+ * @param desc                  The received fragment.  If a reassembled
+ *                                  advertisement is complete, this is
+ *                                  updated to describe the full payload.
+ * @param out_rsm               On success, the buffer holding the
+ *                                  reassembled payload gets written here, or
+ *                                  NULL if the fragment was complete on its
+ *                                  own.  The caller must free the buffer
+ *                                  once the report has been delivered.
+ *
+ * @return                      0 if the report should be delivered;
+ *                              BLE_HS_EAGAIN if more fragments are
+ *                                  expected;
+ *                              BLE_HS_ENOMEM if the fragment was dropped
+ *                                  for lack of a reassembly buffer;
+ *                              BLE_HS_EALREADY if the fragment belongs to
+ *                                  an advertisement that was already
+ *                                  dropped.
+ */
+static int
+ble_gap_ext_rsm_rx(struct ble_gap_ext_disc_desc *desc,
+                   struct ble_gap_ext_rsm **out_rsm)
+{
+    struct ble_gap_ext_rsm_drop *drop;
+    struct ble_gap_ext_rsm *prev;
+    struct ble_gap_ext_rsm *rsm;
+    int rc;
+
+    *out_rsm = NULL;
+
+    ble_hs_lock();
+
+    prev = NULL;
+    SLIST_FOREACH(rsm, &ble_gap_ext_rsms, next) {
+        if (rsm->sid == desc->sid && ble_addr_cmp(&rsm->addr, &desc->addr) == 0) {
+            break;
+        }
+        prev = rsm;
+    }
+
+    if (rsm == NULL) {
+        drop = ble_gap_ext_rsm_drop_find(&desc->addr, desc->sid);
+        if (drop != NULL) {
+            /* Rest of an abandoned advertisement; ignore it up to and
+             * including its last fragment.
+             */
+            if (desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+                drop->exp_os_ticks = ble_gap_ext_rsm_exp_ticks();
+            } else {
+                drop->in_use = 0;
+            }
+            rc = BLE_HS_EALREADY;
+            goto done;
+        }
+
+        if (desc->data_status != BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+            /* Unchained advertisement; deliver it straight from the HCI
+             * event.
+             */
+            rc = 0;
+            goto done;
+        }
+
+        rsm = os_memblock_get(&ble_gap_ext_rsm_pool);
+        if (rsm == NULL) {
+            STATS_INC(ble_gap_stats, rx_ext_adv_rsm_drop);
+            ble_gap_ext_rsm_drop_add(&desc->addr, desc->sid);
+            rc = BLE_HS_ENOMEM;
+            goto done;
+        }
+
+        rsm->addr = desc->addr;
+        rsm->sid = desc->sid;
+        rsm->len = 0;
+        rsm->truncated = 0;
+        SLIST_INSERT_HEAD(&ble_gap_ext_rsms, rsm, next);
+        prev = NULL;
+    }
+
+    ble_gap_ext_rsm_append(rsm, desc);
+
+    if (desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+        rsm->exp_os_ticks = ble_gap_ext_rsm_exp_ticks();
+        ble_hs_timer_resched();
+        rc = BLE_HS_EAGAIN;
+        goto done;
+    }
+
+    /* Last fragment; hand the full payload to the caller. */
+    if (prev == NULL) {
+        SLIST_REMOVE_HEAD(&ble_gap_ext_rsms, next);
+    } else {
+        SLIST_NEXT(prev, next) = SLIST_NEXT(rsm, next);
+    }
+
+    if (rsm->truncated) {
+        STATS_INC(ble_gap_stats, rx_ext_adv_rsm_trunc);
+        desc->data_status = BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED;
+    } else {
+        desc->data_status = BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE;
+    }
+    desc->data = rsm->buf;
+    desc->length_data = rsm->len;
+
+    *out_rsm = rsm;
+    rc = 0;
+
+done:
+    ble_hs_unlock();
+    return rc;
+}
+
+static void
+ble_gap_ext_rsm_free(struct ble_gap_ext_rsm *rsm)
+{
+    int rc;
+
+    if (rsm != NULL) {
+        rc = os_memblock_put(&ble_gap_ext_rsm_pool, rsm);
+        BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+    }
+}
+
+/**
+ * Discards reassemblies whose next fragment has not arrived in time.
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+static int32_t
+ble_gap_ext_rsm_timer(void)
+{
+    struct ble_gap_ext_rsm *prev;
+    struct ble_gap_ext_rsm *next;
+    struct ble_gap_ext_rsm *rsm;
+    os_time_t now;
+    int32_t min_ticks;
+    int32_t ticks;
+
+    min_ticks = BLE_HS_FOREVER;
+    now = os_time_get();
+
+    ble_hs_lock();
+
+    prev = NULL;
+    rsm = SLIST_FIRST(&ble_gap_ext_rsms);
+    while (rsm != NULL) {
+        next = SLIST_NEXT(rsm, next);
+
+        ticks = rsm->exp_os_ticks - now;
+        if (ticks <= 0) {
+            if (prev == NULL) {
+                SLIST_REMOVE_HEAD(&ble_gap_ext_rsms, next);
+            } else {
+                SLIST_NEXT(prev, next) = next;
+            }
+            ble_gap_ext_rsm_drop_add(&rsm->addr, rsm->sid);
+            os_memblock_put(&ble_gap_ext_rsm_pool, rsm);
+            STATS_INC(ble_gap_stats, rx_ext_adv_rsm_timeout);
+        } else {
+            min_ticks = min(min_ticks, ticks);
+            prev = rsm;
+        }
+
+        rsm = next;
+    }
+
+    ble_hs_unlock();
+
+    return min_ticks;
+}
+#endif
+
+/**
+ * Determines whether an extended advertising report duplicates one already
+ * delivered to the application.  Duplicate filtering needs the whole
+ * payload.  Without reassembly, the last fragment of a chained advertisement
+ * can't be told apart from an unchained advertisement, so only legacy
+ * reports are checked.
+ */
+static int
+ble_gap_ext_adv_report_is_dup(const struct ble_gap_ext_disc_desc *desc)
+{
+#if !BLE_GAP_EXT_RSM
+    if (!(desc->props & BLE_HCI_ADV_LEGACY_MASK)) {
+        return 0;
+    }
+#endif
+
+    if (desc->data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+        return 0;
+    }
+
+    return ble_hs_adv_dedup_check(&desc->addr,
+                                  desc->props & ~BLE_HCI_ADV_DATA_STATUS_MASK,
+                                  desc->data, desc->length_data);
+}
+
+void
+ble_gap_rx_ext_adv_report(struct ble_gap_ext_disc_desc *desc)
+{
+#if BLE_GAP_EXT_RSM
+    struct ble_gap_ext_rsm *rsm;
+#endif
+    int filtered;
+
+#if BLE_GAP_EXT_RSM
+    rsm = NULL;
+    if (!(desc->props & BLE_HCI_ADV_LEGACY_MASK)) {
+        if (ble_gap_master.op != BLE_GAP_OP_M_DISC) {
+            return;
+        }
+
+        if (ble_gap_ext_rsm_rx(desc, &rsm) != 0) {
+            return;
+        }
+    }
+#endif
+
+    if (ble_gap_rx_adv_report_sanity_check(desc->data, desc->length_data)) {
+        goto done;
+    }
+
+    filtered = !ble_hs_adv_filt_match(&desc->addr, desc->rssi, desc->data,
+                                      desc->length_data);
+    if (filtered) {
+        STATS_INC(ble_gap_stats, rx_adv_report_filtered);
+    } else if (ble_gap_ext_adv_report_is_dup(desc)) {
+        filtered = 1;
+    }
+
+    ble_gap_disc_report(desc, filtered);
+
+done:
+#if BLE_GAP_EXT_RSM
+    ble_gap_ext_rsm_free(rsm);
+#endif
+    return;
+}
+
+void
+ble_gap_rx_adv_set_terminated(struct hci_le_adv_set_terminated *evt)
+{
+    uint16_t conn_handle;
+    int reason;
+
+    /* Currently spec allows only 0x3c and 0x43 when advertising was stopped
+     * due to timeout or events limit, mp this for timeout error for now */
+    if (evt->status) {
+        reason = BLE_HS_ETIMEOUT;
+        conn_handle = 0;
+    } else {
+        reason = 0;
+        conn_handle = evt->conn_handle;
     }
 
     ble_gap_adv_finished(evt->adv_handle, reason, conn_handle);
@@ -1487,6 +2279,10 @@ ble_gap_rx_l2cap_update_req(uint16_t conn_handle,
     event.conn_update_req.peer_params = params;
 
     rc = ble_gap_call_conn_event_cb(&event, conn_handle);
+    if (rc == 0) {
+        ble_gap_plan_adjust(conn_handle, params);
+    }
+
     return rc;
 }
 
@@ -1675,6 +2471,15 @@ ble_gap_timer(void)
     update_ticks = ble_gap_update_timer();
 
     min_ticks = min(master_ticks, update_ticks);
+    min_ticks = min(min_ticks, ble_gap_reconn_timer());
+
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) > 0
+    min_ticks = min(min_ticks, ble_gap_disc_batch_timer());
+#endif
+
+#if BLE_GAP_EXT_RSM
+    min_ticks = min(min_ticks, ble_gap_ext_rsm_timer());
+#endif
 
 #if !MYNEWT_VAL(BLE_EXT_ADV)
     min_ticks = min(min_ticks, ble_gap_slave_timer());
@@ -2733,10 +3538,8 @@ ble_gap_ext_adv_stop(uint8_t instance)
 
 
 static int
-ble_gap_ext_adv_set_data_validate(uint8_t instance, struct os_mbuf *data)
+ble_gap_ext_adv_set_data_validate(uint8_t instance, uint16_t len)
 {
-    uint16_t len = OS_MBUF_PKTLEN(data);
-
     if (!ble_gap_slave[instance].configured) {
         return BLE_HS_EINVAL;
     }
@@ -2842,145 +3645,838 @@ ble_gap_ext_adv_set(uint8_t instance, uint16_t opcode, struct os_mbuf *data)
         return rc;
     }
 
-    return ble_hs_hci_cmd_tx_empty_ack(opcode, buf,
-                                       BLE_HCI_SET_EXT_ADV_DATA_HDR_LEN + len);
-#endif
+    return ble_hs_hci_cmd_tx_empty_ack(opcode, buf,
+                                       BLE_HCI_SET_EXT_ADV_DATA_HDR_LEN + len);
+#endif
+}
+
+int
+ble_gap_ext_adv_set_data(uint8_t instance, struct os_mbuf *data)
+{
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES) {
+        rc = BLE_HS_EINVAL;
+        goto done;
+    }
+
+    ble_hs_lock();
+    rc = ble_gap_ext_adv_set_data_validate(instance, OS_MBUF_PKTLEN(data));
+    if (rc != 0) {
+        ble_hs_unlock();
+        goto done;
+    }
+
+    rc = ble_gap_ext_adv_set(instance, BLE_HCI_OCF_LE_SET_EXT_ADV_DATA, data);
+
+    ble_hs_unlock();
+
+done:
+    os_mbuf_free_chain(data);
+    return rc;
+}
+
+static int
+ble_gap_ext_adv_rsp_set_validate(uint8_t instance,  struct os_mbuf *data)
+{
+    uint16_t len = OS_MBUF_PKTLEN(data);
+
+    if (!ble_gap_slave[instance].configured) {
+        return BLE_HS_EINVAL;
+    }
+
+    /* not allowed with directed advertising */
+    if (ble_gap_slave[instance].directed) {
+        return BLE_HS_EINVAL;
+    }
+
+    /* only allowed with scannable advertising */
+    if (!ble_gap_slave[instance].scannable) {
+        return BLE_HS_EINVAL;
+    }
+
+    /* with legacy PDU limited to legacy length */
+    if (ble_gap_slave[instance].legacy_pdu) {
+        if (len > BLE_HS_ADV_MAX_SZ) {
+            return BLE_HS_EINVAL;
+        }
+
+        return 0;
+    }
+
+    /* if already advertising, data must fit in single HCI command */
+    if (ble_gap_slave[instance].op == BLE_GAP_OP_S_ADV) {
+        if (len > min(MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE), 251)) {
+            return EINVAL;
+        }
+    }
+
+    return 0;
+}
+
+int
+ble_gap_ext_adv_rsp_set_data(uint8_t instance, struct os_mbuf *data)
+{
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES) {
+        rc = BLE_HS_EINVAL;
+        goto done;
+    }
+
+    ble_hs_lock();
+    rc = ble_gap_ext_adv_rsp_set_validate(instance, data);
+    if (rc != 0) {
+        ble_hs_unlock();
+        goto done;
+    }
+
+    rc = ble_gap_ext_adv_set(instance, BLE_HCI_OCF_LE_SET_EXT_SCAN_RSP_DATA,
+                             data);
+
+    ble_hs_unlock();
+
+done:
+    os_mbuf_free_chain(data);
+    return rc;
+}
+
+int
+ble_gap_ext_adv_remove(uint8_t instance)
+{
+    uint8_t buf[BLE_HCI_LE_REMOVE_ADV_SET_LEN];
+    uint16_t opcode;
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+    if (!ble_gap_slave[instance].configured) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    if (ble_gap_slave[instance].op == BLE_GAP_OP_S_ADV) {
+        ble_hs_unlock();
+        return BLE_HS_EBUSY;
+    }
+
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    if (ble_gap_slave[instance].periodic_op) {
+        ble_hs_unlock();
+        return BLE_HS_EBUSY;
+    }
+#endif
+
+    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_REMOVE_ADV_SET);
+
+    rc = ble_hs_hci_cmd_build_le_ext_adv_remove(instance, buf, sizeof(buf));
+    if (rc != 0) {
+        ble_hs_unlock();
+        return rc;
+    }
+
+    rc = ble_hs_hci_cmd_tx_empty_ack(opcode, buf, sizeof(buf));
+    if (rc != 0) {
+        ble_hs_unlock();
+        return rc;
+    }
+
+    memset(&ble_gap_slave[instance], 0, sizeof(struct ble_gap_slave_state));
+    ble_hs_unlock();
+
+    return 0;
+}
+
+#endif
+
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+static int
+ble_gap_periodic_adv_params_validate(
+    const struct ble_gap_periodic_adv_params *params)
+{
+    if (!params) {
+        return BLE_HS_EINVAL;
+    }
+
+    if (params->itvl_min < BLE_HCI_PERIODIC_ADV_ITVL_MIN ||
+        params->itvl_min > params->itvl_max) {
+        return BLE_HS_EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * Configures periodic advertising for an extended advertising instance.  The
+ * instance must have been configured with ble_gap_ext_adv_configure() as
+ * non-connectable, non-scannable and non-anonymous.
+ *
+ * @param instance              The advertising instance.
+ * @param params                The periodic advertising parameters.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBUSY if periodic advertising is
+ *                                  enabled on the instance;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_periodic_adv_configure(uint8_t instance,
+                               const struct ble_gap_periodic_adv_params *params)
+{
+    uint8_t buf[BLE_HCI_LE_SET_PER_ADV_PARAMS_LEN];
+    uint16_t props;
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES) {
+        return BLE_HS_EINVAL;
+    }
+
+    rc = ble_gap_periodic_adv_params_validate(params);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_hs_lock();
+
+    if (!ble_gap_slave[instance].configured ||
+        ble_gap_slave[instance].legacy_pdu ||
+        ble_gap_slave[instance].connectable ||
+        ble_gap_slave[instance].scannable) {
+        ble_hs_unlock();
+        return BLE_HS_EINVAL;
+    }
+
+    if (ble_gap_slave[instance].periodic_op) {
+        ble_hs_unlock();
+        return BLE_HS_EBUSY;
+    }
+
+    props = 0;
+    if (params->include_tx_power) {
+        props |= BLE_HCI_LE_SET_EXT_ADV_PROP_INC_TX_PWR;
+    }
+
+    rc = ble_hs_hci_cmd_build_le_periodic_adv_params(instance,
+                                                     params->itvl_min,
+                                                     params->itvl_max, props,
+                                                     buf, sizeof(buf));
+    if (rc == 0) {
+        rc = ble_hs_hci_cmd_tx_empty_ack(
+            BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS),
+            buf, sizeof(buf));
+    }
+
+    if (rc == 0) {
+        ble_gap_slave[instance].periodic_configured = 1;
+    }
+
+    ble_hs_unlock();
+    return rc;
+}
+
+/**
+ * Sets the periodic advertising data of an instance.  The mbuf is consumed
+ * regardless of the outcome.  The data may be replaced while the periodic
+ * advertising train is running; synchronized listeners pick up the new data
+ * on a following periodic event without rescanning.
+ *
+ * @param instance              The advertising instance.
+ * @param data                  The periodic advertising data; must fit in a
+ *                                  single HCI command.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+ble_gap_periodic_adv_set_data(uint8_t instance, struct os_mbuf *data)
+{
+    static uint8_t buf[BLE_HCI_SET_PER_ADV_DATA_HDR_LEN +
+                       BLE_HCI_MAX_PER_ADV_DATA_LEN];
+    uint16_t len;
+    int rc;
+
+    len = OS_MBUF_PKTLEN(data);
+
+    if (instance >= BLE_ADV_INSTANCES || len > BLE_HCI_MAX_PER_ADV_DATA_LEN) {
+        rc = BLE_HS_EINVAL;
+        goto done;
+    }
+
+    ble_hs_lock();
+
+    if (!ble_gap_slave[instance].periodic_configured) {
+        ble_hs_unlock();
+        rc = BLE_HS_EINVAL;
+        goto done;
+    }
+
+    rc = ble_hs_hci_cmd_build_le_periodic_adv_data(
+        instance, BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE, data, len,
+        buf, sizeof(buf));
+    if (rc == 0) {
+        rc = ble_hs_hci_cmd_tx_empty_ack(
+            BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_PER_ADV_DATA),
+            buf, BLE_HCI_SET_PER_ADV_DATA_HDR_LEN + len);
+    }
+
+    ble_hs_unlock();
+
+done:
+    os_mbuf_free_chain(data);
+    return rc;
+}
+
+static int
+ble_gap_periodic_adv_enable_tx(uint8_t instance, uint8_t enable)
+{
+    uint8_t buf[BLE_HCI_LE_SET_PER_ADV_ENABLE_LEN];
+    int rc;
+
+    rc = ble_hs_hci_cmd_build_le_periodic_adv_enable(enable, instance,
+                                                     buf, sizeof(buf));
+    if (rc != 0) {
+        return rc;
+    }
+
+    return ble_hs_hci_cmd_tx_empty_ack(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE),
+        buf, sizeof(buf));
+}
+
+/**
+ * Starts periodic advertising on an instance.  The periodic train is only
+ * transmitted, and its SyncInfo advertised, while extended advertising is
+ * also enabled on the instance.
+ *
+ * @param instance              The advertising instance.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if periodic advertising is
+ *                                  already enabled;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_periodic_adv_start(uint8_t instance)
+{
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (!ble_gap_slave[instance].periodic_configured) {
+        ble_hs_unlock();
+        return BLE_HS_EINVAL;
+    }
+
+    if (ble_gap_slave[instance].periodic_op) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    rc = ble_gap_periodic_adv_enable_tx(instance, 1);
+    if (rc == 0) {
+        ble_gap_slave[instance].periodic_op = 1;
+    }
+
+    ble_hs_unlock();
+    return rc;
+}
+
+/**
+ * Stops periodic advertising on an instance.
+ *
+ * @param instance              The advertising instance.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if periodic advertising is
+ *                                  not enabled;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_periodic_adv_stop(uint8_t instance)
+{
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (!ble_gap_slave[instance].periodic_op) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    rc = ble_gap_periodic_adv_enable_tx(instance, 0);
+    if (rc == 0) {
+        ble_gap_slave[instance].periodic_op = 0;
+    }
+
+    ble_hs_unlock();
+    return rc;
+}
+
+static struct ble_gap_sync *
+ble_gap_sync_find(uint16_t sync_handle, struct ble_gap_sync **out_prev)
+{
+    struct ble_gap_sync *prev;
+    struct ble_gap_sync *sync;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    prev = NULL;
+    SLIST_FOREACH(sync, &ble_gap_syncs, next) {
+        if (sync->sync_handle == sync_handle) {
+            break;
+        }
+        prev = sync;
+    }
+
+    if (out_prev != NULL) {
+        *out_prev = prev;
+    }
+
+    return sync;
+}
+
+/**
+ * Synchronizes to a periodic advertising train.  Once synchronized, the
+ * controller only wakes up for the periodic events, which is much cheaper
+ * than continuous scanning.  The outcome is reported with a
+ * BLE_GAP_EVENT_PERIODIC_SYNC event; reports and sync loss for the
+ * established sync are delivered to the same callback.
+ *
+ * @param addr                  Address of the periodic advertiser.
+ * @param adv_sid               Advertising set ID of the periodic advertiser.
+ * @param params                The sync parameters.
+ * @param cb                    The callback to associate with the sync.
+ * @param cb_arg                The optional argument to pass to the callback.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if a sync procedure is
+ *                                  already in progress;
+ *                              BLE_HS_ENOMEM if the maximum number of syncs
+ *                                  is already established;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_periodic_adv_create_sync(const ble_addr_t *addr, uint8_t adv_sid,
+                                 const struct ble_gap_periodic_sync_params *params,
+                                 ble_gap_event_fn *cb, void *cb_arg)
+{
+    uint8_t buf[BLE_HCI_LE_PER_ADV_CREATE_SYNC_LEN];
+    struct ble_gap_sync *sync;
+    int rc;
+
+    if (addr == NULL || params == NULL || adv_sid > 0x0f ||
+        addr->type > BLE_ADDR_RANDOM) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_sync_pending != NULL) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    sync = os_memblock_get(&ble_gap_sync_pool);
+    if (sync == NULL) {
+        ble_hs_unlock();
+        return BLE_HS_ENOMEM;
+    }
+
+    memset(sync, 0, sizeof *sync);
+    sync->cb = cb;
+    sync->cb_arg = cb_arg;
+
+    rc = ble_hs_hci_cmd_build_le_periodic_adv_create_sync(
+        0, adv_sid, addr, params->skip, params->sync_timeout,
+        buf, sizeof(buf));
+    if (rc == 0) {
+        rc = ble_hs_hci_cmd_tx_empty_ack(
+            BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC),
+            buf, sizeof(buf));
+    }
+
+    if (rc == 0) {
+        ble_gap_sync_pending = sync;
+    } else {
+        os_memblock_put(&ble_gap_sync_pool, sync);
+    }
+
+    ble_hs_unlock();
+    return rc;
+}
+
+/**
+ * Cancels a pending periodic advertising sync procedure.  A
+ * BLE_GAP_EVENT_PERIODIC_SYNC event with a status of BLE_HS_EAPP is reported
+ * once the controller aborts the procedure.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if no sync procedure is in
+ *                                  progress;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_periodic_adv_create_sync_cancel(void)
+{
+    int rc;
+
+    ble_hs_lock();
+
+    if (ble_gap_sync_pending == NULL) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    rc = ble_hs_hci_cmd_tx_empty_ack(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC_CANCEL),
+        NULL, 0);
+
+    ble_hs_unlock();
+    return rc;
 }
 
+/**
+ * Terminates an established periodic advertising sync.  A
+ * BLE_GAP_EVENT_PERIODIC_SYNC_LOST event with a reason of BLE_HS_EDONE is
+ * reported.
+ *
+ * @param sync_handle           The handle of the sync to terminate.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTCONN if there is no such sync;
+ *                              Other nonzero on failure.
+ */
 int
-ble_gap_ext_adv_set_data(uint8_t instance, struct os_mbuf *data)
+ble_gap_periodic_adv_terminate_sync(uint16_t sync_handle)
 {
+    uint8_t buf[BLE_HCI_LE_PER_ADV_TERM_SYNC_LEN];
+    struct ble_gap_event event;
+    struct ble_gap_sync *sync;
+    struct ble_gap_sync *prev;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
     int rc;
 
-    if (instance >= BLE_ADV_INSTANCES) {
-        rc = BLE_HS_EINVAL;
-        goto done;
+    ble_hs_lock();
+
+    sync = ble_gap_sync_find(sync_handle, &prev);
+    if (sync == NULL) {
+        ble_hs_unlock();
+        return BLE_HS_ENOTCONN;
+    }
+
+    rc = ble_hs_hci_cmd_build_le_periodic_adv_terminate_sync(sync_handle,
+                                                             buf, sizeof(buf));
+    if (rc == 0) {
+        rc = ble_hs_hci_cmd_tx_empty_ack(
+            BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_PER_ADV_TERM_SYNC),
+            buf, sizeof(buf));
     }
 
-    ble_hs_lock();
-    rc = ble_gap_ext_adv_set_data_validate(instance, data);
     if (rc != 0) {
         ble_hs_unlock();
-        goto done;
+        return rc;
     }
 
-    rc = ble_gap_ext_adv_set(instance, BLE_HCI_OCF_LE_SET_EXT_ADV_DATA, data);
+    if (prev == NULL) {
+        SLIST_REMOVE_HEAD(&ble_gap_syncs, next);
+    } else {
+        SLIST_NEXT(prev, next) = SLIST_NEXT(sync, next);
+    }
+
+    cb = sync->cb;
+    cb_arg = sync->cb_arg;
+    os_memblock_put(&ble_gap_sync_pool, sync);
 
     ble_hs_unlock();
 
-done:
-    os_mbuf_free_chain(data);
-    return rc;
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_PERIODIC_SYNC_LOST;
+    event.periodic_sync_lost.sync_handle = sync_handle;
+    event.periodic_sync_lost.reason = BLE_HS_EDONE;
+    ble_gap_call_event_cb(&event, cb, cb_arg);
+
+    return 0;
 }
 
-static int
-ble_gap_ext_adv_rsp_set_validate(uint8_t instance,  struct os_mbuf *data)
+void
+ble_gap_rx_periodic_adv_sync_estab(struct hci_le_periodic_adv_sync_estab *evt)
 {
-    uint16_t len = OS_MBUF_PKTLEN(data);
+    struct ble_gap_event event;
+    struct ble_gap_sync *sync;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
 
-    if (!ble_gap_slave[instance].configured) {
-        return BLE_HS_EINVAL;
+    ble_hs_lock();
+
+    sync = ble_gap_sync_pending;
+    if (sync == NULL) {
+        ble_hs_unlock();
+        return;
     }
+    ble_gap_sync_pending = NULL;
 
-    /* not allowed with directed advertising */
-    if (ble_gap_slave[instance].directed) {
-        return BLE_HS_EINVAL;
+    cb = sync->cb;
+    cb_arg = sync->cb_arg;
+
+    if (evt->status == BLE_ERR_SUCCESS) {
+        sync->sync_handle = evt->sync_handle;
+        SLIST_INSERT_HEAD(&ble_gap_syncs, sync, next);
+    } else {
+        os_memblock_put(&ble_gap_sync_pool, sync);
     }
 
-    /* only allowed with scannable advertising */
-    if (!ble_gap_slave[instance].scannable) {
-        return BLE_HS_EINVAL;
+    ble_hs_unlock();
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_PERIODIC_SYNC;
+    if (evt->status == BLE_ERR_OPERATION_CANCELLED) {
+        event.periodic_sync.status = BLE_HS_EAPP;
+    } else {
+        event.periodic_sync.status = BLE_HS_HCI_ERR(evt->status);
     }
+    event.periodic_sync.sync_handle = evt->sync_handle;
+    event.periodic_sync.sid = evt->sid;
+    event.periodic_sync.adv_addr.type = evt->adv_addr_type;
+    memcpy(event.periodic_sync.adv_addr.val, evt->adv_addr,
+           sizeof event.periodic_sync.adv_addr.val);
+    event.periodic_sync.adv_phy = evt->adv_phy;
+    event.periodic_sync.per_adv_itvl = evt->per_adv_itvl;
+    event.periodic_sync.adv_clk_accuracy = evt->adv_clk_accuracy;
 
-    /* with legacy PDU limited to legacy length */
-    if (ble_gap_slave[instance].legacy_pdu) {
-        if (len > BLE_HS_ADV_MAX_SZ) {
-            return BLE_HS_EINVAL;
-        }
+    ble_gap_call_event_cb(&event, cb, cb_arg);
+}
 
-        return 0;
+void
+ble_gap_rx_periodic_adv_rpt(struct hci_le_periodic_adv_rpt *evt)
+{
+    struct ble_gap_event event;
+    struct ble_gap_sync *sync;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+
+    ble_hs_lock();
+    sync = ble_gap_sync_find(evt->sync_handle, NULL);
+    if (sync != NULL) {
+        cb = sync->cb;
+        cb_arg = sync->cb_arg;
     }
+    ble_hs_unlock();
 
-    /* if already advertising, data must fit in single HCI command */
-    if (ble_gap_slave[instance].op == BLE_GAP_OP_S_ADV) {
-        if (len > min(MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE), 251)) {
-            return EINVAL;
-        }
+    if (sync == NULL) {
+        return;
     }
 
-    return 0;
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_PERIODIC_REPORT;
+    event.periodic_report.sync_handle = evt->sync_handle;
+    event.periodic_report.tx_power = evt->tx_power;
+    event.periodic_report.rssi = evt->rssi;
+    event.periodic_report.data_status = evt->data_status;
+    event.periodic_report.data_length = evt->data_len;
+    event.periodic_report.data = evt->data;
+
+    ble_gap_call_event_cb(&event, cb, cb_arg);
 }
 
-int
-ble_gap_ext_adv_rsp_set_data(uint8_t instance, struct os_mbuf *data)
+void
+ble_gap_rx_periodic_adv_sync_lost(struct hci_le_periodic_adv_sync_lost *evt)
 {
-    int rc;
-
-    if (instance >= BLE_ADV_INSTANCES) {
-        rc = BLE_HS_EINVAL;
-        goto done;
-    }
+    struct ble_gap_event event;
+    struct ble_gap_sync *sync;
+    struct ble_gap_sync *prev;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
 
     ble_hs_lock();
-    rc = ble_gap_ext_adv_rsp_set_validate(instance, data);
-    if (rc != 0) {
+
+    sync = ble_gap_sync_find(evt->sync_handle, &prev);
+    if (sync == NULL) {
         ble_hs_unlock();
-        goto done;
+        return;
     }
 
-    rc = ble_gap_ext_adv_set(instance, BLE_HCI_OCF_LE_SET_EXT_SCAN_RSP_DATA,
-                             data);
+    if (prev == NULL) {
+        SLIST_REMOVE_HEAD(&ble_gap_syncs, next);
+    } else {
+        SLIST_NEXT(prev, next) = SLIST_NEXT(sync, next);
+    }
+
+    cb = sync->cb;
+    cb_arg = sync->cb_arg;
+    os_memblock_put(&ble_gap_sync_pool, sync);
 
     ble_hs_unlock();
 
-done:
-    os_mbuf_free_chain(data);
-    return rc;
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_PERIODIC_SYNC_LOST;
+    event.periodic_sync_lost.sync_handle = evt->sync_handle;
+    event.periodic_sync_lost.reason = BLE_HS_ETIMEOUT;
+
+    ble_gap_call_event_cb(&event, cb, cb_arg);
 }
+#endif
 
-int
-ble_gap_ext_adv_remove(uint8_t instance)
+/**
+ * Discards GAP state that does not survive a controller reset.  The
+ * controller forgets its periodic advertising configuration and drops all
+ * periodic syncs when it is reset; the application is notified of each sync
+ * procedure and established sync that is lost.
+ *
+ * @param reason                The reason to report to the application.
+ */
+void
+ble_gap_reset_state(int reason)
 {
-    uint8_t buf[BLE_HCI_LE_REMOVE_ADV_SET_LEN];
-    uint16_t opcode;
-    int rc;
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    struct ble_gap_event event;
+    struct ble_gap_sync *sync;
+    ble_gap_event_fn *cb;
+    uint16_t sync_handle;
+    void *cb_arg;
+    int i;
 
-    if (instance >= BLE_ADV_INSTANCES) {
-        return BLE_HS_EINVAL;
+    ble_hs_lock();
+
+    for (i = 0; i < BLE_ADV_INSTANCES; i++) {
+        ble_gap_slave[i].periodic_configured = 0;
+        ble_gap_slave[i].periodic_op = 0;
     }
 
-    ble_hs_lock();
-    if (!ble_gap_slave[instance].configured) {
-        ble_hs_unlock();
-        return BLE_HS_EALREADY;
+    sync = ble_gap_sync_pending;
+    ble_gap_sync_pending = NULL;
+    if (sync != NULL) {
+        cb = sync->cb;
+        cb_arg = sync->cb_arg;
+        os_memblock_put(&ble_gap_sync_pool, sync);
     }
 
-    if (ble_gap_slave[instance].op == BLE_GAP_OP_S_ADV) {
-        ble_hs_unlock();
-        return BLE_HS_EBUSY;
+    ble_hs_unlock();
+
+    if (sync != NULL) {
+        memset(&event, 0, sizeof event);
+        event.type = BLE_GAP_EVENT_PERIODIC_SYNC;
+        event.periodic_sync.status = reason;
+        ble_gap_call_event_cb(&event, cb, cb_arg);
     }
 
-    opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_REMOVE_ADV_SET);
+    while (1) {
+        ble_hs_lock();
+
+        sync = SLIST_FIRST(&ble_gap_syncs);
+        if (sync != NULL) {
+            SLIST_REMOVE_HEAD(&ble_gap_syncs, next);
+
+            sync_handle = sync->sync_handle;
+            cb = sync->cb;
+            cb_arg = sync->cb_arg;
+            os_memblock_put(&ble_gap_sync_pool, sync);
+        }
 
-    rc = ble_hs_hci_cmd_build_le_ext_adv_remove(instance, buf, sizeof(buf));
-    if (rc != 0) {
         ble_hs_unlock();
-        return rc;
+
+        if (sync == NULL) {
+            break;
+        }
+
+        memset(&event, 0, sizeof event);
+        event.type = BLE_GAP_EVENT_PERIODIC_SYNC_LOST;
+        event.periodic_sync_lost.sync_handle = sync_handle;
+        event.periodic_sync_lost.reason = reason;
+        ble_gap_call_event_cb(&event, cb, cb_arg);
     }
+#endif
+}
 
-    rc = ble_hs_hci_cmd_tx_empty_ack(opcode, buf, sizeof(buf));
+/**
+ * Replaces the advertising data of an advertising instance, including while
+ * it is advertising.  This is intended for payloads that change frequently
+ * (e.g., sensor beacons): the data is sent in a single HCI command built
+ * directly from the caller's buffer, advertising does not need to be
+ * stopped, and the controller switches to the new data at the start of the
+ * next advertising event, so no event is skipped or sent with partially
+ * updated data.
+ *
+ * @param instance              The advertising instance; must be 0 if
+ *                                  BLE_EXT_ADV is disabled.
+ * @param data                  Buffer containing the advertising data.
+ * @param data_len              The size of the advertising data, in bytes.
+ *                                  Limited to BLE_HS_ADV_MAX_SZ for legacy
+ *                                  PDUs and to what fits in a single HCI
+ *                                  command for extended PDUs.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the instance is invalid or
+ *                                  the data doesn't fit;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gap_adv_update_data(uint8_t instance, const uint8_t *data,
+                        uint8_t data_len)
+{
+#if !NIMBLE_BLE_ADVERTISE
+    return BLE_HS_ENOTSUP;
+#endif
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    uint8_t buf[BLE_HCI_SET_EXT_ADV_DATA_HDR_LEN +
+                BLE_HCI_MAX_EXT_ADV_DATA_LEN];
+#else
+    uint8_t buf[BLE_HCI_SET_ADV_DATA_LEN];
+#endif
+    int rc;
+
+    if (instance >= BLE_ADV_INSTANCES ||
+        data_len > min(BLE_HCI_MAX_EXT_ADV_DATA_LEN,
+                       MYNEWT_VAL(BLE_EXT_ADV_MAX_SIZE))) {
+        return BLE_HS_EINVAL;
+    }
+
+    STATS_INC(ble_gap_stats, adv_set_data);
+
+#if MYNEWT_VAL(BLE_EXT_ADV)
+    ble_hs_lock();
+    rc = ble_gap_ext_adv_set_data_validate(instance, data_len);
+    ble_hs_unlock();
     if (rc != 0) {
-        ble_hs_unlock();
         return rc;
     }
 
-    memset(&ble_gap_slave[instance], 0, sizeof(struct ble_gap_slave_state));
-    ble_hs_unlock();
+    buf[0] = instance;
+    buf[1] = BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE;
+    buf[2] = 0;
+    buf[3] = data_len;
+    memcpy(buf + BLE_HCI_SET_EXT_ADV_DATA_HDR_LEN, data, data_len);
 
-    return 0;
-}
+    return ble_hs_hci_cmd_tx_empty_ack(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_EXT_ADV_DATA),
+        buf, BLE_HCI_SET_EXT_ADV_DATA_HDR_LEN + data_len);
+#else
+    if (instance != 0 || data_len > BLE_HS_ADV_MAX_SZ) {
+        return BLE_HS_EINVAL;
+    }
+
+    rc = ble_hs_hci_cmd_build_le_set_adv_data(data, data_len, buf,
+                                              sizeof buf);
+    if (rc != 0) {
+        return rc;
+    }
 
+    return ble_hs_hci_cmd_tx_empty_ack(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_ADV_DATA),
+        buf, sizeof buf);
 #endif
+}
 
 /*****************************************************************************
  * $discovery procedures                                                     *
@@ -3137,6 +4633,10 @@ ble_gap_disc_cancel_no_lock(void)
         goto done;
     }
 
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) > 0
+    ble_gap_disc_batch.num = 0;
+#endif
+
     ble_gap_master_reset_state();
 
 done:
@@ -3307,6 +4807,10 @@ ble_gap_ext_disc(uint8_t own_addr_type, uint16_t duration, uint16_t period,
     }
 
     ble_gap_master.op = BLE_GAP_OP_M_DISC;
+    ble_hs_adv_dedup_reset();
+#if BLE_GAP_EXT_RSM
+    ble_gap_ext_rsm_clear();
+#endif
 
     rc = ble_gap_ext_disc_enable_tx(1, filter_duplicates, duration, period);
     if (rc != 0) {
@@ -3450,6 +4954,7 @@ ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms,
     }
 
     ble_gap_master.op = BLE_GAP_OP_M_DISC;
+    ble_hs_adv_dedup_reset();
 
     rc = ble_gap_disc_enable_tx(1, params.filter_duplicates);
     if (rc != 0) {
@@ -3486,6 +4991,66 @@ ble_gap_disc_active(void)
     return ble_gap_master.op == BLE_GAP_OP_M_DISC;
 }
 
+/**
+ * Configures batched delivery of advertising reports for subsequent legacy
+ * discovery procedures.  When enabled, the application receives a single
+ * BLE_GAP_EVENT_DISC_BATCH event per batch instead of one BLE_GAP_EVENT_DISC
+ * event per report.  A batch is delivered when it holds max_reports reports,
+ * when window_ms has elapsed since its first report, or when the procedure
+ * times out.  Reports still pending when discovery is cancelled are
+ * discarded.  Extended discovery procedures are not affected, and neither is
+ * mesh, which keeps receiving each report as it arrives.
+ *
+ * @param max_reports           The number of reports per batch, at most
+ *                                  BLE_GAP_DISC_BATCH_MAX; 0 disables
+ *                                  batching.
+ * @param window_ms             The longest time, in milliseconds, a report
+ *                                  may be held back; 0 means reports are
+ *                                  only delivered when the batch is full or
+ *                                  the procedure ends.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if a parameter is invalid;
+ *                              BLE_HS_EBUSY if discovery is in progress;
+ *                              BLE_HS_ENOTSUP if batching is not compiled
+ *                                  in.
+ */
+int
+ble_gap_disc_batch_set(uint8_t max_reports, uint32_t window_ms)
+{
+#if !NIMBLE_BLE_SCAN || MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) == 0
+    return BLE_HS_ENOTSUP;
+#else
+
+    uint32_t window_ticks;
+    int rc;
+
+    if (max_reports > MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX)) {
+        return BLE_HS_EINVAL;
+    }
+
+    rc = os_time_ms_to_ticks(window_ms, &window_ticks);
+    if (rc != 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_disc_active()) {
+        rc = BLE_HS_EBUSY;
+    } else {
+        ble_gap_disc_batch.max = max_reports;
+        ble_gap_disc_batch.window_ticks = window_ticks;
+        ble_gap_disc_batch.num = 0;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+#endif
+}
+
 /*****************************************************************************
  * $connection establishment procedures                                      *
  *****************************************************************************/
@@ -4268,6 +5833,7 @@ ble_gap_rx_param_req(struct hci_le_conn_param_req *evt)
     }
 
     if (rc == 0) {
+        ble_gap_plan_adjust(evt->connection_handle, &self_params);
         rc = ble_gap_tx_param_pos_reply(evt->connection_handle, &self_params);
         if (rc != 0) {
             ble_gap_update_failed(evt->connection_handle, rc);
@@ -4904,11 +6470,20 @@ ble_gap_init(void)
 
     memset(&ble_gap_master, 0, sizeof ble_gap_master);
     memset(ble_gap_slave, 0, sizeof ble_gap_slave);
+#if MYNEWT_VAL(BLE_GAP_DISC_BATCH_MAX) > 0
+    memset(&ble_gap_disc_batch, 0, sizeof ble_gap_disc_batch);
+#endif
+    ble_gap_reconn_init();
+    ble_gap_plan_init();
 
     os_mutex_init(&preempt_done_mutex);
 
     SLIST_INIT(&ble_gap_update_entries);
 
+    SLIST_INIT(&ble_gap_event_listener_list);
+    ble_gap_event_listener_mask = 0;
+    ble_gap_event_listener_num = 0;
+
     rc = os_mempool_init(&ble_gap_update_entry_pool,
                          BLE_GAP_MAX_UPDATE_ENTRIES,
                          sizeof (struct ble_gap_update_entry),
@@ -4925,6 +6500,33 @@ ble_gap_init(void)
         goto err;
     }
 
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    SLIST_INIT(&ble_gap_syncs);
+    ble_gap_sync_pending = NULL;
+
+    rc = os_mempool_init(&ble_gap_sync_pool,
+                         MYNEWT_VAL(BLE_MAX_PERIODIC_SYNCS),
+                         sizeof (struct ble_gap_sync),
+                         ble_gap_sync_mem, "ble_gap_sync");
+    if (rc != 0) {
+        rc = BLE_HS_EOS;
+        goto err;
+    }
+#endif
+
+#if BLE_GAP_EXT_RSM
+    SLIST_INIT(&ble_gap_ext_rsms);
+
+    rc = os_mempool_init(&ble_gap_ext_rsm_pool,
+                         MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_MAX),
+                         sizeof (struct ble_gap_ext_rsm),
+                         ble_gap_ext_rsm_mem, "ble_gap_ext_rsm");
+    if (rc != 0) {
+        rc = BLE_HS_EOS;
+        goto err;
+    }
+#endif
+
     rc = stats_init_and_reg(
         STATS_HDR(ble_gap_stats), STATS_SIZE_INIT_PARMS(ble_gap_stats,
         STATS_SIZE_32), STATS_NAME_INIT_PARMS(ble_gap_stats), "ble_gap");
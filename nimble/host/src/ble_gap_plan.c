@@ -0,0 +1,435 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "host/ble_gap.h"
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_GAP_PLAN)
+
+/**
+ * Each planned link reserves ce_len / (2 * itvl) of the controller's air
+ * time (CE length is in 0.625 ms units, interval in 1.25 ms units).  Loads
+ * are summed in units of 1 / BLE_GAP_PLAN_LOAD_FULL.
+ */
+#define BLE_GAP_PLAN_LOAD_FULL          0x10000UL
+
+struct ble_gap_plan_link {
+    uint16_t conn_handle;
+
+    /** The interval assigned by the planner, in 1.25 ms units. */
+    uint16_t itvl;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+
+    uint16_t num_updates;
+    uint16_t num_on_plan;
+};
+
+static struct ble_gap_plan_link
+    ble_gap_plan_links[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+
+static uint16_t ble_gap_plan_base_itvl;
+static uint16_t ble_gap_plan_ce_len;
+
+/** Sum of the loads of all planned links. */
+static uint32_t ble_gap_plan_load;
+
+static uint32_t
+ble_gap_plan_link_load(uint16_t itvl)
+{
+    return (uint32_t)ble_gap_plan_ce_len * (BLE_GAP_PLAN_LOAD_FULL / 2) / itvl;
+}
+
+static struct ble_gap_plan_link *
+ble_gap_plan_link_find(uint16_t conn_handle)
+{
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        if (ble_gap_plan_links[i].conn_handle == conn_handle) {
+            return ble_gap_plan_links + i;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+ble_gap_plan_link_free(struct ble_gap_plan_link *link)
+{
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    ble_gap_plan_load -= ble_gap_plan_link_load(link->itvl);
+    memset(link, 0, sizeof *link);
+    link->conn_handle = BLE_HS_CONN_HANDLE_NONE;
+}
+
+static void
+ble_gap_plan_fill_params(const struct ble_gap_plan_link *link,
+                         struct ble_gap_upd_params *params)
+{
+    params->itvl_min = link->itvl;
+    params->itvl_max = link->itvl;
+    params->min_ce_len = ble_gap_plan_ce_len;
+    params->max_ce_len = ble_gap_plan_ce_len;
+}
+
+/**
+ * Configures the connection parameter planner.  Every interval the planner
+ * assigns is the base interval multiplied by a power of two, so the
+ * connection events of all planned links recur in a fixed pattern and
+ * their anchor points never drift into each other.  Each planned link
+ * requests a fixed connection event length, which is what the planner uses
+ * to keep the combined load of all links within the available air time.
+ *
+ * The planner can only be reconfigured while no links are planned.
+ *
+ * @param base_itvl             The base connection interval, in 1.25 ms
+ *                                  units.
+ * @param ce_len                The connection event length to reserve for
+ *                                  each link, in 0.625 ms units.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if a parameter is out of range;
+ *                              BLE_HS_EBUSY if any link is planned;
+ *                              BLE_HS_ENOTSUP if the planner is not
+ *                                  compiled in.
+ */
+int
+ble_gap_plan_configure(uint16_t base_itvl, uint16_t ce_len)
+{
+    int rc;
+
+    if (base_itvl < BLE_HCI_CONN_ITVL_MIN ||
+        base_itvl > BLE_HCI_CONN_ITVL_MAX ||
+        ce_len == 0 || ce_len > 2 * base_itvl) {
+
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_plan_load != 0) {
+        rc = BLE_HS_EBUSY;
+    } else {
+        ble_gap_plan_base_itvl = base_itvl;
+        ble_gap_plan_ce_len = ce_len;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Adds a connection to the plan and asks for the planned parameters on it.
+ * The planner picks the longest interval that is a power-of-two multiple of
+ * the base interval and does not exceed the requested maximum.  The link
+ * keeps its planned interval until it is removed from the plan: connection
+ * parameter requests from the peer are answered with the planned interval
+ * and connection event length.  The outcome of each parameter update on the
+ * link is recorded (see ble_gap_plan_link_stats()).
+ *
+ * @param conn_handle           The connection to plan.
+ * @param max_itvl              The longest acceptable connection interval,
+ *                                  in 1.25 ms units.
+ * @param latency               The slave latency to request.
+ * @param supervision_timeout   The supervision timeout to request, in 10 ms
+ *                                  units.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if the link is already
+ *                                  planned;
+ *                              BLE_HS_EINVAL if max_itvl is shorter than
+ *                                  the base interval, or the resulting
+ *                                  parameters are invalid;
+ *                              BLE_HS_ENOMEM if the link does not fit in
+ *                                  the remaining air time;
+ *                              BLE_HS_ENOTCONN if there is no such
+ *                                  connection;
+ *                              Other nonzero on failure to start the
+ *                                  parameter update.
+ */
+int
+ble_gap_plan_link(uint16_t conn_handle, uint16_t max_itvl, uint16_t latency,
+                  uint16_t supervision_timeout)
+{
+    struct ble_gap_upd_params params;
+    struct ble_gap_plan_link *link;
+    uint32_t load;
+    uint16_t itvl;
+    int rc;
+
+    ble_hs_lock();
+
+    if (ble_hs_conn_find(conn_handle) == NULL) {
+        rc = BLE_HS_ENOTCONN;
+        goto done;
+    }
+
+    if (ble_gap_plan_link_find(conn_handle) != NULL) {
+        rc = BLE_HS_EALREADY;
+        goto done;
+    }
+
+    if (max_itvl < ble_gap_plan_base_itvl) {
+        rc = BLE_HS_EINVAL;
+        goto done;
+    }
+
+    itvl = ble_gap_plan_base_itvl;
+    while (itvl <= max_itvl / 2 && itvl * 2 <= BLE_HCI_CONN_ITVL_MAX) {
+        itvl *= 2;
+    }
+
+    load = ble_gap_plan_link_load(itvl);
+    if (ble_gap_plan_load + load > BLE_GAP_PLAN_LOAD_FULL) {
+        rc = BLE_HS_ENOMEM;
+        goto done;
+    }
+
+    link = ble_gap_plan_link_find(BLE_HS_CONN_HANDLE_NONE);
+    BLE_HS_DBG_ASSERT(link != NULL);
+
+    link->conn_handle = conn_handle;
+    link->itvl = itvl;
+    link->latency = latency;
+    link->supervision_timeout = supervision_timeout;
+    ble_gap_plan_load += load;
+
+    ble_gap_plan_fill_params(link, &params);
+    params.latency = latency;
+    params.supervision_timeout = supervision_timeout;
+
+    rc = 0;
+
+done:
+    ble_hs_unlock();
+
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_gap_update_params(conn_handle, &params);
+    if (rc != 0) {
+        ble_hs_lock();
+        link = ble_gap_plan_link_find(conn_handle);
+        if (link != NULL) {
+            ble_gap_plan_link_free(link);
+        }
+        ble_hs_unlock();
+    }
+
+    return rc;
+}
+
+/**
+ * Removes a connection from the plan, releasing its share of the air time.
+ * The connection keeps its current parameters.
+ *
+ * @param conn_handle           The connection to remove.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if the link is not planned.
+ */
+int
+ble_gap_plan_unlink(uint16_t conn_handle)
+{
+    struct ble_gap_plan_link *link;
+    int rc;
+
+    ble_hs_lock();
+
+    link = ble_gap_plan_link_find(conn_handle);
+    if (link == NULL) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        ble_gap_plan_link_free(link);
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Retrieves the planned parameters of a link and how well the link has
+ * kept to them.
+ *
+ * @param conn_handle           The planned connection.
+ * @param out_stats             On success, the link's statistics are
+ *                                  written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if the link is not planned.
+ */
+int
+ble_gap_plan_link_stats(uint16_t conn_handle,
+                        struct ble_gap_plan_link_stats *out_stats)
+{
+    struct ble_gap_plan_link *link;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    ble_hs_lock();
+
+    link = ble_gap_plan_link_find(conn_handle);
+    conn = ble_hs_conn_find(conn_handle);
+    if (link == NULL || conn == NULL) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        out_stats->planned_itvl = link->itvl;
+        out_stats->conn_itvl = conn->bhc_itvl;
+        out_stats->num_updates = link->num_updates;
+        out_stats->num_on_plan = link->num_on_plan;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+void
+ble_gap_plan_adjust(uint16_t conn_handle, struct ble_gap_upd_params *params)
+{
+    struct ble_gap_plan_link *link;
+    uint32_t min_timeout;
+
+    ble_hs_lock();
+
+    link = ble_gap_plan_link_find(conn_handle);
+    if (link != NULL) {
+        ble_gap_plan_fill_params(link, params);
+
+        /* Keep the peer's latency and timeout unless the planned interval
+         * makes the timeout too short (see ble_gap_validate_conn_params()).
+         */
+        min_timeout = ((1 + params->latency) * (uint32_t)link->itvl) / 4 + 1;
+        if (params->supervision_timeout < min_timeout) {
+            params->latency = link->latency;
+            params->supervision_timeout = link->supervision_timeout;
+        }
+    }
+
+    ble_hs_unlock();
+}
+
+void
+ble_gap_plan_rx_update(uint16_t conn_handle, int status, uint16_t itvl)
+{
+    struct ble_gap_plan_link *link;
+
+    ble_hs_lock();
+
+    link = ble_gap_plan_link_find(conn_handle);
+    if (link != NULL) {
+        link->num_updates++;
+        if (status == 0 && itvl == link->itvl) {
+            link->num_on_plan++;
+        }
+    }
+
+    ble_hs_unlock();
+}
+
+void
+ble_gap_plan_conn_broken(uint16_t conn_handle)
+{
+    struct ble_gap_plan_link *link;
+
+    ble_hs_lock();
+
+    link = ble_gap_plan_link_find(conn_handle);
+    if (link != NULL) {
+        ble_gap_plan_link_free(link);
+    }
+
+    ble_hs_unlock();
+}
+
+void
+ble_gap_plan_init(void)
+{
+    int i;
+
+    ble_gap_plan_base_itvl = MYNEWT_VAL(BLE_GAP_PLAN_BASE_ITVL);
+    ble_gap_plan_ce_len = MYNEWT_VAL(BLE_GAP_PLAN_CE_LEN);
+    ble_gap_plan_load = 0;
+
+    memset(ble_gap_plan_links, 0, sizeof ble_gap_plan_links);
+    for (i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); i++) {
+        ble_gap_plan_links[i].conn_handle = BLE_HS_CONN_HANDLE_NONE;
+    }
+}
+
+#else
+
+int
+ble_gap_plan_configure(uint16_t base_itvl, uint16_t ce_len)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_plan_link(uint16_t conn_handle, uint16_t max_itvl, uint16_t latency,
+                  uint16_t supervision_timeout)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_plan_unlink(uint16_t conn_handle)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_plan_link_stats(uint16_t conn_handle,
+                        struct ble_gap_plan_link_stats *out_stats)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+void
+ble_gap_plan_adjust(uint16_t conn_handle, struct ble_gap_upd_params *params)
+{
+}
+
+void
+ble_gap_plan_rx_update(uint16_t conn_handle, int status, uint16_t itvl)
+{
+}
+
+void
+ble_gap_plan_conn_broken(uint16_t conn_handle)
+{
+}
+
+void
+ble_gap_plan_init(void)
+{
+}
+
+#endif
@@ -63,6 +63,10 @@ STATS_SECT_START(ble_gap_stats)
     STATS_SECT_ENTRY(rx_disconnect)
     STATS_SECT_ENTRY(rx_update_complete)
     STATS_SECT_ENTRY(rx_adv_report)
+    STATS_SECT_ENTRY(rx_adv_report_filtered)
+    STATS_SECT_ENTRY(rx_ext_adv_rsm_drop)
+    STATS_SECT_ENTRY(rx_ext_adv_rsm_trunc)
+    STATS_SECT_ENTRY(rx_ext_adv_rsm_timeout)
     STATS_SECT_ENTRY(rx_conn_complete)
     STATS_SECT_ENTRY(discover_cancel)
     STATS_SECT_ENTRY(discover_cancel_fail)
@@ -78,6 +82,13 @@ extern STATS_SECT_DECL(ble_gap_stats) ble_gap_stats;
 #if MYNEWT_VAL(BLE_EXT_ADV)
 void ble_gap_rx_ext_adv_report(struct ble_gap_ext_disc_desc *desc);
 void ble_gap_rx_adv_set_terminated(struct hci_le_adv_set_terminated *evt);
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+void ble_gap_rx_periodic_adv_sync_estab(
+    struct hci_le_periodic_adv_sync_estab *evt);
+void ble_gap_rx_periodic_adv_rpt(struct hci_le_periodic_adv_rpt *evt);
+void ble_gap_rx_periodic_adv_sync_lost(
+    struct hci_le_periodic_adv_sync_lost *evt);
+#endif
 #endif
 void ble_gap_rx_adv_report(struct ble_gap_disc_desc *desc);
 void ble_gap_rx_rd_rem_sup_feat_complete(struct hci_le_rd_rem_supp_feat_complete *evt);
@@ -109,8 +120,18 @@ void ble_gap_preempt(void);
 void ble_gap_preempt_done(void);
 
 void ble_gap_conn_broken(uint16_t conn_handle, int reason);
+void ble_gap_reset_state(int reason);
 int32_t ble_gap_timer(void);
 
+int32_t ble_gap_reconn_timer(void);
+void ble_gap_reconn_init(void);
+
+void ble_gap_plan_adjust(uint16_t conn_handle,
+                         struct ble_gap_upd_params *params);
+void ble_gap_plan_rx_update(uint16_t conn_handle, int status, uint16_t itvl);
+void ble_gap_plan_conn_broken(uint16_t conn_handle);
+void ble_gap_plan_init(void);
+
 int ble_gap_init(void);
 
 #if MYNEWT_VAL(BLE_HS_DEBUG)
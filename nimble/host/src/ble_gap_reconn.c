@@ -0,0 +1,482 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "host/ble_gap.h"
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_GAP_RECONNECT_MAX) > 0 && MYNEWT_VAL(BLE_ROLE_CENTRAL)
+
+/**
+ * If the initiator can't be (re)started because another GAP procedure is
+ * in the way, try again after this many milliseconds.
+ */
+#define BLE_GAP_RECONN_RETRY_MS         100
+
+struct ble_gap_reconn_target {
+    ble_addr_t addr;
+    uint8_t connected;
+};
+
+/**
+ * State of the reconnect procedure.  Shared between the application task
+ * (start / stop) and the host task (GAP events, timer); protected by the
+ * host lock.
+ */
+static struct {
+    struct ble_gap_reconn_target targets[MYNEWT_VAL(BLE_GAP_RECONNECT_MAX)];
+    struct ble_gap_conn_params conn_params;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+    os_time_t arm_os_ticks;
+    uint8_t num_targets;
+    uint8_t num_connected;
+    uint8_t own_addr_type;
+    uint8_t active:1;
+    uint8_t has_conn_params:1;
+
+    /** The initiator should be (re)started at arm_os_ticks. */
+    uint8_t arm_pending:1;
+
+    /** The white-list initiator is running on our behalf. */
+    uint8_t armed:1;
+} ble_gap_reconn;
+
+static void
+ble_gap_reconn_schedule(uint32_t delay_ms)
+{
+    os_time_t delay_ticks;
+    int rc;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    rc = os_time_ms_to_ticks(delay_ms, &delay_ticks);
+    if (rc != 0) {
+        delay_ticks = 0;
+    }
+
+    ble_gap_reconn.arm_os_ticks = os_time_get() + delay_ticks;
+    ble_gap_reconn.arm_pending = 1;
+    ble_hs_timer_resched();
+}
+
+static int
+ble_gap_reconn_retry_ok(int status)
+{
+    switch (status) {
+    case BLE_HS_EALREADY:
+    case BLE_HS_EBUSY:
+    case BLE_HS_EPREEMPTED:
+    case BLE_HS_ENOMEM:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+static void
+ble_gap_reconn_progress(int status, ble_gap_event_fn *cb, void *cb_arg)
+{
+    struct ble_gap_event event;
+
+    memset(&event, 0, sizeof event);
+    event.type = BLE_GAP_EVENT_RECONNECT;
+    event.reconnect.status = status;
+
+    ble_hs_lock();
+    event.reconnect.num_connected = ble_gap_reconn.num_connected;
+    event.reconnect.num_targets = ble_gap_reconn.num_targets;
+    ble_hs_unlock();
+
+    if (cb != NULL) {
+        cb(&event, cb_arg);
+    }
+}
+
+static int
+ble_gap_reconn_gap_event(struct ble_gap_event *event, void *arg)
+{
+    struct ble_gap_reconn_target *target;
+    struct ble_gap_conn_desc desc;
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+    int report;
+    int rc;
+    int i;
+
+    ble_hs_lock();
+    cb = ble_gap_reconn.cb;
+    cb_arg = ble_gap_reconn.cb_arg;
+    ble_hs_unlock();
+
+    if (event->type != BLE_GAP_EVENT_CONNECT) {
+        return cb != NULL ? cb(event, cb_arg) : 0;
+    }
+
+    if (event->connect.status != 0) {
+        /* The initiator stopped without connecting (cancelled or failed);
+         * start it again unless the application stopped the procedure.
+         */
+        ble_hs_lock();
+        ble_gap_reconn.armed = 0;
+        if (ble_gap_reconn.active) {
+            ble_gap_reconn_schedule(BLE_GAP_RECONN_RETRY_MS);
+        }
+        ble_hs_unlock();
+
+        return 0;
+    }
+
+    rc = ble_gap_conn_find(event->connect.conn_handle, &desc);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    report = 0;
+
+    ble_hs_lock();
+
+    ble_gap_reconn.armed = 0;
+    for (i = 0; i < ble_gap_reconn.num_targets; i++) {
+        target = ble_gap_reconn.targets + i;
+        if (!target->connected &&
+            (ble_addr_cmp(&target->addr, &desc.peer_ota_addr) == 0 ||
+             ble_addr_cmp(&target->addr, &desc.peer_id_addr) == 0)) {
+
+            target->connected = 1;
+            ble_gap_reconn.num_connected++;
+            report = 1;
+            break;
+        }
+    }
+
+    if (ble_gap_reconn.num_connected >= ble_gap_reconn.num_targets) {
+        ble_gap_reconn.active = 0;
+    } else if (ble_gap_reconn.active) {
+        ble_gap_reconn_schedule(0);
+    }
+
+    ble_hs_unlock();
+
+    /* From now on, the application handles this connection directly. */
+    ble_gap_set_event_cb(event->connect.conn_handle, cb, cb_arg);
+
+    rc = cb != NULL ? cb(event, cb_arg) : 0;
+    if (report) {
+        ble_gap_reconn_progress(0, cb, cb_arg);
+    }
+
+    return rc;
+}
+
+/**
+ * Starts the white-list initiator for every target that is not connected
+ * yet.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EDONE if every target is connected;
+ *                              Other nonzero on error.
+ */
+static int
+ble_gap_reconn_arm(void)
+{
+    ble_addr_t addrs[MYNEWT_VAL(BLE_GAP_RECONNECT_MAX)];
+    struct ble_gap_conn_params conn_params;
+    struct ble_gap_reconn_target *target;
+    uint8_t own_addr_type;
+    int has_conn_params;
+    int num_addrs;
+    int rc;
+    int i;
+
+    num_addrs = 0;
+
+    ble_hs_lock();
+
+    for (i = 0; i < ble_gap_reconn.num_targets; i++) {
+        target = ble_gap_reconn.targets + i;
+        if (target->connected) {
+            continue;
+        }
+
+        /* The application may have connected to this peer on its own. */
+        if (ble_hs_conn_find_by_addr(&target->addr) != NULL) {
+            target->connected = 1;
+            ble_gap_reconn.num_connected++;
+            continue;
+        }
+
+        addrs[num_addrs++] = target->addr;
+    }
+
+    own_addr_type = ble_gap_reconn.own_addr_type;
+    conn_params = ble_gap_reconn.conn_params;
+    has_conn_params = ble_gap_reconn.has_conn_params;
+
+    ble_hs_unlock();
+
+    if (num_addrs == 0) {
+        return BLE_HS_EDONE;
+    }
+
+    rc = ble_gap_wl_set(addrs, num_addrs);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_hs_lock();
+    ble_gap_reconn.armed = 1;
+    ble_hs_unlock();
+
+    rc = ble_gap_connect(own_addr_type, NULL, BLE_HS_FOREVER,
+                         has_conn_params ? &conn_params : NULL,
+                         ble_gap_reconn_gap_event, NULL);
+    if (rc != 0) {
+        ble_hs_lock();
+        ble_gap_reconn.armed = 0;
+        ble_hs_unlock();
+    }
+
+    return rc;
+}
+
+/**
+ * Restarts the initiator when due.
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+int32_t
+ble_gap_reconn_timer(void)
+{
+    ble_gap_event_fn *cb;
+    void *cb_arg;
+    int32_t ticks;
+    int rc;
+
+    ble_hs_lock();
+
+    if (!ble_gap_reconn.active || !ble_gap_reconn.arm_pending) {
+        ble_hs_unlock();
+        return BLE_HS_FOREVER;
+    }
+
+    ticks = ble_gap_reconn.arm_os_ticks - os_time_get();
+    if (ticks > 0) {
+        ble_hs_unlock();
+        return ticks;
+    }
+
+    ble_gap_reconn.arm_pending = 0;
+    cb = ble_gap_reconn.cb;
+    cb_arg = ble_gap_reconn.cb_arg;
+
+    ble_hs_unlock();
+
+    rc = ble_gap_reconn_arm();
+    if (rc == 0) {
+        return BLE_HS_FOREVER;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_reconn_retry_ok(rc) && ble_gap_reconn.active) {
+        ble_gap_reconn_schedule(BLE_GAP_RECONN_RETRY_MS);
+        ticks = ble_gap_reconn.arm_os_ticks - os_time_get();
+        rc = 0;
+    } else {
+        ble_gap_reconn.active = 0;
+        ticks = BLE_HS_FOREVER;
+    }
+
+    ble_hs_unlock();
+
+    if (rc != 0) {
+        /* Either every target is connected or the procedure can't go on. */
+        ble_gap_reconn_progress(rc == BLE_HS_EDONE ? 0 : rc, cb, cb_arg);
+    }
+
+    return ticks;
+}
+
+/**
+ * Reconnects to a set of known peers.  The host programs the white list
+ * with every peer that is not connected yet and runs a white-list initiator,
+ * so it connects to whichever peer advertises first instead of waiting for
+ * the peers one at a time.  After each connection the initiator is re-armed
+ * with the remaining peers until all of them are connected or the procedure
+ * is stopped.
+ *
+ * The callback receives a BLE_GAP_EVENT_CONNECT event for each new
+ * connection, and the connection keeps the callback afterwards, as if it had
+ * been passed to ble_gap_connect().  After each connection, and when the
+ * procedure ends, it also receives a BLE_GAP_EVENT_RECONNECT event reporting
+ * progress.
+ *
+ * The procedure owns the white list and the initiator while it runs; other
+ * connect, discovery and white list operations are retried around.
+ *
+ * @param own_addr_type         The type of address the stack should use for
+ *                                  itself.
+ * @param addrs                 The peers to reconnect to.
+ * @param num_addrs             The number of peers; at most
+ *                                  BLE_GAP_RECONNECT_MAX.
+ * @param conn_params           The connection parameters to use; NULL for
+ *                                  defaults.
+ * @param cb                    The callback to report events through.
+ * @param cb_arg                The optional argument to pass to the callback.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if a reconnect procedure is
+ *                                  already running;
+ *                              BLE_HS_EINVAL if the peer list is invalid;
+ *                              BLE_HS_ENOTSUP if the procedure is not
+ *                                  compiled in;
+ *                              Other nonzero on failure to start the
+ *                                  initiator.
+ */
+int
+ble_gap_reconnect_start(uint8_t own_addr_type, const ble_addr_t *addrs,
+                        uint8_t num_addrs,
+                        const struct ble_gap_conn_params *conn_params,
+                        ble_gap_event_fn *cb, void *cb_arg)
+{
+    int rc;
+    int i;
+
+    if (num_addrs == 0 || num_addrs > MYNEWT_VAL(BLE_GAP_RECONNECT_MAX)) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_reconn.active) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    memset(&ble_gap_reconn, 0, sizeof ble_gap_reconn);
+    for (i = 0; i < num_addrs; i++) {
+        ble_gap_reconn.targets[i].addr = addrs[i];
+    }
+    ble_gap_reconn.num_targets = num_addrs;
+    ble_gap_reconn.own_addr_type = own_addr_type;
+    if (conn_params != NULL) {
+        ble_gap_reconn.conn_params = *conn_params;
+        ble_gap_reconn.has_conn_params = 1;
+    }
+    ble_gap_reconn.cb = cb;
+    ble_gap_reconn.cb_arg = cb_arg;
+    ble_gap_reconn.active = 1;
+
+    ble_hs_unlock();
+
+    rc = ble_gap_reconn_arm();
+    if (rc == 0) {
+        return 0;
+    }
+
+    ble_hs_lock();
+
+    if (ble_gap_reconn_retry_ok(rc)) {
+        /* Another procedure is in the way; keep trying in the background. */
+        ble_gap_reconn_schedule(BLE_GAP_RECONN_RETRY_MS);
+        rc = 0;
+    } else {
+        ble_gap_reconn.active = 0;
+    }
+
+    ble_hs_unlock();
+
+    if (rc == BLE_HS_EDONE) {
+        /* Every peer was already connected. */
+        ble_gap_reconn_progress(0, cb, cb_arg);
+        rc = 0;
+    }
+
+    return rc;
+}
+
+/**
+ * Stops the reconnect procedure.  Connections established so far are not
+ * affected.  No further BLE_GAP_EVENT_RECONNECT events are reported.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if no reconnect procedure is
+ *                                  running.
+ */
+int
+ble_gap_reconnect_stop(void)
+{
+    int armed;
+
+    ble_hs_lock();
+
+    if (!ble_gap_reconn.active) {
+        ble_hs_unlock();
+        return BLE_HS_EALREADY;
+    }
+
+    ble_gap_reconn.active = 0;
+    ble_gap_reconn.arm_pending = 0;
+    armed = ble_gap_reconn.armed;
+
+    ble_hs_unlock();
+
+    if (armed) {
+        ble_gap_conn_cancel();
+    }
+
+    return 0;
+}
+
+void
+ble_gap_reconn_init(void)
+{
+    memset(&ble_gap_reconn, 0, sizeof ble_gap_reconn);
+}
+
+#else
+
+int
+ble_gap_reconnect_start(uint8_t own_addr_type, const ble_addr_t *addrs,
+                        uint8_t num_addrs,
+                        const struct ble_gap_conn_params *conn_params,
+                        ble_gap_event_fn *cb, void *cb_arg)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_gap_reconnect_stop(void)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int32_t
+ble_gap_reconn_timer(void)
+{
+    return BLE_HS_FOREVER;
+}
+
+void
+ble_gap_reconn_init(void)
+{
+}
+
+#endif
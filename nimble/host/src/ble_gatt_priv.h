@@ -58,6 +58,8 @@ STATS_SECT_START(ble_gattc_stats)
     STATS_SECT_ENTRY(read_mult_fail)
     STATS_SECT_ENTRY(write_no_rsp)
     STATS_SECT_ENTRY(write_no_rsp_fail)
+    STATS_SECT_ENTRY(signed_write)
+    STATS_SECT_ENTRY(signed_write_fail)
     STATS_SECT_ENTRY(write)
     STATS_SECT_ENTRY(write_fail)
     STATS_SECT_ENTRY(write_long)
@@ -447,6 +447,8 @@ STATS_NAME_START(ble_gattc_stats)
     STATS_NAME(ble_gattc_stats, read_mult_fail)
     STATS_NAME(ble_gattc_stats, write_no_rsp)
     STATS_NAME(ble_gattc_stats, write_no_rsp_fail)
+    STATS_NAME(ble_gattc_stats, signed_write)
+    STATS_NAME(ble_gattc_stats, signed_write_fail)
     STATS_NAME(ble_gattc_stats, write)
     STATS_NAME(ble_gattc_stats, write_fail)
     STATS_NAME(ble_gattc_stats, write_long)
@@ -3607,6 +3609,74 @@ ble_gattc_write_no_rsp_flat(uint16_t conn_handle, uint16_t attr_handle,
     return 0;
 }
 
+/*****************************************************************************
+ * $signed write                                                             *
+ *****************************************************************************/
+
+/**
+ * Initiates GATT procedure: Signed Write Without Response.  The value is
+ * authenticated with the CSRK we distributed to the peer when bonding, so the
+ * peer can accept it without an encrypted link.  If the link is already
+ * encrypted, a plain Write Without Response is sent instead, as the
+ * specification requires.  This function consumes the supplied mbuf
+ * regardless of the outcome.
+ *
+ * @param conn_handle           The connection over which to execute the
+ *                                  procedure.
+ * @param attr_handle           The handle of the characteristic value to write
+ *                                  to.
+ * @param txom                  The value to write to the characteristic.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EAUTHEN if we have not distributed a
+ *                                  CSRK to the peer;
+ *                              Other nonzero on failure.
+ */
+int
+ble_gattc_signed_write(uint16_t conn_handle, uint16_t attr_handle,
+                       struct os_mbuf *txom)
+{
+#if !MYNEWT_VAL(BLE_GATT_SIGNED_WRITE)
+    return BLE_HS_ENOTSUP;
+#endif
+
+    struct ble_hs_conn *conn;
+    int encrypted;
+    int rc;
+
+    STATS_INC(ble_gattc_stats, signed_write);
+
+    encrypted = 0;  /* Silence gcc warning. */
+
+    ble_hs_lock();
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        encrypted = conn->bhc_sec_state.encrypted;
+    }
+    ble_hs_unlock();
+
+    if (conn == NULL) {
+        os_mbuf_free_chain(txom);
+        rc = BLE_HS_ENOTCONN;
+        goto done;
+    }
+
+    ble_gattc_log_write(attr_handle, OS_MBUF_PKTLEN(txom), 0);
+
+    if (encrypted) {
+        rc = ble_att_clt_tx_write_cmd(conn_handle, attr_handle, txom);
+    } else {
+        rc = ble_att_clt_tx_signed_write_cmd(conn_handle, attr_handle, txom);
+    }
+
+done:
+    if (rc != 0) {
+        STATS_INC(ble_gattc_stats, signed_write_fail);
+    }
+
+    return rc;
+}
+
 /*****************************************************************************
  * $write                                                                    *
  *****************************************************************************/
@@ -1488,17 +1488,58 @@ ble_gatts_rx_indicate_ack(uint16_t conn_handle, uint16_t chr_val_handle)
     return 0;
 }
 
+static int
+ble_gatts_chr_updated_persist(int obj_type, union ble_store_value *val,
+                              void *cookie)
+{
+    struct ble_store_value_cccd *cccd_value;
+    struct ble_hs_conn *conn;
+    int persist;
+
+    cccd_value = &val->cccd;
+
+    /* Determine if this record needs to be rewritten. */
+    ble_hs_lock();
+    conn = ble_hs_conn_find_by_addr(&cccd_value->peer_addr);
+
+    if (conn == NULL) {
+        /* Device isn't connected; persist the changed flag so that an
+         * update can be sent when the device reconnects and rebonds.
+         */
+        persist = 1;
+    } else if (cccd_value->flags & BLE_GATTS_CLT_CFG_F_INDICATE) {
+        /* Indication for a connected device; record that the
+         * characteristic has changed until we receive the ack.
+         */
+        persist = 1;
+    } else {
+        /* Notification for a connected device; we already sent it so there
+         * is no need to persist.
+         */
+        persist = 0;
+    }
+
+    ble_hs_unlock();
+
+    /* Only persist if the value changed flag wasn't already sent (i.e.,
+     * don't overwrite with identical data).
+     */
+    if (persist && !cccd_value->value_changed) {
+        cccd_value->value_changed = 1;
+        ble_store_write_cccd(cccd_value);
+    }
+
+    return 0;
+}
+
 void
 ble_gatts_chr_updated(uint16_t chr_val_handle)
 {
-    struct ble_store_value_cccd cccd_value;
     struct ble_store_key_cccd cccd_key;
     struct ble_gatts_clt_cfg *clt_cfg;
     struct ble_hs_conn *conn;
     int new_notifications = 0;
     int clt_cfg_idx;
-    int persist;
-    int rc;
     int i;
 
     /* Determine if notifications or indications are allowed for this
@@ -1539,52 +1580,12 @@ ble_gatts_chr_updated(uint16_t chr_val_handle)
 
     /*** Persist updated flag for unconnected and not-yet-bonded devices. */
 
-    /* Retrieve each record corresponding to the modified characteristic. */
+    /* Visit each record corresponding to the modified characteristic. */
     cccd_key.peer_addr = *BLE_ADDR_ANY;
     cccd_key.chr_val_handle = chr_val_handle;
     cccd_key.idx = 0;
 
-    while (1) {
-        rc = ble_store_read_cccd(&cccd_key, &cccd_value);
-        if (rc != 0) {
-            /* Read error or no more CCCD records. */
-            break;
-        }
-
-        /* Determine if this record needs to be rewritten. */
-        ble_hs_lock();
-        conn = ble_hs_conn_find_by_addr(&cccd_key.peer_addr);
-
-        if (conn == NULL) {
-            /* Device isn't connected; persist the changed flag so that an
-             * update can be sent when the device reconnects and rebonds.
-             */
-            persist = 1;
-        } else if (cccd_value.flags & BLE_GATTS_CLT_CFG_F_INDICATE) {
-            /* Indication for a connected device; record that the
-             * characteristic has changed until we receive the ack.
-             */
-            persist = 1;
-        } else {
-            /* Notification for a connected device; we already sent it so there
-             * is no need to persist.
-             */
-            persist = 0;
-        }
-
-        ble_hs_unlock();
-
-        /* Only persist if the value changed flag wasn't already sent (i.e.,
-         * don't overwrite with identical data).
-         */
-        if (persist && !cccd_value.value_changed) {
-            cccd_value.value_changed = 1;
-            ble_store_write_cccd(&cccd_value);
-        }
-
-        /* Read the next matching record. */
-        cccd_key.idx++;
-    }
+    ble_store_iterate_cccd(&cccd_key, ble_gatts_chr_updated_persist, NULL);
 }
 
 /**
@@ -29,21 +29,26 @@
 #include "ble_hs_priv.h"
 #include "ble_monitor_priv.h"
 
+#define BLE_HS_RX_RING_SIZE     MYNEWT_VAL(BLE_HS_RX_RING_SIZE)
+#define BLE_HS_RX_RING_MASK     (BLE_HS_RX_RING_SIZE - 1)
+
+#if BLE_HS_RX_RING_SIZE & BLE_HS_RX_RING_MASK
+#error "BLE_HS_RX_RING_SIZE must be a power of two"
+#endif
+
+#define BLE_HS_RX_TYPE_EVT      0
+#define BLE_HS_RX_TYPE_ACL      1
+
 #define BLE_HS_HCI_EVT_COUNT                    \
     (MYNEWT_VAL(BLE_HCI_EVT_HI_BUF_COUNT) +     \
      MYNEWT_VAL(BLE_HCI_EVT_LO_BUF_COUNT))
 
-static void ble_hs_event_rx_hci_ev(struct os_event *ev);
+static void ble_hs_event_rx(struct os_event *ev);
 static void ble_hs_event_tx_notify(struct os_event *ev);
 static void ble_hs_event_reset(struct os_event *ev);
 static void ble_hs_event_start(struct os_event *ev);
 static void ble_hs_timer_sched(int32_t ticks_from_now);
 
-struct os_mempool ble_hs_hci_ev_pool;
-static os_membuf_t ble_hs_hci_os_event_buf[
-    OS_MEMPOOL_SIZE(BLE_HS_HCI_EVT_COUNT, sizeof (struct os_event))
-];
-
 /** OS event - triggers tx of pending notifications and indications. */
 static struct os_event ble_hs_ev_tx_notifications = {
     .ev_cb = ble_hs_event_tx_notify,
@@ -74,10 +79,87 @@ static struct os_callout ble_hs_timer_timer;
 /* Shared queue that the host uses for work items. */
 static struct os_eventq *ble_hs_evq;
 
-static struct os_mqueue ble_hs_rx_q;
+/**
+ * Single-producer / single-consumer ring carrying HCI events and incoming ACL
+ * data from the transport to the host task.  The transport is the only
+ * writer of ble_hs_rx_head; the host task is the only writer of
+ * ble_hs_rx_tail.  Both indices are free-running and masked on access.
+ */
+struct ble_hs_rx_entry {
+    void *pkt;
+    uint8_t type;
+};
+
+static struct ble_hs_rx_entry ble_hs_rx_ring[BLE_HS_RX_RING_SIZE];
+static uint16_t ble_hs_rx_head;
+static uint16_t ble_hs_rx_tail;
+
+/**
+ * Packets that arrive while the ring is full are never dropped; they are
+ * queued here instead, and every later packet follows them until the
+ * overflow has been drained, so arrival order is preserved.  ACL data is
+ * linked through its packet header.  Each HCI event takes a node from a pool
+ * sized to the transport's event buffer count, so the pool cannot run dry
+ * before the transport does.  A node records how many overflowed ACL packets
+ * preceded its event.
+ */
+struct ble_hs_rx_ovf_evt {
+    STAILQ_ENTRY(ble_hs_rx_ovf_evt) next;
+    uint8_t *hci_evt;
+    uint16_t acl_seq;
+};
 
+static STAILQ_HEAD(, ble_hs_rx_ovf_evt) ble_hs_rx_ovf_evts;
+static STAILQ_HEAD(, os_mbuf_pkthdr) ble_hs_rx_ovf_acls;
+
+/** Number of ACL packets added to / removed from the overflow queue. */
+static uint16_t ble_hs_rx_ovf_acl_in;
+static uint16_t ble_hs_rx_ovf_acl_out;
+
+/**
+ * Number of packets in the overflow queue.  Only changed inside a critical
+ * section, but read without one to keep the ring's fast path lock-free.
+ */
+static uint16_t ble_hs_rx_ovf_cnt;
+
+static os_membuf_t ble_hs_rx_ovf_evt_mem[
+    OS_MEMPOOL_SIZE(BLE_HS_HCI_EVT_COUNT, sizeof (struct ble_hs_rx_ovf_evt))
+];
+static struct os_mempool ble_hs_rx_ovf_evt_pool;
+
+/** Set while a drain of the rx ring is scheduled but has not started. */
+static uint8_t ble_hs_rx_wakeup_pending;
+
+/** Largest number of packets processed in a single wakeup. */
+static uint16_t ble_hs_rx_batch_max;
+
+/** OS event - drains the rx ring. */
+static struct os_event ble_hs_ev_rx = {
+    .ev_cb = ble_hs_event_rx,
+};
+
+/**
+ * Protects the connection list and all per-connection state (L2CAP channels,
+ * ATT and SM state, outgoing ACL queues), as well as the controller buffer
+ * accounting.  Persistence callbacks run under the separate store lock; the
+ * two are never held at the same time.
+ *
+ * This lock is deliberately not split per connection.  Most critical
+ * sections span several connections or shared state: ACL transmit walks all
+ * connections to share the controller's buffer count, GATT and SM procedure
+ * lists are global and are searched by connection handle, and connection
+ * lookups return pointers that callers dereference after the lookup.  A
+ * per-connection lock would need a lock order across connections and
+ * reference counting for connection objects.  Sections are short and never
+ * block, so contention (see BLE_HS_LOCK_STATS) is the only cost measured.
+ */
 static struct os_mutex ble_hs_mutex;
 
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+static struct ble_hs_lock_stats
+    ble_hs_lock_stats[MYNEWT_VAL(BLE_HS_LOCK_STATS_SITES)];
+#endif
+
 /** These values keep track of required ATT and GATT resources counts.  They
  * increase as services are added, and are read when the ATT server and GATT
  * server are started.
@@ -103,6 +185,14 @@ STATS_NAME_START(ble_hs_stats)
     STATS_NAME(ble_hs_stats, sync)
     STATS_NAME(ble_hs_stats, pvcy_add_entry)
     STATS_NAME(ble_hs_stats, pvcy_add_entry_fail)
+    STATS_NAME(ble_hs_stats, rx_wakeups)
+    STATS_NAME(ble_hs_stats, rx_pkts)
+    STATS_NAME(ble_hs_stats, rx_batch_max)
+    STATS_NAME(ble_hs_stats, rx_ring_full)
+    STATS_NAME(ble_hs_stats, adv_dedup_drop)
+    STATS_NAME(ble_hs_stats, adv_dedup_evict)
+    STATS_NAME(ble_hs_stats, rpa_cache_hit)
+    STATS_NAME(ble_hs_stats, rpa_cache_miss)
 STATS_NAME_END(ble_hs_stats)
 
 struct os_eventq *
@@ -149,23 +239,147 @@ ble_hs_is_parent_task(void)
            os_sched_get_current_task() == ble_hs_parent_task;
 }
 
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
 /**
- * Locks the BLE host mutex.  Nested locks allowed.
+ * Records a lock acquisition.  The table is shared by all host locks, so it
+ * is updated inside a critical section.
+ */
+static void
+ble_hs_lock_stats_record(const char *site, int contended, os_time_t wait)
+{
+    struct ble_hs_lock_stats *entry;
+    os_sr_t sr;
+    int i;
+
+    OS_ENTER_CRITICAL(sr);
+
+    for (i = 0; i < MYNEWT_VAL(BLE_HS_LOCK_STATS_SITES); i++) {
+        entry = ble_hs_lock_stats + i;
+        if (entry->site == site) {
+            break;
+        }
+        if (entry->site == NULL) {
+            entry->site = site;
+            break;
+        }
+    }
+    /* If the table is full, this site is not tracked. */
+    if (i < MYNEWT_VAL(BLE_HS_LOCK_STATS_SITES)) {
+        entry->acquisitions++;
+        if (contended) {
+            entry->contended++;
+            entry->wait_ticks += wait;
+            if (wait > entry->max_wait_ticks) {
+                entry->max_wait_ticks = wait;
+            }
+        }
+    }
+
+    OS_EXIT_CRITICAL(sr);
+}
+#endif
+
+/**
+ * Locks the specified host mutex.  If lock statistics are enabled, the time
+ * spent waiting for another task to release the mutex is attributed to the
+ * specified call site.
  */
 void
-ble_hs_lock_nested(void)
+ble_hs_mutex_pend(struct os_mutex *mutex, const char *site)
 {
     int rc;
 
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+    os_time_t start;
+
+    rc = os_mutex_pend(mutex, 0);
+    if (rc == OS_TIMEOUT) {
+        start = os_time_get();
+        rc = os_mutex_pend(mutex, 0xffffffff);
+        BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+        ble_hs_lock_stats_record(site, 1, os_time_get() - start);
+        return;
+    }
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == OS_NOT_STARTED);
+    ble_hs_lock_stats_record(site, 0, 0);
+#else
+    rc = os_mutex_pend(mutex, 0xffffffff);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == OS_NOT_STARTED);
+#endif
+}
+
+/**
+ * Retrieves the lock contention statistics of a single call site.
+ *
+ * @param idx                   The index of the call site to retrieve.
+ * @param out_stats             On success, the statistics get written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no call site with
+ *                                  the specified index;
+ *                              BLE_HS_ENOTSUP if lock statistics are
+ *                                  disabled.
+ */
+int
+ble_hs_lock_stats_get(int idx, struct ble_hs_lock_stats *out_stats)
+{
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+    os_sr_t sr;
+    int rc;
+
+    if (idx < 0 || idx >= MYNEWT_VAL(BLE_HS_LOCK_STATS_SITES)) {
+        return BLE_HS_ENOENT;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+
+    if (ble_hs_lock_stats[idx].site == NULL) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        *out_stats = ble_hs_lock_stats[idx];
+        rc = 0;
+    }
+
+    OS_EXIT_CRITICAL(sr);
+
+    return rc;
+#else
+    return BLE_HS_ENOTSUP;
+#endif
+}
+
+/**
+ * Clears all lock contention statistics.
+ */
+void
+ble_hs_lock_stats_clear(void)
+{
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    memset(ble_hs_lock_stats, 0, sizeof ble_hs_lock_stats);
+    OS_EXIT_CRITICAL(sr);
+#endif
+}
+
+/**
+ * Locks the BLE host mutex.  Nested locks allowed.
+ */
+void
+ble_hs_lock_nested_at(const char *site)
+{
 #if MYNEWT_VAL(BLE_HS_DEBUG)
     if (!os_started()) {
         ble_hs_dbg_mutex_locked = 1;
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+        ble_hs_lock_stats_record(site, 0, 0);
+#endif
         return;
     }
 #endif
 
-    rc = os_mutex_pend(&ble_hs_mutex, 0xffffffff);
-    BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == OS_NOT_STARTED);
+    ble_hs_mutex_pend(&ble_hs_mutex, site);
 }
 
 /**
@@ -191,7 +405,7 @@ ble_hs_unlock_nested(void)
  * Locks the BLE host mutex.  Nested locks not allowed.
  */
 void
-ble_hs_lock(void)
+ble_hs_lock_at(const char *site)
 {
     BLE_HS_DBG_ASSERT(!ble_hs_locked_by_cur_task());
 #if MYNEWT_VAL(BLE_HS_DEBUG)
@@ -200,7 +414,7 @@ ble_hs_lock(void)
     }
 #endif
 
-    ble_hs_lock_nested();
+    ble_hs_lock_nested_at(site);
 }
 
 /**
@@ -218,17 +432,292 @@ ble_hs_unlock(void)
     ble_hs_unlock_nested();
 }
 
-void
-ble_hs_process_rx_data_queue(void)
+static void
+ble_hs_rx_process(const struct ble_hs_rx_entry *entry)
 {
-    struct os_mbuf *om;
+    uint8_t *hci_evt;
 
-    while ((om = os_mqueue_get(&ble_hs_rx_q)) != NULL) {
+    switch (entry->type) {
+    case BLE_HS_RX_TYPE_EVT:
+        hci_evt = entry->pkt;
 #if BLE_MONITOR
-        ble_monitor_send_om(BLE_MONITOR_OPCODE_ACL_RX_PKT, om);
+        ble_monitor_send(BLE_MONITOR_OPCODE_EVENT_PKT, hci_evt,
+                         hci_evt[1] + BLE_HCI_EVENT_HDR_LEN);
 #endif
+        ble_hs_hci_evt_process(hci_evt);
+        break;
 
-        ble_hs_hci_evt_acl_process(om);
+    case BLE_HS_RX_TYPE_ACL:
+#if BLE_MONITOR
+        ble_monitor_send_om(BLE_MONITOR_OPCODE_ACL_RX_PKT, entry->pkt);
+#endif
+        ble_hs_hci_evt_acl_process(entry->pkt);
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        break;
+    }
+}
+
+/**
+ * Removes the oldest packet from the rx ring or, once the ring is empty, from
+ * the overflow queue.  Must only be called from the host task.  Taking a
+ * packet from the ring is lock-free: the entry is read and the slot handed
+ * back to the transport with a release store of ble_hs_rx_tail.  A critical
+ * section is only entered when the ring is empty and the overflow queue is
+ * not.
+ *
+ * @return                      0 if an entry was retrieved;
+ *                              BLE_HS_ENOENT if there are no queued packets.
+ */
+static int
+ble_hs_rx_get(struct ble_hs_rx_entry *out_entry)
+{
+    struct ble_hs_rx_ovf_evt *ovf_evt;
+    struct os_mbuf_pkthdr *omp;
+    uint16_t head;
+    uint16_t tail;
+    os_sr_t sr;
+    int rc;
+
+    /* Everything in the ring arrived before anything in the overflow
+     * queue.
+     */
+    tail = ble_hs_rx_tail;
+    head = __atomic_load_n(&ble_hs_rx_head, __ATOMIC_SEQ_CST);
+    if (head != tail) {
+        *out_entry = ble_hs_rx_ring[tail & BLE_HS_RX_RING_MASK];
+        __atomic_store_n(&ble_hs_rx_tail, (uint16_t)(tail + 1),
+                         __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    /* A packet queued after the checks here is picked up by the drain its
+     * wakeup schedules.
+     */
+    if (__atomic_load_n(&ble_hs_rx_ovf_cnt, __ATOMIC_ACQUIRE) == 0) {
+        return BLE_HS_ENOENT;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+
+    /* The ring may have filled up, and overflowed, since it was checked
+     * above.  While the overflow queue is non-empty the transport does not
+     * add to the ring, and whatever is in the ring is older than anything in
+     * the overflow queue.
+     */
+    head = __atomic_load_n(&ble_hs_rx_head, __ATOMIC_ACQUIRE);
+    if (head != tail) {
+        *out_entry = ble_hs_rx_ring[tail & BLE_HS_RX_RING_MASK];
+        __atomic_store_n(&ble_hs_rx_tail, (uint16_t)(tail + 1),
+                         __ATOMIC_RELEASE);
+        OS_EXIT_CRITICAL(sr);
+        return 0;
+    }
+
+    ovf_evt = STAILQ_FIRST(&ble_hs_rx_ovf_evts);
+    omp = STAILQ_FIRST(&ble_hs_rx_ovf_acls);
+
+    if (omp != NULL &&
+        (ovf_evt == NULL ||
+         ble_hs_rx_ovf_acl_out != ovf_evt->acl_seq)) {
+
+        STAILQ_REMOVE_HEAD(&ble_hs_rx_ovf_acls, omp_next);
+        ble_hs_rx_ovf_acl_out++;
+        out_entry->pkt = OS_MBUF_PKTHDR_TO_MBUF(omp);
+        out_entry->type = BLE_HS_RX_TYPE_ACL;
+        rc = 0;
+    } else if (ovf_evt != NULL) {
+        STAILQ_REMOVE_HEAD(&ble_hs_rx_ovf_evts, next);
+        out_entry->pkt = ovf_evt->hci_evt;
+        out_entry->type = BLE_HS_RX_TYPE_EVT;
+        os_memblock_put(&ble_hs_rx_ovf_evt_pool, ovf_evt);
+        rc = 0;
+    } else {
+        rc = BLE_HS_ENOENT;
+    }
+
+    if (rc == 0) {
+        __atomic_store_n(&ble_hs_rx_ovf_cnt, (uint16_t)(ble_hs_rx_ovf_cnt - 1),
+                         __ATOMIC_RELEASE);
+    }
+
+    OS_EXIT_CRITICAL(sr);
+    return rc;
+}
+
+/**
+ * Adds a packet to the overflow queue.  Called by the transport when the
+ * ring is full or earlier packets are already waiting in the overflow
+ * queue.
+ */
+static int
+ble_hs_rx_put_ovf(void *pkt, uint8_t type)
+{
+    struct ble_hs_rx_ovf_evt *ovf_evt;
+    struct ble_hs_rx_entry *entry;
+    struct os_mbuf *om;
+    uint16_t head;
+    uint16_t tail;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+
+    /* The host task may have drained the overflow queue and freed ring
+     * slots since the caller looked.
+     */
+    head = ble_hs_rx_head;
+    tail = __atomic_load_n(&ble_hs_rx_tail, __ATOMIC_ACQUIRE);
+    if (ble_hs_rx_ovf_cnt == 0 &&
+        (uint16_t)(head - tail) < BLE_HS_RX_RING_SIZE) {
+
+        entry = ble_hs_rx_ring + (head & BLE_HS_RX_RING_MASK);
+        entry->pkt = pkt;
+        entry->type = type;
+        __atomic_store_n(&ble_hs_rx_head, (uint16_t)(head + 1),
+                         __ATOMIC_RELEASE);
+
+        OS_EXIT_CRITICAL(sr);
+        return 0;
+    }
+
+    switch (type) {
+    case BLE_HS_RX_TYPE_EVT:
+        ovf_evt = os_memblock_get(&ble_hs_rx_ovf_evt_pool);
+        if (ovf_evt == NULL) {
+            OS_EXIT_CRITICAL(sr);
+            return BLE_HS_ENOMEM;
+        }
+        ovf_evt->hci_evt = pkt;
+        ovf_evt->acl_seq = ble_hs_rx_ovf_acl_in;
+        STAILQ_INSERT_TAIL(&ble_hs_rx_ovf_evts, ovf_evt, next);
+        break;
+
+    case BLE_HS_RX_TYPE_ACL:
+        om = pkt;
+        STAILQ_INSERT_TAIL(&ble_hs_rx_ovf_acls, OS_MBUF_PKTHDR(om),
+                           omp_next);
+        ble_hs_rx_ovf_acl_in++;
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        OS_EXIT_CRITICAL(sr);
+        return BLE_HS_EINVAL;
+    }
+
+    __atomic_store_n(&ble_hs_rx_ovf_cnt, (uint16_t)(ble_hs_rx_ovf_cnt + 1),
+                     __ATOMIC_RELEASE);
+
+    OS_EXIT_CRITICAL(sr);
+
+    STATS_INC(ble_hs_stats, rx_ring_full);
+    return 0;
+}
+
+/**
+ * Queues a received packet for the host task, and wakes the host task if a
+ * drain is not already scheduled.  Must only be called from the transport's
+ * receive context.
+ *
+ * The ring is single-producer / single-consumer: the entry is written and
+ * then published with a release store of ble_hs_rx_head, without a critical
+ * section.  Only when the ring is full, or earlier packets are still waiting
+ * in the overflow queue, is the packet added to the overflow queue under a
+ * critical section.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOMEM if an HCI event could not be
+ *                                  queued because the transport delivered
+ *                                  more events than it has buffers for.
+ */
+static int
+ble_hs_rx_put(void *pkt, uint8_t type)
+{
+    struct ble_hs_rx_entry *entry;
+    uint16_t head;
+    uint16_t tail;
+    int rc;
+
+    /* The transport is the only task that adds to the overflow queue, so a
+     * count of zero cannot become stale before the packet is published.
+     */
+    head = ble_hs_rx_head;
+    tail = __atomic_load_n(&ble_hs_rx_tail, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&ble_hs_rx_ovf_cnt, __ATOMIC_ACQUIRE) == 0 &&
+        (uint16_t)(head - tail) < BLE_HS_RX_RING_SIZE) {
+
+        entry = ble_hs_rx_ring + (head & BLE_HS_RX_RING_MASK);
+        entry->pkt = pkt;
+        entry->type = type;
+        __atomic_store_n(&ble_hs_rx_head, (uint16_t)(head + 1),
+                         __ATOMIC_RELEASE);
+    } else {
+        rc = ble_hs_rx_put_ovf(pkt, type);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    /* Only the first packet of a burst wakes the host; the rest are picked
+     * up by the same drain.  The transport only ever sets the flag and the
+     * host task only clears it, so no read-modify-write is needed.  If both
+     * sides see it clear at once the event is posted twice, which the
+     * event queue ignores.
+     */
+    if (!__atomic_load_n(&ble_hs_rx_wakeup_pending, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&ble_hs_rx_wakeup_pending, 1, __ATOMIC_SEQ_CST);
+        os_eventq_put(ble_hs_evq, &ble_hs_ev_rx);
+    }
+
+    return 0;
+}
+
+/**
+ * Processes all HCI events and ACL data packets currently queued for the
+ * host.
+ */
+void
+ble_hs_process_rx_data_queue(void)
+{
+    struct ble_hs_rx_entry entry;
+    uint16_t count;
+
+    /* Clear the pending flag before looking at the queues.  A packet added
+     * after this point either gets picked up below or schedules another
+     * drain.
+     */
+    __atomic_store_n(&ble_hs_rx_wakeup_pending, 0, __ATOMIC_SEQ_CST);
+
+    /* Bound the batch so that other host work is not starved by a transport
+     * that keeps the ring full.
+     */
+    count = 0;
+    while (count < BLE_HS_RX_RING_SIZE) {
+        if (ble_hs_rx_get(&entry) != 0) {
+            break;
+        }
+
+        ble_hs_rx_process(&entry);
+        count++;
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    STATS_INC(ble_hs_stats, rx_wakeups);
+    STATS_INCN(ble_hs_stats, rx_pkts, count);
+    if (count > ble_hs_rx_batch_max) {
+        STATS_INCN(ble_hs_stats, rx_batch_max, count - ble_hs_rx_batch_max);
+        ble_hs_rx_batch_max = count;
+    }
+
+    if (count == BLE_HS_RX_RING_SIZE) {
+        /* Possibly more packets; continue after other pending host work. */
+        __atomic_store_n(&ble_hs_rx_wakeup_pending, 1, __ATOMIC_SEQ_CST);
+        os_eventq_put(ble_hs_evq, &ble_hs_ev_rx);
     }
 }
 
@@ -304,10 +793,22 @@ done:
 static void
 ble_hs_clear_rx_queue(void)
 {
-    struct os_mbuf *om;
+    struct ble_hs_rx_entry entry;
 
-    while ((om = os_mqueue_get(&ble_hs_rx_q)) != NULL) {
-        os_mbuf_free_chain(om);
+    while (ble_hs_rx_get(&entry) == 0) {
+        switch (entry.type) {
+        case BLE_HS_RX_TYPE_EVT:
+            ble_hci_trans_buf_free(entry.pkt);
+            break;
+
+        case BLE_HS_RX_TYPE_ACL:
+            os_mbuf_free_chain(entry.pkt);
+            break;
+
+        default:
+            BLE_HS_DBG_ASSERT(0);
+            break;
+        }
     }
 }
 
@@ -324,7 +825,7 @@ ble_hs_synced(void)
     return ble_hs_sync_state == BLE_HS_SYNC_STATE_GOOD;
 }
 
-static int
+int
 ble_hs_sync(void)
 {
     int rc;
@@ -345,7 +846,7 @@ ble_hs_sync(void)
     ble_hs_timer_sched(BLE_HS_SYNC_RETRY_RATE);
 
     if (rc == 0) {
-        rc = ble_hs_misc_restore_irks();
+        rc = ble_hs_pvcy_sync();
         if (rc != 0) {
             BLE_HS_LOG(INFO, "Failed to restore IRKs from store; status=%d",
                        rc);
@@ -379,6 +880,9 @@ ble_hs_reset(void)
 
     ble_hs_clear_rx_queue();
 
+    /* Abort queued HCI commands; the controller is about to be reset. */
+    ble_hs_hci_async_flush(BLE_HS_ENOTSYNCED);
+
     while (1) {
         conn_handle = ble_hs_atomic_first_conn_handle();
         if (conn_handle == BLE_HS_CONN_HANDLE_NONE) {
@@ -388,6 +892,8 @@ ble_hs_reset(void)
         ble_gap_conn_broken(conn_handle, ble_hs_reset_reason);
     }
 
+    ble_gap_reset_state(ble_hs_reset_reason);
+
     if (ble_hs_cfg.reset_cb != NULL && ble_hs_reset_reason != 0) {
         ble_hs_cfg.reset_cb(ble_hs_reset_reason);
     }
@@ -425,6 +931,9 @@ ble_hs_timer_exp(struct os_event *ev)
 
     ticks_until_next = ble_hs_conn_timer();
     ble_hs_timer_sched(ticks_until_next);
+
+    ticks_until_next = ble_hs_hci_async_timer();
+    ble_hs_timer_sched(ticks_until_next);
 }
 
 static void
@@ -465,24 +974,6 @@ ble_hs_timer_resched(void)
     ble_hs_timer_reset(0);
 }
 
-static void
-ble_hs_event_rx_hci_ev(struct os_event *ev)
-{
-    uint8_t *hci_evt;
-    int rc;
-
-    hci_evt = ev->ev_arg;
-    rc = os_memblock_put(&ble_hs_hci_ev_pool, ev);
-    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
-
-#if BLE_MONITOR
-    ble_monitor_send(BLE_MONITOR_OPCODE_EVENT_PKT, hci_evt,
-                     hci_evt[1] + BLE_HCI_EVENT_HDR_LEN);
-#endif
-
-    ble_hs_hci_evt_process(hci_evt);
-}
-
 static void
 ble_hs_event_tx_notify(struct os_event *ev)
 {
@@ -490,7 +981,7 @@ ble_hs_event_tx_notify(struct os_event *ev)
 }
 
 static void
-ble_hs_event_rx_data(struct os_event *ev)
+ble_hs_event_rx(struct os_event *ev)
 {
     ble_hs_process_rx_data_queue();
 }
@@ -513,16 +1004,11 @@ ble_hs_event_start(struct os_event *ev)
 void
 ble_hs_enqueue_hci_event(uint8_t *hci_evt)
 {
-    struct os_event *ev;
+    int rc;
 
-    ev = os_memblock_get(&ble_hs_hci_ev_pool);
-    if (ev == NULL) {
+    rc = ble_hs_rx_put(hci_evt, BLE_HS_RX_TYPE_EVT);
+    if (rc != 0) {
         ble_hci_trans_buf_free(hci_evt);
-    } else {
-        ev->ev_queued = 0;
-        ev->ev_cb = ble_hs_event_rx_hci_ev;
-        ev->ev_arg = hci_evt;
-        os_eventq_put(ble_hs_evq, ev);
     }
 }
 
@@ -617,7 +1103,7 @@ ble_hs_rx_data(struct os_mbuf *om, void *arg)
      */
     ble_hs_flow_fill_acl_usrhdr(om);
 
-    rc = os_mqueue_put(&ble_hs_rx_q, ble_hs_evq, om);
+    rc = ble_hs_rx_put(om, BLE_HS_RX_TYPE_ACL);
     if (rc != 0) {
         os_mbuf_free_chain(om);
         return BLE_HS_EOS;
@@ -663,12 +1149,6 @@ ble_hs_init(void)
 
     log_init();
 
-    /* Create memory pool of OS events */
-    rc = os_mempool_init(&ble_hs_hci_ev_pool, BLE_HS_HCI_EVT_COUNT,
-                         sizeof (struct os_event), ble_hs_hci_os_event_buf,
-                         "ble_hs_hci_ev_pool");
-    SYSINIT_PANIC_ASSERT(rc == 0);
-
     /* These get initialized here to allow unit tests to run without a zeroed
      * bss.
      */
@@ -682,6 +1162,23 @@ ble_hs_init(void)
     ble_hs_ev_start = (struct os_event) {
         .ev_cb = ble_hs_event_start,
     };
+    ble_hs_ev_rx = (struct os_event) {
+        .ev_cb = ble_hs_event_rx,
+    };
+    ble_hs_rx_head = 0;
+    ble_hs_rx_tail = 0;
+    STAILQ_INIT(&ble_hs_rx_ovf_evts);
+    STAILQ_INIT(&ble_hs_rx_ovf_acls);
+    ble_hs_rx_ovf_acl_in = 0;
+    ble_hs_rx_ovf_acl_out = 0;
+    ble_hs_rx_ovf_cnt = 0;
+    ble_hs_rx_wakeup_pending = 0;
+    ble_hs_rx_batch_max = 0;
+
+    rc = os_mempool_init(&ble_hs_rx_ovf_evt_pool, BLE_HS_HCI_EVT_COUNT,
+                         sizeof (struct ble_hs_rx_ovf_evt),
+                         ble_hs_rx_ovf_evt_mem, "ble_hs_rx_ovf_evt");
+    SYSINIT_PANIC_ASSERT(rc == 0);
 
 #if BLE_MONITOR
     rc = ble_monitor_init();
@@ -689,6 +1186,14 @@ ble_hs_init(void)
 #endif
 
     ble_hs_hci_init();
+    ble_hs_startup_clear_ctlr_info();
+    ble_hs_adv_filt_init();
+
+    rc = ble_hs_adv_dedup_init();
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+    rc = ble_hs_resolv_init();
+    SYSINIT_PANIC_ASSERT(rc == 0);
 
     rc = ble_hs_conn_init();
     SYSINIT_PANIC_ASSERT(rc == 0);
@@ -711,8 +1216,6 @@ ble_hs_init(void)
     rc = ble_gatts_init();
     SYSINIT_PANIC_ASSERT(rc == 0);
 
-    os_mqueue_init(&ble_hs_rx_q, ble_hs_event_rx_data, NULL);
-
     rc = stats_init_and_reg(
         STATS_HDR(ble_hs_stats), STATS_SIZE_INIT_PARMS(ble_hs_stats,
         STATS_SIZE_32), STATS_NAME_INIT_PARMS(ble_hs_stats), "ble_hs");
@@ -721,6 +1224,13 @@ ble_hs_init(void)
     rc = os_mutex_init(&ble_hs_mutex);
     SYSINIT_PANIC_ASSERT(rc == 0);
 
+    rc = ble_store_init();
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+    memset(ble_hs_lock_stats, 0, sizeof ble_hs_lock_stats);
+#endif
+
 #if MYNEWT_VAL(BLE_HS_DEBUG)
     ble_hs_dbg_mutex_locked = 0;
 #endif
@@ -737,7 +737,7 @@ ble_hs_adv_parse_fields(struct ble_hs_adv_fields *adv_fields, uint8_t *src,
 }
 
 int
-ble_hs_adv_parse(const uint8_t *data, uint8_t length,
+ble_hs_adv_parse(const uint8_t *data, uint16_t length,
                  ble_hs_adv_parse_func_t func, void *user_data)
 {
     const struct ble_hs_adv_field *field;
@@ -775,7 +775,7 @@ find_field_func(const struct ble_hs_adv_field *field, void *user_data)
 }
 
 int
-ble_hs_adv_find_field(uint8_t type, const uint8_t *data, uint8_t length,
+ble_hs_adv_find_field(uint8_t type, const uint8_t *data, uint16_t length,
                       const struct ble_hs_adv_field **out)
 {
     int rc;
@@ -797,3 +797,238 @@ ble_hs_adv_find_field(uint8_t type, const uint8_t *data, uint8_t length,
 
     return 0;
 }
+
+/**
+ * Prepares an iterator over the AD structures of an advertising payload.
+ * The payload must remain valid for as long as the iterator, and any field
+ * it yields, is in use.
+ *
+ * @param iter                  The iterator to initialize.
+ * @param data                  The raw advertising data.
+ * @param length                The length of the advertising data.
+ */
+void
+ble_hs_adv_iter_init(struct ble_hs_adv_iter *iter, const uint8_t *data,
+                     uint16_t length)
+{
+    iter->data = data;
+    iter->length = length;
+    iter->off = 0;
+}
+
+/**
+ * Retrieves the next AD structure from an advertising payload.  Nothing is
+ * decoded or copied; the returned field points into the payload.  Zero-length
+ * structures are skipped, as the core specification allows them as padding.
+ *
+ * @param iter                  The iterator to advance.
+ * @param out_field             On success, the next field gets written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there are no more fields;
+ *                              BLE_HS_EBADDATA if a field overruns the
+ *                                  payload.
+ */
+int
+ble_hs_adv_iter_next(struct ble_hs_adv_iter *iter,
+                     const struct ble_hs_adv_field **out_field)
+{
+    const struct ble_hs_adv_field *field;
+    int remaining;
+
+    while (1) {
+        remaining = iter->length - iter->off;
+        if (remaining <= 0) {
+            return BLE_HS_ENOENT;
+        }
+
+        field = (const void *)(iter->data + iter->off);
+        if (field->length == 0) {
+            iter->off++;
+            continue;
+        }
+
+        if (field->length >= remaining) {
+            /* Don't yield anything else from a corrupt payload. */
+            iter->off = iter->length;
+            return BLE_HS_EBADDATA;
+        }
+
+        iter->off += 1 + field->length;
+        *out_field = field;
+
+        return 0;
+    }
+}
+
+static int
+ble_hs_adv_field_uuid_sz(uint8_t type, int *out_svc_data)
+{
+    *out_svc_data = 0;
+
+    switch (type) {
+    case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
+    case BLE_HS_ADV_TYPE_COMP_UUIDS16:
+    case BLE_HS_ADV_TYPE_SOL_UUIDS16:
+        return 2;
+
+    case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
+    case BLE_HS_ADV_TYPE_COMP_UUIDS32:
+        return 4;
+
+    case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
+    case BLE_HS_ADV_TYPE_COMP_UUIDS128:
+    case BLE_HS_ADV_TYPE_SOL_UUIDS128:
+        return 16;
+
+    case BLE_HS_ADV_TYPE_SVC_DATA_UUID16:
+        *out_svc_data = 1;
+        return 2;
+
+    case BLE_HS_ADV_TYPE_SVC_DATA_UUID32:
+        *out_svc_data = 1;
+        return 4;
+
+    case BLE_HS_ADV_TYPE_SVC_DATA_UUID128:
+        *out_svc_data = 1;
+        return 16;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Retrieves the number of UUIDs carried by a service UUID list, solicitation
+ * list or service data structure.
+ *
+ * @param field                 The field to inspect.
+ * @param out_num               On success, the number of UUIDs gets written
+ *                                  here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the field does not carry
+ *                                  UUIDs;
+ *                              BLE_HS_EBADDATA if the field length is
+ *                                  inconsistent with its type.
+ */
+int
+ble_hs_adv_field_num_uuids(const struct ble_hs_adv_field *field, int *out_num)
+{
+    int data_len;
+    int svc_data;
+    int uuid_sz;
+
+    uuid_sz = ble_hs_adv_field_uuid_sz(field->type, &svc_data);
+    if (uuid_sz == 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    data_len = field->length - 1;
+    if (svc_data) {
+        /* Service data carries one UUID followed by opaque data. */
+        if (data_len < uuid_sz) {
+            return BLE_HS_EBADDATA;
+        }
+        *out_num = 1;
+        return 0;
+    }
+
+    if (data_len % uuid_sz != 0) {
+        return BLE_HS_EBADDATA;
+    }
+
+    *out_num = data_len / uuid_sz;
+    return 0;
+}
+
+/**
+ * Decodes a single UUID from a service UUID list, solicitation list or
+ * service data structure.
+ *
+ * @param field                 The field to decode from.
+ * @param idx                   The index of the UUID within the field.
+ * @param out_uuid              On success, the UUID gets written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the field does not carry
+ *                                  UUIDs;
+ *                              BLE_HS_EBADDATA if the field is malformed;
+ *                              BLE_HS_ENOENT if idx is out of range.
+ */
+int
+ble_hs_adv_field_uuid(const struct ble_hs_adv_field *field, int idx,
+                      ble_uuid_any_t *out_uuid)
+{
+    int num_uuids;
+    int svc_data;
+    int uuid_sz;
+    int rc;
+
+    rc = ble_hs_adv_field_num_uuids(field, &num_uuids);
+    if (rc != 0) {
+        return rc;
+    }
+
+    if (idx < 0 || idx >= num_uuids) {
+        return BLE_HS_ENOENT;
+    }
+
+    uuid_sz = ble_hs_adv_field_uuid_sz(field->type, &svc_data);
+
+    return ble_uuid_init_from_buf(out_uuid, field->value + idx * uuid_sz,
+                                  uuid_sz);
+}
+
+/**
+ * Locates several AD structures in a single pass over an advertising
+ * payload.  For each request, the first structure of the requested type is
+ * reported; the walk stops as soon as every request has been satisfied.
+ *
+ * @param data                  The raw advertising data.
+ * @param length                The length of the advertising data.
+ * @param reqs                  The types to look for.  On return, each
+ *                                  entry's field member points to the
+ *                                  matching structure, or is NULL.
+ * @param num_reqs              The number of entries in reqs.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EBADDATA if the payload is malformed.
+ *                                  Fields located before the corruption are
+ *                                  still reported.
+ */
+int
+ble_hs_adv_extract(const uint8_t *data, uint16_t length,
+                   struct ble_hs_adv_extract *reqs, int num_reqs)
+{
+    const struct ble_hs_adv_field *field;
+    struct ble_hs_adv_iter iter;
+    int pending;
+    int rc;
+    int i;
+
+    for (i = 0; i < num_reqs; i++) {
+        reqs[i].field = NULL;
+    }
+
+    pending = num_reqs;
+    ble_hs_adv_iter_init(&iter, data, length);
+    while (pending > 0) {
+        rc = ble_hs_adv_iter_next(&iter, &field);
+        if (rc == BLE_HS_ENOENT) {
+            break;
+        }
+        if (rc != 0) {
+            return rc;
+        }
+
+        for (i = 0; i < num_reqs; i++) {
+            if (reqs[i].field == NULL && reqs[i].type == field->type) {
+                reqs[i].field = field;
+                pending--;
+            }
+        }
+    }
+
+    return 0;
+}
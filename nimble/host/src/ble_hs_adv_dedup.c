@@ -0,0 +1,296 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "os/os.h"
+#include "host/ble_hs_adv.h"
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX) > 0
+
+#define BLE_HS_ADV_DEDUP_FNV_OFFSET     2166136261UL
+#define BLE_HS_ADV_DEDUP_FNV_PRIME      16777619UL
+
+/**
+ * An advertisement the host has already delivered.  Advertisements are
+ * identified by their advertiser and a hash of their type and payload, so
+ * an advertiser that changes its payload produces a new entry.
+ */
+struct ble_hs_adv_dedup_entry {
+    SLIST_ENTRY(ble_hs_adv_dedup_entry) bucket_next;
+    TAILQ_ENTRY(ble_hs_adv_dedup_entry) lru_next;
+    ble_addr_t addr;
+    uint32_t hash;
+
+    /** When this advertisement was last passed to the application. */
+    os_time_t reported_at;
+};
+
+SLIST_HEAD(ble_hs_adv_dedup_bucket, ble_hs_adv_dedup_entry);
+TAILQ_HEAD(ble_hs_adv_dedup_lru, ble_hs_adv_dedup_entry);
+
+static os_membuf_t ble_hs_adv_dedup_entry_mem[
+    OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX),
+                    sizeof (struct ble_hs_adv_dedup_entry))];
+static struct os_mempool ble_hs_adv_dedup_entry_pool;
+
+static struct ble_hs_adv_dedup_bucket
+    ble_hs_adv_dedup_buckets[MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX)];
+
+/** Most recently seen at the head; evicted from the tail. */
+static struct ble_hs_adv_dedup_lru ble_hs_adv_dedup_lru;
+
+static uint8_t ble_hs_adv_dedup_enabled;
+static uint32_t ble_hs_adv_dedup_expiry_ticks;
+
+static uint32_t
+ble_hs_adv_dedup_fnv(uint32_t hash, const uint8_t *data, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= BLE_HS_ADV_DEDUP_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static struct ble_hs_adv_dedup_bucket *
+ble_hs_adv_dedup_bucket(const ble_addr_t *addr, uint32_t hash)
+{
+    uint32_t idx;
+
+    idx = ble_hs_adv_dedup_fnv(hash, &addr->type, 1);
+    idx = ble_hs_adv_dedup_fnv(idx, addr->val, sizeof addr->val);
+
+    return ble_hs_adv_dedup_buckets + idx % MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX);
+}
+
+static void
+ble_hs_adv_dedup_remove(struct ble_hs_adv_dedup_entry *entry)
+{
+    SLIST_REMOVE(ble_hs_adv_dedup_bucket(&entry->addr, entry->hash), entry,
+                 ble_hs_adv_dedup_entry, bucket_next);
+    TAILQ_REMOVE(&ble_hs_adv_dedup_lru, entry, lru_next);
+}
+
+/**
+ * Forgets every advertisement seen so far.  Called when a discovery
+ * procedure starts so that it reports every advertiser at least once.
+ * Must be called with the host lock held.
+ */
+void
+ble_hs_adv_dedup_reset(void)
+{
+    struct ble_hs_adv_dedup_entry *entry;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    while ((entry = TAILQ_FIRST(&ble_hs_adv_dedup_lru)) != NULL) {
+        TAILQ_REMOVE(&ble_hs_adv_dedup_lru, entry, lru_next);
+        os_memblock_put(&ble_hs_adv_dedup_entry_pool, entry);
+    }
+
+    for (i = 0; i < MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX); i++) {
+        SLIST_INIT(ble_hs_adv_dedup_buckets + i);
+    }
+}
+
+/**
+ * Enables or disables host-side duplicate filtering of advertising reports.
+ * Unlike the controller's filter, which suppresses every report after the
+ * first from a given address, the host only suppresses reports whose type
+ * and advertising data are identical to one already delivered.  Advertisers
+ * that change their payload (counters, sensor readings) are reported on each
+ * change.  Duplicates are withheld from the application only; mesh still
+ * receives them.
+ *
+ * Up to BLE_HS_ADV_DEDUP_MAX advertisements are remembered; when the table
+ * is full, the least recently seen advertisement is forgotten.  Changing the
+ * configuration forgets all advertisements.
+ *
+ * @param enable                1 to enable filtering; 0 to disable.
+ * @param expiry_ms             If nonzero, an unchanged advertisement is
+ *                                  reported again once this many
+ *                                  milliseconds have passed since it was
+ *                                  last reported.  0 suppresses it until
+ *                                  it is evicted or discovery restarts.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the expiry is too large;
+ *                              BLE_HS_ENOTSUP if filtering is not compiled
+ *                                  in.
+ */
+int
+ble_hs_adv_dedup_set(int enable, uint32_t expiry_ms)
+{
+    uint32_t expiry_ticks;
+    int rc;
+
+    rc = os_time_ms_to_ticks(expiry_ms, &expiry_ticks);
+    if (rc != 0 || expiry_ticks > INT32_MAX) {
+        return BLE_HS_EINVAL;
+    }
+
+    ble_hs_lock();
+
+    ble_hs_adv_dedup_reset();
+    ble_hs_adv_dedup_enabled = !!enable;
+    ble_hs_adv_dedup_expiry_ticks = expiry_ticks;
+
+    ble_hs_unlock();
+
+    return 0;
+}
+
+/**
+ * Records an incoming advertising report and determines whether it
+ * duplicates one already delivered to the application.
+ *
+ * @param addr                  The advertiser's address.
+ * @param kind                  Distinguishes reports from the same
+ *                                  advertiser that legitimately carry
+ *                                  different data (e.g., the report's event
+ *                                  type).
+ * @param data                  The advertising data.
+ * @param length                The length of the advertising data.
+ *
+ * @return                      1 if the report is a duplicate and should be
+ *                                  dropped;
+ *                              0 if it should be delivered.
+ */
+int
+ble_hs_adv_dedup_check(const ble_addr_t *addr, uint8_t kind,
+                       const uint8_t *data, uint16_t length)
+{
+    struct ble_hs_adv_dedup_bucket *bucket;
+    struct ble_hs_adv_dedup_entry *entry;
+    os_time_t now;
+    uint32_t hash;
+    int dup;
+
+    ble_hs_lock();
+
+    if (!ble_hs_adv_dedup_enabled) {
+        ble_hs_unlock();
+        return 0;
+    }
+
+    hash = ble_hs_adv_dedup_fnv(BLE_HS_ADV_DEDUP_FNV_OFFSET, &kind, 1);
+    hash = ble_hs_adv_dedup_fnv(hash, data, length);
+    bucket = ble_hs_adv_dedup_bucket(addr, hash);
+    now = os_time_get();
+
+    SLIST_FOREACH(entry, bucket, bucket_next) {
+        if (entry->hash == hash && ble_addr_cmp(&entry->addr, addr) == 0) {
+            break;
+        }
+    }
+
+    if (entry != NULL) {
+        TAILQ_REMOVE(&ble_hs_adv_dedup_lru, entry, lru_next);
+        TAILQ_INSERT_HEAD(&ble_hs_adv_dedup_lru, entry, lru_next);
+
+        if (ble_hs_adv_dedup_expiry_ticks != 0 &&
+            (int32_t)(now - entry->reported_at) >=
+            (int32_t)ble_hs_adv_dedup_expiry_ticks) {
+
+            entry->reported_at = now;
+            dup = 0;
+        } else {
+            dup = 1;
+        }
+    } else {
+        entry = os_memblock_get(&ble_hs_adv_dedup_entry_pool);
+        if (entry == NULL) {
+            /* Table full; reuse the least recently seen entry. */
+            entry = TAILQ_LAST(&ble_hs_adv_dedup_lru, ble_hs_adv_dedup_lru);
+            BLE_HS_DBG_ASSERT(entry != NULL);
+            ble_hs_adv_dedup_remove(entry);
+            STATS_INC(ble_hs_stats, adv_dedup_evict);
+        }
+
+        entry->addr = *addr;
+        entry->hash = hash;
+        entry->reported_at = now;
+        SLIST_INSERT_HEAD(bucket, entry, bucket_next);
+        TAILQ_INSERT_HEAD(&ble_hs_adv_dedup_lru, entry, lru_next);
+
+        dup = 0;
+    }
+
+    if (dup) {
+        STATS_INC(ble_hs_stats, adv_dedup_drop);
+    }
+
+    ble_hs_unlock();
+
+    return dup;
+}
+
+int
+ble_hs_adv_dedup_init(void)
+{
+    int rc;
+
+    rc = os_mempool_init(&ble_hs_adv_dedup_entry_pool,
+                         MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX),
+                         sizeof (struct ble_hs_adv_dedup_entry),
+                         ble_hs_adv_dedup_entry_mem, "ble_hs_adv_dedup");
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    TAILQ_INIT(&ble_hs_adv_dedup_lru);
+    memset(ble_hs_adv_dedup_buckets, 0, sizeof ble_hs_adv_dedup_buckets);
+    ble_hs_adv_dedup_enabled = 0;
+    ble_hs_adv_dedup_expiry_ticks = 0;
+
+    return 0;
+}
+
+#else
+
+int
+ble_hs_adv_dedup_set(int enable, uint32_t expiry_ms)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+void
+ble_hs_adv_dedup_reset(void)
+{
+}
+
+int
+ble_hs_adv_dedup_check(const ble_addr_t *addr, uint8_t kind,
+                       const uint8_t *data, uint16_t length)
+{
+    return 0;
+}
+
+int
+ble_hs_adv_dedup_init(void)
+{
+    return 0;
+}
+
+#endif
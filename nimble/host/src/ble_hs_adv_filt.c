@@ -0,0 +1,494 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "host/ble_hs_adv.h"
+#include "ble_hs_priv.h"
+
+#if MYNEWT_VAL(BLE_HS_ADV_FILT_MAX) > 0
+
+#if MYNEWT_VAL(BLE_HS_ADV_FILT_MAX) > 32
+#error "BLE_HS_ADV_FILT_MAX must not exceed 32"
+#endif
+
+/* Criteria that can only be evaluated by walking the advertising data. */
+#define BLE_HS_ADV_FILT_F_AD_MASK   (BLE_HS_ADV_FILT_F_AD_TYPE |    \
+                                     BLE_HS_ADV_FILT_F_MFG |        \
+                                     BLE_HS_ADV_FILT_F_UUID)
+
+/**
+ * A filter in the form the matcher consumes: the address prefix, company
+ * identifier and UUID are stored as the raw bytes they are compared against.
+ */
+struct ble_hs_adv_filt_entry {
+    uint8_t criteria;
+    uint8_t addr_len;
+    uint8_t ad_type;
+    uint8_t mfg_len;
+    uint8_t uuid_len;
+    int8_t rssi_min;
+    uint8_t addr[6];
+    uint8_t mfg[2 + BLE_HS_ADV_FILT_MFG_PREFIX_MAX];
+    uint8_t uuid[16];
+    uint32_t hits;
+};
+
+/** What a single pass over the advertising data found. */
+struct ble_hs_adv_filt_scan {
+    /** Bitmap of AD types present. */
+    uint32_t ad_types[8];
+
+    /** Filters whose manufacturer data criterion is met. */
+    uint32_t mfg_match;
+
+    /** Filters whose UUID criterion is met. */
+    uint32_t uuid_match;
+};
+
+static struct ble_hs_adv_filt_entry
+    ble_hs_adv_filt_entries[MYNEWT_VAL(BLE_HS_ADV_FILT_MAX)];
+static uint8_t ble_hs_adv_filt_num;
+
+/** Union of the criteria of all configured filters. */
+static uint8_t ble_hs_adv_filt_criteria;
+
+static int
+ble_hs_adv_filt_compile(const struct ble_hs_adv_filt *filt,
+                        struct ble_hs_adv_filt_entry *entry)
+{
+    int i;
+
+    memset(entry, 0, sizeof *entry);
+    entry->criteria = filt->criteria;
+
+    if (filt->criteria & BLE_HS_ADV_FILT_F_ADDR) {
+        if (filt->addr_len == 0 || filt->addr_len > 6) {
+            return BLE_HS_EINVAL;
+        }
+
+        /* Store most significant byte first so a prefix is a memcmp. */
+        entry->addr_len = filt->addr_len;
+        for (i = 0; i < 6; i++) {
+            entry->addr[i] = filt->addr.val[5 - i];
+        }
+    }
+
+    if (filt->criteria & BLE_HS_ADV_FILT_F_AD_TYPE) {
+        entry->ad_type = filt->ad_type;
+    }
+
+    if (filt->criteria & BLE_HS_ADV_FILT_F_MFG) {
+        if (filt->mfg_prefix_len > BLE_HS_ADV_FILT_MFG_PREFIX_MAX) {
+            return BLE_HS_EINVAL;
+        }
+
+        put_le16(entry->mfg, filt->mfg_id);
+        memcpy(entry->mfg + 2, filt->mfg_prefix, filt->mfg_prefix_len);
+        entry->mfg_len = 2 + filt->mfg_prefix_len;
+    }
+
+    if (filt->criteria & BLE_HS_ADV_FILT_F_UUID) {
+        switch (filt->uuid.u.type) {
+        case BLE_UUID_TYPE_16:
+            put_le16(entry->uuid, filt->uuid.u16.value);
+            entry->uuid_len = 2;
+            break;
+
+        case BLE_UUID_TYPE_32:
+            put_le32(entry->uuid, filt->uuid.u32.value);
+            entry->uuid_len = 4;
+            break;
+
+        case BLE_UUID_TYPE_128:
+            memcpy(entry->uuid, filt->uuid.u128.value, 16);
+            entry->uuid_len = 16;
+            break;
+
+        default:
+            return BLE_HS_EINVAL;
+        }
+    }
+
+    if (filt->criteria & BLE_HS_ADV_FILT_F_RSSI) {
+        entry->rssi_min = filt->rssi_min;
+    }
+
+    return 0;
+}
+
+/**
+ * Configures the set of advertising report filters.  A report is delivered
+ * to the application if it matches at least one filter.  The filters are
+ * evaluated before the GAP event is built, so rejected reports cost only the
+ * match.  They do not apply to mesh, which filters reports itself.  An empty
+ * set disables filtering.  Replacing the set resets the hit counters.
+ *
+ * @param filts                 The filters to apply.
+ * @param num_filts             The number of filters; 0 disables filtering.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if a filter is malformed or
+ *                                  there are more than BLE_HS_ADV_FILT_MAX
+ *                                  filters;
+ *                              BLE_HS_ENOTSUP if filtering is not compiled
+ *                                  in.
+ */
+int
+ble_hs_adv_filt_set(const struct ble_hs_adv_filt *filts, int num_filts)
+{
+    struct ble_hs_adv_filt_entry entries[MYNEWT_VAL(BLE_HS_ADV_FILT_MAX)];
+    uint8_t criteria;
+    int rc;
+    int i;
+
+    if (num_filts < 0 || num_filts > MYNEWT_VAL(BLE_HS_ADV_FILT_MAX)) {
+        return BLE_HS_EINVAL;
+    }
+
+    criteria = 0;
+    for (i = 0; i < num_filts; i++) {
+        rc = ble_hs_adv_filt_compile(filts + i, entries + i);
+        if (rc != 0) {
+            return rc;
+        }
+        criteria |= entries[i].criteria;
+    }
+
+    ble_hs_lock();
+
+    memcpy(ble_hs_adv_filt_entries, entries, num_filts * sizeof entries[0]);
+    ble_hs_adv_filt_num = num_filts;
+    ble_hs_adv_filt_criteria = criteria;
+
+    ble_hs_unlock();
+
+    return 0;
+}
+
+/**
+ * Retrieves the number of reports that matched the specified filter since
+ * the filter set was configured.
+ *
+ * @param idx                   The index of the filter, as passed to
+ *                                  ble_hs_adv_filt_set().
+ * @param out_hits              On success, the hit count gets written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOENT if there is no such filter.
+ */
+int
+ble_hs_adv_filt_hits(int idx, uint32_t *out_hits)
+{
+    int rc;
+
+    ble_hs_lock();
+
+    if (idx < 0 || idx >= ble_hs_adv_filt_num) {
+        rc = BLE_HS_ENOENT;
+    } else {
+        *out_hits = ble_hs_adv_filt_entries[idx].hits;
+        rc = 0;
+    }
+
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * Returns the size of the UUIDs carried by an AD structure of the specified
+ * type, or 0 if the type carries no service UUIDs.
+ */
+static uint8_t
+ble_hs_adv_filt_uuid_sz(uint8_t ad_type, int *out_svc_data)
+{
+    *out_svc_data = 0;
+
+    switch (ad_type) {
+    case BLE_HS_ADV_TYPE_INCOMP_UUIDS16:
+    case BLE_HS_ADV_TYPE_COMP_UUIDS16:
+        return 2;
+
+    case BLE_HS_ADV_TYPE_INCOMP_UUIDS32:
+    case BLE_HS_ADV_TYPE_COMP_UUIDS32:
+        return 4;
+
+    case BLE_HS_ADV_TYPE_INCOMP_UUIDS128:
+    case BLE_HS_ADV_TYPE_COMP_UUIDS128:
+        return 16;
+
+    case BLE_HS_ADV_TYPE_SVC_DATA_UUID16:
+        *out_svc_data = 1;
+        return 2;
+
+    case BLE_HS_ADV_TYPE_SVC_DATA_UUID32:
+        *out_svc_data = 1;
+        return 4;
+
+    case BLE_HS_ADV_TYPE_SVC_DATA_UUID128:
+        *out_svc_data = 1;
+        return 16;
+
+    default:
+        return 0;
+    }
+}
+
+static void
+ble_hs_adv_filt_scan_uuids(const uint8_t *val, uint8_t val_len,
+                           uint8_t ad_type, uint32_t candidates,
+                           struct ble_hs_adv_filt_scan *scan)
+{
+    const struct ble_hs_adv_filt_entry *entry;
+    uint8_t uuid_sz;
+    int svc_data;
+    int off;
+    int i;
+
+    uuid_sz = ble_hs_adv_filt_uuid_sz(ad_type, &svc_data);
+    if (uuid_sz == 0) {
+        return;
+    }
+
+    for (i = 0; i < ble_hs_adv_filt_num; i++) {
+        entry = ble_hs_adv_filt_entries + i;
+        if (!(candidates & (1UL << i)) ||
+            !(entry->criteria & BLE_HS_ADV_FILT_F_UUID) ||
+            entry->uuid_len != uuid_sz) {
+
+            continue;
+        }
+
+        /* Service data carries a single UUID followed by the data. */
+        for (off = 0; off + uuid_sz <= val_len; off += uuid_sz) {
+            if (memcmp(val + off, entry->uuid, uuid_sz) == 0) {
+                scan->uuid_match |= 1UL << i;
+                break;
+            }
+            if (svc_data) {
+                break;
+            }
+        }
+    }
+}
+
+static void
+ble_hs_adv_filt_scan_mfg(const uint8_t *val, uint8_t val_len,
+                         uint32_t candidates,
+                         struct ble_hs_adv_filt_scan *scan)
+{
+    const struct ble_hs_adv_filt_entry *entry;
+    int i;
+
+    for (i = 0; i < ble_hs_adv_filt_num; i++) {
+        entry = ble_hs_adv_filt_entries + i;
+        if ((candidates & (1UL << i)) &&
+            (entry->criteria & BLE_HS_ADV_FILT_F_MFG) &&
+            val_len >= entry->mfg_len &&
+            memcmp(val, entry->mfg, entry->mfg_len) == 0) {
+
+            scan->mfg_match |= 1UL << i;
+        }
+    }
+}
+
+/**
+ * Walks the advertising data once, recording everything the candidate
+ * filters need.  Parsing stops at the first malformed structure.
+ */
+static void
+ble_hs_adv_filt_scan(const uint8_t *data, uint16_t length,
+                     uint32_t candidates, struct ble_hs_adv_filt_scan *scan)
+{
+    const uint8_t *val;
+    uint8_t field_len;
+    uint8_t val_len;
+    uint8_t type;
+    int off;
+
+    memset(scan, 0, sizeof *scan);
+
+    off = 0;
+    while (off + 2 <= length) {
+        field_len = data[off];
+        if (field_len == 0 || off + 1 + field_len > length) {
+            break;
+        }
+
+        type = data[off + 1];
+        val = data + off + 2;
+        val_len = field_len - 1;
+
+        scan->ad_types[type / 32] |= 1UL << (type % 32);
+
+        if (ble_hs_adv_filt_criteria & BLE_HS_ADV_FILT_F_MFG &&
+            type == BLE_HS_ADV_TYPE_MFG_DATA) {
+
+            ble_hs_adv_filt_scan_mfg(val, val_len, candidates, scan);
+        }
+
+        if (ble_hs_adv_filt_criteria & BLE_HS_ADV_FILT_F_UUID) {
+            ble_hs_adv_filt_scan_uuids(val, val_len, type, candidates, scan);
+        }
+
+        off += 1 + field_len;
+    }
+}
+
+static int
+ble_hs_adv_filt_entry_match_ad(const struct ble_hs_adv_filt_entry *entry,
+                               uint32_t bit,
+                               const struct ble_hs_adv_filt_scan *scan)
+{
+    if (entry->criteria & BLE_HS_ADV_FILT_F_AD_TYPE &&
+        !(scan->ad_types[entry->ad_type / 32] &
+          (1UL << (entry->ad_type % 32)))) {
+
+        return 0;
+    }
+
+    if (entry->criteria & BLE_HS_ADV_FILT_F_MFG && !(scan->mfg_match & bit)) {
+        return 0;
+    }
+
+    if (entry->criteria & BLE_HS_ADV_FILT_F_UUID && !(scan->uuid_match & bit)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Determines whether an advertising report passes the configured filters.
+ * The address and RSSI criteria are checked first; the advertising data is
+ * only walked, once, if a filter that passed them needs it.
+ *
+ * @return                      1 if the report should be delivered;
+ *                              0 if it should be dropped.
+ */
+int
+ble_hs_adv_filt_match(const ble_addr_t *addr, int8_t rssi,
+                      const uint8_t *data, uint16_t length)
+{
+    struct ble_hs_adv_filt_entry *entry;
+    struct ble_hs_adv_filt_scan scan;
+    uint8_t addr_be[6];
+    uint32_t candidates;
+    uint32_t need_ad;
+    uint32_t bit;
+    int match;
+    int i;
+
+    ble_hs_lock();
+
+    if (ble_hs_adv_filt_num == 0) {
+        ble_hs_unlock();
+        return 1;
+    }
+
+    if (ble_hs_adv_filt_criteria & BLE_HS_ADV_FILT_F_ADDR) {
+        for (i = 0; i < 6; i++) {
+            addr_be[i] = addr->val[5 - i];
+        }
+    }
+
+    /* Cheap criteria first. */
+    match = 0;
+    candidates = 0;
+    need_ad = 0;
+    for (i = 0; i < ble_hs_adv_filt_num; i++) {
+        entry = ble_hs_adv_filt_entries + i;
+        bit = 1UL << i;
+
+        if (entry->criteria & BLE_HS_ADV_FILT_F_RSSI &&
+            (rssi == 127 || rssi < entry->rssi_min)) {
+
+            continue;
+        }
+
+        if (entry->criteria & BLE_HS_ADV_FILT_F_ADDR &&
+            memcmp(addr_be, entry->addr, entry->addr_len) != 0) {
+
+            continue;
+        }
+
+        if (entry->criteria & BLE_HS_ADV_FILT_F_AD_MASK) {
+            candidates |= bit;
+            need_ad |= bit;
+        } else {
+            entry->hits++;
+            match = 1;
+        }
+    }
+
+    if (need_ad != 0) {
+        ble_hs_adv_filt_scan(data, length, candidates, &scan);
+
+        for (i = 0; i < ble_hs_adv_filt_num; i++) {
+            entry = ble_hs_adv_filt_entries + i;
+            bit = 1UL << i;
+
+            if (need_ad & bit &&
+                ble_hs_adv_filt_entry_match_ad(entry, bit, &scan)) {
+
+                entry->hits++;
+                match = 1;
+            }
+        }
+    }
+
+    ble_hs_unlock();
+
+    return match;
+}
+
+void
+ble_hs_adv_filt_init(void)
+{
+    ble_hs_adv_filt_num = 0;
+    ble_hs_adv_filt_criteria = 0;
+}
+
+#else
+
+int
+ble_hs_adv_filt_set(const struct ble_hs_adv_filt *filts, int num_filts)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_hs_adv_filt_hits(int idx, uint32_t *out_hits)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+int
+ble_hs_adv_filt_match(const ble_addr_t *addr, int8_t rssi,
+                      const uint8_t *data, uint16_t length)
+{
+    return 1;
+}
+
+void
+ble_hs_adv_filt_init(void)
+{
+}
+
+#endif
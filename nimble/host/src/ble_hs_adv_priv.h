@@ -26,8 +26,15 @@ extern "C" {
 
 int ble_hs_adv_set_flat(uint8_t type, int data_len, const void *data,
                         uint8_t *dst, uint8_t *dst_len, uint8_t max_len);
-int ble_hs_adv_find_field(uint8_t type, const uint8_t *data, uint8_t length,
+int ble_hs_adv_find_field(uint8_t type, const uint8_t *data, uint16_t length,
                           const struct ble_hs_adv_field **out);
+int ble_hs_adv_filt_match(const ble_addr_t *addr, int8_t rssi,
+                          const uint8_t *data, uint16_t length);
+void ble_hs_adv_filt_init(void);
+int ble_hs_adv_dedup_check(const ble_addr_t *addr, uint8_t kind,
+                           const uint8_t *data, uint16_t length);
+void ble_hs_adv_dedup_reset(void);
+int ble_hs_adv_dedup_init(void);
 
 #ifdef __cplusplus
 }
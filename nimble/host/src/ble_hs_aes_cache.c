@@ -0,0 +1,364 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * AES-128 key schedule cache.
+ *
+ * The security manager and mesh crypto encrypt many blocks, and compute many
+ * AES-CMACs, with a small set of keys (e.g., a mesh node decrypts every
+ * network PDU with the same NetKey-derived encryption key).  Expanding the
+ * key schedule, and for CMAC deriving the K1/K2 subkeys, on every call is
+ * wasted work.  This module keeps the most recently used expanded keys in a
+ * small table.  Lookups copy the schedule out, so callers never hold a
+ * reference to a cache entry; evicted and cleared entries are zeroized.
+ */
+
+#include <string.h>
+#include "syscfg/syscfg.h"
+#include "nimble/nimble_opt.h"
+
+#if NIMBLE_BLE_SM || MYNEWT_VAL(BLE_MESH)
+
+#include "os/os.h"
+#include "host/ble_hs.h"
+#include "tinycrypt/aes.h"
+#include "tinycrypt/cmac_mode.h"
+#include "tinycrypt/constants.h"
+#include "ble_hs_aes_cache_priv.h"
+
+#define BLE_HS_AES_CACHE_SIZE   MYNEWT_VAL(BLE_HS_AES_CACHE_SIZE)
+
+static void
+ble_hs_aes_cache_zeroize(void *buf, size_t len)
+{
+    volatile uint8_t *p;
+
+    /* Written through a volatile pointer so the compiler cannot elide it. */
+    p = buf;
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
+#if BLE_HS_AES_CACHE_SIZE > 0
+
+struct ble_hs_aes_cache_entry {
+    struct tc_aes_key_sched_struct sched;
+    uint8_t key[TC_AES_KEY_SIZE];
+    uint8_t k1[TC_AES_BLOCK_SIZE];
+    uint8_t k2[TC_AES_BLOCK_SIZE];
+
+    /** Time of last use; 0 if the entry is free. */
+    uint32_t last_used;
+
+    /** Set if k1 and k2 hold the key's CMAC subkeys. */
+    uint8_t cmac_valid;
+};
+
+static struct ble_hs_aes_cache_entry
+    ble_hs_aes_cache_entries[BLE_HS_AES_CACHE_SIZE];
+static uint32_t ble_hs_aes_cache_clock;
+
+static int
+ble_hs_aes_cache_key_eq(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t diff;
+    int i;
+
+    /* Constant time; do not leak how much of a cached key matched. */
+    diff = 0;
+    for (i = 0; i < TC_AES_KEY_SIZE; i++) {
+        diff |= a[i] ^ b[i];
+    }
+
+    return diff == 0;
+}
+
+static void
+ble_hs_aes_cache_touch(struct ble_hs_aes_cache_entry *entry)
+{
+    ble_hs_aes_cache_clock++;
+    if (ble_hs_aes_cache_clock == 0) {
+        /* Wrapped; 0 marks free entries. */
+        ble_hs_aes_cache_clock = 1;
+    }
+    entry->last_used = ble_hs_aes_cache_clock;
+}
+
+static struct ble_hs_aes_cache_entry *
+ble_hs_aes_cache_find(const uint8_t *key)
+{
+    struct ble_hs_aes_cache_entry *entry;
+    int i;
+
+    for (i = 0; i < BLE_HS_AES_CACHE_SIZE; i++) {
+        entry = ble_hs_aes_cache_entries + i;
+        if (entry->last_used != 0 && ble_hs_aes_cache_key_eq(entry->key, key)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Selects an entry for a new key: a free one if available, otherwise the
+ * least recently used one, which is zeroized.
+ */
+static struct ble_hs_aes_cache_entry *
+ble_hs_aes_cache_victim(void)
+{
+    struct ble_hs_aes_cache_entry *victim;
+    struct ble_hs_aes_cache_entry *entry;
+    int i;
+
+    victim = ble_hs_aes_cache_entries;
+    for (i = 0; i < BLE_HS_AES_CACHE_SIZE; i++) {
+        entry = ble_hs_aes_cache_entries + i;
+        if (entry->last_used == 0) {
+            return entry;
+        }
+
+        /* Unsigned difference tolerates a wrapped clock. */
+        if (ble_hs_aes_cache_clock - entry->last_used >
+            ble_hs_aes_cache_clock - victim->last_used) {
+
+            victim = entry;
+        }
+    }
+
+    ble_hs_aes_cache_zeroize(victim, sizeof *victim);
+    return victim;
+}
+
+#endif
+
+/* Doubling in GF(2^128), as used to derive the AES-CMAC subkeys. */
+static void
+ble_hs_aes_cache_gf_double(uint8_t *out, const uint8_t *in)
+{
+    uint8_t carry;
+    int i;
+
+    carry = in[0] & 0x80;
+    for (i = 0; i < TC_AES_BLOCK_SIZE - 1; i++) {
+        out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+    }
+    out[TC_AES_BLOCK_SIZE - 1] = in[TC_AES_BLOCK_SIZE - 1] << 1;
+
+    if (carry) {
+        out[TC_AES_BLOCK_SIZE - 1] ^= 0x87;
+    }
+}
+
+/**
+ * Retrieves the expanded encryption schedule of the specified key, expanding
+ * and caching it on a miss.
+ *
+ * @param key                   The AES-128 key.
+ * @param out_sched             On success, the key schedule is written here.
+ *
+ * @return                      0 on success; BLE_HS_EUNKNOWN on failure.
+ */
+int
+ble_hs_aes_cache_sched(const uint8_t *key,
+                       struct tc_aes_key_sched_struct *out_sched)
+{
+#if BLE_HS_AES_CACHE_SIZE > 0
+    struct ble_hs_aes_cache_entry *entry;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    entry = ble_hs_aes_cache_find(key);
+    if (entry != NULL) {
+        *out_sched = entry->sched;
+        ble_hs_aes_cache_touch(entry);
+        OS_EXIT_CRITICAL(sr);
+        return 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+#endif
+
+    if (tc_aes128_set_encrypt_key(out_sched, key) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+#if BLE_HS_AES_CACHE_SIZE > 0
+    OS_ENTER_CRITICAL(sr);
+    /* Another task may have inserted the key while we expanded it. */
+    entry = ble_hs_aes_cache_find(key);
+    if (entry == NULL) {
+        entry = ble_hs_aes_cache_victim();
+        memcpy(entry->key, key, sizeof entry->key);
+        entry->sched = *out_sched;
+    }
+    ble_hs_aes_cache_touch(entry);
+    OS_EXIT_CRITICAL(sr);
+#endif
+
+    return 0;
+}
+
+/**
+ * Encrypts a single block with the specified key, using the cached key
+ * schedule if available.
+ *
+ * @param key                   The AES-128 key.
+ * @param plaintext             The 16-byte block to encrypt.
+ * @param enc_data              On success, the encrypted block is written
+ *                                  here.  May alias plaintext.
+ *
+ * @return                      0 on success; BLE_HS_EUNKNOWN on failure.
+ */
+int
+ble_hs_aes_cache_encrypt(const uint8_t *key, const uint8_t *plaintext,
+                         uint8_t *enc_data)
+{
+    struct tc_aes_key_sched_struct sched;
+    int rc;
+
+    rc = ble_hs_aes_cache_sched(key, &sched);
+    if (rc == 0) {
+        if (tc_aes_encrypt(enc_data, plaintext, &sched) == TC_CRYPTO_FAIL) {
+            rc = BLE_HS_EUNKNOWN;
+        }
+    }
+
+    ble_hs_aes_cache_zeroize(&sched, sizeof sched);
+
+    return rc;
+}
+
+/**
+ * Equivalent of tc_cmac_setup(), but reuses the cached key schedule and
+ * CMAC subkeys if available.  On success, the state is initialized and ready
+ * for tc_cmac_update().
+ *
+ * @param state                 The CMAC state to initialize.
+ * @param key                   The AES-128 key.
+ * @param sched                 Storage for the key schedule; must remain
+ *                                  valid while the state is in use.
+ *
+ * @return                      0 on success; BLE_HS_EUNKNOWN on failure.
+ */
+int
+ble_hs_aes_cache_cmac_setup(struct tc_cmac_struct *state, const uint8_t *key,
+                            struct tc_aes_key_sched_struct *sched)
+{
+#if BLE_HS_AES_CACHE_SIZE > 0
+    struct ble_hs_aes_cache_entry *entry;
+    os_sr_t sr;
+#endif
+    int rc;
+
+    memset(state, 0, sizeof *state);
+    state->sched = sched;
+
+#if BLE_HS_AES_CACHE_SIZE > 0
+    OS_ENTER_CRITICAL(sr);
+    entry = ble_hs_aes_cache_find(key);
+    if (entry != NULL && entry->cmac_valid) {
+        *sched = entry->sched;
+        memcpy(state->K1, entry->k1, sizeof state->K1);
+        memcpy(state->K2, entry->k2, sizeof state->K2);
+        ble_hs_aes_cache_touch(entry);
+        OS_EXIT_CRITICAL(sr);
+        goto done;
+    }
+    OS_EXIT_CRITICAL(sr);
+#endif
+
+    rc = ble_hs_aes_cache_sched(key, sched);
+    if (rc != 0) {
+        return rc;
+    }
+
+    /* L = e(K, 0); K1 = L * x; K2 = K1 * x */
+    if (tc_aes_encrypt(state->iv, state->iv, sched) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+    ble_hs_aes_cache_gf_double(state->K1, state->iv);
+    ble_hs_aes_cache_gf_double(state->K2, state->K1);
+
+#if BLE_HS_AES_CACHE_SIZE > 0
+    OS_ENTER_CRITICAL(sr);
+    entry = ble_hs_aes_cache_find(key);
+    if (entry != NULL) {
+        memcpy(entry->k1, state->K1, sizeof entry->k1);
+        memcpy(entry->k2, state->K2, sizeof entry->k2);
+        entry->cmac_valid = 1;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+done:
+#endif
+    if (tc_cmac_init(state) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+
+/**
+ * @return                      The number of keys currently cached.
+ */
+int
+ble_hs_aes_cache_dbg_num_entries(void)
+{
+    int count;
+#if BLE_HS_AES_CACHE_SIZE > 0
+    int i;
+#endif
+
+    count = 0;
+
+#if BLE_HS_AES_CACHE_SIZE > 0
+    for (i = 0; i < BLE_HS_AES_CACHE_SIZE; i++) {
+        if (ble_hs_aes_cache_entries[i].last_used != 0) {
+            count++;
+        }
+    }
+#endif
+
+    return count;
+}
+
+#endif
+
+/**
+ * Zeroizes all cached keys.  Should be called whenever keys that may be in
+ * the cache are discarded.
+ */
+void
+ble_hs_aes_cache_clear(void)
+{
+#if BLE_HS_AES_CACHE_SIZE > 0
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    ble_hs_aes_cache_zeroize(ble_hs_aes_cache_entries,
+                             sizeof ble_hs_aes_cache_entries);
+    ble_hs_aes_cache_clock = 0;
+    OS_EXIT_CRITICAL(sr);
+#endif
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_HS_AES_CACHE_PRIV_
+#define H_BLE_HS_AES_CACHE_PRIV_
+
+#include <inttypes.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct tc_aes_key_sched_struct;
+struct tc_cmac_struct;
+
+/* All keys are 16-byte AES-128 keys in big-endian (tinycrypt) order. */
+
+int ble_hs_aes_cache_sched(const uint8_t *key,
+                           struct tc_aes_key_sched_struct *out_sched);
+int ble_hs_aes_cache_encrypt(const uint8_t *key, const uint8_t *plaintext,
+                             uint8_t *enc_data);
+int ble_hs_aes_cache_cmac_setup(struct tc_cmac_struct *state,
+                                const uint8_t *key,
+                                struct tc_aes_key_sched_struct *sched);
+void ble_hs_aes_cache_clear(void);
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+int ble_hs_aes_cache_dbg_num_entries(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
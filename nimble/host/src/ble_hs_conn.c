@@ -35,6 +35,18 @@ static os_membuf_t ble_hs_conn_elem_mem[
                     sizeof (struct ble_hs_conn))
 ];
 
+/**
+ * Direct-mapped cache of connections, indexed by connection handle modulo
+ * the maximum number of connections.  Controllers typically hand out small,
+ * sequential handles, so lookups by handle hit in constant time; on a miss
+ * the connection list is walked and the slot refilled.
+ */
+static struct ble_hs_conn *
+ble_hs_conn_cache[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+
+#define BLE_HS_CONN_CACHE_IDX(handle) \
+    ((handle) % MYNEWT_VAL(BLE_MAX_CONNECTIONS))
+
 static const uint8_t ble_hs_conn_null_addr[6];
 
 int
@@ -239,6 +251,7 @@ ble_hs_conn_insert(struct ble_hs_conn *conn)
 
     BLE_HS_DBG_ASSERT_EVAL(ble_hs_conn_find(conn->bhc_handle) == NULL);
     SLIST_INSERT_HEAD(&ble_hs_conns, conn, bhc_next);
+    ble_hs_conn_cache[BLE_HS_CONN_CACHE_IDX(conn->bhc_handle)] = conn;
 }
 
 void
@@ -251,6 +264,10 @@ ble_hs_conn_remove(struct ble_hs_conn *conn)
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
     SLIST_REMOVE(&ble_hs_conns, conn, ble_hs_conn, bhc_next);
+
+    if (ble_hs_conn_cache[BLE_HS_CONN_CACHE_IDX(conn->bhc_handle)] == conn) {
+        ble_hs_conn_cache[BLE_HS_CONN_CACHE_IDX(conn->bhc_handle)] = NULL;
+    }
 }
 
 struct ble_hs_conn *
@@ -264,8 +281,14 @@ ble_hs_conn_find(uint16_t conn_handle)
 
     BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
 
+    conn = ble_hs_conn_cache[BLE_HS_CONN_CACHE_IDX(conn_handle)];
+    if (conn != NULL && conn->bhc_handle == conn_handle) {
+        return conn;
+    }
+
     SLIST_FOREACH(conn, &ble_hs_conns, bhc_next) {
         if (conn->bhc_handle == conn_handle) {
+            ble_hs_conn_cache[BLE_HS_CONN_CACHE_IDX(conn_handle)] = conn;
             return conn;
         }
     }
@@ -506,6 +529,7 @@ ble_hs_conn_init(void)
     }
 
     SLIST_INIT(&ble_hs_conns);
+    memset(ble_hs_conn_cache, 0, sizeof ble_hs_conn_cache);
 
     return 0;
 }
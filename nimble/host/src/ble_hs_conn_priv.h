@@ -81,6 +81,23 @@ struct ble_hs_conn {
 
     struct ble_gap_sec_state bhc_sec_state;
 
+#if MYNEWT_VAL(BLE_GATT_SIGNED_WRITE)
+    /**
+     * SignCounter for the next signed write we send, and the end of the
+     * block of counter values reserved in the bond.
+     */
+    uint32_t bhc_sign_counter;
+    uint32_t bhc_sign_counter_limit;
+#endif
+
+#if MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+    /**
+     * Lowest SignCounter still accepted from the peer.  The bond is only
+     * brought up to date periodically and when the connection terminates.
+     */
+    uint32_t bhc_peer_sign_counter;
+#endif
+
     ble_gap_event_fn *bhc_cb;
     void *bhc_cb_arg;
 };
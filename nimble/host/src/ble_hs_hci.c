@@ -21,7 +21,6 @@
 #include <errno.h>
 #include <stdio.h>
 #include "os/os.h"
-#include "mem/mem.h"
 #include "nimble/ble_hci_trans.h"
 #include "host/ble_monitor.h"
 #include "ble_hs_priv.h"
@@ -30,8 +29,72 @@
 
 #define BLE_HCI_CMD_TIMEOUT     ((OS_TICKS_PER_SEC) * 2)
 
+/**
+ * Size of the per-command buffer used by the asynchronous command interface.
+ * The buffer holds the command parameters until the command is sent, and the
+ * return parameters once the command has been acknowledged.
+ */
+#define BLE_HS_HCI_ASYNC_BUF_SZ             64
+
+#define BLE_HS_HCI_ASYNC_STATE_QUEUED       0
+#define BLE_HS_HCI_ASYNC_STATE_SENT         1
+#define BLE_HS_HCI_ASYNC_STATE_DONE         2
+
+struct ble_hs_hci_async_cmd {
+    STAILQ_ENTRY(ble_hs_hci_async_cmd) next;
+    ble_hs_hci_cmd_cb_fn *cb;
+    void *cb_arg;
+    os_time_t exp_os_ticks;
+    int status;
+    uint16_t opcode;
+    uint8_t state;
+    uint8_t len;
+    uint8_t buf[BLE_HS_HCI_ASYNC_BUF_SZ];
+};
+
+STAILQ_HEAD(ble_hs_hci_async_cmd_list, ble_hs_hci_async_cmd);
+
 static struct os_mutex ble_hs_hci_mutex;
 static struct os_sem ble_hs_hci_sem;
+static struct os_sem ble_hs_hci_credit_sem;
+static struct os_sem ble_hs_hci_async_sem;
+
+static os_membuf_t ble_hs_hci_async_cmd_mem[
+    OS_MEMPOOL_SIZE(MYNEWT_VAL(BLE_HS_HCI_CMD_ASYNC_MAX),
+                    sizeof (struct ble_hs_hci_async_cmd))
+];
+static struct os_mempool ble_hs_hci_async_cmd_pool;
+
+/** Asynchronous commands, in the order they were submitted. */
+static struct ble_hs_hci_async_cmd_list ble_hs_hci_async_cmds;
+
+static void ble_hs_hci_async_event(struct os_event *ev);
+static void ble_hs_hci_async_sched(void);
+static void ble_hs_hci_async_kick(void);
+
+/** OS event - delivers completed asynchronous commands in the host task. */
+static struct os_event ble_hs_hci_async_ev = {
+    .ev_cb = ble_hs_hci_async_event,
+};
+
+/**
+ * The number of commands the controller is currently willing to accept
+ * (Num_HCI_Command_Packets from the most recent command complete or command
+ * status event).  Only accessed inside a critical section.
+ */
+static uint8_t ble_hs_hci_cmd_credits;
+
+/** Set while a blocking command is waiting for its acknowledgement. */
+static volatile uint8_t ble_hs_hci_sync_pending;
+
+/** Set when a blocking command is waiting for a command credit. */
+static uint8_t ble_hs_hci_credit_waiting;
+
+/** Set while a batch is waiting for asynchronous commands to complete. */
+static volatile uint8_t ble_hs_hci_async_waiting;
+
+/** Set when the async queue needs to be serviced by the mutex holder. */
+static volatile uint8_t ble_hs_hci_async_kick_req;
 
 static uint8_t *ble_hs_hci_ack;
 static uint16_t ble_hs_hci_buf_sz;
@@ -75,6 +138,125 @@ ble_hs_hci_unlock(void)
     BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == OS_NOT_STARTED);
 }
 
+/**
+ * Attempts to lock the HCI mutex without blocking.
+ *
+ * @return                      0 if the mutex was acquired;
+ *                              BLE_HS_EBUSY if another task holds it.
+ */
+static int
+ble_hs_hci_trylock(void)
+{
+    int rc;
+
+    rc = os_mutex_pend(&ble_hs_hci_mutex, 0);
+    switch (rc) {
+    case 0:
+    case OS_NOT_STARTED:
+        return 0;
+
+    default:
+        return BLE_HS_EBUSY;
+    }
+}
+
+/**
+ * Records the controller's Num_HCI_Command_Packets value.  If a blocking
+ * command is waiting for a credit, the credit is handed to it directly.
+ * Called from the transport's context.
+ */
+static void
+ble_hs_hci_credits_set(uint8_t num_pkts)
+{
+    os_sr_t sr;
+    int wake;
+    int sched;
+
+    wake = 0;
+
+    OS_ENTER_CRITICAL(sr);
+
+    ble_hs_hci_cmd_credits = num_pkts;
+    if (ble_hs_hci_credit_waiting && ble_hs_hci_cmd_credits > 0) {
+        ble_hs_hci_credit_waiting = 0;
+        ble_hs_hci_cmd_credits--;
+        wake = 1;
+    }
+    sched = ble_hs_hci_cmd_credits > 0 &&
+            !STAILQ_EMPTY(&ble_hs_hci_async_cmds);
+
+    OS_EXIT_CRITICAL(sr);
+
+    if (wake) {
+        os_sem_release(&ble_hs_hci_credit_sem);
+    }
+
+    if (sched) {
+        /* Let the host task send queued commands now that the controller has
+         * room for them.
+         */
+        ble_hs_hci_async_sched();
+    }
+}
+
+/**
+ * Returns a command credit that was taken for a command that never reached
+ * the controller.
+ */
+static void
+ble_hs_hci_credit_put(void)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    ble_hs_hci_cmd_credits++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * Takes a command credit on behalf of a blocking command, waiting until the
+ * controller indicates it can accept another command.
+ */
+static int
+ble_hs_hci_wait_for_credit(void)
+{
+#if MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+    /* Phony acks are delivered synchronously; there is never more than one
+     * command outstanding.
+     */
+    return 0;
+#else
+    os_sr_t sr;
+    int rc;
+
+    OS_ENTER_CRITICAL(sr);
+    if (ble_hs_hci_cmd_credits > 0) {
+        ble_hs_hci_cmd_credits--;
+        OS_EXIT_CRITICAL(sr);
+        return 0;
+    }
+    ble_hs_hci_credit_waiting = 1;
+    OS_EXIT_CRITICAL(sr);
+
+    rc = os_sem_pend(&ble_hs_hci_credit_sem, BLE_HCI_CMD_TIMEOUT);
+    switch (rc) {
+    case 0:
+        return 0;
+
+    case OS_TIMEOUT:
+        OS_ENTER_CRITICAL(sr);
+        ble_hs_hci_credit_waiting = 0;
+        OS_EXIT_CRITICAL(sr);
+
+        STATS_INC(ble_hs_stats, hci_timeout);
+        return BLE_HS_ETIMEOUT_HCI;
+
+    default:
+        return BLE_HS_EOS;
+    }
+#endif
+}
+
 int
 ble_hs_hci_set_buf_sz(uint16_t pktlen, uint16_t max_pkts)
 {
@@ -290,8 +472,17 @@ ble_hs_hci_cmd_tx(uint16_t opcode, void *cmd, uint8_t cmd_len,
     BLE_HS_DBG_ASSERT(ble_hs_hci_ack == NULL);
     ble_hs_hci_lock();
 
+    rc = ble_hs_hci_wait_for_credit();
+    if (rc != 0) {
+        ble_hs_sched_reset(rc);
+        goto done;
+    }
+
+    ble_hs_hci_sync_pending = 1;
+
     rc = ble_hs_hci_cmd_send_buf(opcode, cmd, cmd_len);
     if (rc != 0) {
+        ble_hs_hci_credit_put();
         goto done;
     }
 
@@ -314,12 +505,20 @@ ble_hs_hci_cmd_tx(uint16_t opcode, void *cmd, uint8_t cmd_len,
     rc = ack.bha_status;
 
 done:
+    ble_hs_hci_sync_pending = 0;
+
     if (ble_hs_hci_ack != NULL) {
         ble_hci_trans_buf_free(ble_hs_hci_ack);
         ble_hs_hci_ack = NULL;
     }
 
     ble_hs_hci_unlock();
+
+    /* Asynchronous commands may have been queued while this command was in
+     * progress.
+     */
+    ble_hs_hci_async_kick();
+
     return rc;
 }
 
@@ -336,10 +535,136 @@ ble_hs_hci_cmd_tx_empty_ack(uint16_t opcode, void *cmd, uint8_t cmd_len)
     return 0;
 }
 
+/**
+ * Indicates whether an asynchronous command with the specified opcode has
+ * been sent and not yet acknowledged.  Must be called inside a critical
+ * section.
+ */
+static struct ble_hs_hci_async_cmd *
+ble_hs_hci_async_find_sent(uint16_t opcode)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+
+    STAILQ_FOREACH(cmd, &ble_hs_hci_async_cmds, next) {
+        if (cmd->state == BLE_HS_HCI_ASYNC_STATE_SENT &&
+            cmd->opcode == opcode) {
+
+            return cmd;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Marks an asynchronous command as complete.  The command's callback gets
+ * executed in the host task.
+ */
+static void
+ble_hs_hci_async_done(struct ble_hs_hci_async_cmd *cmd, int status)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    cmd->status = status;
+    cmd->state = BLE_HS_HCI_ASYNC_STATE_DONE;
+    OS_EXIT_CRITICAL(sr);
+
+    if (ble_hs_hci_async_waiting) {
+        os_sem_release(&ble_hs_hci_async_sem);
+    } else {
+        ble_hs_hci_async_sched();
+    }
+}
+
+/**
+ * Matches an incoming acknowledgement against the in-flight asynchronous
+ * commands.  The oldest in-flight command with a matching opcode is
+ * completed.  On success, the ack buffer is consumed.
+ *
+ * @return                      0 if the ack was consumed;
+ *                              BLE_HS_ENOENT if no asynchronous command was
+ *                                  waiting for it.
+ */
+static int
+ble_hs_hci_async_rx_ack(uint8_t *ack_ev)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+    struct ble_hs_hci_ack ack;
+    uint16_t opcode;
+    os_sr_t sr;
+    int rc;
+
+    if (ack_ev[0] == BLE_HCI_EVCODE_COMMAND_COMPLETE) {
+        opcode = get_le16(ack_ev + 3);
+    } else {
+        opcode = get_le16(ack_ev + 4);
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    cmd = ble_hs_hci_async_find_sent(opcode);
+    OS_EXIT_CRITICAL(sr);
+
+    if (cmd == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    STATS_INC(ble_hs_stats, hci_event);
+
+#if BLE_MONITOR
+    ble_monitor_send(BLE_MONITOR_OPCODE_EVENT_PKT, ack_ev,
+                     ack_ev[1] + BLE_HCI_EVENT_HDR_LEN);
+#endif
+
+    memset(&ack, 0, sizeof ack);
+    if (ack_ev[0] == BLE_HCI_EVCODE_COMMAND_COMPLETE) {
+        rc = ble_hs_hci_rx_cmd_complete(ack_ev[0], ack_ev, ack_ev[1] + 2,
+                                        &ack);
+    } else {
+        rc = ble_hs_hci_rx_cmd_status(ack_ev[0], ack_ev, ack_ev[1] + 2,
+                                      &ack);
+    }
+
+    if (rc == 0) {
+        if (ack.bha_params_len > sizeof cmd->buf) {
+            ack.bha_params_len = sizeof cmd->buf;
+            rc = BLE_HS_ECONTROLLER;
+        } else {
+            rc = ack.bha_status;
+        }
+        memcpy(cmd->buf, ack.bha_params, ack.bha_params_len);
+        cmd->len = ack.bha_params_len;
+    } else {
+        STATS_INC(ble_hs_stats, hci_invalid_ack);
+        cmd->len = 0;
+    }
+
+    ble_hci_trans_buf_free(ack_ev);
+    ble_hs_hci_async_done(cmd, rc);
+
+    return 0;
+}
+
 void
 ble_hs_hci_rx_ack(uint8_t *ack_ev)
 {
-    if (os_sem_get_count(&ble_hs_hci_sem) > 0) {
+    int rc;
+
+    if (ack_ev[0] == BLE_HCI_EVCODE_COMMAND_COMPLETE) {
+        ble_hs_hci_credits_set(ack_ev[2]);
+    } else {
+        ble_hs_hci_credits_set(ack_ev[3]);
+    }
+
+    /* An asynchronous command with the same opcode as the blocking command
+     * can only have been sent before it, so it gets matched first.
+     */
+    rc = ble_hs_hci_async_rx_ack(ack_ev);
+    if (rc == 0) {
+        return;
+    }
+
+    if (!ble_hs_hci_sync_pending || os_sem_get_count(&ble_hs_hci_sem) > 0) {
         /* This ack is unexpected; ignore it. */
         ble_hci_trans_buf_free(ack_ev);
         return;
@@ -353,6 +678,459 @@ ble_hs_hci_rx_ack(uint8_t *ack_ev)
     os_sem_release(&ble_hs_hci_sem);
 }
 
+static void
+ble_hs_hci_async_sched(void)
+{
+#if !MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+    os_eventq_put(ble_hs_evq_get(), &ble_hs_hci_async_ev);
+#endif
+}
+
+#if MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+static void
+ble_hs_hci_async_phony_ack(struct ble_hs_hci_async_cmd *cmd)
+{
+    uint8_t *ack;
+    int rc;
+
+    if (ble_hs_hci_phony_ack_cb == NULL) {
+        ble_hs_hci_async_done(cmd, BLE_HS_ETIMEOUT_HCI);
+        return;
+    }
+
+    ack = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_CMD);
+    BLE_HS_DBG_ASSERT(ack != NULL);
+
+    rc = ble_hs_hci_phony_ack_cb(ack, 260);
+    if (rc == 0 && get_le16(ack + 3) != cmd->opcode) {
+        STATS_INC(ble_hs_stats, hci_invalid_ack);
+        rc = BLE_HS_ECONTROLLER;
+    }
+    if (rc != 0) {
+        ble_hci_trans_buf_free(ack);
+        ble_hs_hci_async_done(cmd, rc);
+        return;
+    }
+
+    ble_hs_hci_rx_ack(ack);
+}
+#endif
+
+/**
+ * Sends queued asynchronous commands, in submission order, for as long as the
+ * controller has command credits.  A command is held back while another
+ * command with the same opcode is in flight; otherwise its acknowledgement
+ * could not be told apart.  The HCI mutex must be held.
+ */
+static int
+ble_hs_hci_async_tx_pending(void)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+    os_sr_t sr;
+    int num_sent;
+    int rc;
+
+    num_sent = 0;
+
+    while (1) {
+        OS_ENTER_CRITICAL(sr);
+
+        STAILQ_FOREACH(cmd, &ble_hs_hci_async_cmds, next) {
+            if (cmd->state == BLE_HS_HCI_ASYNC_STATE_QUEUED) {
+                break;
+            }
+        }
+
+        if (cmd == NULL ||
+            ble_hs_hci_cmd_credits == 0 ||
+            ble_hs_hci_async_find_sent(cmd->opcode) != NULL) {
+
+            OS_EXIT_CRITICAL(sr);
+            return num_sent;
+        }
+
+        /* Mark the command as sent before it is handed to the transport; the
+         * ack may arrive before the transport call returns.
+         */
+        cmd->state = BLE_HS_HCI_ASYNC_STATE_SENT;
+        cmd->exp_os_ticks = os_time_get() + BLE_HCI_CMD_TIMEOUT;
+        ble_hs_hci_cmd_credits--;
+
+        OS_EXIT_CRITICAL(sr);
+
+        rc = ble_hs_hci_cmd_send_buf(cmd->opcode, cmd->buf, cmd->len);
+        if (rc != 0) {
+            ble_hs_hci_credit_put();
+            ble_hs_hci_async_done(cmd, rc);
+            continue;
+        }
+
+        num_sent++;
+
+#if MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+        ble_hs_hci_async_phony_ack(cmd);
+#endif
+    }
+}
+
+/**
+ * Services the async command queue.  If another task holds the HCI mutex,
+ * that task services the queue when it releases the mutex.
+ */
+static void
+ble_hs_hci_async_kick(void)
+{
+    int num_sent;
+
+    num_sent = 0;
+    ble_hs_hci_async_kick_req = 1;
+
+    while (ble_hs_hci_async_kick_req && ble_hs_hci_trylock() == 0) {
+        ble_hs_hci_async_kick_req = 0;
+        num_sent += ble_hs_hci_async_tx_pending();
+        ble_hs_hci_unlock();
+    }
+
+#if !MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+    if (num_sent > 0) {
+        /* Arm the host timer so unacknowledged commands get detected. */
+        ble_hs_timer_resched();
+    }
+#endif
+}
+
+/**
+ * Removes and returns the first completed asynchronous command.
+ */
+static struct ble_hs_hci_async_cmd *
+ble_hs_hci_async_extract_done(void)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+
+    STAILQ_FOREACH(cmd, &ble_hs_hci_async_cmds, next) {
+        if (cmd->state == BLE_HS_HCI_ASYNC_STATE_DONE) {
+            STAILQ_REMOVE(&ble_hs_hci_async_cmds, cmd, ble_hs_hci_async_cmd,
+                          next);
+            break;
+        }
+    }
+
+    OS_EXIT_CRITICAL(sr);
+
+    return cmd;
+}
+
+static void
+ble_hs_hci_async_free(struct ble_hs_hci_async_cmd *cmd)
+{
+    int rc;
+
+    rc = os_memblock_put(&ble_hs_hci_async_cmd_pool, cmd);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+}
+
+/**
+ * Executes the callbacks of all completed asynchronous commands and sends
+ * any commands that are waiting for a credit.
+ */
+static void
+ble_hs_hci_async_process(void)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+
+    while ((cmd = ble_hs_hci_async_extract_done()) != NULL) {
+        if (cmd->cb != NULL) {
+            cmd->cb(cmd->opcode, cmd->status, cmd->buf, cmd->len,
+                    cmd->cb_arg);
+        }
+        ble_hs_hci_async_free(cmd);
+    }
+
+    ble_hs_hci_async_kick();
+}
+
+static void
+ble_hs_hci_async_event(struct os_event *ev)
+{
+    ble_hs_hci_async_process();
+}
+
+/**
+ * Queues an HCI command for transmission without waiting for the controller
+ * to acknowledge it.  Commands are sent in the order they are queued, and
+ * several commands may be in flight at once if the controller's
+ * Num_HCI_Command_Packets allows it.  The callback is executed in the host
+ * task when the command complete or command status event arrives.
+ *
+ * @param opcode                The command opcode.
+ * @param cmd                   The command parameters.
+ * @param cmd_len               The length of the command parameters; must
+ *                                  not exceed 64 bytes.
+ * @param cb                    Callback to execute on completion; may be
+ *                                  NULL.  Return parameters longer than 64
+ *                                  bytes are truncated and reported as
+ *                                  BLE_HS_ECONTROLLER.
+ * @param cb_arg                Argument to pass to the callback.
+ *
+ * @return                      0 if the command was queued;
+ *                              BLE_HS_EINVAL if the parameters are too long;
+ *                              BLE_HS_ENOMEM if the command queue is full.
+ */
+int
+ble_hs_hci_cmd_tx_async(uint16_t opcode, const void *cmd, uint8_t cmd_len,
+                        ble_hs_hci_cmd_cb_fn *cb, void *cb_arg)
+{
+    struct ble_hs_hci_async_cmd *entry;
+    os_sr_t sr;
+
+    if (cmd_len > BLE_HS_HCI_ASYNC_BUF_SZ) {
+        return BLE_HS_EINVAL;
+    }
+
+    entry = os_memblock_get(&ble_hs_hci_async_cmd_pool);
+    if (entry == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    memset(entry, 0, sizeof *entry);
+    entry->cb = cb;
+    entry->cb_arg = cb_arg;
+    entry->opcode = opcode;
+    entry->state = BLE_HS_HCI_ASYNC_STATE_QUEUED;
+    entry->len = cmd_len;
+    if (cmd_len != 0) {
+        memcpy(entry->buf, cmd, cmd_len);
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    STAILQ_INSERT_TAIL(&ble_hs_hci_async_cmds, entry, next);
+    OS_EXIT_CRITICAL(sr);
+
+    ble_hs_hci_async_kick();
+
+#if MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+    ble_hs_hci_async_process();
+#endif
+
+    return 0;
+}
+
+static void
+ble_hs_hci_batch_cb(uint16_t opcode, int status, const uint8_t *params,
+                    uint8_t params_len, void *arg)
+{
+    struct ble_hs_hci_batch_cmd *cmd;
+
+    cmd = arg;
+
+    if (status == 0 && cmd->rsp != NULL) {
+        if (params_len > cmd->rsp_len) {
+            params_len = cmd->rsp_len;
+            status = BLE_HS_ECONTROLLER;
+        }
+        memcpy(cmd->rsp, params, params_len);
+    } else {
+        params_len = 0;
+    }
+
+    cmd->rsp_len = params_len;
+    cmd->status = status;
+    cmd->done = 1;
+}
+
+/**
+ * Blocks until an asynchronous command completes, then executes the
+ * callbacks of all completed commands in the current task.
+ */
+static int
+ble_hs_hci_async_wait(void)
+{
+#if MYNEWT_VAL(BLE_HS_PHONY_HCI_ACKS)
+    /* Phony acks complete commands as they are sent. */
+    return 0;
+#else
+    int rc;
+
+    rc = os_sem_pend(&ble_hs_hci_async_sem, BLE_HCI_CMD_TIMEOUT);
+    switch (rc) {
+    case 0:
+        ble_hs_hci_async_process();
+        return 0;
+
+    case OS_TIMEOUT:
+        STATS_INC(ble_hs_stats, hci_timeout);
+        return BLE_HS_ETIMEOUT_HCI;
+
+    default:
+        return BLE_HS_EOS;
+    }
+#endif
+}
+
+/**
+ * Sends a set of independent HCI commands and blocks until all of them are
+ * acknowledged.  The commands are sent back-to-back, so the round trip to
+ * the controller is paid once per batch rather than once per command.
+ * Commands that need each other's results must be placed in separate
+ * batches.
+ *
+ * Only the host parent task may call this function; callbacks of other
+ * asynchronous commands that complete in the meantime are executed in the
+ * caller's context.
+ *
+ * @param cmds                  The commands to send.  On return, each
+ *                                  entry's status, and rsp_len fields are
+ *                                  filled in.
+ * @param num_cmds              The number of entries in the array.
+ *
+ * @return                      0 if every command succeeded;
+ *                              The status of the first failed command
+ *                                  otherwise.
+ */
+int
+ble_hs_hci_cmd_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds)
+{
+    struct ble_hs_hci_batch_cmd *cmd;
+    int num_sent;
+    int num_done;
+    int rc;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
+
+    for (i = 0; i < num_cmds; i++) {
+        cmds[i].done = 0;
+    }
+
+    ble_hs_hci_async_waiting = 1;
+
+    num_sent = 0;
+    while (1) {
+        /* Queue as many commands as the async pool allows. */
+        while (num_sent < num_cmds) {
+            cmd = cmds + num_sent;
+            rc = ble_hs_hci_cmd_tx_async(cmd->opcode, cmd->cmd, cmd->cmd_len,
+                                         ble_hs_hci_batch_cb, cmd);
+            if (rc == BLE_HS_ENOMEM) {
+                break;
+            }
+            if (rc != 0) {
+                cmd->status = rc;
+                cmd->rsp_len = 0;
+                cmd->done = 1;
+            }
+            num_sent++;
+        }
+
+        num_done = 0;
+        for (i = 0; i < num_sent; i++) {
+            num_done += cmds[i].done;
+        }
+        if (num_done == num_cmds) {
+            break;
+        }
+
+        rc = ble_hs_hci_async_wait();
+        if (rc != 0) {
+            /* The callbacks reference the caller's array; they must not run
+             * after this function returns.
+             */
+            ble_hs_hci_async_waiting = 0;
+            ble_hs_hci_async_flush(rc);
+            ble_hs_sched_reset(rc);
+            return rc;
+        }
+    }
+
+    ble_hs_hci_async_waiting = 0;
+
+    for (i = 0; i < num_cmds; i++) {
+        if (cmds[i].status != 0) {
+            return cmds[i].status;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Checks for asynchronous commands that the controller failed to acknowledge
+ * in time.  A timeout triggers a host reset.
+ *
+ * @return                      The number of ticks until this function should
+ *                                  be called again.
+ */
+int32_t
+ble_hs_hci_async_timer(void)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+    int32_t next_exp_in;
+    int32_t time_diff;
+    os_time_t now;
+    os_sr_t sr;
+    int timed_out;
+
+    next_exp_in = BLE_HS_FOREVER;
+    timed_out = 0;
+    now = os_time_get();
+
+    OS_ENTER_CRITICAL(sr);
+
+    STAILQ_FOREACH(cmd, &ble_hs_hci_async_cmds, next) {
+        if (cmd->state == BLE_HS_HCI_ASYNC_STATE_SENT) {
+            time_diff = cmd->exp_os_ticks - now;
+            if (time_diff <= 0) {
+                timed_out = 1;
+                break;
+            }
+
+            if (time_diff < next_exp_in) {
+                next_exp_in = time_diff;
+            }
+        }
+    }
+
+    OS_EXIT_CRITICAL(sr);
+
+    if (timed_out) {
+        STATS_INC(ble_hs_stats, hci_timeout);
+        ble_hs_sched_reset(BLE_HS_ETIMEOUT_HCI);
+        return BLE_HS_FOREVER;
+    }
+
+    return next_exp_in;
+}
+
+/**
+ * Aborts all queued and in-flight asynchronous commands with the specified
+ * status and restores the initial command credit.  Called when the host
+ * resets.
+ */
+void
+ble_hs_hci_async_flush(int status)
+{
+    struct ble_hs_hci_async_cmd *cmd;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    STAILQ_FOREACH(cmd, &ble_hs_hci_async_cmds, next) {
+        cmd->status = status;
+        cmd->state = BLE_HS_HCI_ASYNC_STATE_DONE;
+    }
+    ble_hs_hci_cmd_credits = 1;
+    OS_EXIT_CRITICAL(sr);
+
+    while ((cmd = ble_hs_hci_async_extract_done()) != NULL) {
+        if (cmd->cb != NULL) {
+            cmd->cb(cmd->opcode, cmd->status, NULL, 0, cmd->cb_arg);
+        }
+        ble_hs_hci_async_free(cmd);
+    }
+}
+
 int
 ble_hs_hci_rx_evt(uint8_t *hci_ev, void *arg)
 {
@@ -364,6 +1142,10 @@ ble_hs_hci_rx_evt(uint8_t *hci_ev, void *arg)
     case BLE_HCI_EVCODE_COMMAND_COMPLETE:
     case BLE_HCI_EVCODE_COMMAND_STATUS:
         if (hci_ev[3] == 0 && hci_ev[4] == 0) {
+            if (hci_ev[0] == BLE_HCI_EVCODE_COMMAND_COMPLETE) {
+                /* A NOP only updates the controller's command credit. */
+                ble_hs_hci_credits_set(hci_ev[2]);
+            }
             enqueue = 1;
         } else {
             ble_hs_hci_rx_ack(hci_ev);
@@ -394,12 +1176,73 @@ ble_hs_hci_max_acl_payload_sz(void)
 }
 
 /**
- * Allocates an mbuf to contain an outgoing ACL data fragment.
+ * Splits the first fragment off an outgoing ACL data packet without copying
+ * the packet's payload.  The fragment is made of the packet's leading mbufs;
+ * the remaining mbufs are moved behind a newly allocated packet header mbuf.
+ * Only if the fragment boundary falls inside an mbuf are the bytes past the
+ * boundary copied, so at most one mbuf's worth of data is copied per
+ * fragment.
+ *
+ * @param om                    The packet to split.  On return, this points
+ *                                  to the remainder of the packet, or NULL if
+ *                                  the entire packet fit in one fragment.
+ * @param max_frag_sz           The maximum size of a fragment.
+ *
+ * @return                      The fragment on success;
+ *                              NULL on mbuf exhaustion, in which case the
+ *                                  packet is left unmodified.
  */
 static struct os_mbuf *
-ble_hs_hci_frag_alloc(uint16_t frag_size, void *arg)
+ble_hs_hci_split_frag(struct os_mbuf **om, uint16_t max_frag_sz)
 {
-    return ble_hs_mbuf_acl_pkt();
+    struct os_mbuf *frag;
+    struct os_mbuf *next;
+    struct os_mbuf *cur;
+    struct os_mbuf *rem;
+    uint16_t off;
+    uint16_t split;
+    int rc;
+
+    frag = *om;
+    if (OS_MBUF_PKTLEN(frag) <= max_frag_sz) {
+        *om = NULL;
+        return frag;
+    }
+
+    /* The remainder needs leading space for its own ACL data header. */
+    rem = ble_hs_mbuf_acl_pkt();
+    if (rem == NULL) {
+        return NULL;
+    }
+
+    /* Find the mbuf containing the fragment boundary. */
+    off = 0;
+    cur = frag;
+    while (off + cur->om_len < max_frag_sz) {
+        off += cur->om_len;
+        cur = SLIST_NEXT(cur, om_next);
+    }
+
+    split = max_frag_sz - off;
+    if (split < cur->om_len) {
+        rc = os_mbuf_append(rem, cur->om_data + split, cur->om_len - split);
+        if (rc != 0) {
+            os_mbuf_free_chain(rem);
+            return NULL;
+        }
+        cur->om_len = split;
+    }
+
+    next = SLIST_NEXT(cur, om_next);
+    SLIST_NEXT(cur, om_next) = NULL;
+    if (next != NULL) {
+        os_mbuf_concat(rem, next);
+    }
+
+    OS_MBUF_PKTHDR(frag)->omp_len = max_frag_sz;
+    *om = rem;
+
+    return frag;
 }
 
 static struct os_mbuf *
@@ -459,8 +1302,11 @@ ble_hs_hci_acl_tx_now(struct ble_hs_conn *conn, struct os_mbuf **om)
 
     /* Send fragments until the entire packet has been sent. */
     while (txom != NULL && ble_hs_hci_avail_pkts > 0) {
-        frag = mem_split_frag(&txom, ble_hs_hci_max_acl_payload_sz(),
-                              ble_hs_hci_frag_alloc, NULL);
+        frag = ble_hs_hci_split_frag(&txom, ble_hs_hci_max_acl_payload_sz());
+        if (frag == NULL) {
+            rc = BLE_HS_ENOMEM;
+            goto err;
+        }
 
         frag = ble_hs_hci_acl_hdr_prepend(frag, conn->bhc_handle, pb);
         if (frag == NULL) {
@@ -569,4 +1415,26 @@ ble_hs_hci_init(void)
 
     rc = os_mutex_init(&ble_hs_hci_mutex);
     BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    rc = os_sem_init(&ble_hs_hci_credit_sem, 0);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    rc = os_sem_init(&ble_hs_hci_async_sem, 0);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    rc = os_mempool_init(&ble_hs_hci_async_cmd_pool,
+                         MYNEWT_VAL(BLE_HS_HCI_CMD_ASYNC_MAX),
+                         sizeof (struct ble_hs_hci_async_cmd),
+                         ble_hs_hci_async_cmd_mem,
+                         "ble_hs_hci_async_cmd_pool");
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    STAILQ_INIT(&ble_hs_hci_async_cmds);
+    ble_hs_hci_async_ev = (struct os_event) {
+        .ev_cb = ble_hs_hci_async_event,
+    };
+    ble_hs_hci_cmd_credits = 1;
+    ble_hs_hci_credit_waiting = 0;
+    ble_hs_hci_async_waiting = 0;
+    ble_hs_hci_async_kick_req = 0;
 }
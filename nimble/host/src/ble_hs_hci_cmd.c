@@ -1605,6 +1605,88 @@ ble_hs_hci_cmd_build_le_ext_adv_remove(uint8_t handle,
 
     return 0;
 }
+
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+int
+ble_hs_hci_cmd_build_le_periodic_adv_params(uint8_t handle, uint16_t itvl_min,
+                                            uint16_t itvl_max, uint16_t props,
+                                            uint8_t *cmd, int cmd_len)
+{
+    BLE_HS_DBG_ASSERT(cmd_len >= BLE_HCI_LE_SET_PER_ADV_PARAMS_LEN);
+
+    cmd[0] = handle;
+    put_le16(&cmd[1], itvl_min);
+    put_le16(&cmd[3], itvl_max);
+    put_le16(&cmd[5], props);
+
+    return 0;
+}
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_data(uint8_t handle, uint8_t operation,
+                                          struct os_mbuf *data,
+                                          uint8_t data_len,
+                                          uint8_t *cmd, int cmd_len)
+{
+    BLE_HS_DBG_ASSERT(cmd_len >= BLE_HCI_SET_PER_ADV_DATA_HDR_LEN + data_len);
+
+    cmd[0] = handle;
+    cmd[1] = operation;
+    cmd[2] = data_len;
+    os_mbuf_copydata(data, 0, data_len, cmd + 3);
+
+    return 0;
+}
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_enable(uint8_t enable, uint8_t handle,
+                                            uint8_t *cmd, int cmd_len)
+{
+    BLE_HS_DBG_ASSERT(cmd_len >= BLE_HCI_LE_SET_PER_ADV_ENABLE_LEN);
+
+    cmd[0] = enable;
+    cmd[1] = handle;
+
+    return 0;
+}
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_create_sync(uint8_t filter_policy,
+                                                 uint8_t adv_sid,
+                                                 const ble_addr_t *addr,
+                                                 uint16_t skip,
+                                                 uint16_t sync_timeout,
+                                                 uint8_t *cmd, int cmd_len)
+{
+    BLE_HS_DBG_ASSERT(cmd_len >= BLE_HCI_LE_PER_ADV_CREATE_SYNC_LEN);
+
+    cmd[0] = filter_policy;
+    cmd[1] = adv_sid;
+    if (addr != NULL) {
+        cmd[2] = addr->type;
+        memcpy(&cmd[3], addr->val, BLE_DEV_ADDR_LEN);
+    } else {
+        cmd[2] = 0;
+        memset(&cmd[3], 0, BLE_DEV_ADDR_LEN);
+    }
+    put_le16(&cmd[9], skip);
+    put_le16(&cmd[11], sync_timeout);
+    cmd[13] = 0;
+
+    return 0;
+}
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_terminate_sync(uint16_t sync_handle,
+                                                    uint8_t *cmd, int cmd_len)
+{
+    BLE_HS_DBG_ASSERT(cmd_len >= BLE_HCI_LE_PER_ADV_TERM_SYNC_LEN);
+
+    put_le16(cmd, sync_handle);
+
+    return 0;
+}
+#endif
 #endif
 
 static int
@@ -51,6 +51,9 @@ static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_phy_update_complete;
 static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_ext_adv_rpt;
 static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_rd_rem_used_feat_complete;
 static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_adv_set_terminated;
+static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_periodic_adv_sync_estab;
+static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_periodic_adv_rpt;
+static ble_hs_hci_evt_le_fn ble_hs_hci_evt_le_periodic_adv_sync_lost;
 
 /* Statistics */
 struct host_hci_stats
@@ -100,6 +103,11 @@ static const struct ble_hs_hci_evt_le_dispatch_entry
     { BLE_HCI_LE_SUBEV_PHY_UPDATE_COMPLETE,
         ble_hs_hci_evt_le_phy_update_complete },
     { BLE_HCI_LE_SUBEV_EXT_ADV_RPT, ble_hs_hci_evt_le_ext_adv_rpt },
+    { BLE_HCI_LE_SUBEV_PER_ADV_SYNC_ESTAB,
+            ble_hs_hci_evt_le_periodic_adv_sync_estab },
+    { BLE_HCI_LE_SUBEV_PER_ADV_RPT, ble_hs_hci_evt_le_periodic_adv_rpt },
+    { BLE_HCI_LE_SUBEV_PER_ADV_SYNC_LOST,
+            ble_hs_hci_evt_le_periodic_adv_sync_lost },
     { BLE_HCI_LE_SUBEV_RD_REM_USED_FEAT,
             ble_hs_hci_evt_le_rd_rem_used_feat_complete },
     { BLE_HCI_LE_SUBEV_ADV_SET_TERMINATED,
@@ -581,8 +589,10 @@ ble_hs_hci_evt_le_ext_adv_rpt(uint8_t subevent, uint8_t *data, int len)
                 continue;
             }
             desc.legacy_event_type = legacy_event_type;
+            desc.data_status = BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE;
         } else {
-            desc.data_status = params->evt_type >> 8;
+            desc.data_status = (params->evt_type &
+                                BLE_HCI_ADV_DATA_STATUS_MASK) >> 5;
         }
         desc.addr.type = params->addr_type;
         memcpy(desc.addr.val, params->addr, 6);
@@ -628,6 +638,82 @@ ble_hs_hci_evt_le_adv_set_terminated(uint8_t subevent, uint8_t *data, int len)
     return 0;
 }
 
+static int
+ble_hs_hci_evt_le_periodic_adv_sync_estab(uint8_t subevent, uint8_t *data,
+                                          int len)
+{
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    struct hci_le_periodic_adv_sync_estab evt;
+
+    if (len < BLE_HCI_LE_SUBEV_PER_ADV_SYNC_ESTAB_LEN) {
+        return BLE_HS_ECONTROLLER;
+    }
+
+    evt.subevent_code = data[0];
+    evt.status = data[1];
+    evt.sync_handle = get_le16(data + 2);
+    evt.sid = data[4];
+    evt.adv_addr_type = data[5];
+    memcpy(evt.adv_addr, data + 6, BLE_DEV_ADDR_LEN);
+    evt.adv_phy = data[12];
+    evt.per_adv_itvl = get_le16(data + 13);
+    evt.adv_clk_accuracy = data[15];
+
+    ble_gap_rx_periodic_adv_sync_estab(&evt);
+#endif
+
+    return 0;
+}
+
+static int
+ble_hs_hci_evt_le_periodic_adv_rpt(uint8_t subevent, uint8_t *data, int len)
+{
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    struct hci_le_periodic_adv_rpt evt;
+
+    if (len < BLE_HCI_LE_SUBEV_PER_ADV_RPT_LEN) {
+        return BLE_HS_ECONTROLLER;
+    }
+
+    evt.subevent_code = data[0];
+    evt.sync_handle = get_le16(data + 1);
+    evt.tx_power = data[3];
+    evt.rssi = data[4];
+    /* data[5] is unused */
+    evt.data_status = data[6];
+    evt.data_len = data[7];
+    evt.data = data + BLE_HCI_LE_SUBEV_PER_ADV_RPT_LEN;
+
+    if (len < BLE_HCI_LE_SUBEV_PER_ADV_RPT_LEN + evt.data_len) {
+        return BLE_HS_ECONTROLLER;
+    }
+
+    ble_gap_rx_periodic_adv_rpt(&evt);
+#endif
+
+    return 0;
+}
+
+static int
+ble_hs_hci_evt_le_periodic_adv_sync_lost(uint8_t subevent, uint8_t *data,
+                                         int len)
+{
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+    struct hci_le_periodic_adv_sync_lost evt;
+
+    if (len < BLE_HCI_LE_SUBEV_PER_ADV_SYNC_LOST_LEN) {
+        return BLE_HS_ECONTROLLER;
+    }
+
+    evt.subevent_code = data[0];
+    evt.sync_handle = get_le16(data + 1);
+
+    ble_gap_rx_periodic_adv_sync_lost(&evt);
+#endif
+
+    return 0;
+}
+
 static int
 ble_hs_hci_evt_le_conn_upd_complete(uint8_t subevent, uint8_t *data, int len)
 {
@@ -75,6 +75,43 @@ int ble_hs_hci_cmd_tx(uint16_t opcode, void *cmd, uint8_t cmd_len,
                       void *evt_buf, uint8_t evt_buf_len,
                       uint8_t *out_evt_buf_len);
 int ble_hs_hci_cmd_tx_empty_ack(uint16_t opcode, void *cmd, uint8_t cmd_len);
+
+/**
+ * Callback for commands sent with ble_hs_hci_cmd_tx_async().
+ *
+ * @param opcode                The opcode of the completed command.
+ * @param status                0 on success; a BLE_HS_E<...> error otherwise
+ *                                  (NOT a naked HCI code).
+ * @param params                The command's return parameters, excluding
+ *                                  the status byte.  NULL if the command
+ *                                  was aborted.
+ * @param params_len            The length of the return parameters.
+ * @param arg                   The argument passed at submission time.
+ */
+typedef void ble_hs_hci_cmd_cb_fn(uint16_t opcode, int status,
+                                  const uint8_t *params, uint8_t params_len,
+                                  void *arg);
+
+int ble_hs_hci_cmd_tx_async(uint16_t opcode, const void *cmd, uint8_t cmd_len,
+                            ble_hs_hci_cmd_cb_fn *cb, void *cb_arg);
+
+/** One entry of a batch sent with ble_hs_hci_cmd_tx_batch(). */
+struct ble_hs_hci_batch_cmd {
+    /*** Filled in by the caller. */
+    uint16_t opcode;
+    const void *cmd;
+    uint8_t cmd_len;
+    void *rsp;
+    uint8_t rsp_len;        /* Size of rsp; return params length on exit. */
+
+    /*** Filled in on completion. */
+    int status;             /* A BLE_HS_E<...> error; NOT a naked HCI code. */
+    uint8_t done;
+};
+
+int ble_hs_hci_cmd_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds);
+int32_t ble_hs_hci_async_timer(void);
+void ble_hs_hci_async_flush(int status);
 void ble_hs_hci_rx_ack(uint8_t *ack_ev);
 void ble_hs_hci_init(void);
 
@@ -235,6 +272,35 @@ ble_hs_hci_cmd_build_le_ext_adv_params(uint8_t handle,
 int
 ble_hs_hci_cmd_build_le_ext_adv_remove(uint8_t handle,
                                        uint8_t *cmd, int cmd_len);
+
+#if MYNEWT_VAL(BLE_PERIODIC_ADV)
+int
+ble_hs_hci_cmd_build_le_periodic_adv_params(uint8_t handle, uint16_t itvl_min,
+                                            uint16_t itvl_max, uint16_t props,
+                                            uint8_t *cmd, int cmd_len);
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_data(uint8_t handle, uint8_t operation,
+                                          struct os_mbuf *data,
+                                          uint8_t data_len,
+                                          uint8_t *cmd, int cmd_len);
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_enable(uint8_t enable, uint8_t handle,
+                                            uint8_t *cmd, int cmd_len);
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_create_sync(uint8_t filter_policy,
+                                                 uint8_t adv_sid,
+                                                 const ble_addr_t *addr,
+                                                 uint16_t skip,
+                                                 uint16_t sync_timeout,
+                                                 uint8_t *cmd, int cmd_len);
+
+int
+ble_hs_hci_cmd_build_le_periodic_adv_terminate_sync(uint16_t sync_handle,
+                                                    uint8_t *cmd, int cmd_len);
+#endif
 #endif
 
 int ble_hs_hci_cmd_build_le_enh_recv_test(uint8_t rx_chan, uint8_t phy,
@@ -39,8 +39,10 @@
 #include "ble_l2cap_coc_priv.h"
 #include "ble_sm_priv.h"
 #include "ble_hs_adv_priv.h"
+#include "ble_hs_aes_cache_priv.h"
 #include "ble_hs_flow_priv.h"
 #include "ble_hs_pvcy_priv.h"
+#include "ble_hs_resolv_priv.h"
 #include "ble_hs_id_priv.h"
 #include "ble_uuid_priv.h"
 #include "host/ble_hs.h"
@@ -86,6 +88,14 @@ STATS_SECT_START(ble_hs_stats)
     STATS_SECT_ENTRY(sync)
     STATS_SECT_ENTRY(pvcy_add_entry)
     STATS_SECT_ENTRY(pvcy_add_entry_fail)
+    STATS_SECT_ENTRY(rx_wakeups)
+    STATS_SECT_ENTRY(rx_pkts)
+    STATS_SECT_ENTRY(rx_batch_max)
+    STATS_SECT_ENTRY(rx_ring_full)
+    STATS_SECT_ENTRY(adv_dedup_drop)
+    STATS_SECT_ENTRY(adv_dedup_evict)
+    STATS_SECT_ENTRY(rpa_cache_hit)
+    STATS_SECT_ENTRY(rpa_cache_miss)
 STATS_SECT_END
 extern STATS_SECT_DECL(ble_hs_stats) ble_hs_stats;
 
@@ -114,15 +124,33 @@ void ble_hs_misc_conn_chan_find_reqd(uint16_t conn_handle, uint16_t cid,
                                      struct ble_hs_conn **out_conn,
                                      struct ble_l2cap_chan **out_chan);
 uint8_t ble_hs_misc_addr_type_to_id(uint8_t addr_type);
-int ble_hs_misc_restore_irks(void);
 
 int ble_hs_locked_by_cur_task(void);
 int ble_hs_is_parent_task(void);
-void ble_hs_lock_nested(void);
+int ble_hs_sync(void);
+
+/* When lock statistics are enabled, each acquisition is attributed to the
+ * function that performs it.
+ */
+#if MYNEWT_VAL(BLE_HS_LOCK_STATS)
+#define BLE_HS_LOCK_SITE        __func__
+#else
+#define BLE_HS_LOCK_SITE        NULL
+#endif
+
+#define ble_hs_lock_nested()    ble_hs_lock_nested_at(BLE_HS_LOCK_SITE)
+#define ble_hs_lock()           ble_hs_lock_at(BLE_HS_LOCK_SITE)
+
+void ble_hs_mutex_pend(struct os_mutex *mutex, const char *site);
+void ble_hs_lock_nested_at(const char *site);
 void ble_hs_unlock_nested(void);
-void ble_hs_lock(void);
+void ble_hs_lock_at(const char *site);
 void ble_hs_unlock(void);
 void ble_hs_hw_error(uint8_t hw_code);
+int ble_store_init(void);
+int ble_store_iterate_cccd(const struct ble_store_key_cccd *key,
+                           ble_store_iterator_fn *callback,
+                           void *cookie);
 void ble_hs_timer_resched(void);
 void ble_hs_notifications_sched(void);
 struct os_eventq *ble_hs_evq_get(void);
@@ -31,6 +31,45 @@ const uint8_t ble_hs_pvcy_default_irk[16] = {
     0xbf, 0x5b, 0xdd, 0x34, 0xc0, 0x53, 0x1e, 0xb8,
 };
 
+/* One entry per bond, plus the local entry with the all-zero address. */
+#define BLE_HS_PVCY_MAX_ENTRIES     (MYNEWT_VAL(BLE_STORE_MAX_BONDS) + 1)
+
+/* Number of resolving list operations sent to the controller as a single
+ * batch of HCI commands.
+ */
+#define BLE_HS_PVCY_BATCH_OPS       4
+
+#define BLE_HS_PVCY_OP_ADD          0
+#define BLE_HS_PVCY_OP_REMOVE       1
+#define BLE_HS_PVCY_OP_CLEAR        2
+
+struct ble_hs_pvcy_entry {
+    ble_addr_t addr;
+    uint8_t irk[16];
+};
+
+struct ble_hs_pvcy_op {
+    uint8_t type;
+    struct ble_hs_pvcy_entry entry;
+};
+
+/**
+ * The host's copy of the controller's resolving list.  It lets list updates
+ * be limited to the entries that actually changed.  The copy is emptied
+ * whenever the controller is reset.  Protected by the host lock; the lock is
+ * released while commands are sent to the controller.
+ */
+static struct ble_hs_pvcy_entry ble_hs_pvcy_entries[BLE_HS_PVCY_MAX_ENTRIES];
+static int ble_hs_pvcy_num_entries;
+
+/* Whether address resolution is known to be enabled in the controller. */
+static uint8_t ble_hs_pvcy_resolve_enabled;
+
+/* Scratch space for ble_hs_pvcy_sync(); only used by the host parent task. */
+static struct ble_hs_pvcy_entry ble_hs_pvcy_sync_want[BLE_HS_PVCY_MAX_ENTRIES];
+static int ble_hs_pvcy_sync_num_want;
+static struct ble_hs_pvcy_op ble_hs_pvcy_sync_ops[2 * BLE_HS_PVCY_MAX_ENTRIES];
+
 static int
 ble_hs_pvcy_set_addr_timeout(uint16_t timeout)
 {
@@ -66,113 +105,443 @@ ble_hs_pvcy_set_resolve_enabled(int enable)
         return rc;
     }
 
+    ble_hs_pvcy_resolve_enabled = enable;
+
     return 0;
 }
 
-int
-ble_hs_pvcy_remove_entry(uint8_t addr_type, const uint8_t *addr)
+static int
+ble_hs_pvcy_entry_find(const ble_addr_t *addr)
 {
-    uint8_t buf[BLE_HCI_RMV_FROM_RESOLV_LIST_LEN];
-    int rc;
+    int i;
 
-    rc = ble_hs_hci_cmd_build_remove_from_resolv_list(addr_type, addr,
-                                                      buf, sizeof(buf));
-    if (rc != 0) {
-        return rc;
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    for (i = 0; i < ble_hs_pvcy_num_entries; i++) {
+        if (ble_addr_cmp(&ble_hs_pvcy_entries[i].addr, addr) == 0) {
+            return i;
+        }
     }
 
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_RMV_RESOLV_LIST),
-                           buf, sizeof(buf), NULL, 0, NULL);
-    if (rc != 0) {
-        return rc;
+    return -1;
+}
+
+static int
+ble_hs_pvcy_entry_matches(const struct ble_hs_pvcy_entry *entry)
+{
+    int idx;
+
+    idx = ble_hs_pvcy_entry_find(&entry->addr);
+    return idx != -1 &&
+           memcmp(ble_hs_pvcy_entries[idx].irk, entry->irk, 16) == 0;
+}
+
+static void
+ble_hs_pvcy_entry_remove(const ble_addr_t *addr)
+{
+    int idx;
+
+    idx = ble_hs_pvcy_entry_find(addr);
+    if (idx == -1) {
+        return;
     }
 
-    return 0;
+    ble_hs_pvcy_num_entries--;
+    ble_hs_pvcy_entries[idx] = ble_hs_pvcy_entries[ble_hs_pvcy_num_entries];
 }
 
+static void
+ble_hs_pvcy_entry_add(const struct ble_hs_pvcy_entry *entry)
+{
+    ble_hs_pvcy_entry_remove(&entry->addr);
+
+    BLE_HS_DBG_ASSERT(ble_hs_pvcy_num_entries < BLE_HS_PVCY_MAX_ENTRIES);
+    ble_hs_pvcy_entries[ble_hs_pvcy_num_entries++] = *entry;
+}
+
+/**
+ * Sends a batch of HCI commands.  The host parent task pipelines the
+ * commands; other tasks fall back to sending them one at a time.  Either way,
+ * the controller executes them in order.
+ */
 static int
-ble_hs_pvcy_clear_entries(void)
+ble_hs_pvcy_tx_batch(struct ble_hs_hci_batch_cmd *cmds, int num_cmds)
 {
-    int rc;
+    int status;
+    int i;
 
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_CLR_RESOLV_LIST),
-                           NULL, 0, NULL, 0, NULL);
-    if (rc != 0) {
-        return rc;
+    if (ble_hs_is_parent_task()) {
+        return ble_hs_hci_cmd_tx_batch(cmds, num_cmds);
     }
 
-    return 0;
+    status = 0;
+    for (i = 0; i < num_cmds; i++) {
+        cmds[i].status = ble_hs_hci_cmd_tx(cmds[i].opcode,
+                                           (void *)cmds[i].cmd,
+                                           cmds[i].cmd_len,
+                                           NULL, 0, NULL);
+        cmds[i].rsp_len = 0;
+        cmds[i].done = 1;
+
+        if (status == 0) {
+            status = cmds[i].status;
+        }
+    }
+
+    return status;
 }
 
+/**
+ * Executes a sequence of resolving list operations and updates the host's
+ * copy of the list to match the outcome.  Operations are sent in batches so
+ * the controller round trip is paid once per batch rather than once per
+ * command.  Each added entry is also switched to device privacy mode.
+ *
+ * @return                      0 if every operation succeeded;
+ *                              The status of the first failed command
+ *                                  otherwise.
+ */
 static int
-ble_hs_pvcy_add_entry_hci(const uint8_t *addr, uint8_t addr_type,
-                          const uint8_t *irk)
+ble_hs_pvcy_apply(const struct ble_hs_pvcy_op *ops, int num_ops)
 {
     struct hci_add_dev_to_resolving_list add;
-    uint8_t buf[BLE_HCI_ADD_TO_RESOLV_LIST_LEN];
-    ble_addr_t peer_addr;
+    struct ble_hs_hci_batch_cmd cmds[2 * BLE_HS_PVCY_BATCH_OPS];
+    uint8_t bufs[2 * BLE_HS_PVCY_BATCH_OPS][BLE_HCI_ADD_TO_RESOLV_LIST_LEN];
+    const struct ble_hs_pvcy_op *op;
+    int num_cmds;
+    int status;
+    int first;
     int rc;
+    int i;
+    int j;
 
-    add.addr_type = addr_type;
-    memcpy(add.addr, addr, 6);
-    memcpy(add.local_irk, ble_hs_pvcy_irk, 16);
-    memcpy(add.peer_irk, irk, 16);
-
-    rc = ble_hs_hci_cmd_build_add_to_resolv_list(&add, buf, sizeof(buf));
-    if (rc != 0) {
-        return rc;
+    if (num_ops == 0 && ble_hs_pvcy_resolve_enabled) {
+        return 0;
     }
 
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_ADD_RESOLV_LIST),
-                           buf, sizeof(buf), NULL, 0, NULL);
-    if (rc != 0) {
-        return rc;
+    /* No GAP procedures can be active when the resolving list is modified
+     * (Vol 2, Part E, 7.8.38).  Stop all GAP procedures and temporarily
+     * prevent any new ones from being started.  With GAP halted, address
+     * resolution can stay enabled throughout.
+     */
+    ble_gap_preempt();
+
+    status = 0;
+
+    if (!ble_hs_pvcy_resolve_enabled) {
+        status = ble_hs_pvcy_set_resolve_enabled(1);
     }
 
+    for (first = 0; status == 0 && first < num_ops;
+         first += BLE_HS_PVCY_BATCH_OPS) {
+
+        num_cmds = 0;
+        for (i = first; i < num_ops && i < first + BLE_HS_PVCY_BATCH_OPS; i++) {
+            op = ops + i;
+
+            switch (op->type) {
+            case BLE_HS_PVCY_OP_ADD:
+                STATS_INC(ble_hs_stats, pvcy_add_entry);
+
+                add.addr_type = op->entry.addr.type;
+                memcpy(add.addr, op->entry.addr.val, 6);
+                memcpy(add.local_irk, ble_hs_pvcy_irk, 16);
+                memcpy(add.peer_irk, op->entry.irk, 16);
+                ble_hs_hci_cmd_build_add_to_resolv_list(
+                    &add, bufs[num_cmds], sizeof bufs[num_cmds]);
+                cmds[num_cmds].opcode =
+                    BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_ADD_RESOLV_LIST);
+                cmds[num_cmds].cmd_len = BLE_HCI_ADD_TO_RESOLV_LIST_LEN;
+                cmds[num_cmds].cmd = bufs[num_cmds];
+                cmds[num_cmds].rsp = NULL;
+                cmds[num_cmds].rsp_len = 0;
+                num_cmds++;
+
+                /* FIXME Controller is BT5.0 and default privacy mode is
+                 * network which can cause problems for apps which are not
+                 * aware of it. We need to sort it out somehow. For now we set
+                 * device mode for all of the peer devices and application
+                 * should change it to network if needed
+                 */
+                ble_hs_hci_cmd_build_le_set_priv_mode(
+                    op->entry.addr.val, op->entry.addr.type,
+                    BLE_GAP_PRIVATE_MODE_DEVICE,
+                    bufs[num_cmds], sizeof bufs[num_cmds]);
+                cmds[num_cmds].opcode =
+                    BLE_HCI_OP(BLE_HCI_OGF_LE,
+                               BLE_HCI_OCF_LE_SET_PRIVACY_MODE);
+                cmds[num_cmds].cmd_len = BLE_HCI_LE_SET_PRIVACY_MODE_LEN;
+                break;
+
+            case BLE_HS_PVCY_OP_REMOVE:
+                ble_hs_hci_cmd_build_remove_from_resolv_list(
+                    op->entry.addr.type, op->entry.addr.val,
+                    bufs[num_cmds], sizeof bufs[num_cmds]);
+                cmds[num_cmds].opcode =
+                    BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RMV_RESOLV_LIST);
+                cmds[num_cmds].cmd_len = BLE_HCI_RMV_FROM_RESOLV_LIST_LEN;
+                break;
+
+            case BLE_HS_PVCY_OP_CLEAR:
+                cmds[num_cmds].opcode =
+                    BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CLR_RESOLV_LIST);
+                cmds[num_cmds].cmd_len = 0;
+                break;
+
+            default:
+                BLE_HS_DBG_ASSERT(0);
+                break;
+            }
+
+            cmds[num_cmds].cmd = bufs[num_cmds];
+            cmds[num_cmds].rsp = NULL;
+            cmds[num_cmds].rsp_len = 0;
+            num_cmds++;
+        }
 
-    /* FIXME Controller is BT5.0 and default privacy mode is network which
-     * can cause problems for apps which are not aware of it. We need to
-     * sort it out somehow. For now we set device mode for all of the peer
-     * devices and application should change it to network if needed
-     */
-    peer_addr.type = addr_type;
-    memcpy(peer_addr.val, addr, sizeof peer_addr.val);
-    rc = ble_hs_pvcy_set_mode(&peer_addr, BLE_GAP_PRIVATE_MODE_DEVICE);
-    if (rc != 0) {
-        return rc;
+        rc = ble_hs_pvcy_tx_batch(cmds, num_cmds);
+
+        /* Record the outcome of each operation in the host's copy of the
+         * list.
+         */
+        ble_hs_lock();
+
+        j = 0;
+        for (i = first; i < num_ops && i < first + BLE_HS_PVCY_BATCH_OPS; i++) {
+            op = ops + i;
+
+            switch (op->type) {
+            case BLE_HS_PVCY_OP_ADD:
+                if (cmds[j].done && cmds[j].status == 0) {
+                    ble_hs_pvcy_entry_add(&op->entry);
+                }
+                if (!cmds[j].done || cmds[j].status != 0 ||
+                    !cmds[j + 1].done || cmds[j + 1].status != 0) {
+
+                    STATS_INC(ble_hs_stats, pvcy_add_entry_fail);
+                }
+                j += 2;
+                break;
+
+            case BLE_HS_PVCY_OP_REMOVE:
+                if (cmds[j].done && cmds[j].status == 0) {
+                    ble_hs_pvcy_entry_remove(&op->entry.addr);
+                }
+                j++;
+                break;
+
+            case BLE_HS_PVCY_OP_CLEAR:
+                if (cmds[j].done && cmds[j].status == 0) {
+                    ble_hs_pvcy_num_entries = 0;
+                }
+                j++;
+                break;
+            }
+        }
+
+        ble_hs_unlock();
+
+        status = rc;
     }
 
-    return 0;
+    /* Allow GAP procedures to be started again. */
+    ble_gap_preempt_done();
+
+    return status;
+}
+
+/**
+ * Forgets the state of the controller's resolving list.  Called after the
+ * controller is reset, which empties the list and disables address
+ * resolution.
+ */
+void
+ble_hs_pvcy_reset(void)
+{
+    ble_hs_lock();
+    ble_hs_pvcy_num_entries = 0;
+    ble_hs_unlock();
+
+    ble_hs_pvcy_resolve_enabled = 0;
+}
+
+int
+ble_hs_pvcy_remove_entry(uint8_t addr_type, const uint8_t *addr)
+{
+    struct ble_hs_pvcy_op op;
+
+    op.type = BLE_HS_PVCY_OP_REMOVE;
+    op.entry.addr.type = addr_type;
+    memcpy(op.entry.addr.val, addr, 6);
+
+    return ble_hs_pvcy_apply(&op, 1);
 }
 
 int
 ble_hs_pvcy_add_entry(const uint8_t *addr, uint8_t addr_type,
                       const uint8_t *irk)
 {
-    int rc;
+    struct ble_hs_pvcy_op ops[2];
+    int num_ops;
+
+    ops[1].type = BLE_HS_PVCY_OP_ADD;
+    ops[1].entry.addr.type = addr_type;
+    memcpy(ops[1].entry.addr.val, addr, 6);
+    memcpy(ops[1].entry.irk, irk, 16);
+
+    ble_hs_lock();
+
+    if (ble_hs_pvcy_entry_matches(&ops[1].entry)) {
+        /* Nothing to do if the controller already has this exact entry. */
+        num_ops = 0;
+    } else if (ble_hs_pvcy_entry_find(&ops[1].entry.addr) != -1) {
+        /* The peer's IRK changed; the stale entry must go first. */
+        ops[0].type = BLE_HS_PVCY_OP_REMOVE;
+        ops[0].entry = ops[1].entry;
+        num_ops = 2;
+    } else if (ble_hs_pvcy_num_entries >= BLE_HS_PVCY_MAX_ENTRIES) {
+        num_ops = -1;
+    } else {
+        num_ops = 1;
+    }
 
-    STATS_INC(ble_hs_stats, pvcy_add_entry);
+    ble_hs_unlock();
 
-    /* No GAP procedures can be active when adding an entry to the resolving
-     * list (Vol 2, Part E, 7.8.38).  Stop all GAP procedures and temporarily
-     * prevent any new ones from being started.
+    switch (num_ops) {
+    case -1:
+        STATS_INC(ble_hs_stats, pvcy_add_entry_fail);
+        return BLE_HS_ENOMEM;
+
+    case 0:
+        return 0;
+
+    default:
+        return ble_hs_pvcy_apply(ops + 2 - num_ops, num_ops);
+    }
+}
+
+static void
+ble_hs_pvcy_local_entry(struct ble_hs_pvcy_entry *entry)
+{
+    /*
+     * Local IRK entry with 00:00:00:00:00:00 address. This entry will be used
+     * to generate RPA for non-directed advertising if own_addr_type is set to
+     * rpa_pub since we use all-zero address as peer addres in such case. Peer
+     * IRK should be left all-zero since this is not for an actual peer.
      */
-    ble_gap_preempt();
+    memset(entry, 0, sizeof *entry);
+}
 
-    /* Try to add the entry now that GAP is halted. */
-    rc = ble_hs_pvcy_add_entry_hci(addr, addr_type, irk);
+static int
+ble_hs_pvcy_sync_collect(int obj_type, union ble_store_value *val,
+                         void *cookie)
+{
+    const struct ble_store_value_sec *sec;
+    struct ble_hs_pvcy_entry *entry;
 
-    /* Allow GAP procedures to be started again. */
-    ble_gap_preempt_done();
+    BLE_HS_DBG_ASSERT(obj_type == BLE_STORE_OBJ_TYPE_PEER_SEC);
+
+    sec = &val->sec;
+    if (!sec->irk_present || !ble_addr_cmp(&sec->peer_addr, BLE_ADDR_ANY)) {
+        return 0;
+    }
+
+    if (ble_hs_pvcy_sync_num_want >= BLE_HS_PVCY_MAX_ENTRIES) {
+        BLE_HS_LOG(ERROR, "too many IRKs in store for resolving list\n");
+        return 1;
+    }
+
+    entry = ble_hs_pvcy_sync_want + ble_hs_pvcy_sync_num_want++;
+    entry->addr = sec->peer_addr;
+    memcpy(entry->irk, sec->irk, 16);
+
+    return 0;
+}
+
+static int
+ble_hs_pvcy_sync_is_wanted(const struct ble_hs_pvcy_entry *entry)
+{
+    int i;
+
+    for (i = 0; i < ble_hs_pvcy_sync_num_want; i++) {
+        if (ble_addr_cmp(&ble_hs_pvcy_sync_want[i].addr, &entry->addr) == 0 &&
+            memcmp(ble_hs_pvcy_sync_want[i].irk, entry->irk, 16) == 0) {
+
+            return 1;
+        }
+    }
 
+    return 0;
+}
+
+/**
+ * Brings the controller's resolving list in line with the IRKs in the host
+ * store.  Only the difference between the two is sent to the controller.  If
+ * removing stale entries one by one would take more commands than clearing
+ * the list and re-adding the entries to keep, the list is cleared instead.
+ *
+ * Must be called from the host parent task.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+ble_hs_pvcy_sync(void)
+{
+    struct ble_hs_pvcy_op *op;
+    int num_remove;
+    int num_keep;
+    int num_ops;
+    int clear;
+    int rc;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_is_parent_task());
+
+    ble_hs_pvcy_sync_num_want = 1;
+    ble_hs_pvcy_local_entry(ble_hs_pvcy_sync_want + 0);
+
+    rc = ble_store_iterate(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                           ble_hs_pvcy_sync_collect, NULL);
     if (rc != 0) {
-        STATS_INC(ble_hs_stats, pvcy_add_entry_fail);
+        return rc;
+    }
+
+    ble_hs_lock();
+
+    num_keep = 0;
+    for (i = 0; i < ble_hs_pvcy_num_entries; i++) {
+        num_keep += ble_hs_pvcy_sync_is_wanted(ble_hs_pvcy_entries + i);
     }
+    num_remove = ble_hs_pvcy_num_entries - num_keep;
+
+    /* A kept entry costs two commands to re-add. */
+    clear = num_remove > 1 + 2 * num_keep;
 
-    return rc;
+    num_ops = 0;
+    if (clear) {
+        op = ble_hs_pvcy_sync_ops + num_ops++;
+        op->type = BLE_HS_PVCY_OP_CLEAR;
+    } else {
+        for (i = 0; i < ble_hs_pvcy_num_entries; i++) {
+            if (!ble_hs_pvcy_sync_is_wanted(ble_hs_pvcy_entries + i)) {
+                op = ble_hs_pvcy_sync_ops + num_ops++;
+                op->type = BLE_HS_PVCY_OP_REMOVE;
+                op->entry = ble_hs_pvcy_entries[i];
+            }
+        }
+    }
+
+    for (i = 0; i < ble_hs_pvcy_sync_num_want; i++) {
+        if (clear || !ble_hs_pvcy_entry_matches(ble_hs_pvcy_sync_want + i)) {
+            op = ble_hs_pvcy_sync_ops + num_ops++;
+            op->type = BLE_HS_PVCY_OP_ADD;
+            op->entry = ble_hs_pvcy_sync_want[i];
+        }
+    }
+
+    ble_hs_unlock();
+
+    return ble_hs_pvcy_apply(ble_hs_pvcy_sync_ops, num_ops);
 }
 
 int
@@ -198,9 +567,9 @@ ble_hs_pvcy_ensure_started(void)
 int
 ble_hs_pvcy_set_our_irk(const uint8_t *irk)
 {
-    uint8_t tmp_addr[6];
+    struct ble_hs_pvcy_op ops[2];
     uint8_t new_irk[16];
-    int rc;
+    int num_ops;
 
     if (irk != NULL) {
         memcpy(new_irk, irk, 16);
@@ -208,41 +577,30 @@ ble_hs_pvcy_set_our_irk(const uint8_t *irk)
         memcpy(new_irk, ble_hs_pvcy_default_irk, 16);
     }
 
-    /* Clear the resolving list if this is a new IRK. */
-    if (memcmp(ble_hs_pvcy_irk, new_irk, 16) != 0) {
-        memcpy(ble_hs_pvcy_irk, new_irk, 16);
+    num_ops = 0;
 
-        rc = ble_hs_pvcy_set_resolve_enabled(0);
-        if (rc != 0) {
-            return rc;
-        }
+    ble_hs_lock();
 
-        rc = ble_hs_pvcy_clear_entries();
-        if (rc != 0) {
-            return rc;
-        }
+    /* Clear the resolving list if this is a new IRK; every entry in it was
+     * added with the old one.
+     */
+    if (memcmp(ble_hs_pvcy_irk, new_irk, 16) != 0) {
+        memcpy(ble_hs_pvcy_irk, new_irk, 16);
 
-        rc = ble_hs_pvcy_set_resolve_enabled(1);
-        if (rc != 0) {
-            return rc;
+        if (ble_hs_pvcy_num_entries > 0) {
+            ops[num_ops++].type = BLE_HS_PVCY_OP_CLEAR;
         }
+    }
 
-        /*
-         * Add local IRK entry with 00:00:00:00:00:00 address. This entry will
-         * be used to generate RPA for non-directed advertising if own_addr_type
-         * is set to rpa_pub since we use all-zero address as peer addres in
-         * such case. Peer IRK should be left all-zero since this is not for an
-         * actual peer.
-         */
-        memset(tmp_addr, 0, 6);
-        memset(new_irk, 0, 16);
-        rc = ble_hs_pvcy_add_entry(tmp_addr, 0, new_irk);
-        if (rc != 0) {
-            return rc;
-        }
+    ops[num_ops].type = BLE_HS_PVCY_OP_ADD;
+    ble_hs_pvcy_local_entry(&ops[num_ops].entry);
+    if (num_ops > 0 || !ble_hs_pvcy_entry_matches(&ops[num_ops].entry)) {
+        num_ops++;
     }
 
-    return 0;
+    ble_hs_unlock();
+
+    return ble_hs_pvcy_apply(ops, num_ops);
 }
 
 int
@@ -34,6 +34,8 @@ int ble_hs_pvcy_remove_entry(uint8_t addr_type, const uint8_t *addr);
 int ble_hs_pvcy_add_entry(const uint8_t *addr, uint8_t addrtype,
                           const uint8_t *irk);
 int ble_hs_pvcy_ensure_started(void);
+int ble_hs_pvcy_sync(void);
+void ble_hs_pvcy_reset(void);
 int ble_hs_pvcy_set_mode(const ble_addr_t *addr, uint8_t priv_mode);
 
 #ifdef __cplusplus
@@ -0,0 +1,500 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Host-side resolution of peer resolvable private addresses.
+ *
+ * Resolving an RPA in the host costs one AES-128 operation per bonded IRK.
+ * The key schedule of each bonded IRK is expanded once, when the IRKs are
+ * loaded from the store, rather than passed through the shared AES cache,
+ * which is much smaller than the number of bonds and would be thrashed by
+ * every lookup.
+ * A scanner sees the same few RPAs many times a second, so results are
+ * cached: each entry maps an RPA to the identity address it resolved to, or
+ * records that no bonded IRK resolves it.  The whole cache is discarded
+ * whenever the set of bonded IRKs changes.  Entries also expire after
+ * BLE_HS_RPA_CACHE_TIMEOUT seconds, by which time the peer should have moved
+ * on to a new RPA.
+ */
+
+#include <string.h>
+#include "os/os.h"
+#include "host/ble_hs_id.h"
+#include "ble_hs_priv.h"
+
+#if NIMBLE_BLE_SM
+
+#include "tinycrypt/aes.h"
+#include "tinycrypt/constants.h"
+
+#define BLE_HS_RESOLV_MAX_IRKS      MYNEWT_VAL(BLE_STORE_MAX_BONDS)
+#define BLE_HS_RESOLV_CACHE_SIZE    MYNEWT_VAL(BLE_HS_RPA_CACHE_SIZE)
+
+/** A bonded peer's identity address and the expanded schedule of its IRK. */
+struct ble_hs_resolv_irk {
+    ble_addr_t id_addr;
+    struct tc_aes_key_sched_struct sched;
+};
+
+static struct ble_hs_resolv_irk ble_hs_resolv_irks[BLE_HS_RESOLV_MAX_IRKS];
+static int ble_hs_resolv_num_irks;
+static uint8_t ble_hs_resolv_irks_loaded;
+
+/**
+ * Incremented whenever the IRK table is invalidated or reloaded.  Results
+ * computed against an older generation are discarded rather than cached.
+ */
+static uint32_t ble_hs_resolv_gen;
+
+#if BLE_HS_RESOLV_CACHE_SIZE > 0
+
+struct ble_hs_resolv_entry {
+    SLIST_ENTRY(ble_hs_resolv_entry) bucket_next;
+    TAILQ_ENTRY(ble_hs_resolv_entry) lru_next;
+    uint8_t rpa[6];
+
+    /** 1 if id_addr is valid; 0 if no bonded IRK resolves the RPA. */
+    uint8_t resolved;
+    ble_addr_t id_addr;
+
+    os_time_t added_at;
+};
+
+SLIST_HEAD(ble_hs_resolv_bucket, ble_hs_resolv_entry);
+TAILQ_HEAD(ble_hs_resolv_lru, ble_hs_resolv_entry);
+
+static os_membuf_t ble_hs_resolv_entry_mem[
+    OS_MEMPOOL_SIZE(BLE_HS_RESOLV_CACHE_SIZE,
+                    sizeof (struct ble_hs_resolv_entry))];
+static struct os_mempool ble_hs_resolv_entry_pool;
+
+static struct ble_hs_resolv_bucket
+    ble_hs_resolv_buckets[BLE_HS_RESOLV_CACHE_SIZE];
+
+/** Most recently used at the head; evicted from the tail. */
+static struct ble_hs_resolv_lru ble_hs_resolv_lru;
+
+static uint32_t ble_hs_resolv_timeout_ticks;
+
+static struct ble_hs_resolv_bucket *
+ble_hs_resolv_bucket(const uint8_t *rpa)
+{
+    uint32_t hash;
+
+    /* The hash part of an RPA is an AES output, so it is already uniform. */
+    hash = rpa[0] | (rpa[1] << 8) | ((uint32_t)rpa[2] << 16);
+
+    return ble_hs_resolv_buckets + hash % BLE_HS_RESOLV_CACHE_SIZE;
+}
+
+static void
+ble_hs_resolv_cache_remove(struct ble_hs_resolv_entry *entry)
+{
+    SLIST_REMOVE(ble_hs_resolv_bucket(entry->rpa), entry,
+                 ble_hs_resolv_entry, bucket_next);
+    TAILQ_REMOVE(&ble_hs_resolv_lru, entry, lru_next);
+}
+
+static void
+ble_hs_resolv_cache_flush(void)
+{
+    struct ble_hs_resolv_entry *entry;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    while ((entry = TAILQ_FIRST(&ble_hs_resolv_lru)) != NULL) {
+        TAILQ_REMOVE(&ble_hs_resolv_lru, entry, lru_next);
+        os_memblock_put(&ble_hs_resolv_entry_pool, entry);
+    }
+
+    for (i = 0; i < BLE_HS_RESOLV_CACHE_SIZE; i++) {
+        SLIST_INIT(ble_hs_resolv_buckets + i);
+    }
+}
+
+/**
+ * Looks up a cached result for the specified RPA.  Expired entries are freed
+ * and treated as absent.  Must be called with the host lock held.
+ */
+static struct ble_hs_resolv_entry *
+ble_hs_resolv_cache_find(const uint8_t *rpa)
+{
+    struct ble_hs_resolv_entry *entry;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    SLIST_FOREACH(entry, ble_hs_resolv_bucket(rpa), bucket_next) {
+        if (memcmp(entry->rpa, rpa, sizeof entry->rpa) == 0) {
+            break;
+        }
+    }
+
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    if (ble_hs_resolv_timeout_ticks != 0 &&
+        (int32_t)(os_time_get() - entry->added_at) >=
+        (int32_t)ble_hs_resolv_timeout_ticks) {
+
+        ble_hs_resolv_cache_remove(entry);
+        os_memblock_put(&ble_hs_resolv_entry_pool, entry);
+        return NULL;
+    }
+
+    TAILQ_REMOVE(&ble_hs_resolv_lru, entry, lru_next);
+    TAILQ_INSERT_HEAD(&ble_hs_resolv_lru, entry, lru_next);
+
+    return entry;
+}
+
+static void
+ble_hs_resolv_cache_insert(const uint8_t *rpa, int resolved,
+                           const ble_addr_t *id_addr)
+{
+    struct ble_hs_resolv_entry *entry;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    /* Another task may have resolved the same RPA in the meantime. */
+    SLIST_FOREACH(entry, ble_hs_resolv_bucket(rpa), bucket_next) {
+        if (memcmp(entry->rpa, rpa, sizeof entry->rpa) == 0) {
+            return;
+        }
+    }
+
+    entry = os_memblock_get(&ble_hs_resolv_entry_pool);
+    if (entry == NULL) {
+        /* Cache full; reuse the least recently used entry. */
+        entry = TAILQ_LAST(&ble_hs_resolv_lru, ble_hs_resolv_lru);
+        BLE_HS_DBG_ASSERT(entry != NULL);
+        ble_hs_resolv_cache_remove(entry);
+    }
+
+    memcpy(entry->rpa, rpa, sizeof entry->rpa);
+    entry->resolved = resolved;
+    if (resolved) {
+        entry->id_addr = *id_addr;
+    } else {
+        memset(&entry->id_addr, 0, sizeof entry->id_addr);
+    }
+    entry->added_at = os_time_get();
+
+    SLIST_INSERT_HEAD(ble_hs_resolv_bucket(rpa), entry, bucket_next);
+    TAILQ_INSERT_HEAD(&ble_hs_resolv_lru, entry, lru_next);
+}
+
+#endif
+
+/**
+ * Builds the AES input of the ah() function for an RPA: 13 bytes of zero
+ * padding followed by the RPA's prand, most significant byte first.  The
+ * block depends only on the RPA, so it is built once and encrypted with
+ * each candidate IRK in turn.
+ */
+static void
+ble_hs_resolv_prand_block(const uint8_t *rpa, uint8_t *block)
+{
+    memset(block, 0, 13);
+    block[13] = rpa[5];
+    block[14] = rpa[4];
+    block[15] = rpa[3];
+}
+
+static int
+ble_hs_resolv_hash_matches(const uint8_t *rpa, const uint8_t *enc)
+{
+    /* The hash is the least significant 24 bits of the AES output. */
+    return enc[15] == rpa[0] && enc[14] == rpa[1] && enc[13] == rpa[2];
+}
+
+static int
+ble_hs_resolv_load_one(int obj_type, union ble_store_value *val,
+                       void *cookie)
+{
+    struct ble_hs_resolv_irk *irk;
+    struct tc_aes_key_sched_struct sched;
+    uint8_t irk_be[16];
+    uint32_t gen;
+    int rc;
+
+    if (!val->sec.irk_present ||
+        ble_addr_cmp(&val->sec.peer_addr, BLE_ADDR_ANY) == 0) {
+
+        return 0;
+    }
+
+    gen = *(uint32_t *)cookie;
+
+    /* Expand the key outside the lock; tinycrypt wants it big endian. */
+    swap_buf(irk_be, val->sec.irk, sizeof irk_be);
+    rc = tc_aes128_set_encrypt_key(&sched, irk_be);
+    memset(irk_be, 0, sizeof irk_be);
+    if (rc == TC_CRYPTO_FAIL) {
+        return 0;
+    }
+
+    ble_hs_lock();
+
+    if (ble_hs_resolv_gen != gen) {
+        /* Invalidated or reloaded by another task; stop. */
+        ble_hs_unlock();
+        memset(&sched, 0, sizeof sched);
+        return 1;
+    }
+
+    if (ble_hs_resolv_num_irks < BLE_HS_RESOLV_MAX_IRKS) {
+        irk = ble_hs_resolv_irks + ble_hs_resolv_num_irks;
+        irk->id_addr = val->sec.peer_addr;
+        irk->sched = sched;
+        ble_hs_resolv_num_irks++;
+    }
+
+    ble_hs_unlock();
+
+    memset(&sched, 0, sizeof sched);
+
+    return 0;
+}
+
+/**
+ * Ensures the table of bonded IRKs is populated, reading it from the store
+ * if necessary.
+ *
+ * @param out_gen               On success, the generation of the table is
+ *                                  written here.
+ *
+ * @return                      0 on success; nonzero on store failure.
+ */
+static int
+ble_hs_resolv_load(uint32_t *out_gen)
+{
+    uint32_t gen;
+    int rc;
+
+    ble_hs_lock();
+
+    if (ble_hs_resolv_irks_loaded) {
+        *out_gen = ble_hs_resolv_gen;
+        ble_hs_unlock();
+        return 0;
+    }
+
+    gen = ++ble_hs_resolv_gen;
+    ble_hs_resolv_num_irks = 0;
+
+    ble_hs_unlock();
+
+    rc = ble_store_iterate(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                           ble_hs_resolv_load_one, &gen);
+
+    ble_hs_lock();
+    if (rc == 0 && ble_hs_resolv_gen == gen) {
+        ble_hs_resolv_irks_loaded = 1;
+    }
+    ble_hs_unlock();
+
+    *out_gen = gen;
+    return rc;
+}
+
+/**
+ * Discards the bonded IRKs and all cached results.  Called whenever a peer
+ * security record is written or deleted.  Must not be called with the host
+ * lock held.
+ */
+void
+ble_hs_resolv_invalidate(void)
+{
+    ble_hs_lock();
+
+    ble_hs_resolv_gen++;
+    ble_hs_resolv_irks_loaded = 0;
+    ble_hs_resolv_num_irks = 0;
+    memset(ble_hs_resolv_irks, 0, sizeof ble_hs_resolv_irks);
+
+#if BLE_HS_RESOLV_CACHE_SIZE > 0
+    ble_hs_resolv_cache_flush();
+#endif
+
+    ble_hs_unlock();
+}
+
+/**
+ * Resolves a peer's resolvable private address against the IRKs of all
+ * bonded peers.  Results, including failures to resolve, are cached (see
+ * BLE_HS_RPA_CACHE_SIZE), so repeatedly resolving the same RPA is cheap.
+ * This does not depend on the controller's resolving list, so it works
+ * when the list is full or when address resolution is disabled.
+ *
+ * This function reads the store; it must not be called with the host lock
+ * held.
+ *
+ * @param addr                  The address to resolve.
+ * @param out_id_addr           On success, the identity address of the
+ *                                  bonded peer that owns the RPA is written
+ *                                  here.  Pass NULL if you only need to
+ *                                  know whether the RPA resolves.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EINVAL if the address is not an RPA;
+ *                              BLE_HS_ENOENT if no bonded IRK resolves it;
+ *                              Other nonzero on error.
+ */
+int
+ble_hs_id_resolve_rpa(const ble_addr_t *addr, ble_addr_t *out_id_addr)
+{
+#if BLE_HS_RESOLV_CACHE_SIZE > 0
+    struct ble_hs_resolv_entry *entry;
+#endif
+    struct ble_hs_resolv_irk irk;
+    ble_addr_t id_addr;
+    uint8_t block[16];
+    uint8_t enc[16];
+    uint32_t gen;
+    int resolved;
+    int rc;
+    int i;
+
+    if (!BLE_ADDR_IS_RPA(addr)) {
+        return BLE_HS_EINVAL;
+    }
+
+#if BLE_HS_RESOLV_CACHE_SIZE > 0
+    ble_hs_lock();
+    entry = ble_hs_resolv_cache_find(addr->val);
+    if (entry != NULL) {
+        resolved = entry->resolved;
+        id_addr = entry->id_addr;
+        ble_hs_unlock();
+
+        STATS_INC(ble_hs_stats, rpa_cache_hit);
+        goto done;
+    }
+    ble_hs_unlock();
+
+    STATS_INC(ble_hs_stats, rpa_cache_miss);
+#endif
+
+    rc = ble_hs_resolv_load(&gen);
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_hs_resolv_prand_block(addr->val, block);
+    resolved = 0;
+
+    /* The host lock is released while encrypting; if the IRK table changes
+     * underneath us, stop and leave the result uncached.
+     */
+    for (i = 0; ; i++) {
+        ble_hs_lock();
+        if (ble_hs_resolv_gen != gen || i >= ble_hs_resolv_num_irks) {
+            ble_hs_unlock();
+            break;
+        }
+        irk = ble_hs_resolv_irks[i];
+        ble_hs_unlock();
+
+        if (tc_aes_encrypt(enc, block, &irk.sched) == TC_CRYPTO_FAIL) {
+            memset(&irk, 0, sizeof irk);
+            return BLE_HS_EUNKNOWN;
+        }
+
+        if (ble_hs_resolv_hash_matches(addr->val, enc)) {
+            resolved = 1;
+            id_addr = irk.id_addr;
+            break;
+        }
+    }
+
+    memset(&irk, 0, sizeof irk);
+
+#if BLE_HS_RESOLV_CACHE_SIZE > 0
+    ble_hs_lock();
+    if (ble_hs_resolv_gen == gen) {
+        ble_hs_resolv_cache_insert(addr->val, resolved, &id_addr);
+    }
+    ble_hs_unlock();
+
+done:
+#endif
+    if (!resolved) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (out_id_addr != NULL) {
+        *out_id_addr = id_addr;
+    }
+
+    return 0;
+}
+
+int
+ble_hs_resolv_init(void)
+{
+#if BLE_HS_RESOLV_CACHE_SIZE > 0
+    int rc;
+
+    rc = os_mempool_init(&ble_hs_resolv_entry_pool,
+                         BLE_HS_RESOLV_CACHE_SIZE,
+                         sizeof (struct ble_hs_resolv_entry),
+                         ble_hs_resolv_entry_mem, "ble_hs_resolv");
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    rc = os_time_ms_to_ticks(MYNEWT_VAL(BLE_HS_RPA_CACHE_TIMEOUT) * 1000,
+                             &ble_hs_resolv_timeout_ticks);
+    if (rc != 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    TAILQ_INIT(&ble_hs_resolv_lru);
+    memset(ble_hs_resolv_buckets, 0, sizeof ble_hs_resolv_buckets);
+#endif
+
+    ble_hs_resolv_gen = 0;
+    ble_hs_resolv_irks_loaded = 0;
+    ble_hs_resolv_num_irks = 0;
+
+    return 0;
+}
+
+#else
+
+int
+ble_hs_id_resolve_rpa(const ble_addr_t *addr, ble_addr_t *out_id_addr)
+{
+    return BLE_HS_ENOTSUP;
+}
+
+void
+ble_hs_resolv_invalidate(void)
+{
+}
+
+int
+ble_hs_resolv_init(void)
+{
+    return 0;
+}
+
+#endif
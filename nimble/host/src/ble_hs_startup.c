@@ -23,113 +23,122 @@
 #include "host/ble_hs_hci.h"
 #include "ble_hs_priv.h"
 
-#if !MYNEWT_VAL(BLE_DEVICE)
-static int
-ble_hs_startup_read_sup_f_tx(void)
+/**
+ * What the host reads from the controller on every startup.  A controller
+ * whose firmware is updated, or which is swapped for another, may keep its
+ * version and address but change its features or supported commands, so all
+ * of these identify the controller.
+ */
+struct ble_hs_startup_ctlr_id {
+    uint8_t local_ver[BLE_HCI_RD_LOC_VER_INFO_RSPLEN];
+    uint8_t bd_addr[BLE_HCI_IP_RD_BD_ADDR_ACK_PARAM_LEN];
+    uint8_t le_feat[BLE_HCI_RD_LE_LOC_SUPP_FEAT_RSPLEN];
+    uint8_t sup_cmds[BLE_HCI_RD_LOC_SUPP_CMD_RSPLEN];
+};
+
+/**
+ * Controller information that an HCI reset cannot change.  It is retained
+ * across host resets so that resynchronizing with the same controller skips
+ * the corresponding reads.
+ */
+struct ble_hs_startup_ctlr_info {
+    uint8_t valid;
+    struct ble_hs_startup_ctlr_id id;
+    uint16_t acl_pktlen;
+    uint16_t acl_max_pkts;
+};
+
+static struct ble_hs_startup_ctlr_info ble_hs_startup_ctlr_info;
+
+/** Maximum number of commands in a single startup batch. */
+#define BLE_HS_STARTUP_MAX_BATCH        5
+
+static void
+ble_hs_startup_batch_add(struct ble_hs_hci_batch_cmd *cmds, int *num_cmds,
+                         uint16_t opcode, const void *cmd, uint8_t cmd_len,
+                         void *rsp, uint8_t rsp_len)
 {
-    uint8_t ack_params[BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN];
-    uint8_t ack_params_len;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
-                                      BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT),
-                           NULL,0, ack_params, sizeof ack_params,
-                           &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
+    struct ble_hs_hci_batch_cmd *entry;
 
-    if (ack_params_len != BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN) {
-        return BLE_HS_ECONTROLLER;
-    }
+    BLE_HS_DBG_ASSERT(*num_cmds < BLE_HS_STARTUP_MAX_BATCH);
 
-    /* for now we don't use it outside of init sequence so check this here
-     * LE Supported (Controller) byte 4, bit 6
-     */
-    if (!(ack_params[4] & 0x60)) {
-        BLE_HS_LOG(ERROR, "Controller doesn't support LE\n");
-        return BLE_HS_ECONTROLLER;
-    }
+    entry = cmds + *num_cmds;
+    memset(entry, 0, sizeof *entry);
+    entry->opcode = opcode;
+    entry->cmd = cmd;
+    entry->cmd_len = cmd_len;
+    entry->rsp = rsp;
+    entry->rsp_len = rsp_len;
 
-    return 0;
+    (*num_cmds)++;
 }
-#endif
 
+/**
+ * Reads the identity of the controller: its version information, public
+ * address, LE features and supported commands.  All four reads are sent in
+ * a single batch.
+ */
 static int
-ble_hs_startup_read_local_ver_tx(void)
+ble_hs_startup_read_identity(struct ble_hs_startup_ctlr_id *out_id)
 {
-    uint8_t ack_params[BLE_HCI_RD_LOC_VER_INFO_RSPLEN];
-    uint8_t ack_params_len;
-    uint8_t hci_version;
+    struct ble_hs_hci_batch_cmd cmds[4];
+    int num_cmds;
     int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
-                                      BLE_HCI_OCF_IP_RD_LOCAL_VER),
-                           NULL,0, ack_params, sizeof ack_params,
-                           &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
-
-    if (ack_params_len != BLE_HCI_RD_LOC_VER_INFO_RSPLEN) {
-        return BLE_HS_ECONTROLLER;
+    int i;
+
+    memset(out_id, 0, sizeof *out_id);
+
+    num_cmds = 0;
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
+                                        BLE_HCI_OCF_IP_RD_LOCAL_VER),
+                             NULL, 0, out_id->local_ver,
+                             sizeof out_id->local_ver);
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
+                                        BLE_HCI_OCF_IP_RD_BD_ADDR),
+                             NULL, 0, out_id->bd_addr,
+                             sizeof out_id->bd_addr);
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                        BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT),
+                             NULL, 0, out_id->le_feat,
+                             sizeof out_id->le_feat);
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
+                                        BLE_HCI_OCF_IP_RD_LOC_SUPP_CMD),
+                             NULL, 0, out_id->sup_cmds,
+                             sizeof out_id->sup_cmds);
+
+    rc = ble_hs_hci_cmd_tx_batch(cmds, num_cmds);
+
+    /* Reading the supported commands is informational only; don't fail the
+     * startup if an older controller rejects it.
+     */
+    if (cmds[3].status != 0 ||
+        cmds[3].rsp_len != BLE_HCI_RD_LOC_SUPP_CMD_RSPLEN) {
+
+        memset(out_id->sup_cmds, 0, sizeof out_id->sup_cmds);
+        cmds[3].status = 0;
+        rc = 0;
+        for (i = 0; i < num_cmds; i++) {
+            if (cmds[i].status != 0) {
+                rc = cmds[i].status;
+                break;
+            }
+        }
     }
-
-    /* For now we are interested only in HCI Version */
-    hci_version = ack_params[0];
-    ble_hs_hci_set_hci_version(hci_version);
-
-    return 0;
-}
-
-static int
-ble_hs_startup_le_read_sup_f_tx(void)
-{
-    uint8_t ack_params[BLE_HCI_RD_LE_LOC_SUPP_FEAT_RSPLEN];
-    uint8_t ack_params_len;
-    uint32_t feat;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT),
-                           NULL,0, ack_params, sizeof ack_params,
-                           &ack_params_len);
     if (rc != 0) {
         return rc;
     }
 
-    if (ack_params_len != BLE_HCI_RD_LE_LOC_SUPP_FEAT_RSPLEN) {
-        return BLE_HS_ECONTROLLER;
-    }
-
-    /* For now 32-bits of features is enough */
-    feat = get_le32(ack_params);
-    ble_hs_hci_set_le_supported_feat(feat);
-
-    return 0;
-}
-
-static int
-ble_hs_startup_le_read_buf_sz_tx(uint16_t *out_pktlen, uint8_t *out_max_pkts)
-{
-    uint8_t ack_params[BLE_HCI_RD_BUF_SIZE_RSPLEN];
-    uint8_t ack_params_len;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                      BLE_HCI_OCF_LE_RD_BUF_SIZE), NULL, 0,
-                           ack_params, sizeof ack_params, &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
+    if (cmds[0].rsp_len != BLE_HCI_RD_LOC_VER_INFO_RSPLEN ||
+        cmds[1].rsp_len != BLE_HCI_IP_RD_BD_ADDR_ACK_PARAM_LEN ||
+        cmds[2].rsp_len != BLE_HCI_RD_LE_LOC_SUPP_FEAT_RSPLEN) {
 
-    if (ack_params_len != BLE_HCI_RD_BUF_SIZE_RSPLEN) {
         return BLE_HS_ECONTROLLER;
     }
 
-    *out_pktlen = get_le16(ack_params + 0);
-    *out_max_pkts = ack_params[2];
-
     return 0;
 }
 
@@ -157,68 +166,11 @@ ble_hs_startup_read_buf_sz_tx(uint16_t *out_pktlen, uint16_t *out_max_pkts)
     return 0;
 }
 
-static int
-ble_hs_startup_read_buf_sz(void)
-{
-    uint16_t le_pktlen = 0;
-    uint16_t max_pkts = 0;
-    uint16_t pktlen = 0;
-    uint8_t le_max_pkts = 0;
-    int rc;
-
-    rc = ble_hs_startup_le_read_buf_sz_tx(&le_pktlen, &le_max_pkts);
-    if (rc != 0) {
-        return rc;
-    }
-
-    if (le_pktlen != 0) {
-        pktlen = le_pktlen;
-        max_pkts = le_max_pkts;
-    } else {
-        rc = ble_hs_startup_read_buf_sz_tx(&pktlen, &max_pkts);
-        if (rc != 0) {
-            return rc;
-        }
-    }
-
-    rc = ble_hs_hci_set_buf_sz(pktlen, max_pkts);
-    if (rc != 0) {
-        return rc;
-    }
-
-    return 0;
-}
-
-static int
-ble_hs_startup_read_bd_addr(void)
-{
-    uint8_t ack_params[BLE_HCI_IP_RD_BD_ADDR_ACK_PARAM_LEN];
-    uint8_t ack_params_len;
-    int rc;
-
-    rc = ble_hs_hci_cmd_tx(BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
-                                      BLE_HCI_OCF_IP_RD_BD_ADDR),
-                           NULL, 0, ack_params, sizeof ack_params,
-                           &ack_params_len);
-    if (rc != 0) {
-        return rc;
-    }
-
-    if (ack_params_len != sizeof ack_params) {
-        return BLE_HS_ECONTROLLER;
-    }
-
-    ble_hs_id_set_pub(ack_params);
-    return 0;
-}
-
-static int
-ble_hs_startup_le_set_evmask_tx(void)
+static void
+ble_hs_startup_le_build_evmask(uint8_t *buf)
 {
-    uint8_t buf[BLE_HCI_SET_LE_EVENT_MASK_LEN];
     uint8_t version;
     uint64_t mask;
-    int rc;
 
     version = ble_hs_hci_get_hci_version();
 
@@ -264,23 +216,13 @@ ble_hs_startup_le_set_evmask_tx(void)
         mask |= 0x00000000000f1800;
     }
 
-    ble_hs_hci_cmd_build_le_set_event_mask(mask, buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx_empty_ack(BLE_HCI_OP(BLE_HCI_OGF_LE,
-                                                BLE_HCI_OCF_LE_SET_EVENT_MASK),
-                                     buf, sizeof(buf));
-    if (rc != 0) {
-        return rc;
-    }
-
-    return 0;
+    ble_hs_hci_cmd_build_le_set_event_mask(mask, buf,
+                                           BLE_HCI_SET_LE_EVENT_MASK_LEN);
 }
 
-static int
-ble_hs_startup_set_evmask_tx(void)
+static void
+ble_hs_startup_build_evmask(uint8_t *buf, uint8_t *buf2)
 {
-    uint8_t buf[BLE_HCI_SET_EVENT_MASK_LEN];
-    int rc;
-
     /**
      * Enable the following events:
      *     0x0000000000000010 Disconnection Complete Event
@@ -290,22 +232,25 @@ ble_hs_startup_set_evmask_tx(void)
      *     0x0000800000000000 Encryption Key Refresh Complete Event
      *     0x2000000000000000 LE Meta-Event
      */
-    ble_hs_hci_cmd_build_set_event_mask(0x2000800002008090, buf, sizeof buf);
-    rc = ble_hs_hci_cmd_tx_empty_ack(BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
-                                                BLE_HCI_OCF_CB_SET_EVENT_MASK),
-                                     buf, sizeof(buf));
-    if (rc != 0) {
-        return rc;
-    }
+    ble_hs_hci_cmd_build_set_event_mask(0x2000800002008090, buf,
+                                        BLE_HCI_SET_EVENT_MASK_LEN);
 
     /**
      * Enable the following events:
      *     0x0000000000800000 Authenticated Payload Timeout Event
      */
-    ble_hs_hci_cmd_build_set_event_mask2(0x0000000000800000, buf, sizeof buf);
+    ble_hs_hci_cmd_build_set_event_mask2(0x0000000000800000, buf2,
+                                         BLE_HCI_SET_EVENT_MASK_LEN);
+}
+
+static int
+ble_hs_startup_reset_tx(void)
+{
+    int rc;
+
     rc = ble_hs_hci_cmd_tx_empty_ack(BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
-                                                BLE_HCI_OCF_CB_SET_EVENT_MASK2),
-                                     buf, sizeof(buf));
+                                                BLE_HCI_OCF_CB_RESET),
+                                     NULL, 0);
     if (rc != 0) {
         return rc;
     }
@@ -313,37 +258,163 @@ ble_hs_startup_set_evmask_tx(void)
     return 0;
 }
 
+/**
+ * Configures the controller and, unless the controller is the one the host
+ * last synchronized with, reads its capabilities.  Commands that do not
+ * depend on each other are sent in a single batch.
+ */
 static int
-ble_hs_startup_reset_tx(void)
+ble_hs_startup_configure(int cached)
 {
+    struct ble_hs_hci_batch_cmd cmds[BLE_HS_STARTUP_MAX_BATCH];
+    struct ble_hs_startup_ctlr_info *info;
+    uint8_t le_evmask[BLE_HCI_SET_LE_EVENT_MASK_LEN];
+    uint8_t evmask2[BLE_HCI_SET_EVENT_MASK_LEN];
+    uint8_t evmask[BLE_HCI_SET_EVENT_MASK_LEN];
+    uint8_t sup_feat[BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN];
+    uint8_t le_buf_sz[BLE_HCI_RD_BUF_SIZE_RSPLEN];
+    int sup_feat_idx;
+    int le_buf_idx;
+    int num_cmds;
     int rc;
 
-    rc = ble_hs_hci_cmd_tx_empty_ack(BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
-                                                BLE_HCI_OCF_CB_RESET),
-                                     NULL, 0);
+    info = &ble_hs_startup_ctlr_info;
+
+    ble_hs_startup_build_evmask(evmask, evmask2);
+    ble_hs_startup_le_build_evmask(le_evmask);
+
+    num_cmds = 0;
+    sup_feat_idx = -1;
+    le_buf_idx = -1;
+
+    if (!cached) {
+#if !MYNEWT_VAL(BLE_DEVICE)
+        /* We need to check this only if using external controller. */
+        sup_feat_idx = num_cmds;
+        ble_hs_startup_batch_add(cmds, &num_cmds,
+                                 BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS,
+                                            BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT),
+                                 NULL, 0, sup_feat, sizeof sup_feat);
+#endif
+
+        le_buf_idx = num_cmds;
+        ble_hs_startup_batch_add(cmds, &num_cmds,
+                                 BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                            BLE_HCI_OCF_LE_RD_BUF_SIZE),
+                                 NULL, 0, le_buf_sz, sizeof le_buf_sz);
+    }
+
+    /* The event masks are cleared by a reset, so they are always sent. */
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
+                                        BLE_HCI_OCF_CB_SET_EVENT_MASK),
+                             evmask, sizeof evmask, NULL, 0);
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND,
+                                        BLE_HCI_OCF_CB_SET_EVENT_MASK2),
+                             evmask2, sizeof evmask2, NULL, 0);
+    ble_hs_startup_batch_add(cmds, &num_cmds,
+                             BLE_HCI_OP(BLE_HCI_OGF_LE,
+                                        BLE_HCI_OCF_LE_SET_EVENT_MASK),
+                             le_evmask, sizeof le_evmask, NULL, 0);
+
+    rc = ble_hs_hci_cmd_tx_batch(cmds, num_cmds);
     if (rc != 0) {
         return rc;
     }
 
+    if (cached) {
+        return 0;
+    }
+
+    if (sup_feat_idx >= 0) {
+        if (cmds[sup_feat_idx].rsp_len != BLE_HCI_RD_LOC_SUPP_FEAT_RSPLEN) {
+            return BLE_HS_ECONTROLLER;
+        }
+
+        /* for now we don't use it outside of init sequence so check this here
+         * LE Supported (Controller) byte 4, bit 6
+         */
+        if (!(sup_feat[4] & 0x60)) {
+            BLE_HS_LOG(ERROR, "Controller doesn't support LE\n");
+            return BLE_HS_ECONTROLLER;
+        }
+    }
+
+    if (cmds[le_buf_idx].rsp_len != BLE_HCI_RD_BUF_SIZE_RSPLEN) {
+        return BLE_HS_ECONTROLLER;
+    }
+
+    info->acl_pktlen = get_le16(le_buf_sz + 0);
+    info->acl_max_pkts = le_buf_sz[2];
+    if (info->acl_pktlen == 0) {
+        /* The controller shares its ACL buffers with BR/EDR. */
+        rc = ble_hs_startup_read_buf_sz_tx(&info->acl_pktlen,
+                                           &info->acl_max_pkts);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
     return 0;
 }
 
+/**
+ * Forgets the cached controller capabilities.  The next startup reads them
+ * again, even if the controller's identity has not changed.
+ */
+void
+ble_hs_startup_clear_ctlr_info(void)
+{
+    memset(&ble_hs_startup_ctlr_info, 0, sizeof ble_hs_startup_ctlr_info);
+}
+
+/**
+ * Retrieves the controller's supported commands bitmask, as reported by the
+ * HCI Read Local Supported Commands command.
+ *
+ * @param octet                 The octet of the bitmask to check.
+ * @param bit                   The bit within the octet.
+ *
+ * @return                      1 if the command is supported; 0 otherwise.
+ */
+int
+ble_hs_startup_cmd_supported(uint8_t octet, uint8_t bit)
+{
+    if (octet >= BLE_HCI_RD_LOC_SUPP_CMD_RSPLEN) {
+        return 0;
+    }
+
+    return !!(ble_hs_startup_ctlr_info.id.sup_cmds[octet] & (1 << bit));
+}
+
 int
 ble_hs_startup_go(void)
 {
+    struct ble_hs_startup_ctlr_info *info;
+    struct ble_hs_startup_ctlr_id id;
+    os_time_t start;
+    int cached;
     int rc;
 
+    info = &ble_hs_startup_ctlr_info;
+    start = os_time_get();
+
     rc = ble_hs_startup_reset_tx();
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_hs_startup_read_local_ver_tx();
+    /* The reset emptied the controller's resolving list. */
+    ble_hs_pvcy_reset();
+
+    rc = ble_hs_startup_read_identity(&id);
     if (rc != 0) {
         return rc;
     }
 
-    /* XXX: Read local supported commands. */
+    /* For now we are interested only in HCI Version */
+    ble_hs_hci_set_hci_version(id.local_ver[0]);
 
     /* we need to check this only if using external controller */
 #if !MYNEWT_VAL(BLE_DEVICE)
@@ -351,42 +422,40 @@ ble_hs_startup_go(void)
         BLE_HS_LOG(ERROR, "Required controller version is 4.0 (6)\n");
         return BLE_HS_ECONTROLLER;
     }
-
-    rc = ble_hs_startup_read_sup_f_tx();
-    if (rc != 0) {
-        return rc;
-    }
 #endif
 
-    rc = ble_hs_startup_set_evmask_tx();
-    if (rc != 0) {
-        return rc;
+    /* If this is the same controller as last time, its capabilities are
+     * already known.
+     */
+    cached = info->valid && memcmp(&info->id, &id, sizeof id) == 0;
+    if (!cached) {
+        info->valid = 0;
+        info->id = id;
     }
 
-    rc = ble_hs_startup_le_set_evmask_tx();
+    rc = ble_hs_startup_configure(cached);
     if (rc != 0) {
         return rc;
     }
+    info->valid = 1;
 
-    rc = ble_hs_startup_read_buf_sz();
-    if (rc != 0) {
-        return rc;
-    }
+    /* For now 32-bits of features is enough */
+    ble_hs_hci_set_le_supported_feat(get_le32(id.le_feat));
 
-    rc = ble_hs_startup_le_read_sup_f_tx();
+    rc = ble_hs_hci_set_buf_sz(info->acl_pktlen, info->acl_max_pkts);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_hs_startup_read_bd_addr();
-    if (rc != 0) {
-        return rc;
-    }
+    ble_hs_id_set_pub(id.bd_addr);
 
     ble_hs_pvcy_set_our_irk(NULL);
 
     /* If flow control is enabled, configure the controller to use it. */
     ble_hs_flow_startup();
 
+    BLE_HS_LOG(INFO, "controller configured in %d ticks; cached=%d\n",
+               (int)(os_time_get() - start), cached);
+
     return 0;
 }
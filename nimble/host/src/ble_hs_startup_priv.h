@@ -25,6 +25,8 @@ extern "C" {
 #endif
 
 int ble_hs_startup_go(void);
+void ble_hs_startup_clear_ctlr_info(void);
+int ble_hs_startup_cmd_supported(uint8_t octet, uint8_t bit);
 
 #ifdef __cplusplus
 }
@@ -396,9 +396,9 @@ ble_sm_proc_free(struct ble_sm_proc *proc)
 
     if (proc != NULL) {
         ble_sm_dbg_assert_not_inserted(proc);
-#if MYNEWT_VAL(BLE_HS_DEBUG)
-        memset(proc, 0xff, sizeof *proc);
-#endif
+
+        /* Scrub the key material before the entry is reused. */
+        memset(proc, 0, sizeof *proc);
         rc = os_memblock_put(&ble_sm_proc_pool, proc);
         BLE_HS_DBG_ASSERT_EVAL(rc == 0);
     }
@@ -553,6 +553,15 @@ ble_sm_persist_keys(struct ble_sm_proc *proc)
         peer_addr.type = ble_hs_misc_addr_type_to_id(conn->bhc_peer_addr.type);
     }
 
+#if MYNEWT_VAL(BLE_GATT_SIGNED_WRITE)
+    /* The new bond starts a new SignCounter sequence. */
+    conn->bhc_sign_counter = 0;
+    conn->bhc_sign_counter_limit = 0;
+#endif
+#if MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+    conn->bhc_peer_sign_counter = 0;
+#endif
+
     ble_hs_unlock();
 
     if (identity_ev) {
@@ -633,6 +642,29 @@ ble_sm_proc_find(uint16_t conn_handle, uint8_t state, int is_initiator,
     return proc;
 }
 
+/**
+ * Searches the main proc list for the first entry that has all of the
+ * specified flags set.  Lock restrictions: Caller must hold ble_hs_lock.
+ *
+ * @return                      The matching proc entry on success;
+ *                                  null on failure.
+ */
+struct ble_sm_proc *
+ble_sm_proc_find_flags(ble_sm_proc_flags flags)
+{
+    struct ble_sm_proc *proc;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    STAILQ_FOREACH(proc, &ble_sm_procs, next) {
+        if ((proc->flags & flags) == flags) {
+            break;
+        }
+    }
+
+    return proc;
+}
+
 static void
 ble_sm_insert(struct ble_sm_proc *proc)
 {
@@ -2372,6 +2404,364 @@ ble_sm_fail_rx(uint16_t conn_handle, struct os_mbuf **om,
     }
 }
 
+/*****************************************************************************
+ * $signing                                                                  *
+ *****************************************************************************/
+
+#if MYNEWT_VAL(BLE_GATT_SIGNED_WRITE) && \
+    MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE) < 1
+#error "BLE_SM_SIGN_COUNTER_RESERVE must be at least 1"
+#endif
+
+#if MYNEWT_VAL(BLE_GATT_SIGNED_WRITE) || MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+static int
+ble_sm_sign_key(uint16_t conn_handle, struct ble_store_key_sec *out_key_sec)
+{
+    struct ble_hs_conn_addrs addrs;
+    struct ble_hs_conn *conn;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        ble_hs_conn_addrs(conn, &addrs);
+
+        memset(out_key_sec, 0, sizeof *out_key_sec);
+        out_key_sec->peer_addr = addrs.peer_id_addr;
+    }
+
+    ble_hs_unlock();
+
+    if (conn == NULL) {
+        return BLE_HS_ENOTCONN;
+    }
+
+    return 0;
+}
+#endif
+
+/**
+ * Signs an outgoing ATT PDU with the CSRK we distributed to the peer.  The
+ * SignCounter and MAC are appended to the supplied mbuf, which must contain
+ * the complete PDU, starting with the opcode.
+ *
+ * SignCounter values are reserved from the bond in blocks of
+ * BLE_SM_SIGN_COUNTER_RESERVE, so the bond is only rewritten once per block
+ * rather than once per PDU.
+ *
+ * @param conn_handle           The connection the PDU will be sent over.
+ * @param om                    The PDU to sign.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EAUTHEN if we have not distributed a
+ *                                  CSRK to the peer;
+ *                              Other nonzero on error.
+ */
+int
+ble_sm_sign_tx(uint16_t conn_handle, struct os_mbuf *om)
+{
+#if !MYNEWT_VAL(BLE_GATT_SIGNED_WRITE)
+    return BLE_HS_ENOTSUP;
+#else
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    struct ble_hs_conn *conn;
+    uint8_t counter_buf[4];
+    uint8_t mac[8];
+    uint32_t counter;
+    uint8_t op;
+    int reserved;
+    int rc;
+
+    rc = ble_sm_sign_key(conn_handle, &key_sec);
+    if (rc != 0) {
+        return rc;
+    }
+
+    while (1) {
+        rc = ble_store_read_our_sec(&key_sec, &value_sec);
+        if (rc == BLE_HS_ENOENT || (rc == 0 && !value_sec.csrk_present)) {
+            return BLE_HS_EAUTHEN;
+        }
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_hs_lock();
+
+        reserved = 0;
+        conn = ble_hs_conn_find(conn_handle);
+        if (conn != NULL &&
+            conn->bhc_sign_counter != conn->bhc_sign_counter_limit) {
+
+            counter = conn->bhc_sign_counter++;
+            reserved = 1;
+        }
+
+        ble_hs_unlock();
+
+        if (conn == NULL) {
+            return BLE_HS_ENOTCONN;
+        }
+        if (reserved) {
+            break;
+        }
+
+        /* This connection has used up its counter values; reserve the next
+         * block in the bond before using any of them.
+         */
+        if (value_sec.sign_counter >
+            UINT32_MAX - MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE)) {
+
+            return BLE_HS_EREJECT;
+        }
+        counter = value_sec.sign_counter;
+        value_sec.sign_counter += MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE);
+
+        rc = ble_store_write_our_sec(&value_sec);
+        if (rc != 0) {
+            return rc;
+        }
+
+        ble_hs_lock();
+
+        conn = ble_hs_conn_find(conn_handle);
+        if (conn != NULL &&
+            value_sec.sign_counter > conn->bhc_sign_counter_limit) {
+
+            if (conn->bhc_sign_counter < counter) {
+                conn->bhc_sign_counter = counter;
+            }
+            conn->bhc_sign_counter_limit = value_sec.sign_counter;
+        }
+
+        ble_hs_unlock();
+    }
+
+    rc = os_mbuf_copydata(om, 0, 1, &op);
+    if (rc != 0) {
+        return BLE_HS_EINVAL;
+    }
+
+    put_le32(counter_buf, counter);
+    rc = os_mbuf_append(om, counter_buf, sizeof counter_buf);
+    if (rc != 0) {
+        return BLE_HS_ENOMEM;
+    }
+
+    rc = ble_sm_alg_sign(value_sec.csrk, op, om, 1, OS_MBUF_PKTLEN(om) - 1,
+                         mac);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = os_mbuf_append(om, mac, sizeof mac);
+    if (rc != 0) {
+        return BLE_HS_ENOMEM;
+    }
+
+    return 0;
+#endif
+}
+
+#if MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+/**
+ * Writes the lowest SignCounter still accepted from the peer to the bond, if
+ * it has advanced past the persisted value by at least min_advance.
+ */
+static int
+ble_sm_sign_rx_persist(uint16_t conn_handle,
+                       struct ble_store_value_sec *value_sec,
+                       uint32_t min_advance)
+{
+    struct ble_hs_conn *conn;
+    uint32_t counter;
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        counter = conn->bhc_peer_sign_counter;
+    }
+
+    ble_hs_unlock();
+
+    if (conn == NULL || counter < value_sec->sign_counter ||
+        counter - value_sec->sign_counter < min_advance) {
+
+        return 0;
+    }
+
+    value_sec->sign_counter = counter;
+    return ble_store_write_peer_sec(value_sec);
+}
+
+/**
+ * Persists the SignCounter received over a terminating connection.
+ */
+static void
+ble_sm_sign_rx_conn_broken(uint16_t conn_handle)
+{
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    int rc;
+
+    rc = ble_sm_sign_key(conn_handle, &key_sec);
+    if (rc != 0) {
+        return;
+    }
+
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    if (rc != 0 || !value_sec.csrk_present) {
+        return;
+    }
+
+    ble_sm_sign_rx_persist(conn_handle, &value_sec, 1);
+}
+#endif
+
+/**
+ * Verifies the signature at the end of an incoming ATT PDU against the CSRK
+ * the peer distributed to us, then strips the signature from the mbuf.  On
+ * success, the lowest SignCounter accepted from the peer is advanced past
+ * the received one so that a replayed PDU is rejected.
+ *
+ * The accepted SignCounter is tracked per connection.  It is written to the
+ * bond once it has advanced by BLE_SM_SIGN_COUNTER_RESERVE, and when the
+ * connection terminates, rather than once per PDU.
+ *
+ * @param conn_handle           The connection the PDU was received over.
+ * @param op                    The ATT opcode of the PDU.
+ * @param om                    The rest of the PDU, following the opcode.
+ * @param out_sec_state         On success, the security state to check the
+ *                                  PDU's permissions against.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EAUTHEN if the peer has not
+ *                                  distributed a CSRK or the MAC does not
+ *                                  match;
+ *                              BLE_HS_EREJECT if the SignCounter has already
+ *                                  been used;
+ *                              Other nonzero on error.
+ */
+int
+ble_sm_sign_rx(uint16_t conn_handle, uint8_t op, struct os_mbuf *om,
+               struct ble_gap_sec_state *out_sec_state)
+{
+#if !MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+    return BLE_HS_ENOTSUP;
+#else
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    struct ble_hs_conn *conn;
+    uint8_t sig[BLE_ATT_SIGNATURE_SZ];
+    uint8_t mac[8];
+    uint32_t counter;
+    uint32_t next;
+    uint8_t diff;
+    int len;
+    int rc;
+    int i;
+
+    if (OS_MBUF_PKTLEN(om) < BLE_ATT_SIGNATURE_SZ) {
+        return BLE_HS_EBADDATA;
+    }
+
+    /* The signed message runs up to and including the SignCounter. */
+    len = OS_MBUF_PKTLEN(om) - sizeof mac;
+
+    rc = os_mbuf_copydata(om, len - 4, sizeof sig, sig);
+    if (rc != 0) {
+        return BLE_HS_EBADDATA;
+    }
+    counter = get_le32(sig);
+
+    rc = ble_sm_sign_key(conn_handle, &key_sec);
+    if (rc != 0) {
+        return rc;
+    }
+
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    if (rc == BLE_HS_ENOENT || (rc == 0 && !value_sec.csrk_present)) {
+        return BLE_HS_EAUTHEN;
+    }
+    if (rc != 0) {
+        return rc;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        next = conn->bhc_peer_sign_counter;
+    }
+
+    ble_hs_unlock();
+
+    if (conn == NULL) {
+        return BLE_HS_ENOTCONN;
+    }
+
+    if (next < value_sec.sign_counter) {
+        next = value_sec.sign_counter;
+    }
+    if (counter < next || counter == UINT32_MAX) {
+        return BLE_HS_EREJECT;
+    }
+
+    rc = ble_sm_alg_sign(value_sec.csrk, op, om, 0, len, mac);
+    if (rc != 0) {
+        return rc;
+    }
+
+    diff = 0;
+    for (i = 0; i < sizeof mac; i++) {
+        diff |= mac[i] ^ sig[4 + i];
+    }
+    if (diff != 0) {
+        return BLE_HS_EAUTHEN;
+    }
+
+    ble_hs_lock();
+
+    conn = ble_hs_conn_find(conn_handle);
+    if (conn != NULL) {
+        if (counter < conn->bhc_peer_sign_counter) {
+            conn = NULL;
+        } else {
+            conn->bhc_peer_sign_counter = counter + 1;
+        }
+    }
+
+    ble_hs_unlock();
+
+    if (conn == NULL) {
+        /* Disconnected, or the counter was accepted in the meantime. */
+        return BLE_HS_EREJECT;
+    }
+
+    rc = ble_sm_sign_rx_persist(conn_handle, &value_sec,
+                                MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE));
+    if (rc != 0) {
+        return rc;
+    }
+
+    os_mbuf_adj(om, -BLE_ATT_SIGNATURE_SZ);
+
+    /* Data signed with a bond's CSRK satisfies the same encryption and
+     * authentication requirements as a link encrypted with that bond (Vol 3,
+     * Part C, 10.2.2).  CSRKs are always full length.
+     */
+    memset(out_sec_state, 0, sizeof *out_sec_state);
+    out_sec_state->encrypted = 1;
+    out_sec_state->authenticated = value_sec.authenticated;
+    out_sec_state->bonded = 1;
+    out_sec_state->key_size = 16;
+
+    return 0;
+#endif
+}
+
 /*****************************************************************************
  * $api                                                                      *
  *****************************************************************************/
@@ -2695,6 +3085,10 @@ ble_sm_connection_broken(uint16_t conn_handle)
     res.enc_cb = 1;
 
     ble_sm_process_result(conn_handle, &res);
+
+#if MYNEWT_VAL(BLE_ATT_SVR_SIGNED_WRITE)
+    ble_sm_sign_rx_conn_broken(conn_handle);
+#endif
 }
 
 int
@@ -29,11 +29,11 @@
 #include "nimble/nimble_opt.h"
 #include "ble_hs_priv.h"
 #include "tinycrypt/aes.h"
+#include "tinycrypt/cmac_mode.h"
 #include "tinycrypt/constants.h"
 #include "tinycrypt/utils.h"
 
 #if MYNEWT_VAL(BLE_SM_SC)
-#include "tinycrypt/cmac_mode.h"
 #include "tinycrypt/ecc_dh.h"
 #endif
 
@@ -47,29 +47,37 @@ ble_sm_alg_xor_128(uint8_t *p, uint8_t *q, uint8_t *r)
     }
 }
 
+/**
+ * Encrypts a single block.  The keys used here (TK, STK) are only good for
+ * a single pairing procedure, so their schedules are not added to the AES
+ * cache.
+ */
 static int
 ble_sm_alg_encrypt(uint8_t *key, uint8_t *plaintext, uint8_t *enc_data)
 {
     struct tc_aes_key_sched_struct s;
     uint8_t tmp[16];
+    int rc;
 
     swap_buf(tmp, key, 16);
 
+    rc = 0;
     if (tc_aes128_set_encrypt_key(&s, tmp) == TC_CRYPTO_FAIL) {
-        return BLE_HS_EUNKNOWN;
-    }
-
-    swap_buf(tmp, plaintext, 16);
-
-
+        rc = BLE_HS_EUNKNOWN;
+    } else {
+        swap_buf(tmp, plaintext, 16);
 
-    if (tc_aes_encrypt(enc_data, tmp, &s) == TC_CRYPTO_FAIL) {
-        return BLE_HS_EUNKNOWN;
+        if (tc_aes_encrypt(enc_data, tmp, &s) == TC_CRYPTO_FAIL) {
+            rc = BLE_HS_EUNKNOWN;
+        } else {
+            swap_in_place(enc_data, 16);
+        }
     }
 
-    swap_in_place(enc_data, 16);
+    memset(&s, 0, sizeof s);
+    memset(tmp, 0, sizeof tmp);
 
-    return 0;
+    return rc;
 }
 
 int
@@ -177,6 +185,80 @@ done:
     return rc;
 }
 
+/**
+ * Computes the 64-bit MAC of a signed ATT PDU (Vol 3, Part H, 2.4.5).  The
+ * signed message is the ATT opcode followed by len bytes of the mbuf chain,
+ * starting at off; the caller includes the SignCounter in this range.
+ *
+ * The specification feeds the message to AES-CMAC with its byte order
+ * reversed.  Rather than flattening and reversing the whole PDU, the chain is
+ * consumed a block at a time from its tail, so only one 16-byte block is ever
+ * copied out.  The CMAC subkeys come from the AES cache, so a bond's CSRK is
+ * only expanded once while it stays in use.
+ *
+ * @param csrk                  The CSRK, in little-endian order.
+ * @param op                    The ATT opcode of the PDU.
+ * @param om                    The mbuf chain holding the rest of the PDU.
+ * @param off                   The offset within om of the byte following
+ *                                  the opcode.
+ * @param len                   The number of bytes to sign after the opcode.
+ * @param out_mac               On success, the MAC is written here, in the
+ *                                  order it is transmitted.
+ *
+ * @return                      0 on success; nonzero on failure.
+ */
+int
+ble_sm_alg_sign(const uint8_t *csrk, uint8_t op, const struct os_mbuf *om,
+                int off, int len, uint8_t *out_mac)
+{
+    struct tc_aes_key_sched_struct sched;
+    struct tc_cmac_struct state;
+    uint8_t block[16];
+    uint8_t key[16];
+    int chunk;
+    int rc;
+    int i;
+
+    swap_buf(key, csrk, 16);
+
+    rc = ble_hs_aes_cache_cmac_setup(&state, key, &sched);
+    if (rc != 0) {
+        return rc;
+    }
+
+    while (len > 0) {
+        chunk = min(len, (int)sizeof block);
+        len -= chunk;
+
+        rc = os_mbuf_copydata(om, off + len, chunk, block);
+        if (rc != 0) {
+            return BLE_HS_EINVAL;
+        }
+        swap_in_place(block, chunk);
+
+        if (tc_cmac_update(&state, block, chunk) == TC_CRYPTO_FAIL) {
+            return BLE_HS_EUNKNOWN;
+        }
+    }
+
+    if (tc_cmac_update(&state, &op, 1) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    if (tc_cmac_final(block, &state) == TC_CRYPTO_FAIL) {
+        return BLE_HS_EUNKNOWN;
+    }
+
+    /* The MAC is the 64 most significant bits of the CMAC output, sent least
+     * significant octet first.
+     */
+    for (i = 0; i < 8; i++) {
+        out_mac[i] = block[7 - i];
+    }
+
+    return 0;
+}
+
 #if MYNEWT_VAL(BLE_SM_SC)
 
 static void
@@ -191,30 +273,45 @@ ble_sm_alg_log_buf(const char *name, const uint8_t *buf, int len)
  * Cypher based Message Authentication Code (CMAC) with AES 128 bit
  *
  * @param key                   128-bit key.
+ * @param cache_key             Whether the key's schedule should go through
+ *                                  the AES cache.  Only set for constant
+ *                                  keys; per-procedure keys (nonces, T,
+ *                                  MacKey) would just evict useful entries.
  * @param in                    Message to be authenticated.
  * @param len                   Length of the message in octets.
  * @param out                   Output; message authentication code.
  */
 static int
-ble_sm_alg_aes_cmac(const uint8_t *key, const uint8_t *in, size_t len,
-                    uint8_t *out)
+ble_sm_alg_aes_cmac(const uint8_t *key, int cache_key, const uint8_t *in,
+                    size_t len, uint8_t *out)
 {
     struct tc_aes_key_sched_struct sched;
     struct tc_cmac_struct state;
+    int rc;
 
-    if (tc_cmac_setup(&state, key, &sched) == TC_CRYPTO_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    rc = 0;
+    if (cache_key) {
+        if (ble_hs_aes_cache_cmac_setup(&state, key, &sched) != 0) {
+            rc = BLE_HS_EUNKNOWN;
+        }
+    } else {
+        if (tc_cmac_setup(&state, key, &sched) == TC_CRYPTO_FAIL) {
+            rc = BLE_HS_EUNKNOWN;
+        }
     }
 
-    if (tc_cmac_update(&state, in, len) == TC_CRYPTO_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    if (rc == 0 && tc_cmac_update(&state, in, len) == TC_CRYPTO_FAIL) {
+        rc = BLE_HS_EUNKNOWN;
     }
 
-    if (tc_cmac_final(out, &state) == TC_CRYPTO_FAIL) {
-        return BLE_HS_EUNKNOWN;
+    if (rc == 0 && tc_cmac_final(out, &state) == TC_CRYPTO_FAIL) {
+        rc = BLE_HS_EUNKNOWN;
     }
 
-    return 0;
+    memset(&state, 0, sizeof state);
+    memset(&sched, 0, sizeof sched);
+
+    return rc;
 }
 
 int
@@ -248,7 +345,7 @@ ble_sm_alg_f4(uint8_t *u, uint8_t *v, uint8_t *x, uint8_t z,
 
     swap_buf(xs, x, 16);
 
-    rc = ble_sm_alg_aes_cmac(xs, m, sizeof(m), out_enc_data);
+    rc = ble_sm_alg_aes_cmac(xs, 0, m, sizeof(m), out_enc_data);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -292,7 +389,7 @@ ble_sm_alg_f5(uint8_t *w, uint8_t *n1, uint8_t *n2, uint8_t a1t,
 
     swap_buf(ws, w, 32);
 
-    rc = ble_sm_alg_aes_cmac(salt, ws, 32, t);
+    rc = ble_sm_alg_aes_cmac(salt, 1, ws, 32, t);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -306,8 +403,9 @@ ble_sm_alg_f5(uint8_t *w, uint8_t *n1, uint8_t *n2, uint8_t a1t,
     m[44] = a2t;
     swap_buf(m + 45, a2, 6);
 
-    rc = ble_sm_alg_aes_cmac(t, m, sizeof(m), mackey);
+    rc = ble_sm_alg_aes_cmac(t, 0, m, sizeof(m), mackey);
     if (rc != 0) {
+        memset(t, 0, sizeof t);
         return BLE_HS_EUNKNOWN;
     }
 
@@ -318,7 +416,8 @@ ble_sm_alg_f5(uint8_t *w, uint8_t *n1, uint8_t *n2, uint8_t a1t,
     /* Counter for ltk is 1. */
     m[0] = 0x01;
 
-    rc = ble_sm_alg_aes_cmac(t, m, sizeof(m), ltk);
+    rc = ble_sm_alg_aes_cmac(t, 0, m, sizeof(m), ltk);
+    memset(t, 0, sizeof t);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -366,7 +465,7 @@ ble_sm_alg_f6(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
 
     swap_buf(ws, w, 16);
 
-    rc = ble_sm_alg_aes_cmac(ws, m, sizeof(m), check);
+    rc = ble_sm_alg_aes_cmac(ws, 0, m, sizeof(m), check);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -398,7 +497,7 @@ ble_sm_alg_g2(uint8_t *u, uint8_t *v, uint8_t *x, uint8_t *y,
     swap_buf(xs, x, 16);
 
     /* reuse xs (key) as buffer for result */
-    rc = ble_sm_alg_aes_cmac(xs, m, sizeof(m), xs);
+    rc = ble_sm_alg_aes_cmac(xs, 0, m, sizeof(m), xs);
     if (rc != 0) {
         return BLE_HS_EUNKNOWN;
     }
@@ -480,10 +579,495 @@ ble_sm_alg_rand(uint8_t *dst, unsigned int size)
     return 1;
 }
 
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+
+static struct os_eventq ble_sm_alg_ecc_evq;
+static struct os_task ble_sm_alg_ecc_task;
+OS_TASK_STACK_DEFINE(ble_sm_alg_ecc_stack,
+                     MYNEWT_VAL(BLE_SM_SC_ECC_TASK_STACK_SIZE));
+static uint8_t ble_sm_alg_ecc_task_started;
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+static uint8_t ble_sm_alg_dbg_ecc_disabled;
+#endif
+
+/**
+ * Hands a finished job back to the host task.  The job's event must not be
+ * queued.
+ */
+static void
+ble_sm_alg_ecc_job_complete(struct ble_sm_alg_ecc_job *job)
+{
+    job->ev.ev_cb = job->done_fn;
+    os_eventq_put(ble_hs_evq_get(), &job->ev);
+}
+
+/**
+ * Executes a single P-256 job in the context of the ECC task and hands the
+ * job back to the host task.
+ */
+static void
+ble_sm_alg_ecc_job_run(struct os_event *ev)
+{
+    struct ble_sm_alg_ecc_job *job;
+
+    job = ev->ev_arg;
+
+    switch (job->op) {
+    case BLE_SM_ALG_ECC_OP_DHKEY:
+        job->status = ble_sm_alg_gen_dhkey(job->pub_key, job->pub_key + 32,
+                                           job->priv_key, job->dhkey);
+        break;
+
+    case BLE_SM_ALG_ECC_OP_KEY_PAIR:
+        job->status = ble_sm_alg_gen_key_pair(job->pub_key, job->priv_key);
+        break;
+
+    default:
+        BLE_HS_DBG_ASSERT(0);
+        job->status = BLE_HS_EINVAL;
+        break;
+    }
+
+    /* The event was removed from the ECC queue before this callback was
+     * invoked; it can now be reused to deliver the result.
+     */
+    ble_sm_alg_ecc_job_complete(job);
+}
+
+static void
+ble_sm_alg_ecc_task_handler(void *arg)
+{
+    while (1) {
+        os_eventq_run(&ble_sm_alg_ecc_evq);
+    }
+}
+
+/**
+ * Queues a P-256 operation for execution on the security manager ECC task.
+ * When the operation completes, the job's event is posted to the host event
+ * queue and the job's done callback is executed in the host task.  The job
+ * must remain valid until then.
+ *
+ * @param job                   The job to execute.  The op, done_fn and
+ *                                  input fields must be populated.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EALREADY if the job is already queued;
+ *                              BLE_HS_ENOTSUP if the ECC task isn't running.
+ */
+int
+ble_sm_alg_ecc_submit(struct ble_sm_alg_ecc_job *job)
+{
+    if (!ble_sm_alg_ecc_task_started) {
+        return BLE_HS_ENOTSUP;
+    }
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+    if (ble_sm_alg_dbg_ecc_disabled) {
+        return BLE_HS_ENOTSUP;
+    }
+#endif
+
+    if (job->ev.ev_queued) {
+        return BLE_HS_EALREADY;
+    }
+
+    job->status = 0;
+    job->ev.ev_cb = ble_sm_alg_ecc_job_run;
+    job->ev.ev_arg = job;
+    os_eventq_put(&ble_sm_alg_ecc_evq, &job->ev);
+
+    return 0;
+}
+
+static void
+ble_sm_alg_ecc_task_init(void)
+{
+    int rc;
+
+    if (ble_sm_alg_ecc_task_started) {
+        return;
+    }
+
+    os_eventq_init(&ble_sm_alg_ecc_evq);
+    rc = os_task_init(&ble_sm_alg_ecc_task, "ble_sm_ecc",
+                      ble_sm_alg_ecc_task_handler, NULL,
+                      MYNEWT_VAL(BLE_SM_SC_ECC_TASK_PRIO), OS_WAIT_FOREVER,
+                      ble_sm_alg_ecc_stack,
+                      MYNEWT_VAL(BLE_SM_SC_ECC_TASK_STACK_SIZE));
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0);
+
+    ble_sm_alg_ecc_task_started = 1;
+}
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+
+/**
+ * Enables or disables the ECC task.  While it is disabled, job submissions
+ * fail as if the task weren't running and P-256 operations are performed on
+ * the host task.  Disabling the task fails the jobs it hasn't run yet; their
+ * done callbacks are called immediately with BLE_HS_ENOTSUP.
+ */
+void
+ble_sm_dbg_ecc_task_enable(int enable)
+{
+    struct ble_sm_alg_ecc_job *job;
+    struct os_event *ev;
+
+    ble_sm_alg_dbg_ecc_disabled = !enable;
+    if (enable || !ble_sm_alg_ecc_task_started) {
+        return;
+    }
+
+    while ((ev = os_eventq_get_no_wait(&ble_sm_alg_ecc_evq)) != NULL) {
+        job = ev->ev_arg;
+        job->status = BLE_HS_ENOTSUP;
+        job->done_fn(ev);
+    }
+}
+
+/**
+ * Runs the oldest job queued for the ECC task in the caller's context, as
+ * the task would.  The result is posted to the host event queue.
+ *
+ * @param status                0 to perform the operation; nonzero to fail
+ *                                  the job with this status instead.
+ *
+ * @return                      0 if a job was run;
+ *                              BLE_HS_ENOENT if no jobs are queued.
+ */
+int
+ble_sm_dbg_ecc_task_run(int status)
+{
+    struct ble_sm_alg_ecc_job *job;
+    struct os_event *ev;
+
+    if (!ble_sm_alg_ecc_task_started) {
+        return BLE_HS_ENOENT;
+    }
+
+    ev = os_eventq_get_no_wait(&ble_sm_alg_ecc_evq);
+    if (ev == NULL) {
+        return BLE_HS_ENOENT;
+    }
+
+    if (status == 0) {
+        ble_sm_alg_ecc_job_run(ev);
+    } else {
+        job = ev->ev_arg;
+        job->status = status;
+        ble_sm_alg_ecc_job_complete(job);
+    }
+
+    return 0;
+}
+
+#endif
+
+#endif
+
+/**
+ * Pool of precomputed local key pairs.  All pool state is owned by the host
+ * task and protected by the host lock; the ECC task only ever operates on
+ * its job buffer.  Key pairs are never generated with the host lock held.
+ */
+struct ble_sm_alg_key_pair {
+    uint8_t pub[64];
+    uint8_t priv[32];
+    uint32_t exp_os_ticks;
+    uint16_t uses;
+    uint8_t ready;
+};
+
+static struct ble_sm_alg_key_pair
+    ble_sm_alg_key_pool[MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE)];
+
+/** Index of the next key pair to hand out; pairs are used round-robin. */
+static uint8_t ble_sm_alg_key_pool_next;
+
+/** Whether a key pair generation is in progress. */
+static uint8_t ble_sm_alg_key_pool_busy;
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+static os_event_fn ble_sm_alg_key_pool_job_done;
+static struct ble_sm_alg_ecc_job ble_sm_alg_key_pool_job;
+#else
+static os_event_fn ble_sm_alg_key_pool_event_cb;
+static struct os_event ble_sm_alg_key_pool_ev = {
+    .ev_cb = ble_sm_alg_key_pool_event_cb,
+};
+#endif
+
+static void
+ble_sm_alg_key_pair_retire(struct ble_sm_alg_key_pair *kp)
+{
+    memset(kp, 0, sizeof *kp);
+}
+
+static int
+ble_sm_alg_key_pair_expired(const struct ble_sm_alg_key_pair *kp,
+                            uint32_t now)
+{
+#if MYNEWT_VAL(BLE_SM_SC_KEY_LIFETIME) != 0
+    return (int32_t)(kp->exp_os_ticks - now) <= 0;
+#else
+    return 0;
+#endif
+}
+
+static struct ble_sm_alg_key_pair *
+ble_sm_alg_key_pool_find_empty(void)
+{
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE); i++) {
+        if (!ble_sm_alg_key_pool[i].ready) {
+            return ble_sm_alg_key_pool + i;
+        }
+    }
+
+    return NULL;
+}
+
+static struct ble_sm_alg_key_pair *
+ble_sm_alg_key_pool_install(const uint8_t *pub, const uint8_t *priv)
+{
+    struct ble_sm_alg_key_pair *kp;
+
+    kp = ble_sm_alg_key_pool_find_empty();
+    if (kp == NULL) {
+        return NULL;
+    }
+
+    memcpy(kp->pub, pub, sizeof kp->pub);
+    memcpy(kp->priv, priv, sizeof kp->priv);
+    kp->exp_os_ticks = os_time_get() +
+                       MYNEWT_VAL(BLE_SM_SC_KEY_LIFETIME) * OS_TICKS_PER_SEC;
+    kp->uses = 0;
+    kp->ready = 1;
+
+    return kp;
+}
+
+/**
+ * Starts generating a key pair for the first empty pool slot, if any.  Only
+ * one key pair is generated at a time.  With the ECC task, each completion
+ * schedules the next so the pool stays full.  Without it, the key pair is
+ * generated by a host event and this is only called when the pool is empty;
+ * the pool is never refilled speculatively on the host task.
+ */
+static void
+ble_sm_alg_key_pool_refill(void)
+{
+    if (ble_sm_alg_key_pool_busy ||
+        ble_sm_alg_key_pool_find_empty() == NULL) {
+
+        return;
+    }
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    ble_sm_alg_key_pool_job.op = BLE_SM_ALG_ECC_OP_KEY_PAIR;
+    ble_sm_alg_key_pool_job.done_fn = ble_sm_alg_key_pool_job_done;
+    if (ble_sm_alg_ecc_submit(&ble_sm_alg_key_pool_job) != 0) {
+        return;
+    }
+#else
+    os_eventq_put(ble_hs_evq_get(), &ble_sm_alg_key_pool_ev);
+#endif
+
+    ble_sm_alg_key_pool_busy = 1;
+}
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+
+static void
+ble_sm_alg_key_pool_job_done(struct os_event *ev)
+{
+    struct ble_sm_alg_ecc_job *job;
+    int rc;
+
+    job = ev->ev_arg;
+
+    ble_hs_lock();
+
+    rc = job->status;
+    if (rc == 0) {
+        ble_sm_alg_key_pool_install(job->pub_key, job->priv_key);
+    }
+    memset(job->priv_key, 0, sizeof job->priv_key);
+
+    ble_sm_alg_key_pool_busy = 0;
+    if (rc == 0) {
+        ble_sm_alg_key_pool_refill();
+    }
+
+    ble_hs_unlock();
+
+    ble_sm_sc_key_pool_ready(rc);
+}
+
+#else
+
+/**
+ * Generates a single key pair on behalf of the procedures waiting on an empty
+ * pool.  Runs in the host task without the host lock held.
+ */
+static void
+ble_sm_alg_key_pool_event_cb(struct os_event *ev)
+{
+    uint8_t pub[64];
+    uint8_t priv[32];
+    int rc;
+
+    rc = ble_sm_alg_gen_key_pair(pub, priv);
+
+    ble_hs_lock();
+
+    if (rc == 0) {
+        ble_sm_alg_key_pool_install(pub, priv);
+    }
+    memset(priv, 0, sizeof priv);
+
+    ble_sm_alg_key_pool_busy = 0;
+
+    ble_hs_unlock();
+
+    ble_sm_sc_key_pool_ready(rc);
+}
+
+#endif
+
+/**
+ * Retrieves a local key pair for a new LE Secure Connections pairing
+ * procedure.  A precomputed pair is taken from the pool if one is available.
+ * Pairs that have reached their maximum use count or lifetime are discarded.
+ * If the pool is empty, a key pair is requested and the caller must wait for
+ * ble_sm_sc_key_pool_ready() before trying again; this function never
+ * generates a key pair itself.
+ *
+ * Must be called with the host lock held.
+ *
+ * @param pub                   On success, our 64-byte public key gets
+ *                                  written here.
+ * @param priv                  On success, our 32-byte private key gets
+ *                                  written here.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EAGAIN if the pool is empty.
+ */
+int
+ble_sm_alg_key_pool_get(uint8_t *pub, uint8_t *priv)
+{
+    struct ble_sm_alg_key_pair *kp;
+    struct ble_sm_alg_key_pair *cur;
+    uint32_t now;
+    int idx;
+    int i;
+
+    BLE_HS_DBG_ASSERT(ble_hs_locked_by_cur_task());
+
+    now = os_time_get();
+    kp = NULL;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE); i++) {
+        idx = (ble_sm_alg_key_pool_next + i) %
+              MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE);
+        cur = ble_sm_alg_key_pool + idx;
+
+        if (!cur->ready) {
+            continue;
+        }
+
+        if (ble_sm_alg_key_pair_expired(cur, now)) {
+            ble_sm_alg_key_pair_retire(cur);
+            continue;
+        }
+
+        if (kp == NULL) {
+            kp = cur;
+            ble_sm_alg_key_pool_next = (idx + 1) %
+                                       MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE);
+        }
+    }
+
+    if (kp == NULL) {
+        ble_sm_alg_key_pool_refill();
+        return BLE_HS_EAGAIN;
+    }
+
+    memcpy(pub, kp->pub, sizeof kp->pub);
+    memcpy(priv, kp->priv, sizeof kp->priv);
+    kp->uses++;
+
+#if MYNEWT_VAL(BLE_SM_SC_KEY_MAX_USES) != 0
+    if (kp->uses >= MYNEWT_VAL(BLE_SM_SC_KEY_MAX_USES)) {
+        ble_sm_alg_key_pair_retire(kp);
+    }
+#endif
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    ble_sm_alg_key_pool_refill();
+#endif
+
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_HS_DEBUG)
+
+/**
+ * Adds the specified key pair to the pool as if it had just been generated.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOMEM if the pool is full.
+ */
+int
+ble_sm_dbg_key_pool_add(const uint8_t *pub, const uint8_t *priv)
+{
+    struct ble_sm_alg_key_pair *kp;
+
+    ble_hs_lock();
+    kp = ble_sm_alg_key_pool_install(pub, priv);
+    ble_hs_unlock();
+
+    if (kp == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    return 0;
+}
+
+#endif
+
+static void
+ble_sm_alg_key_pool_init(void)
+{
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_SC_KEY_POOL_SIZE); i++) {
+        ble_sm_alg_key_pair_retire(ble_sm_alg_key_pool + i);
+    }
+    ble_sm_alg_key_pool_next = 0;
+    ble_sm_alg_key_pool_busy = 0;
+
+    /* Start filling the pool right away if the ECC task can do it.  Without
+     * the ECC task, key pairs are only generated on demand.
+     */
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    ble_sm_alg_key_pool_refill();
+#endif
+}
+
 void
 ble_sm_alg_ecc_init(void)
 {
     uECC_set_rng(ble_sm_alg_rand);
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    ble_sm_alg_ecc_task_init();
+#endif
+
+    ble_sm_alg_key_pool_init();
 }
 
 #endif
@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 struct ble_gap_sec_state;
+struct os_mbuf;
 struct hci_le_lt_key_req;
 struct hci_encrypt_change;
 
@@ -216,6 +217,10 @@ struct ble_sm_dhkey_check {
 #define BLE_SM_PROC_F_AUTHENTICATED         0x08
 #define BLE_SM_PROC_F_SC                    0x10
 #define BLE_SM_PROC_F_BONDING               0x20
+#define BLE_SM_PROC_F_DHKEY_PENDING         0x40
+#define BLE_SM_PROC_F_DHKEY_WAIT            0x80
+#define BLE_SM_PROC_F_SC_KEYS               0x0100
+#define BLE_SM_PROC_F_KEYS_WAIT             0x0200
 
 #define BLE_SM_KE_F_ENC_INFO                0x01
 #define BLE_SM_KE_F_MASTER_ID               0x02
@@ -223,7 +228,7 @@ struct ble_sm_dhkey_check {
 #define BLE_SM_KE_F_ADDR_INFO               0x08
 #define BLE_SM_KE_F_SIGN_INFO               0x10
 
-typedef uint8_t ble_sm_proc_flags;
+typedef uint16_t ble_sm_proc_flags;
 
 struct ble_sm_keys {
     unsigned ltk_valid:1;
@@ -267,8 +272,13 @@ struct ble_sm_proc {
     uint8_t passkey_bits_exchanged;
     uint8_t ri;
     struct ble_sm_public_key pub_key_peer;
+    uint8_t our_pub_key[64];
+    uint8_t our_priv_key[32];
     uint8_t mackey[16];
     uint8_t dhkey[32];
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    uint32_t dhkey_job_seq;
+#endif
 #endif
 };
 
@@ -290,6 +300,11 @@ void ble_sm_dbg_set_next_master_id_rand(uint64_t next_master_id_rand);
 void ble_sm_dbg_set_next_ltk(uint8_t *next_ltk);
 void ble_sm_dbg_set_next_csrk(uint8_t *next_csrk);
 void ble_sm_dbg_set_sc_keys(uint8_t *pubkey, uint8_t *privkey);
+int ble_sm_dbg_key_pool_add(const uint8_t *pub, const uint8_t *priv);
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+void ble_sm_dbg_ecc_task_enable(int enable);
+int ble_sm_dbg_ecc_task_run(int status);
+#endif
 #endif
 
 int ble_sm_num_procs(void);
@@ -313,6 +328,8 @@ int ble_sm_alg_c1(uint8_t *k, uint8_t *r,
                   uint8_t iat, uint8_t rat,
                   uint8_t *ia, uint8_t *ra,
                   uint8_t *out_enc_data);
+int ble_sm_alg_sign(const uint8_t *csrk, uint8_t op, const struct os_mbuf *om,
+                    int off, int len, uint8_t *out_mac);
 int ble_sm_alg_f4(uint8_t *u, uint8_t *v, uint8_t *x, uint8_t z,
                   uint8_t *out_enc_data);
 int ble_sm_alg_g2(uint8_t *u, uint8_t *v, uint8_t *x, uint8_t *y,
@@ -327,8 +344,32 @@ int ble_sm_alg_f6(const uint8_t *w, const uint8_t *n1, const uint8_t *n2,
 int ble_sm_alg_gen_dhkey(uint8_t *peer_pub_key_x, uint8_t *peer_pub_key_y,
                          uint8_t *our_priv_key, uint8_t *out_dhkey);
 int ble_sm_alg_gen_key_pair(uint8_t *pub, uint8_t *priv);
+int ble_sm_alg_key_pool_get(uint8_t *pub, uint8_t *priv);
 void ble_sm_alg_ecc_init(void);
 
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+#define BLE_SM_ALG_ECC_OP_DHKEY             0
+#define BLE_SM_ALG_ECC_OP_KEY_PAIR          1
+
+/** A P-256 operation executed by the security manager ECC task. */
+struct ble_sm_alg_ecc_job {
+    /* Posted to the ECC task, then back to the host task on completion. */
+    struct os_event ev;
+    os_event_fn *done_fn;
+    int status;
+    uint8_t op;
+
+    /* DHKEY: peer public key in; KEY_PAIR: our public key out. */
+    uint8_t pub_key[64];
+    /* DHKEY: our private key in; KEY_PAIR: our private key out. */
+    uint8_t priv_key[32];
+    /* DHKEY: shared secret out. */
+    uint8_t dhkey[32];
+};
+
+int ble_sm_alg_ecc_submit(struct ble_sm_alg_ecc_job *job);
+#endif
+
 void ble_sm_enc_change_rx(struct hci_encrypt_change *evt);
 void ble_sm_enc_key_refresh_rx(struct hci_encrypt_key_refresh *evt);
 int ble_sm_ltk_req_rx(struct hci_le_lt_key_req *evt);
@@ -364,6 +405,7 @@ void ble_sm_sc_dhkey_check_exec(struct ble_sm_proc *proc,
                                 struct ble_sm_result *res, void *arg);
 void ble_sm_sc_dhkey_check_rx(uint16_t conn_handle, struct os_mbuf **rxom,
                               struct ble_sm_result *res);
+void ble_sm_sc_key_pool_ready(int status);
 void ble_sm_sc_init(void);
 #else
 #define ble_sm_sc_io_action(proc, action) (BLE_HS_ENOTSUP)
@@ -374,6 +416,7 @@ void ble_sm_sc_init(void);
 #define ble_sm_sc_public_key_rx(conn_handle, op, om, res)
 #define ble_sm_sc_dhkey_check_exec(proc, res, arg)
 #define ble_sm_sc_dhkey_check_rx(conn_handle, op, om, res)
+#define ble_sm_sc_key_pool_ready(status)
 #define ble_sm_sc_init()
 
 #endif
@@ -381,6 +424,7 @@ void ble_sm_sc_init(void);
 struct ble_sm_proc *ble_sm_proc_find(uint16_t conn_handle, uint8_t state,
                                      int is_initiator,
                                      struct ble_sm_proc **out_prev);
+struct ble_sm_proc *ble_sm_proc_find_flags(ble_sm_proc_flags flags);
 int ble_sm_gen_pair_rand(uint8_t *pair_rand);
 uint8_t *ble_sm_our_pair_rand(struct ble_sm_proc *proc);
 uint8_t *ble_sm_peer_pair_rand(struct ble_sm_proc *proc);
@@ -398,6 +442,9 @@ int ble_sm_pair_initiate(uint16_t conn_handle);
 int ble_sm_slave_initiate(uint16_t conn_handle);
 int ble_sm_enc_initiate(uint16_t conn_handle, const uint8_t *ltk,
                         uint16_t ediv, uint64_t rand_val, int auth);
+int ble_sm_sign_tx(uint16_t conn_handle, struct os_mbuf *om);
+int ble_sm_sign_rx(uint16_t conn_handle, uint8_t op, struct os_mbuf *om,
+                   struct ble_gap_sec_state *out_sec_state);
 int ble_sm_init(void);
 
 #define BLE_SM_LOG_CMD(is_tx, cmd_name, conn_handle, log_cb, cmd) \
@@ -415,6 +462,8 @@ int ble_sm_init(void);
 #define ble_sm_slave_initiate(conn_handle)  BLE_HS_ENOTSUP
 #define ble_sm_enc_initiate(conn_handle, ltk, ediv, rand_val, auth) \
         BLE_HS_ENOTSUP
+#define ble_sm_sign_tx(conn_handle, om) BLE_HS_ENOTSUP
+#define ble_sm_sign_rx(conn_handle, op, om, out_sec_state) BLE_HS_ENOTSUP
 
 #define ble_sm_init() 0
 
@@ -29,14 +29,29 @@
 #define BLE_SM_SC_PASSKEY_BYTES     4
 #define BLE_SM_SC_PASSKEY_BITS      20
 
-static uint8_t ble_sm_sc_pub_key[64];
-static uint8_t ble_sm_sc_priv_key[32];
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
 
 /**
- * Whether our public-private key pair has been generated.  We generate it on
- * startup for now until we have a non-volatile storage mechanism.
+ * An outstanding DHKey computation.  The job carries its own copy of the keys
+ * so that the procedure can be freed (e.g., on timeout) while the ECC task is
+ * still working on it.
  */
-static uint8_t ble_sm_sc_keys_generated;
+struct ble_sm_sc_dhkey_job {
+    struct ble_sm_alg_ecc_job ecc;
+    uint32_t seq;
+    uint16_t conn_handle;
+    uint8_t in_use;
+};
+
+static struct ble_sm_sc_dhkey_job
+    ble_sm_sc_dhkey_jobs[MYNEWT_VAL(BLE_SM_MAX_PROCS)];
+
+/** Sequence number of the most recently started DHKey job. */
+static uint32_t ble_sm_sc_dhkey_job_seq;
+
+static os_event_fn ble_sm_sc_dhkey_job_done;
+
+#endif
 
 /**
  * Create some shortened names for the passkey actions so that the table is
@@ -163,7 +178,7 @@ ble_sm_gen_pub_priv(uint8_t *pub, uint8_t *priv)
     }
 #endif
 
-    rc = ble_sm_alg_gen_key_pair(pub, priv);
+    rc = ble_sm_alg_key_pool_get(pub, priv);
     if (rc != 0) {
         return rc;
     }
@@ -171,25 +186,37 @@ ble_sm_gen_pub_priv(uint8_t *pub, uint8_t *priv)
     return 0;
 }
 
+/**
+ * Assigns a local key pair to the specified procedure if it doesn't have one
+ * yet.  Each procedure keeps its own copy so that the key pool can rotate
+ * keys while other procedures are in progress.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_EAGAIN if the key pool is empty; the
+ *                                  caller should set
+ *                                  BLE_SM_PROC_F_KEYS_WAIT and wait for
+ *                                  ble_sm_sc_key_pool_ready();
+ *                              other nonzero on error.
+ */
 static int
-ble_sm_sc_ensure_keys_generated(void)
+ble_sm_sc_ensure_keys_generated(struct ble_sm_proc *proc)
 {
     int rc;
 
-    if (!ble_sm_sc_keys_generated) {
-        rc = ble_sm_gen_pub_priv(ble_sm_sc_pub_key, ble_sm_sc_priv_key);
+    if (!(proc->flags & BLE_SM_PROC_F_SC_KEYS)) {
+        rc = ble_sm_gen_pub_priv(proc->our_pub_key, proc->our_priv_key);
         if (rc != 0) {
             return rc;
         }
 
-        ble_sm_sc_keys_generated = 1;
+        proc->flags |= BLE_SM_PROC_F_SC_KEYS;
     }
 
     BLE_HS_LOG(DEBUG, "our pubkey=");
-    ble_hs_log_flat_buf(&ble_sm_sc_pub_key, 64);
+    ble_hs_log_flat_buf(proc->our_pub_key, 64);
     BLE_HS_LOG(DEBUG, "\n");
     BLE_HS_LOG(DEBUG, "our privkey=");
-    ble_hs_log_flat_buf(&ble_sm_sc_priv_key, 32);
+    ble_hs_log_flat_buf(proc->our_priv_key, 32);
     BLE_HS_LOG(DEBUG, "\n");
 
     return 0;
@@ -287,7 +314,7 @@ ble_sm_sc_confirm_exec(struct ble_sm_proc *proc, struct ble_sm_result *res)
         return;
     }
 
-    rc = ble_sm_alg_f4(ble_sm_sc_pub_key, proc->pub_key_peer.x,
+    rc = ble_sm_alg_f4(proc->our_pub_key, proc->pub_key_peer.x,
                        ble_sm_our_pair_rand(proc), proc->ri, cmd->value);
     if (rc != 0) {
         os_mbuf_free_chain(txom);
@@ -317,11 +344,11 @@ ble_sm_sc_gen_numcmp(struct ble_sm_proc *proc, struct ble_sm_result *res)
     uint8_t *pkb;
 
     if (proc->flags & BLE_SM_PROC_F_INITIATOR) {
-        pka = ble_sm_sc_pub_key;
+        pka = proc->our_pub_key;
         pkb = proc->pub_key_peer.x;
     } else {
         pka = proc->pub_key_peer.x;
-        pkb = ble_sm_sc_pub_key;
+        pkb = proc->our_pub_key;
     }
     res->app_status = ble_sm_alg_g2(pka, pkb, proc->randm, proc->rands,
                                     &res->passkey_params.numcmp);
@@ -403,15 +430,13 @@ ble_sm_sc_random_exec(struct ble_sm_proc *proc, struct ble_sm_result *res)
     }
 }
 
+static void ble_sm_sc_random_finish(struct ble_sm_proc *proc,
+                                    struct ble_sm_result *res);
+
 void
 ble_sm_sc_random_rx(struct ble_sm_proc *proc, struct ble_sm_result *res)
 {
     uint8_t confirm_val[16];
-    uint8_t ia[6];
-    uint8_t ra[6];
-    uint8_t ioact;
-    uint8_t iat;
-    uint8_t rat;
     int rc;
 
     if (proc->flags & BLE_SM_PROC_F_INITIATOR ||
@@ -421,7 +446,7 @@ ble_sm_sc_random_rx(struct ble_sm_proc *proc, struct ble_sm_result *res)
         ble_hs_log_flat_buf(proc->tk, 16);
         BLE_HS_LOG(DEBUG, "\n");
 
-        rc = ble_sm_alg_f4(proc->pub_key_peer.x, ble_sm_sc_pub_key,
+        rc = ble_sm_alg_f4(proc->pub_key_peer.x, proc->our_pub_key,
                            ble_sm_peer_pair_rand(proc), proc->ri,
                            confirm_val);
         if (rc != 0) {
@@ -440,6 +465,31 @@ ble_sm_sc_random_rx(struct ble_sm_proc *proc, struct ble_sm_result *res)
         }
     }
 
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    if (proc->flags & BLE_SM_PROC_F_DHKEY_PENDING) {
+        /* The DHKey is still being computed; finish when it arrives. */
+        proc->flags |= BLE_SM_PROC_F_DHKEY_WAIT;
+        return;
+    }
+#endif
+
+    ble_sm_sc_random_finish(proc, res);
+}
+
+/**
+ * Derives the MacKey and LTK once the peer's random value has been verified
+ * and continues the procedure.
+ */
+static void
+ble_sm_sc_random_finish(struct ble_sm_proc *proc, struct ble_sm_result *res)
+{
+    uint8_t ia[6];
+    uint8_t ra[6];
+    uint8_t ioact;
+    uint8_t iat;
+    uint8_t rat;
+    int rc;
+
     /* Calculate the mac key and ltk. */
     ble_sm_ia_ra(proc, &iat, ia, &rat, ra);
     rc = ble_sm_alg_f5(proc->dhkey, proc->randm, proc->rands,
@@ -497,8 +547,16 @@ ble_sm_sc_public_key_exec(struct ble_sm_proc *proc, struct ble_sm_result *res,
     struct ble_sm_public_key *cmd;
     struct os_mbuf *txom;
     uint8_t ioact;
+    int rc;
 
-    res->app_status = ble_sm_sc_ensure_keys_generated();
+    rc = ble_sm_sc_ensure_keys_generated(proc);
+    if (rc == BLE_HS_EAGAIN) {
+        /* Resumed by ble_sm_sc_key_pool_ready(). */
+        proc->flags |= BLE_SM_PROC_F_KEYS_WAIT;
+        return;
+    }
+
+    res->app_status = rc;
     if (res->app_status != 0) {
         res->enc_cb = 1;
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
@@ -513,8 +571,8 @@ ble_sm_sc_public_key_exec(struct ble_sm_proc *proc, struct ble_sm_result *res,
         return;
     }
 
-    memcpy(cmd->x, ble_sm_sc_pub_key + 0, 32);
-    memcpy(cmd->y, ble_sm_sc_pub_key + 32, 32);
+    memcpy(cmd->x, proc->our_pub_key + 0, 32);
+    memcpy(cmd->y, proc->our_pub_key + 32, 32);
 
     res->app_status = ble_sm_tx(proc->conn_handle, txom);
     if (res->app_status != 0) {
@@ -525,7 +583,6 @@ ble_sm_sc_public_key_exec(struct ble_sm_proc *proc, struct ble_sm_result *res,
 
     if (!(proc->flags & BLE_SM_PROC_F_INITIATOR)) {
         proc->state = BLE_SM_PROC_STATE_CONFIRM;
-        int rc;
 
         rc = ble_sm_sc_io_action(proc, &ioact);
         if (rc != 0) {
@@ -544,25 +601,195 @@ ble_sm_sc_public_key_exec(struct ble_sm_proc *proc, struct ble_sm_result *res,
     }
 }
 
-void
-ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
-                        struct ble_sm_result *res)
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+
+static struct ble_sm_sc_dhkey_job *
+ble_sm_sc_dhkey_job_alloc(void)
 {
-    struct ble_sm_public_key *cmd;
+    int i;
+
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_MAX_PROCS); i++) {
+        if (!ble_sm_sc_dhkey_jobs[i].in_use) {
+            return ble_sm_sc_dhkey_jobs + i;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+ble_sm_sc_dhkey_job_free(struct ble_sm_sc_dhkey_job *job)
+{
+    memset(&job->ecc.priv_key, 0, sizeof job->ecc.priv_key);
+    memset(&job->ecc.dhkey, 0, sizeof job->ecc.dhkey);
+    job->in_use = 0;
+}
+
+/**
+ * Hands a DHKey computation to the ECC task.  The procedure is marked
+ * pending; the state machine continues in ble_sm_sc_dhkey_job_done().
+ */
+static int
+ble_sm_sc_dhkey_job_start(struct ble_sm_proc *proc)
+{
+    struct ble_sm_sc_dhkey_job *job;
+    int rc;
+
+    job = ble_sm_sc_dhkey_job_alloc();
+    if (job == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    job->conn_handle = proc->conn_handle;
+    job->seq = ++ble_sm_sc_dhkey_job_seq;
+    job->ecc.op = BLE_SM_ALG_ECC_OP_DHKEY;
+    job->ecc.done_fn = ble_sm_sc_dhkey_job_done;
+    memcpy(job->ecc.pub_key, &proc->pub_key_peer, sizeof job->ecc.pub_key);
+    memcpy(job->ecc.priv_key, proc->our_priv_key, sizeof job->ecc.priv_key);
+
+    rc = ble_sm_alg_ecc_submit(&job->ecc);
+    if (rc != 0) {
+        ble_sm_sc_dhkey_job_free(job);
+        return rc;
+    }
+
+    job->in_use = 1;
+    proc->dhkey_job_seq = job->seq;
+    proc->flags |= BLE_SM_PROC_F_DHKEY_PENDING;
+
+    return 0;
+}
+
+/**
+ * Called in the host task when the ECC task has finished a DHKey
+ * computation.  Resumes the procedure that requested it, if it still exists.
+ */
+static void
+ble_sm_sc_dhkey_job_done(struct os_event *ev)
+{
+    struct ble_sm_sc_dhkey_job *job;
+    struct ble_sm_result res;
     struct ble_sm_proc *proc;
+    uint16_t conn_handle;
+    int resume;
+
+    job = (struct ble_sm_sc_dhkey_job *)ev->ev_arg;
+    conn_handle = job->conn_handle;
+
+    memset(&res, 0, sizeof res);
+    resume = 0;
+
+    ble_hs_lock();
+
+    proc = ble_sm_proc_find(conn_handle, BLE_SM_PROC_STATE_NONE, -1, NULL);
+
+    /* Ignore the result if the procedure that requested it is gone.  A new
+     * procedure on the same connection may be waiting for a job of its own,
+     * possibly with the same peer key, so match on the job's sequence number.
+     */
+    if (proc != NULL && proc->flags & BLE_SM_PROC_F_DHKEY_PENDING &&
+        proc->dhkey_job_seq == job->seq) {
+
+        proc->flags &= ~BLE_SM_PROC_F_DHKEY_PENDING;
+        resume = 1;
+
+        if (job->ecc.status != 0) {
+            res.app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
+            res.sm_err = BLE_SM_ERR_DHKEY;
+            res.enc_cb = 1;
+        } else {
+            memcpy(proc->dhkey, job->ecc.dhkey, sizeof proc->dhkey);
+            if (proc->flags & BLE_SM_PROC_F_DHKEY_WAIT) {
+                proc->flags &= ~BLE_SM_PROC_F_DHKEY_WAIT;
+                ble_sm_sc_random_finish(proc, &res);
+            }
+        }
+    }
+
+    ble_sm_sc_dhkey_job_free(job);
+
+    ble_hs_unlock();
+
+    if (resume) {
+        ble_sm_process_result(conn_handle, &res);
+    }
+}
+
+#endif
+
+/**
+ * Computes the DHKey for the specified procedure.  If the ECC task is
+ * enabled, the computation is performed asynchronously and the procedure is
+ * flagged as pending; otherwise the result is written to proc->dhkey before
+ * this function returns.
+ */
+static int
+ble_sm_sc_gen_dhkey(struct ble_sm_proc *proc)
+{
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    if (ble_sm_sc_dhkey_job_start(proc) == 0) {
+        return 0;
+    }
+
+    /* Fall back to a blocking computation. */
+#endif
+
+    return ble_sm_alg_gen_dhkey(proc->pub_key_peer.x, proc->pub_key_peer.y,
+                                proc->our_priv_key, proc->dhkey);
+}
+
+/**
+ * Continues a procedure once both public keys are known: starts the DHKey
+ * computation and advances to the confirm state.
+ */
+static void
+ble_sm_sc_public_key_process(struct ble_sm_proc *proc,
+                             struct ble_sm_result *res)
+{
     uint8_t ioact;
     int rc;
 
-    res->app_status = ble_hs_mbuf_pullup_base(om, sizeof(*cmd));
-    if (res->app_status != 0) {
+    rc = ble_sm_sc_gen_dhkey(proc);
+    if (rc != 0) {
+        res->app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
+        res->sm_err = BLE_SM_ERR_DHKEY;
         res->enc_cb = 1;
         return;
     }
 
-    res->app_status = ble_sm_sc_ensure_keys_generated();
+    if (proc->flags & BLE_SM_PROC_F_INITIATOR) {
+        proc->state = BLE_SM_PROC_STATE_CONFIRM;
+
+        rc = ble_sm_sc_io_action(proc, &ioact);
+        if (rc != 0) {
+            BLE_HS_DBG_ASSERT(0);
+        }
+
+        if (ble_sm_ioact_state(ioact) == proc->state) {
+            res->passkey_params.action = ioact;
+        }
+
+        if (ble_sm_proc_can_advance(proc) &&
+            ble_sm_sc_initiator_txes_confirm(proc)) {
+
+            res->execute = 1;
+        }
+    } else {
+        res->execute = 1;
+    }
+}
+
+void
+ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
+                        struct ble_sm_result *res)
+{
+    struct ble_sm_public_key *cmd;
+    struct ble_sm_proc *proc;
+    int rc;
+
+    res->app_status = ble_hs_mbuf_pullup_base(om, sizeof(*cmd));
     if (res->app_status != 0) {
         res->enc_cb = 1;
-        res->sm_err = BLE_SM_ERR_UNSPECIFIED;
         return;
     }
 
@@ -577,40 +804,80 @@ ble_sm_sc_public_key_rx(uint16_t conn_handle, struct os_mbuf **om,
         res->sm_err = BLE_SM_ERR_UNSPECIFIED;
     } else {
         memcpy(&proc->pub_key_peer, cmd, sizeof(*cmd));
-        rc = ble_sm_alg_gen_dhkey(proc->pub_key_peer.x,
-                                  proc->pub_key_peer.y,
-                                  ble_sm_sc_priv_key,
-                                  proc->dhkey);
-        if (rc != 0) {
-            res->app_status = BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY);
-            res->sm_err = BLE_SM_ERR_DHKEY;
+
+        /* Only copies a pooled key pair; key generation never happens with
+         * the host lock held.
+         */
+        rc = ble_sm_sc_ensure_keys_generated(proc);
+        if (rc == BLE_HS_EAGAIN) {
+            /* Resumed by ble_sm_sc_key_pool_ready(). */
+            proc->flags |= BLE_SM_PROC_F_KEYS_WAIT;
+        } else if (rc != 0) {
+            res->app_status = rc;
+            res->sm_err = BLE_SM_ERR_UNSPECIFIED;
             res->enc_cb = 1;
         } else {
-            if (proc->flags & BLE_SM_PROC_F_INITIATOR) {
-                int rc;
+            ble_sm_sc_public_key_process(proc, res);
+        }
+    }
+    ble_hs_unlock();
+}
 
-                proc->state = BLE_SM_PROC_STATE_CONFIRM;
+/**
+ * Called in the host task when the key pool has generated a key pair, or
+ * failed to.  Resumes the procedures that are waiting for a local key pair:
+ * an initiator sends its public key; a responder, which already has the
+ * peer's public key, continues with the DHKey computation.
+ *
+ * @param status                0 if a key pair was added to the pool;
+ *                                  nonzero if key generation failed.
+ */
+void
+ble_sm_sc_key_pool_ready(int status)
+{
+    struct ble_sm_result res;
+    struct ble_sm_proc *proc;
+    uint16_t conn_handle;
+    int rc;
 
-                rc = ble_sm_sc_io_action(proc, &ioact);
-                if (rc != 0) {
-                        BLE_HS_DBG_ASSERT(0);
-                }
+    while (1) {
+        memset(&res, 0, sizeof res);
 
-                if (ble_sm_ioact_state(ioact) == proc->state) {
-                    res->passkey_params.action = ioact;
-                }
+        ble_hs_lock();
 
-                if (ble_sm_proc_can_advance(proc) &&
-                    ble_sm_sc_initiator_txes_confirm(proc)) {
+        proc = ble_sm_proc_find_flags(BLE_SM_PROC_F_KEYS_WAIT);
+        if (proc == NULL) {
+            ble_hs_unlock();
+            return;
+        }
 
-                    res->execute = 1;
-                }
-            } else {
-                res->execute = 1;
+        rc = status;
+        if (rc == 0) {
+            rc = ble_sm_sc_ensure_keys_generated(proc);
+            if (rc == BLE_HS_EAGAIN) {
+                /* Pool drained again; the next key pair is on its way. */
+                ble_hs_unlock();
+                return;
             }
         }
+
+        proc->flags &= ~BLE_SM_PROC_F_KEYS_WAIT;
+        conn_handle = proc->conn_handle;
+
+        if (rc != 0) {
+            res.app_status = rc;
+            res.sm_err = BLE_SM_ERR_UNSPECIFIED;
+            res.enc_cb = 1;
+        } else if (proc->flags & BLE_SM_PROC_F_INITIATOR) {
+            res.execute = 1;
+        } else {
+            ble_sm_sc_public_key_process(proc, &res);
+        }
+
+        ble_hs_unlock();
+
+        ble_sm_process_result(conn_handle, &res);
     }
-    ble_hs_unlock();
 }
 
 static void
@@ -785,7 +1052,6 @@ void
 ble_sm_sc_init(void)
 {
     ble_sm_alg_ecc_init();
-    ble_sm_sc_keys_generated = 0;
 }
 
 #endif  /* MYNEWT_VAL(BLE_SM_SC) */
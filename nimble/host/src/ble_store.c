@@ -22,13 +22,40 @@
 #include "host/ble_store.h"
 #include "ble_hs_priv.h"
 
+/**
+ * Serializes calls into the persistence callbacks.  These may perform slow
+ * flash I/O, so they run under their own lock rather than the host lock.
+ * The host lock is never held while this lock is taken.
+ */
+static struct os_mutex ble_store_mutex;
+
+/* Attributes each acquisition to the function taking the lock. */
+#define ble_store_lock()        ble_store_lock_at(BLE_HS_LOCK_SITE)
+
+static void
+ble_store_lock_at(const char *site)
+{
+    BLE_HS_DBG_ASSERT(!ble_hs_locked_by_cur_task());
+
+    ble_hs_mutex_pend(&ble_store_mutex, site);
+}
+
+static void
+ble_store_unlock(void)
+{
+    int rc;
+
+    rc = os_mutex_release(&ble_store_mutex);
+    BLE_HS_DBG_ASSERT_EVAL(rc == 0 || rc == OS_NOT_STARTED);
+}
+
 int
 ble_store_read(int obj_type, const union ble_store_key *key,
                union ble_store_value *val)
 {
     int rc;
 
-    ble_hs_lock();
+    ble_store_lock();
 
     if (ble_hs_cfg.store_read_cb == NULL) {
         rc = BLE_HS_ENOTSUP;
@@ -36,14 +63,47 @@ ble_store_read(int obj_type, const union ble_store_key *key,
         rc = ble_hs_cfg.store_read_cb(obj_type, key, val);
     }
 
-    ble_hs_unlock();
+    ble_store_unlock();
 
     return rc;
 }
 
+/**
+ * Indicates whether writing the specified peer security record changes what
+ * the host-side address resolver knows about the peer: a new identity or a
+ * different IRK.  Rewrites that only update other fields, such as the
+ * SignCounter, leave the resolver intact.  Must be called with the store
+ * lock held.
+ */
+static int
+ble_store_peer_irk_changed(const struct ble_store_value_sec *value_sec)
+{
+    union ble_store_value old;
+    union ble_store_key key;
+    int rc;
+
+    if (ble_hs_cfg.store_read_cb == NULL) {
+        return 1;
+    }
+
+    ble_store_key_from_value_sec(&key.sec, value_sec);
+    rc = ble_hs_cfg.store_read_cb(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &old);
+    if (rc != 0) {
+        return 1;
+    }
+
+    if (old.sec.irk_present != value_sec->irk_present) {
+        return 1;
+    }
+
+    return value_sec->irk_present &&
+           memcmp(old.sec.irk, value_sec->irk, sizeof old.sec.irk) != 0;
+}
+
 int
 ble_store_write(int obj_type, const union ble_store_value *val)
 {
+    int irk_changed;
     int rc;
 
     if (ble_hs_cfg.store_write_cb == NULL) {
@@ -51,12 +111,17 @@ ble_store_write(int obj_type, const union ble_store_value *val)
     }
 
     while (1) {
-        ble_hs_lock();
+        ble_store_lock();
+        irk_changed = obj_type == BLE_STORE_OBJ_TYPE_PEER_SEC &&
+                      ble_store_peer_irk_changed(&val->sec);
         rc = ble_hs_cfg.store_write_cb(obj_type, val);
-        ble_hs_unlock();
+        ble_store_unlock();
 
         switch (rc) {
         case 0:
+            if (irk_changed) {
+                ble_hs_resolv_invalidate();
+            }
             return 0;
         case BLE_HS_ESTORE_CAP:
             /* Record didn't fit.  Give the application the opportunity to free
@@ -76,12 +141,35 @@ ble_store_write(int obj_type, const union ble_store_value *val)
     }
 }
 
+/**
+ * Writes any modified objects the store is holding in RAM to persistent
+ * storage.  The host calls this whenever a connection terminates.
+ *
+ * @return                      0 on success;
+ *                              Other nonzero on error.
+ */
+int
+ble_store_flush(void)
+{
+    int rc;
+
+    if (ble_hs_cfg.store_flush_cb == NULL) {
+        return 0;
+    }
+
+    ble_store_lock();
+    rc = ble_hs_cfg.store_flush_cb();
+    ble_store_unlock();
+
+    return rc;
+}
+
 int
 ble_store_delete(int obj_type, const union ble_store_key *key)
 {
     int rc;
 
-    ble_hs_lock();
+    ble_store_lock();
 
     if (ble_hs_cfg.store_delete_cb == NULL) {
         rc = BLE_HS_ENOTSUP;
@@ -89,7 +177,11 @@ ble_store_delete(int obj_type, const union ble_store_key *key)
         rc = ble_hs_cfg.store_delete_cb(obj_type, key);
     }
 
-    ble_hs_unlock();
+    ble_store_unlock();
+
+    if (rc == 0 && obj_type == BLE_STORE_OBJ_TYPE_PEER_SEC) {
+        ble_hs_resolv_invalidate();
+    }
 
     return rc;
 }
@@ -327,16 +419,66 @@ ble_store_key_from_value(int obj_type,
     }
 }
 
+/**
+ * Calls the specified function for each object matching the given key,
+ * retrieving matches one at a time with increasing key indices.  The store
+ * lock is only held during each read, so the callback runs unlocked.
+ */
+static int
+ble_store_iterate_read(int obj_type, union ble_store_key *key, uint8_t *pidx,
+                       ble_store_iterator_fn *callback, void *cookie)
+{
+    union ble_store_value value;
+    int idx;
+    int rc;
+
+    idx = 0;
+    while (1) {
+        *pidx = idx;
+        rc = ble_store_read(obj_type, key, &value);
+        switch (rc) {
+        case 0:
+            rc = callback(obj_type, &value, cookie);
+            if (rc != 0) {
+                /* User function indicates to stop iterating. */
+                return 0;
+            }
+            break;
+
+        case BLE_HS_ENOENT:
+            /* No more entries. */
+            return 0;
+
+        default:
+            /* Read error. */
+            return rc;
+        }
+
+        idx++;
+    }
+}
+
+static int
+ble_store_iterate_nop(int obj_type, union ble_store_value *val, void *cookie)
+{
+    return 0;
+}
+
+/**
+ * Calls the specified function for each object of the given type.  Objects
+ * are read one at a time and the callback is called without any lock held,
+ * so it may call back into the store.
+ *
+ * @return                      0 on success;
+ *                              Other nonzero on error.
+ */
 int
 ble_store_iterate(int obj_type,
                   ble_store_iterator_fn *callback,
                   void *cookie)
 {
     union ble_store_key key;
-    union ble_store_value value;
-    int idx = 0;
     uint8_t *pidx;
-    int rc;
 
     /* a magic value to retrieve anything */
     memset(&key, 0, sizeof(key));
@@ -355,31 +497,49 @@ ble_store_iterate(int obj_type,
             return BLE_HS_EINVAL;
     }
 
-    while (1) {
-        *pidx = idx;
-        rc = ble_store_read(obj_type, &key, &value);
-        switch (rc) {
-        case 0:
-            if (callback != NULL) {
-                rc = callback(obj_type, &value, cookie);
-                if (rc != 0) {
-                    /* User function indicates to stop iterating. */
-                    return 0;
-                }
-            }
-            break;
+    if (callback == NULL) {
+        callback = ble_store_iterate_nop;
+    }
 
-        case BLE_HS_ENOENT:
-            /* No more entries. */
-            return 0;
+    return ble_store_iterate_read(obj_type, &key, pidx, callback, cookie);
+}
 
-        default:
-            /* Read error. */
-            return rc;
-        }
+/**
+ * Calls the specified function for each CCCD record matching the given key;
+ * e.g., every record for a particular characteristic.  The key's idx field is
+ * ignored.
+ *
+ * If the store provides an iterate callback, the whole pass is made in one
+ * call under the store lock.  The callback may then take the host lock and
+ * rewrite the record it is passed (the store lock nests), but must not add or
+ * delete CCCD records, nor wait on a task that uses the store.  This is only
+ * used internally; ble_store_iterate() keeps the unlocked behavior.
+ *
+ * @return                      0 on success;
+ *                              Other nonzero on error.
+ */
+int
+ble_store_iterate_cccd(const struct ble_store_key_cccd *key,
+                       ble_store_iterator_fn *callback,
+                       void *cookie)
+{
+    union ble_store_key store_key;
+    int rc;
 
-        idx++;
+    store_key.cccd = *key;
+    store_key.cccd.idx = 0;
+
+    if (ble_hs_cfg.store_iterate_cb != NULL) {
+        ble_store_lock();
+        rc = ble_hs_cfg.store_iterate_cb(BLE_STORE_OBJ_TYPE_CCCD, &store_key,
+                                         callback, cookie);
+        ble_store_unlock();
+
+        return rc;
     }
+
+    return ble_store_iterate_read(BLE_STORE_OBJ_TYPE_CCCD, &store_key,
+                                  &store_key.cccd.idx, callback, cookie);
 }
 
 /**
@@ -418,3 +578,16 @@ ble_store_clear(void)
 
     return 0;
 }
+
+int
+ble_store_init(void)
+{
+    int rc;
+
+    rc = os_mutex_init(&ble_store_mutex);
+    if (rc != 0) {
+        return BLE_HS_EOS;
+    }
+
+    return 0;
+}
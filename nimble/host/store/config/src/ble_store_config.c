@@ -22,24 +22,200 @@
 
 #include "sysinit/sysinit.h"
 #include "syscfg/syscfg.h"
+#include "stats/stats.h"
 #include "host/ble_hs.h"
 #include "config/config.h"
 #include "base64/base64.h"
 #include "store/config/ble_store_config.h"
+#include "store/idx/ble_store_idx.h"
 #include "ble_store_config_priv.h"
 
 struct ble_store_value_sec
     ble_store_config_our_secs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+uint16_t ble_store_config_our_sec_slots[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
 int ble_store_config_num_our_secs;
 
 struct ble_store_value_sec
     ble_store_config_peer_secs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+uint16_t ble_store_config_peer_sec_slots[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
 int ble_store_config_num_peer_secs;
 
 struct ble_store_value_cccd
     ble_store_config_cccds[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
+uint16_t ble_store_config_cccd_slots[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
 int ble_store_config_num_cccds;
 
+STATS_SECT_DECL(ble_store_config_stats) ble_store_config_stats;
+STATS_NAME_START(ble_store_config_stats)
+    STATS_NAME(ble_store_config_stats, cccd_write)
+    STATS_NAME(ble_store_config_stats, cccd_write_unchanged)
+    STATS_NAME(ble_store_config_stats, cccd_write_coalesced)
+    STATS_NAME(ble_store_config_stats, cccd_persist)
+    STATS_NAME(ble_store_config_stats, cccd_persist_fail)
+    STATS_NAME(ble_store_config_stats, flush)
+STATS_NAME_END(ble_store_config_stats)
+
+/*****************************************************************************
+ * $slot                                                                     *
+ *****************************************************************************/
+
+/**
+ * Free record slots of each entry type, kept as a stack so that allocating
+ * and releasing a slot is O(1).  Slot numbers are always smaller than the
+ * capacity of the entry type.
+ */
+#define BLE_STORE_CONFIG_SLOT_POOL_DEFINE(name, sz)                         \
+    static uint16_t name ## _free[sz];                                      \
+    struct ble_store_config_slot_pool name = {                              \
+        .free = name ## _free,                                              \
+        .size = (sz),                                                       \
+    }
+
+BLE_STORE_CONFIG_SLOT_POOL_DEFINE(ble_store_config_our_sec_slot_pool,
+                                  MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_CONFIG_SLOT_POOL_DEFINE(ble_store_config_peer_sec_slot_pool,
+                                  MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_CONFIG_SLOT_POOL_DEFINE(ble_store_config_cccd_slot_pool,
+                                  MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
+
+/**
+ * Allocates a persistent record slot for a new entry.  Each entry keeps the
+ * same slot for its whole lifetime, so the entry can be rewritten or erased
+ * in persistent storage without touching any other entry.  The caller must
+ * ensure the entry type has room for another entry.
+ *
+ * @param pool                  The slot pool of the entry type.
+ *
+ * @return                      An unused slot number.
+ */
+uint16_t
+ble_store_config_slot_alloc(struct ble_store_config_slot_pool *pool)
+{
+    pool->num_free--;
+    return pool->free[pool->num_free];
+}
+
+/**
+ * Returns the slot of a removed entry to its pool.
+ */
+void
+ble_store_config_slot_free(struct ble_store_config_slot_pool *pool,
+                           uint16_t slot)
+{
+    pool->free[pool->num_free] = slot;
+    pool->num_free++;
+}
+
+/**
+ * Rebuilds a slot pool from the slots used by the entries in RAM.  Entries
+ * without a slot (BLE_STORE_CONFIG_SLOT_NONE) don't consume one.
+ */
+static void
+ble_store_config_slot_rebuild(struct ble_store_config_slot_pool *pool,
+                              const uint16_t *slots, int num_slots)
+{
+    int slot;
+    int i;
+
+    /* Mark used slots in the free array, then compact the unused slot
+     * numbers into it.  The write position never passes the read position,
+     * so no mark is overwritten before it is read.
+     */
+    for (i = 0; i < pool->size; i++) {
+        pool->free[i] = 0;
+    }
+    for (i = 0; i < num_slots; i++) {
+        if (slots[i] < pool->size) {
+            pool->free[slots[i]] = 1;
+        }
+    }
+
+    pool->num_free = 0;
+    for (slot = 0; slot < pool->size; slot++) {
+        if (!pool->free[slot]) {
+            pool->free[pool->num_free] = slot;
+            pool->num_free++;
+        }
+    }
+
+    /* Hand out the lowest slots first. */
+    for (i = 0; i < pool->num_free / 2; i++) {
+        slot = pool->free[i];
+        pool->free[i] = pool->free[pool->num_free - 1 - i];
+        pool->free[pool->num_free - 1 - i] = slot;
+    }
+}
+
+/**
+ * Finds the entry occupying the specified persistent record slot.
+ *
+ * @return                      The entry index on success; -1 if the slot is
+ *                                  unused.
+ */
+int
+ble_store_config_slot_find(const uint16_t *slots, int num_slots,
+                           uint16_t slot)
+{
+    int i;
+
+    for (i = 0; i < num_slots; i++) {
+        if (slots[i] == slot) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*****************************************************************************
+ * $index                                                                    *
+ *****************************************************************************/
+
+BLE_STORE_IDX_DEFINE(ble_store_config_our_sec_addr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_config_our_sec_ediv_rand_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_config_peer_sec_addr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_config_peer_sec_ediv_rand_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_config_cccd_addr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
+BLE_STORE_IDX_DEFINE(ble_store_config_cccd_chr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
+
+/**
+ * Rebuilds all lookup indices and slot pools from the entry arrays.  Must be
+ * called after the arrays are modified directly (e.g., when they are loaded
+ * from persistent storage).
+ */
+void
+ble_store_config_idx_rebuild(void)
+{
+    ble_store_config_slot_rebuild(&ble_store_config_our_sec_slot_pool,
+                                  ble_store_config_our_sec_slots,
+                                  ble_store_config_num_our_secs);
+    ble_store_config_slot_rebuild(&ble_store_config_peer_sec_slot_pool,
+                                  ble_store_config_peer_sec_slots,
+                                  ble_store_config_num_peer_secs);
+    ble_store_config_slot_rebuild(&ble_store_config_cccd_slot_pool,
+                                  ble_store_config_cccd_slots,
+                                  ble_store_config_num_cccds);
+
+    ble_store_idx_sec_rebuild(&ble_store_config_our_sec_addr_idx,
+                              &ble_store_config_our_sec_ediv_rand_idx,
+                              ble_store_config_our_secs,
+                              ble_store_config_num_our_secs);
+    ble_store_idx_sec_rebuild(&ble_store_config_peer_sec_addr_idx,
+                              &ble_store_config_peer_sec_ediv_rand_idx,
+                              ble_store_config_peer_secs,
+                              ble_store_config_num_peer_secs);
+    ble_store_idx_cccd_rebuild(&ble_store_config_cccd_addr_idx,
+                               &ble_store_config_cccd_chr_idx,
+                               ble_store_config_cccds,
+                               ble_store_config_num_cccds);
+}
+
 /*****************************************************************************
  * $sec                                                                      *
  *****************************************************************************/
@@ -85,42 +261,23 @@ ble_store_config_print_key_sec(const struct ble_store_key_sec *key_sec)
 static int
 ble_store_config_find_sec(const struct ble_store_key_sec *key_sec,
                           const struct ble_store_value_sec *value_secs,
-                          int num_value_secs)
+                          int num_value_secs,
+                          const struct ble_store_idx *addr_idx,
+                          const struct ble_store_idx *ediv_rand_idx)
 {
-    const struct ble_store_value_sec *cur;
     int skipped;
     int i;
 
-    skipped = 0;
-
-    for (i = 0; i < num_value_secs; i++) {
-        cur = value_secs + i;
-
-        if (ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
-            if (ble_addr_cmp(&cur->peer_addr, &key_sec->peer_addr)) {
-                continue;
-            }
-        }
-
-        if (key_sec->ediv_rand_present) {
-            if (cur->ediv != key_sec->ediv) {
-                continue;
-            }
-
-            if (cur->rand_num != key_sec->rand_num) {
-                continue;
-            }
-        }
-
-        if (key_sec->idx > skipped) {
-            skipped++;
-            continue;
+    i = -1;
+    for (skipped = 0; skipped <= key_sec->idx; skipped++) {
+        i = ble_store_idx_sec_next(key_sec, value_secs, num_value_secs,
+                                   addr_idx, ediv_rand_idx, i);
+        if (i == -1) {
+            break;
         }
-
-        return i;
     }
 
-    return -1;
+    return i;
 }
 
 static int
@@ -130,7 +287,9 @@ ble_store_config_read_our_sec(const struct ble_store_key_sec *key_sec,
     int idx;
 
     idx = ble_store_config_find_sec(key_sec, ble_store_config_our_secs,
-                                    ble_store_config_num_our_secs);
+                                    ble_store_config_num_our_secs,
+                                    &ble_store_config_our_sec_addr_idx,
+                                    &ble_store_config_our_sec_ediv_rand_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -152,7 +311,9 @@ ble_store_config_write_our_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_key_from_value_sec(&key_sec, value_sec);
     idx = ble_store_config_find_sec(&key_sec, ble_store_config_our_secs,
-                                    ble_store_config_num_our_secs);
+                                    ble_store_config_num_our_secs,
+                                    &ble_store_config_our_sec_addr_idx,
+                                    &ble_store_config_our_sec_ediv_rand_idx);
     if (idx == -1) {
         if (ble_store_config_num_our_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
             BLE_HS_LOG(DEBUG, "error persisting our sec; too many entries "
@@ -161,12 +322,19 @@ ble_store_config_write_our_sec(const struct ble_store_value_sec *value_sec)
         }
 
         idx = ble_store_config_num_our_secs;
+        ble_store_config_our_sec_slots[idx] =
+            ble_store_config_slot_alloc(&ble_store_config_our_sec_slot_pool);
         ble_store_config_num_our_secs++;
-    }
 
-    ble_store_config_our_secs[idx] = *value_sec;
+        ble_store_config_our_secs[idx] = *value_sec;
+        ble_store_idx_sec_add(&ble_store_config_our_sec_addr_idx,
+                              &ble_store_config_our_sec_ediv_rand_idx,
+                              value_sec, idx);
+    } else {
+        ble_store_config_our_secs[idx] = *value_sec;
+    }
 
-    rc = ble_store_config_persist_our_secs();
+    rc = ble_store_config_persist_our_sec(idx);
     if (rc != 0) {
         return rc;
     }
@@ -174,9 +342,9 @@ ble_store_config_write_our_sec(const struct ble_store_value_sec *value_sec)
     return 0;
 }
 
-static int
-ble_store_config_delete_obj(void *values, int value_size, int idx,
-                            int *num_values)
+int
+ble_store_config_delete_obj(void *values, int value_size, uint16_t *slots,
+                            int idx, int *num_values)
 {
     uint8_t *dst;
     uint8_t *src;
@@ -190,6 +358,7 @@ ble_store_config_delete_obj(void *values, int value_size, int idx,
 
         move_count = *num_values - idx;
         memmove(dst, src, move_count * value_size);
+        memmove(slots + idx, slots + idx + 1, move_count * sizeof *slots);
     }
 
     return 0;
@@ -198,37 +367,55 @@ ble_store_config_delete_obj(void *values, int value_size, int idx,
 static int
 ble_store_config_delete_sec(const struct ble_store_key_sec *key_sec,
                             struct ble_store_value_sec *value_secs,
-                            int *num_value_secs)
+                            uint16_t *slots,
+                            struct ble_store_config_slot_pool *slot_pool,
+                            int *num_value_secs,
+                            struct ble_store_idx *addr_idx,
+                            struct ble_store_idx *ediv_rand_idx,
+                            uint16_t *out_slot)
 {
     int idx;
     int rc;
 
-    idx = ble_store_config_find_sec(key_sec, value_secs, *num_value_secs);
+    idx = ble_store_config_find_sec(key_sec, value_secs, *num_value_secs,
+                                    addr_idx, ediv_rand_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
 
-    rc = ble_store_config_delete_obj(value_secs, sizeof *value_secs, idx,
-                                  num_value_secs);
+    *out_slot = slots[idx];
+
+    rc = ble_store_config_delete_obj(value_secs, sizeof *value_secs, slots,
+                                     idx, num_value_secs);
     if (rc != 0) {
         return rc;
     }
 
+    ble_store_idx_sec_rebuild(addr_idx, ediv_rand_idx, value_secs,
+                              *num_value_secs);
+    ble_store_config_slot_free(slot_pool, *out_slot);
+
     return 0;
 }
 
 static int
 ble_store_config_delete_our_sec(const struct ble_store_key_sec *key_sec)
 {
+    uint16_t slot;
     int rc;
 
     rc = ble_store_config_delete_sec(key_sec, ble_store_config_our_secs,
-                                     &ble_store_config_num_our_secs);
+                                     ble_store_config_our_sec_slots,
+                                     &ble_store_config_our_sec_slot_pool,
+                                     &ble_store_config_num_our_secs,
+                                     &ble_store_config_our_sec_addr_idx,
+                                     &ble_store_config_our_sec_ediv_rand_idx,
+                                     &slot);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_store_config_persist_our_secs();
+    rc = ble_store_config_erase_our_sec(slot);
     if (rc != 0) {
         return rc;
     }
@@ -239,15 +426,21 @@ ble_store_config_delete_our_sec(const struct ble_store_key_sec *key_sec)
 static int
 ble_store_config_delete_peer_sec(const struct ble_store_key_sec *key_sec)
 {
+    uint16_t slot;
     int rc;
 
     rc = ble_store_config_delete_sec(key_sec, ble_store_config_peer_secs,
-                                  &ble_store_config_num_peer_secs);
+                                     ble_store_config_peer_sec_slots,
+                                     &ble_store_config_peer_sec_slot_pool,
+                                     &ble_store_config_num_peer_secs,
+                                     &ble_store_config_peer_sec_addr_idx,
+                                     &ble_store_config_peer_sec_ediv_rand_idx,
+                                     &slot);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_store_config_persist_peer_secs();
+    rc = ble_store_config_erase_peer_sec(slot);
     if (rc != 0) {
         return rc;
     }
@@ -262,7 +455,9 @@ ble_store_config_read_peer_sec(const struct ble_store_key_sec *key_sec,
     int idx;
 
     idx = ble_store_config_find_sec(key_sec, ble_store_config_peer_secs,
-                             ble_store_config_num_peer_secs);
+                                    ble_store_config_num_peer_secs,
+                                    &ble_store_config_peer_sec_addr_idx,
+                                    &ble_store_config_peer_sec_ediv_rand_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -283,7 +478,9 @@ ble_store_config_write_peer_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_key_from_value_sec(&key_sec, value_sec);
     idx = ble_store_config_find_sec(&key_sec, ble_store_config_peer_secs,
-                                 ble_store_config_num_peer_secs);
+                                    ble_store_config_num_peer_secs,
+                                    &ble_store_config_peer_sec_addr_idx,
+                                    &ble_store_config_peer_sec_ediv_rand_idx);
     if (idx == -1) {
         if (ble_store_config_num_peer_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
             BLE_HS_LOG(DEBUG, "error persisting peer sec; too many entries "
@@ -292,12 +489,19 @@ ble_store_config_write_peer_sec(const struct ble_store_value_sec *value_sec)
         }
 
         idx = ble_store_config_num_peer_secs;
+        ble_store_config_peer_sec_slots[idx] =
+            ble_store_config_slot_alloc(&ble_store_config_peer_sec_slot_pool);
         ble_store_config_num_peer_secs++;
-    }
 
-    ble_store_config_peer_secs[idx] = *value_sec;
+        ble_store_config_peer_secs[idx] = *value_sec;
+        ble_store_idx_sec_add(&ble_store_config_peer_sec_addr_idx,
+                              &ble_store_config_peer_sec_ediv_rand_idx,
+                              value_sec, idx);
+    } else {
+        ble_store_config_peer_secs[idx] = *value_sec;
+    }
 
-    rc = ble_store_config_persist_peer_secs();
+    rc = ble_store_config_persist_peer_sec(idx);
     if (rc != 0) {
         return rc;
     }
@@ -306,46 +510,222 @@ ble_store_config_write_peer_sec(const struct ble_store_value_sec *value_sec)
 }
 
 /*****************************************************************************
- * $cccd                                                                     *
+ * $flush                                                                    *
  *****************************************************************************/
 
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) && \
+    MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_FLUSH_DELAY) > 0
+
+/**
+ * CCCD records are written behind: a modified record is marked dirty by slot
+ * and persisted when the flush timer expires, when too many records are
+ * pending, or when the host requests a flush.  Each record is saved with a
+ * single sys/config write, so a reset can only lose pending modifications;
+ * it never leaves a partially written record behind.  Security material is
+ * always written immediately.
+ */
+static uint8_t ble_store_config_cccd_dirty[
+    (MYNEWT_VAL(BLE_STORE_MAX_CCCDS) + 7) / 8];
+static int ble_store_config_cccd_num_dirty;
+static struct os_callout ble_store_config_flush_timer;
+
 static int
-ble_store_config_find_cccd(const struct ble_store_key_cccd *key)
+ble_store_config_cccd_is_dirty(uint16_t slot)
 {
-    struct ble_store_value_cccd *cccd;
-    int skipped;
+    return ble_store_config_cccd_dirty[slot / 8] & (1 << (slot % 8));
+}
+
+static void
+ble_store_config_cccd_clear_dirty(uint16_t slot)
+{
+    if (ble_store_config_cccd_is_dirty(slot)) {
+        ble_store_config_cccd_dirty[slot / 8] &= ~(1 << (slot % 8));
+        ble_store_config_cccd_num_dirty--;
+    }
+}
+
+/**
+ * Writes all dirty CCCD records to persistent storage.  Records that fail to
+ * persist stay dirty and are retried on the next flush.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ESTORE_FAIL if a record could not be
+ *                                  written.
+ */
+int
+ble_store_config_flush(void)
+{
+    uint16_t slot;
+    int status;
+    int rc;
     int i;
 
-    skipped = 0;
-    for (i = 0; i < ble_store_config_num_cccds; i++) {
-        cccd = ble_store_config_cccds + i;
+    os_callout_stop(&ble_store_config_flush_timer);
 
-        if (ble_addr_cmp(&key->peer_addr, BLE_ADDR_ANY)) {
-            if (ble_addr_cmp(&cccd->peer_addr, &key->peer_addr)) {
-                continue;
-            }
-        }
+    if (ble_store_config_cccd_num_dirty == 0) {
+        return 0;
+    }
 
-        if (key->chr_val_handle != 0) {
-            if (cccd->chr_val_handle != key->chr_val_handle) {
-                continue;
-            }
+    STATS_INC(ble_store_config_stats, flush);
+
+    status = 0;
+    for (i = 0; i < ble_store_config_num_cccds; i++) {
+        slot = ble_store_config_cccd_slots[i];
+        if (!ble_store_config_cccd_is_dirty(slot)) {
+            continue;
         }
 
-        if (key->idx > skipped) {
-            skipped++;
+        rc = ble_store_config_persist_cccd(i);
+        if (rc != 0) {
+            STATS_INC(ble_store_config_stats, cccd_persist_fail);
+            status = rc;
             continue;
         }
 
-        return i;
+        STATS_INC(ble_store_config_stats, cccd_persist);
+        ble_store_config_cccd_clear_dirty(slot);
     }
 
-    return -1;
+    if (ble_store_config_cccd_num_dirty > 0) {
+        os_callout_reset(&ble_store_config_flush_timer,
+            os_time_ms_to_ticks32(MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_FLUSH_DELAY)));
+    }
+
+    return status;
+}
+
+static void
+ble_store_config_flush_timer_exp(struct os_event *ev)
+{
+    ble_store_flush();
+}
+
+/**
+ * Schedules a CCCD entry to be persisted.  The record is written immediately
+ * if this brings the number of pending records to the configured maximum.
+ */
+static int
+ble_store_config_cccd_schedule(int idx)
+{
+    uint16_t slot;
+
+    slot = ble_store_config_cccd_slots[idx];
+    if (ble_store_config_cccd_is_dirty(slot)) {
+        /* The pending write will pick up this modification. */
+        STATS_INC(ble_store_config_stats, cccd_write_coalesced);
+        return 0;
+    }
+
+    ble_store_config_cccd_dirty[slot / 8] |= 1 << (slot % 8);
+    ble_store_config_cccd_num_dirty++;
+
+    if (ble_store_config_cccd_num_dirty >=
+        MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_MAX_DIRTY)) {
+
+        return ble_store_config_flush();
+    }
+
+    if (!os_callout_queued(&ble_store_config_flush_timer)) {
+        os_callout_reset(&ble_store_config_flush_timer,
+            os_time_ms_to_ticks32(MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_FLUSH_DELAY)));
+    }
+
+    return 0;
+}
+
+static void
+ble_store_config_flush_init(void)
+{
+    /* The timer may still be armed if this is a unit test rerunning
+     * sysinit.
+     */
+    os_callout_stop(&ble_store_config_flush_timer);
+
+    memset(ble_store_config_cccd_dirty, 0,
+           sizeof ble_store_config_cccd_dirty);
+    ble_store_config_cccd_num_dirty = 0;
+
+    os_callout_init(&ble_store_config_flush_timer, os_eventq_dflt_get(),
+                    ble_store_config_flush_timer_exp, NULL);
+}
+
+#else
+
+int
+ble_store_config_flush(void)
+{
+    return 0;
+}
+
+static int
+ble_store_config_cccd_schedule(int idx)
+{
+    int rc;
+
+    rc = ble_store_config_persist_cccd(idx);
+    if (rc != 0) {
+        STATS_INC(ble_store_config_stats, cccd_persist_fail);
+        return rc;
+    }
+
+    STATS_INC(ble_store_config_stats, cccd_persist);
+    return 0;
+}
+
+static void
+ble_store_config_cccd_clear_dirty(uint16_t slot)
+{
+}
+
+static void
+ble_store_config_flush_init(void)
+{
+}
+
+#endif
+
+/*****************************************************************************
+ * $cccd                                                                     *
+ *****************************************************************************/
+
+/**
+ * Compares two CCCD entries field by field; the structs contain padding and a
+ * bit-field, so they can't be compared with memcmp().
+ */
+static int
+ble_store_config_cccd_equal(const struct ble_store_value_cccd *a,
+                            const struct ble_store_value_cccd *b)
+{
+    return ble_addr_cmp(&a->peer_addr, &b->peer_addr) == 0 &&
+           a->chr_val_handle == b->chr_val_handle &&
+           a->flags == b->flags &&
+           a->value_changed == b->value_changed;
+}
+
+static int
+ble_store_config_find_cccd(const struct ble_store_key_cccd *key)
+{
+    int skipped;
+    int i;
+
+    i = -1;
+    for (skipped = 0; skipped <= key->idx; skipped++) {
+        i = ble_store_idx_cccd_next(key, ble_store_config_cccds,
+                                    ble_store_config_num_cccds,
+                                    &ble_store_config_cccd_addr_idx,
+                                    &ble_store_config_cccd_chr_idx, i);
+        if (i == -1) {
+            break;
+        }
+    }
+
+    return i;
 }
 
 static int
 ble_store_config_delete_cccd(const struct ble_store_key_cccd *key_cccd)
 {
+    uint16_t slot;
     int idx;
     int rc;
 
@@ -354,15 +734,27 @@ ble_store_config_delete_cccd(const struct ble_store_key_cccd *key_cccd)
         return BLE_HS_ENOENT;
     }
 
+    slot = ble_store_config_cccd_slots[idx];
+
     rc = ble_store_config_delete_obj(ble_store_config_cccds,
                                      sizeof *ble_store_config_cccds,
+                                     ble_store_config_cccd_slots,
                                      idx,
                                      &ble_store_config_num_cccds);
     if (rc != 0) {
         return rc;
     }
 
-    rc = ble_store_config_persist_cccds();
+    ble_store_idx_cccd_rebuild(&ble_store_config_cccd_addr_idx,
+                               &ble_store_config_cccd_chr_idx,
+                               ble_store_config_cccds,
+                               ble_store_config_num_cccds);
+    ble_store_config_slot_free(&ble_store_config_cccd_slot_pool, slot);
+
+    /* A pending write must not resurrect the record. */
+    ble_store_config_cccd_clear_dirty(slot);
+
+    rc = ble_store_config_erase_cccd(slot);
     if (rc != 0) {
         return rc;
     }
@@ -402,12 +794,29 @@ ble_store_config_write_cccd(const struct ble_store_value_cccd *value_cccd)
         }
 
         idx = ble_store_config_num_cccds;
+        ble_store_config_cccd_slots[idx] =
+            ble_store_config_slot_alloc(&ble_store_config_cccd_slot_pool);
         ble_store_config_num_cccds++;
+
+        ble_store_config_cccds[idx] = *value_cccd;
+        ble_store_idx_cccd_add(&ble_store_config_cccd_addr_idx,
+                               &ble_store_config_cccd_chr_idx, value_cccd,
+                               idx);
+    } else {
+        if (ble_store_config_cccd_equal(ble_store_config_cccds + idx,
+                                        value_cccd)) {
+
+            /* Nothing changed; don't wear out the flash. */
+            STATS_INC(ble_store_config_stats, cccd_write_unchanged);
+            return 0;
+        }
+
+        ble_store_config_cccds[idx] = *value_cccd;
     }
 
-    ble_store_config_cccds[idx] = *value_cccd;
+    STATS_INC(ble_store_config_stats, cccd_write);
 
-    rc = ble_store_config_persist_cccds();
+    rc = ble_store_config_cccd_schedule(idx);
     if (rc != 0) {
         return rc;
     }
@@ -514,20 +923,107 @@ ble_store_config_delete(int obj_type, const union ble_store_key *key)
     }
 }
 
+/**
+ * Calls the specified function for each object matching the given key.  The
+ * key's idx field is ignored.  The callback may rewrite the object it is
+ * passed, but must not add or delete objects of the type being iterated.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTSUP if the object type is not
+ *                                  supported.
+ */
+int
+ble_store_config_iterate(int obj_type, const union ble_store_key *key,
+                         ble_store_iterator_fn *cb, void *cookie)
+{
+    union ble_store_value value;
+    int i;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+        i = -1;
+        while (1) {
+            i = ble_store_idx_sec_next(
+                    &key->sec, ble_store_config_peer_secs,
+                    ble_store_config_num_peer_secs,
+                    &ble_store_config_peer_sec_addr_idx,
+                    &ble_store_config_peer_sec_ediv_rand_idx, i);
+            if (i == -1) {
+                return 0;
+            }
+
+            value.sec = ble_store_config_peer_secs[i];
+            if (cb(obj_type, &value, cookie) != 0) {
+                return 0;
+            }
+        }
+
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        i = -1;
+        while (1) {
+            i = ble_store_idx_sec_next(
+                    &key->sec, ble_store_config_our_secs,
+                    ble_store_config_num_our_secs,
+                    &ble_store_config_our_sec_addr_idx,
+                    &ble_store_config_our_sec_ediv_rand_idx, i);
+            if (i == -1) {
+                return 0;
+            }
+
+            value.sec = ble_store_config_our_secs[i];
+            if (cb(obj_type, &value, cookie) != 0) {
+                return 0;
+            }
+        }
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        i = -1;
+        while (1) {
+            i = ble_store_idx_cccd_next(&key->cccd, ble_store_config_cccds,
+                                        ble_store_config_num_cccds,
+                                        &ble_store_config_cccd_addr_idx,
+                                        &ble_store_config_cccd_chr_idx, i);
+            if (i == -1) {
+                return 0;
+            }
+
+            value.cccd = ble_store_config_cccds[i];
+            if (cb(obj_type, &value, cookie) != 0) {
+                return 0;
+            }
+        }
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
+
 void
 ble_store_config_init(void)
 {
+    int rc;
+
     /* Ensure this function only gets called by sysinit. */
     SYSINIT_ASSERT_ACTIVE();
 
+    rc = stats_init_and_reg(
+        STATS_HDR(ble_store_config_stats),
+        STATS_SIZE_INIT_PARMS(ble_store_config_stats, STATS_SIZE_32),
+        STATS_NAME_INIT_PARMS(ble_store_config_stats), "ble_store_config");
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
     ble_hs_cfg.store_read_cb = ble_store_config_read;
     ble_hs_cfg.store_write_cb = ble_store_config_write;
     ble_hs_cfg.store_delete_cb = ble_store_config_delete;
+    ble_hs_cfg.store_iterate_cb = ble_store_config_iterate;
+    ble_hs_cfg.store_flush_cb = ble_store_config_flush;
 
     /* Re-initialize BSS values in case of unit tests. */
     ble_store_config_num_our_secs = 0;
     ble_store_config_num_peer_secs = 0;
     ble_store_config_num_cccds = 0;
+    ble_store_config_idx_rebuild();
+    ble_store_config_flush_init();
 
     ble_store_config_conf_init();
 }
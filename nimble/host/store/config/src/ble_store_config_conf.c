@@ -22,6 +22,8 @@
 #if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "sysinit/sysinit.h"
@@ -34,6 +36,8 @@
 static int
 ble_store_config_conf_set(int argc, char **argv, char *val);
 static int
+ble_store_config_conf_commit(void);
+static int
 ble_store_config_conf_export(void (*func)(char *name, char *val),
                              enum conf_export_tgt tgt);
 
@@ -41,127 +45,412 @@ static struct conf_handler ble_store_config_conf_handler = {
     .ch_name = "ble_hs",
     .ch_get = NULL,
     .ch_set = ble_store_config_conf_set,
-    .ch_commit = NULL,
+    .ch_commit = ble_store_config_conf_commit,
     .ch_export = ble_store_config_conf_export
 };
 
 #define BLE_STORE_CONFIG_SEC_ENCODE_SZ      \
     BASE64_ENCODE_SIZE(sizeof (struct ble_store_value_sec))
 
-#define BLE_STORE_CONFIG_SEC_SET_ENCODE_SZ  \
-    (MYNEWT_VAL(BLE_STORE_MAX_BONDS) * BLE_STORE_CONFIG_SEC_ENCODE_SZ + 1)
-
 #define BLE_STORE_CONFIG_CCCD_ENCODE_SZ     \
     BASE64_ENCODE_SIZE(sizeof (struct ble_store_value_cccd))
 
-#define BLE_STORE_CONFIG_CCCD_SET_ENCODE_SZ \
-    (MYNEWT_VAL(BLE_STORE_MAX_CCCDS) * BLE_STORE_CONFIG_CCCD_ENCODE_SZ + 1)
+/** Longest record name: "ble_hs/peer_sec/65535". */
+#define BLE_STORE_CONFIG_NAME_MAX_SZ        24
+
+/**
+ * Describes one type of persisted object.  Every entry is stored as a
+ * separate record, "ble_hs/<type>/<slot>", so adding, changing or removing
+ * an entry appends a single record to the config log.  Superseded records
+ * are dropped when the config backend compacts its log.
+ *
+ * Older versions stored each type as a single array, "ble_hs/<type>".  Such
+ * an array is still accepted on load and is converted to per-entry records
+ * on commit.  Until the conversion completes, both the array and some
+ * records may be present and may be replayed in either order; per-entry
+ * records always take precedence over array entries.
+ */
+struct ble_store_config_type {
+    const char *name;
+    int obj_type;
+    void *values;
+    uint16_t *slots;
+    struct ble_store_config_slot_pool *slot_pool;
+    int *num_values;
+    int value_size;
+    int max_values;
+};
+
+static const struct ble_store_config_type ble_store_config_types[] = {
+    {
+        .name = "our_sec",
+        .obj_type = BLE_STORE_OBJ_TYPE_OUR_SEC,
+        .values = ble_store_config_our_secs,
+        .slots = ble_store_config_our_sec_slots,
+        .slot_pool = &ble_store_config_our_sec_slot_pool,
+        .num_values = &ble_store_config_num_our_secs,
+        .value_size = sizeof (struct ble_store_value_sec),
+        .max_values = MYNEWT_VAL(BLE_STORE_MAX_BONDS),
+    },
+    {
+        .name = "peer_sec",
+        .obj_type = BLE_STORE_OBJ_TYPE_PEER_SEC,
+        .values = ble_store_config_peer_secs,
+        .slots = ble_store_config_peer_sec_slots,
+        .slot_pool = &ble_store_config_peer_sec_slot_pool,
+        .num_values = &ble_store_config_num_peer_secs,
+        .value_size = sizeof (struct ble_store_value_sec),
+        .max_values = MYNEWT_VAL(BLE_STORE_MAX_BONDS),
+    },
+    {
+        .name = "cccd",
+        .obj_type = BLE_STORE_OBJ_TYPE_CCCD,
+        .values = ble_store_config_cccds,
+        .slots = ble_store_config_cccd_slots,
+        .slot_pool = &ble_store_config_cccd_slot_pool,
+        .num_values = &ble_store_config_num_cccds,
+        .value_size = sizeof (struct ble_store_value_cccd),
+        .max_values = MYNEWT_VAL(BLE_STORE_MAX_CCCDS),
+    },
+};
+
+#define BLE_STORE_CONFIG_TYPE_OUR_SEC       0
+#define BLE_STORE_CONFIG_TYPE_PEER_SEC      1
+#define BLE_STORE_CONFIG_TYPE_CCCD          2
+#define BLE_STORE_CONFIG_NUM_TYPES          \
+    (int)(sizeof ble_store_config_types / sizeof ble_store_config_types[0])
+
+/**
+ * Bitmap of the types whose legacy array was found on load.  The array is
+ * converted and deleted on commit.
+ */
+static uint8_t ble_store_config_legacy_present;
+
+static const struct ble_store_config_type *
+ble_store_config_type_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < BLE_STORE_CONFIG_NUM_TYPES; i++) {
+        if (strcmp(ble_store_config_types[i].name, name) == 0) {
+            return ble_store_config_types + i;
+        }
+    }
+
+    return NULL;
+}
+
+static void *
+ble_store_config_type_value(const struct ble_store_config_type *type, int idx)
+{
+    return (uint8_t *)type->values + idx * type->value_size;
+}
+
+static void
+ble_store_config_record_name(const struct ble_store_config_type *type,
+                             uint16_t slot, char *out_name)
+{
+    sprintf(out_name, "ble_hs/%s/%u", type->name, slot);
+}
+
+static int
+ble_store_config_type_idx(const struct ble_store_config_type *type)
+{
+    return type - ble_store_config_types;
+}
+
+/**
+ * Indicates whether two entries of the same type describe the same object,
+ * i.e., whether a write of one would replace the other.
+ */
+static int
+ble_store_config_same_obj(const struct ble_store_config_type *type,
+                          const void *a, const void *b)
+{
+    union ble_store_key key_a;
+    union ble_store_key key_b;
+
+    ble_store_key_from_value(type->obj_type, &key_a, a);
+    ble_store_key_from_value(type->obj_type, &key_b, b);
+
+    switch (type->obj_type) {
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+        return ble_addr_cmp(&key_a.sec.peer_addr, &key_b.sec.peer_addr) == 0 &&
+               key_a.sec.ediv == key_b.sec.ediv &&
+               key_a.sec.rand_num == key_b.sec.rand_num;
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        return ble_addr_cmp(&key_a.cccd.peer_addr,
+                            &key_b.cccd.peer_addr) == 0 &&
+               key_a.cccd.chr_val_handle == key_b.cccd.chr_val_handle;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Finds the entry that a record loaded for the specified object should
+ * take over: the legacy entry describing the same object, or, if the type
+ * is full, any legacy entry.
+ *
+ * @return                      The entry index on success; -1 if no legacy
+ *                                  entry needs to make way for the record.
+ */
+static int
+ble_store_config_legacy_victim(const struct ble_store_config_type *type,
+                               const void *value)
+{
+    int victim;
+    int i;
+
+    victim = -1;
+    for (i = 0; i < *type->num_values; i++) {
+        if (type->slots[i] != BLE_STORE_CONFIG_SLOT_NONE) {
+            continue;
+        }
+
+        if (ble_store_config_same_obj(type,
+                                      ble_store_config_type_value(type, i),
+                                      value)) {
+            return i;
+        }
+
+        if (victim == -1) {
+            victim = i;
+        }
+    }
+
+    if (*type->num_values < type->max_values) {
+        return -1;
+    }
+
+    return victim;
+}
+
+/**
+ * Removes all entries that were loaded from a legacy array and have not been
+ * converted to per-entry records yet.
+ */
+static void
+ble_store_config_legacy_clear(const struct ble_store_config_type *type)
+{
+    int i;
+
+    i = 0;
+    while (i < *type->num_values) {
+        if (type->slots[i] == BLE_STORE_CONFIG_SLOT_NONE) {
+            ble_store_config_delete_obj(type->values, type->value_size,
+                                        type->slots, i, type->num_values);
+        } else {
+            i++;
+        }
+    }
+}
 
+/**
+ * Adds an entry decoded from a legacy array, unless a per-entry record for
+ * the same object has already been loaded.  Records also take precedence for
+ * space; the entry is dropped if the type is full.
+ */
 static void
-ble_store_config_serialize_arr(const void *arr, int obj_sz, int num_objs,
-                               char *out_buf, int buf_sz)
+ble_store_config_legacy_add(const struct ble_store_config_type *type,
+                            const void *value)
+{
+    int idx;
+    int i;
+
+    for (i = 0; i < *type->num_values; i++) {
+        if (ble_store_config_same_obj(type,
+                                      ble_store_config_type_value(type, i),
+                                      value)) {
+            /* Already converted; the record is more recent. */
+            return;
+        }
+    }
+
+    if (*type->num_values >= type->max_values) {
+        return;
+    }
+
+    idx = (*type->num_values)++;
+    type->slots[idx] = BLE_STORE_CONFIG_SLOT_NONE;
+    memcpy(ble_store_config_type_value(type, idx), value, type->value_size);
+}
+
+static int
+ble_store_config_legacy_set(const struct ble_store_config_type *type,
+                            const char *val)
 {
-    int arr_size;
+    union {
+        struct ble_store_value_sec sec;
+        struct ble_store_value_cccd cccd;
+    } value;
+    uint8_t bytes[3];
+    char chunk[5];
+    int value_len;
+    int len;
+    int off;
+    int i;
 
-    arr_size = obj_sz * num_objs;
-    assert(arr_size <= buf_sz);
+    /* Each save of the legacy array replaces the previous one. */
+    ble_store_config_legacy_clear(type);
 
-    base64_encode(arr, arr_size, out_buf, 1);
+    if (val == NULL) {
+        /* Deleted; the array has been converted to per-entry records. */
+        ble_store_config_legacy_present &=
+            ~(1 << ble_store_config_type_idx(type));
+        return 0;
+    }
+
+    ble_store_config_legacy_present |= 1 << ble_store_config_type_idx(type);
+
+    /* Per-entry records loaded earlier may already occupy part of the value
+     * array, so the array is decoded one base64 quantum at a time rather
+     * than in place.
+     */
+    value_len = 0;
+    chunk[4] = '\0';
+    for (off = 0; val[off] != '\0'; off += 4) {
+        for (i = 0; i < 4; i++) {
+            if (val[off + i] == '\0') {
+                return OS_EINVAL;
+            }
+            chunk[i] = val[off + i];
+        }
+
+        len = base64_decode(chunk, bytes);
+        if (len < 0) {
+            return OS_EINVAL;
+        }
+
+        for (i = 0; i < len; i++) {
+            ((uint8_t *)&value)[value_len++] = bytes[i];
+            if (value_len == type->value_size) {
+                ble_store_config_legacy_add(type, &value);
+                value_len = 0;
+            }
+        }
+    }
+
+    return 0;
 }
 
 static int
-ble_store_config_deserialize_arr(const char *enc,
-                                 void *out_arr,
-                                 int obj_sz,
-                                 int *out_num_objs)
+ble_store_config_record_set(const struct ble_store_config_type *type,
+                            const char *slot_str, const char *val)
 {
+    union {
+        struct ble_store_value_sec sec;
+        struct ble_store_value_cccd cccd;
+    } value;
+    unsigned long slot;
+    char *end;
+    int idx;
     int len;
 
-    len = base64_decode(enc, out_arr);
-    if (len < 0) {
+    slot = strtoul(slot_str, &end, 10);
+    if (end == slot_str || *end != '\0' || slot >= type->max_values) {
+        return OS_EINVAL;
+    }
+
+    idx = ble_store_config_slot_find(type->slots, *type->num_values, slot);
+
+    if (val == NULL) {
+        /* Record erased. */
+        if (idx != -1) {
+            ble_store_config_delete_obj(type->values, type->value_size,
+                                        type->slots, idx, type->num_values);
+        }
+        return 0;
+    }
+
+    if (base64_decode_len(val) > (int)sizeof value) {
+        return OS_EINVAL;
+    }
+
+    memset(&value, 0, sizeof value);
+    len = base64_decode(val, &value);
+    if (len != type->value_size) {
         return OS_EINVAL;
     }
 
-    *out_num_objs = len / obj_sz;
+    if (idx == -1) {
+        /* A record supersedes the legacy entry it was converted from, and
+         * takes precedence over unconverted legacy entries for space.
+         */
+        idx = ble_store_config_legacy_victim(type, &value);
+    }
+
+    if (idx == -1) {
+        if (*type->num_values >= type->max_values) {
+            return OS_ENOMEM;
+        }
+
+        idx = (*type->num_values)++;
+    }
+
+    type->slots[idx] = slot;
+    memcpy(ble_store_config_type_value(type, idx), &value, type->value_size);
+
     return 0;
 }
 
 static int
 ble_store_config_conf_set(int argc, char **argv, char *val)
 {
-    int rc;
+    const struct ble_store_config_type *type;
+
+    if (argc < 1 || argc > 2) {
+        return OS_ENOENT;
+    }
+
+    type = ble_store_config_type_find(argv[0]);
+    if (type == NULL) {
+        return OS_ENOENT;
+    }
 
     if (argc == 1) {
-        if (strcmp(argv[0], "our_sec") == 0) {
-            rc = ble_store_config_deserialize_arr(
-                    val,
-                    ble_store_config_our_secs,
-                    sizeof *ble_store_config_our_secs,
-                    &ble_store_config_num_our_secs);
-            return rc;
-        } else if (strcmp(argv[0], "peer_sec") == 0) {
-            rc = ble_store_config_deserialize_arr(
-                    val,
-                    ble_store_config_peer_secs,
-                    sizeof *ble_store_config_peer_secs,
-                    &ble_store_config_num_peer_secs);
-            return rc;
-        } else if (strcmp(argv[0], "cccd") == 0) {
-            rc = ble_store_config_deserialize_arr(
-                    val,
-                    ble_store_config_cccds,
-                    sizeof *ble_store_config_cccds,
-                    &ble_store_config_num_cccds);
-            return rc;
-        }
+        return ble_store_config_legacy_set(type, val);
+    } else {
+        return ble_store_config_record_set(type, argv[1], val);
     }
-    return OS_ENOENT;
 }
 
 static int
-ble_store_config_conf_export(void (*func)(char *name, char *val),
-                             enum conf_export_tgt tgt)
+ble_store_config_persist_record(const struct ble_store_config_type *type,
+                                int idx)
 {
+    char name[BLE_STORE_CONFIG_NAME_MAX_SZ];
     union {
-        char sec[BLE_STORE_CONFIG_SEC_SET_ENCODE_SZ];
-        char cccd[BLE_STORE_CONFIG_CCCD_SET_ENCODE_SZ];
+        char sec[BLE_STORE_CONFIG_SEC_ENCODE_SZ + 1];
+        char cccd[BLE_STORE_CONFIG_CCCD_ENCODE_SZ + 1];
     } buf;
+    int rc;
+
+    ble_store_config_record_name(type, type->slots[idx], name);
+    base64_encode(ble_store_config_type_value(type, idx), type->value_size,
+                  (char *)&buf, 1);
 
-    ble_store_config_serialize_arr(ble_store_config_our_secs,
-                                   sizeof *ble_store_config_our_secs,
-                                   ble_store_config_num_our_secs,
-                                   buf.sec,
-                                   sizeof buf.sec);
-    func("ble_hs/our_sec", buf.sec);
-
-    ble_store_config_serialize_arr(ble_store_config_peer_secs,
-                                   sizeof *ble_store_config_peer_secs,
-                                   ble_store_config_num_peer_secs,
-                                   buf.sec,
-                                   sizeof buf.sec);
-    func("ble_hs/peer_sec", buf.sec);
-
-    ble_store_config_serialize_arr(ble_store_config_cccds,
-                                   sizeof *ble_store_config_cccds,
-                                   ble_store_config_num_cccds,
-                                   buf.cccd,
-                                   sizeof buf.cccd);
-    func("ble_hs/cccd", buf.cccd);
+    rc = conf_save_one(name, (char *)&buf);
+    if (rc != 0) {
+        return BLE_HS_ESTORE_FAIL;
+    }
 
     return 0;
 }
 
 static int
-ble_store_config_persist_sec_set(const char *setting_name,
-                                 const struct ble_store_value_sec *secs,
-                                 int num_secs)
+ble_store_config_erase_record(const struct ble_store_config_type *type,
+                              uint16_t slot)
 {
-    char buf[BLE_STORE_CONFIG_SEC_SET_ENCODE_SZ];
+    char name[BLE_STORE_CONFIG_NAME_MAX_SZ];
     int rc;
 
-    ble_store_config_serialize_arr(secs, sizeof *secs, num_secs,
-                                   buf, sizeof buf);
-    rc = conf_save_one(setting_name, buf);
+    ble_store_config_record_name(type, slot, name);
+
+    rc = conf_save_one(name, NULL);
     if (rc != 0) {
         return BLE_HS_ESTORE_FAIL;
     }
@@ -169,53 +458,124 @@ ble_store_config_persist_sec_set(const char *setting_name,
     return 0;
 }
 
-int
-ble_store_config_persist_our_secs(void)
+/**
+ * Indexes the loaded entries.  Then converts entries loaded from a legacy
+ * array into per-entry records and deletes the array.  The array is only
+ * deleted once all of its entries have been written as records.
+ */
+static int
+ble_store_config_conf_commit(void)
 {
+    const struct ble_store_config_type *type;
+    char name[BLE_STORE_CONFIG_NAME_MAX_SZ];
     int rc;
+    int i;
+    int j;
 
-    rc = ble_store_config_persist_sec_set("ble_hs/our_sec",
-                                          ble_store_config_our_secs,
-                                          ble_store_config_num_our_secs);
-    if (rc != 0) {
-        return rc;
+    ble_store_config_idx_rebuild();
+
+    for (i = 0; i < BLE_STORE_CONFIG_NUM_TYPES; i++) {
+        if (!(ble_store_config_legacy_present & (1 << i))) {
+            continue;
+        }
+
+        type = ble_store_config_types + i;
+
+        for (j = 0; j < *type->num_values; j++) {
+            if (type->slots[j] != BLE_STORE_CONFIG_SLOT_NONE) {
+                continue;
+            }
+
+            type->slots[j] = ble_store_config_slot_alloc(type->slot_pool);
+            rc = ble_store_config_persist_record(type, j);
+            if (rc != 0) {
+                return rc;
+            }
+        }
+
+        sprintf(name, "ble_hs/%s", type->name);
+        rc = conf_save_one(name, NULL);
+        if (rc != 0) {
+            return BLE_HS_ESTORE_FAIL;
+        }
+
+        ble_store_config_legacy_present &= ~(1 << i);
     }
 
     return 0;
 }
 
-int
-ble_store_config_persist_peer_secs(void)
+static int
+ble_store_config_conf_export(void (*func)(char *name, char *val),
+                             enum conf_export_tgt tgt)
 {
-    int rc;
+    const struct ble_store_config_type *type;
+    char name[BLE_STORE_CONFIG_NAME_MAX_SZ];
+    union {
+        char sec[BLE_STORE_CONFIG_SEC_ENCODE_SZ + 1];
+        char cccd[BLE_STORE_CONFIG_CCCD_ENCODE_SZ + 1];
+    } buf;
+    int i;
+    int j;
 
-    rc = ble_store_config_persist_sec_set("ble_hs/peer_sec",
-                                          ble_store_config_peer_secs,
-                                          ble_store_config_num_peer_secs);
-    if (rc != 0) {
-        return rc;
+    for (i = 0; i < BLE_STORE_CONFIG_NUM_TYPES; i++) {
+        type = ble_store_config_types + i;
+
+        for (j = 0; j < *type->num_values; j++) {
+            if (type->slots[j] == BLE_STORE_CONFIG_SLOT_NONE) {
+                continue;
+            }
+
+            ble_store_config_record_name(type, type->slots[j], name);
+            base64_encode(ble_store_config_type_value(type, j),
+                          type->value_size, (char *)&buf, 1);
+            func(name, (char *)&buf);
+        }
     }
 
     return 0;
 }
 
 int
-ble_store_config_persist_cccds(void)
+ble_store_config_persist_our_sec(int idx)
 {
-    char buf[BLE_STORE_CONFIG_CCCD_SET_ENCODE_SZ];
-    int rc;
+    return ble_store_config_persist_record(
+        ble_store_config_types + BLE_STORE_CONFIG_TYPE_OUR_SEC, idx);
+}
 
-    ble_store_config_serialize_arr(ble_store_config_cccds,
-                                   sizeof *ble_store_config_cccds,
-                                   ble_store_config_num_cccds,
-                                   buf,
-                                   sizeof buf);
-    rc = conf_save_one("ble_hs/cccd", buf);
-    if (rc != 0) {
-        return BLE_HS_ESTORE_FAIL;
-    }
+int
+ble_store_config_persist_peer_sec(int idx)
+{
+    return ble_store_config_persist_record(
+        ble_store_config_types + BLE_STORE_CONFIG_TYPE_PEER_SEC, idx);
+}
 
-    return 0;
+int
+ble_store_config_persist_cccd(int idx)
+{
+    return ble_store_config_persist_record(
+        ble_store_config_types + BLE_STORE_CONFIG_TYPE_CCCD, idx);
+}
+
+int
+ble_store_config_erase_our_sec(uint16_t slot)
+{
+    return ble_store_config_erase_record(
+        ble_store_config_types + BLE_STORE_CONFIG_TYPE_OUR_SEC, slot);
+}
+
+int
+ble_store_config_erase_peer_sec(uint16_t slot)
+{
+    return ble_store_config_erase_record(
+        ble_store_config_types + BLE_STORE_CONFIG_TYPE_PEER_SEC, slot);
+}
+
+int
+ble_store_config_erase_cccd(uint16_t slot)
+{
+    return ble_store_config_erase_record(
+        ble_store_config_types + BLE_STORE_CONFIG_TYPE_CCCD, slot);
 }
 
 void
@@ -223,6 +583,8 @@ ble_store_config_conf_init(void)
 {
     int rc;
 
+    ble_store_config_legacy_present = 0;
+
     rc = conf_register(&ble_store_config_conf_handler);
     SYSINIT_PANIC_ASSERT_MSG(rc == 0,
                              "Failed to register ble_store_config conf");
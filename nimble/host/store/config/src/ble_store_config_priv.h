@@ -20,35 +20,83 @@
 #ifndef H_BLE_STORE_CONFIG_PRIV_
 #define H_BLE_STORE_CONFIG_PRIV_
 
+#include "stats/stats.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+STATS_SECT_START(ble_store_config_stats)
+    STATS_SECT_ENTRY(cccd_write)
+    STATS_SECT_ENTRY(cccd_write_unchanged)
+    STATS_SECT_ENTRY(cccd_write_coalesced)
+    STATS_SECT_ENTRY(cccd_persist)
+    STATS_SECT_ENTRY(cccd_persist_fail)
+    STATS_SECT_ENTRY(flush)
+STATS_SECT_END
+extern STATS_SECT_DECL(ble_store_config_stats) ble_store_config_stats;
+
+/* Each entry is persisted as its own record; the slot arrays hold the
+ * record number of the corresponding entry.
+ */
+#define BLE_STORE_CONFIG_SLOT_NONE          0xffff
+
 extern struct ble_store_value_sec
     ble_store_config_our_secs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+extern uint16_t
+    ble_store_config_our_sec_slots[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
 extern int ble_store_config_num_our_secs;
 
 extern struct ble_store_value_sec
     ble_store_config_peer_secs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
+extern uint16_t
+    ble_store_config_peer_sec_slots[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
 extern int ble_store_config_num_peer_secs;
 
 extern struct ble_store_value_cccd
     ble_store_config_cccds[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
+extern uint16_t
+    ble_store_config_cccd_slots[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
 extern int ble_store_config_num_cccds;
 
+struct ble_store_config_slot_pool {
+    uint16_t *free;
+    int num_free;
+    int size;
+};
+
+extern struct ble_store_config_slot_pool ble_store_config_our_sec_slot_pool;
+extern struct ble_store_config_slot_pool ble_store_config_peer_sec_slot_pool;
+extern struct ble_store_config_slot_pool ble_store_config_cccd_slot_pool;
+
+uint16_t ble_store_config_slot_alloc(struct ble_store_config_slot_pool *pool);
+void ble_store_config_slot_free(struct ble_store_config_slot_pool *pool,
+                                uint16_t slot);
+int ble_store_config_slot_find(const uint16_t *slots, int num_slots,
+                               uint16_t slot);
+int ble_store_config_delete_obj(void *values, int value_size, uint16_t *slots,
+                                int idx, int *num_values);
+void ble_store_config_idx_rebuild(void);
+
 #if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
 
-int ble_store_config_persist_our_secs(void);
-int ble_store_config_persist_peer_secs(void);
-int ble_store_config_persist_cccds(void);
+int ble_store_config_persist_our_sec(int idx);
+int ble_store_config_persist_peer_sec(int idx);
+int ble_store_config_persist_cccd(int idx);
+int ble_store_config_erase_our_sec(uint16_t slot);
+int ble_store_config_erase_peer_sec(uint16_t slot);
+int ble_store_config_erase_cccd(uint16_t slot);
 void ble_store_config_conf_init(void);
 
 #else
 
-static inline int ble_store_config_persist_our_secs(void)   { return 0; }
-static inline int ble_store_config_persist_peer_secs(void)  { return 0; }
-static inline int ble_store_config_persist_cccds(void)      { return 0; }
-static inline void ble_store_config_conf_init(void)         { }
+static inline int ble_store_config_persist_our_sec(int idx)     { return 0; }
+static inline int ble_store_config_persist_peer_sec(int idx)    { return 0; }
+static inline int ble_store_config_persist_cccd(int idx)        { return 0; }
+static inline int ble_store_config_erase_our_sec(uint16_t slot) { return 0; }
+static inline int ble_store_config_erase_peer_sec(uint16_t slot){ return 0; }
+static inline int ble_store_config_erase_cccd(uint16_t slot)    { return 0; }
+static inline void ble_store_config_conf_init(void)             { }
 
 #endif /* MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST) */
 
@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_STORE_IDX_
+#define H_BLE_STORE_IDX_
+
+#include <inttypes.h>
+#include "host/ble_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hash index over an entry array.  Entries with the same hash are chained in
+ * array order, so walking a chain visits matching entries in the same order
+ * as a linear scan would.  Removing an entry shifts the array, so indices
+ * are rebuilt after every removal.
+ */
+struct ble_store_idx {
+    int16_t *heads;
+    int16_t *next;
+    int size;
+};
+
+#define BLE_STORE_IDX_END                   (-1)
+
+/** Defines a static index over an array of the specified size. */
+#define BLE_STORE_IDX_DEFINE(name, sz)                                      \
+    static int16_t name ## _heads[sz];                                      \
+    static int16_t name ## _next[sz];                                       \
+    static struct ble_store_idx name = {                                    \
+        .heads = name ## _heads,                                            \
+        .next = name ## _next,                                              \
+        .size = (sz),                                                       \
+    }
+
+void ble_store_idx_sec_add(struct ble_store_idx *addr_idx,
+                           struct ble_store_idx *ediv_rand_idx,
+                           const struct ble_store_value_sec *value_sec,
+                           int entry);
+void ble_store_idx_sec_rebuild(struct ble_store_idx *addr_idx,
+                               struct ble_store_idx *ediv_rand_idx,
+                               const struct ble_store_value_sec *value_secs,
+                               int num_value_secs);
+int ble_store_idx_sec_next(const struct ble_store_key_sec *key_sec,
+                           const struct ble_store_value_sec *value_secs,
+                           int num_value_secs,
+                           const struct ble_store_idx *addr_idx,
+                           const struct ble_store_idx *ediv_rand_idx,
+                           int prev);
+
+void ble_store_idx_cccd_add(struct ble_store_idx *addr_idx,
+                            struct ble_store_idx *chr_idx,
+                            const struct ble_store_value_cccd *value_cccd,
+                            int entry);
+void ble_store_idx_cccd_rebuild(struct ble_store_idx *addr_idx,
+                                struct ble_store_idx *chr_idx,
+                                const struct ble_store_value_cccd *value_cccds,
+                                int num_value_cccds);
+int ble_store_idx_cccd_next(const struct ble_store_key_cccd *key,
+                            const struct ble_store_value_cccd *value_cccds,
+                            int num_value_cccds,
+                            const struct ble_store_idx *addr_idx,
+                            const struct ble_store_idx *chr_idx,
+                            int prev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "host/ble_hs.h"
+#include "store/idx/ble_store_idx.h"
+
+static uint32_t
+ble_store_idx_hash_addr(const ble_addr_t *addr)
+{
+    uint32_t hash;
+    int i;
+
+    hash = addr->type;
+    for (i = 0; i < sizeof addr->val; i++) {
+        hash = hash * 31 + addr->val[i];
+    }
+
+    return hash;
+}
+
+static uint32_t
+ble_store_idx_hash_ediv_rand(uint16_t ediv, uint64_t rand_num)
+{
+    return ediv ^ (uint32_t)rand_num ^ (uint32_t)(rand_num >> 32);
+}
+
+static void
+ble_store_idx_clear(struct ble_store_idx *idx)
+{
+    int i;
+
+    for (i = 0; i < idx->size; i++) {
+        idx->heads[i] = BLE_STORE_IDX_END;
+    }
+}
+
+/**
+ * Appends an entry to its hash chain.  The entry must have a greater array
+ * index than any entry already in the index.
+ */
+static void
+ble_store_idx_add(struct ble_store_idx *idx, uint32_t hash, int entry)
+{
+    int16_t *link;
+
+    link = idx->heads + hash % idx->size;
+    while (*link != BLE_STORE_IDX_END) {
+        link = idx->next + *link;
+    }
+
+    *link = entry;
+    idx->next[entry] = BLE_STORE_IDX_END;
+}
+
+/**
+ * Returns the first candidate entry for a lookup.  A null index means the
+ * key doesn't constrain any indexed field, in which case every entry is a
+ * candidate.
+ */
+static int
+ble_store_idx_first(const struct ble_store_idx *idx, uint32_t hash,
+                    int num_entries)
+{
+    if (idx == NULL) {
+        return num_entries > 0 ? 0 : BLE_STORE_IDX_END;
+    }
+
+    return idx->heads[hash % idx->size];
+}
+
+static int
+ble_store_idx_next(const struct ble_store_idx *idx, int entry,
+                   int num_entries)
+{
+    if (idx == NULL) {
+        return entry + 1 < num_entries ? entry + 1 : BLE_STORE_IDX_END;
+    }
+
+    return idx->next[entry];
+}
+
+/*****************************************************************************
+ * $sec                                                                      *
+ *****************************************************************************/
+
+void
+ble_store_idx_sec_add(struct ble_store_idx *addr_idx,
+                      struct ble_store_idx *ediv_rand_idx,
+                      const struct ble_store_value_sec *value_sec,
+                      int entry)
+{
+    ble_store_idx_add(addr_idx,
+                      ble_store_idx_hash_addr(&value_sec->peer_addr),
+                      entry);
+    ble_store_idx_add(ediv_rand_idx,
+                      ble_store_idx_hash_ediv_rand(value_sec->ediv,
+                                                   value_sec->rand_num),
+                      entry);
+}
+
+void
+ble_store_idx_sec_rebuild(struct ble_store_idx *addr_idx,
+                          struct ble_store_idx *ediv_rand_idx,
+                          const struct ble_store_value_sec *value_secs,
+                          int num_value_secs)
+{
+    int i;
+
+    ble_store_idx_clear(addr_idx);
+    ble_store_idx_clear(ediv_rand_idx);
+
+    for (i = 0; i < num_value_secs; i++) {
+        ble_store_idx_sec_add(addr_idx, ediv_rand_idx, value_secs + i, i);
+    }
+}
+
+/**
+ * Finds the next security entry matching the specified key, ignoring the
+ * key's idx field.
+ *
+ * @param prev                  The entry returned by the previous call, or -1
+ *                                  to start a new search.
+ *
+ * @return                      The index of the matching entry;
+ *                              -1 if there are no more matches.
+ */
+int
+ble_store_idx_sec_next(const struct ble_store_key_sec *key_sec,
+                       const struct ble_store_value_sec *value_secs,
+                       int num_value_secs,
+                       const struct ble_store_idx *addr_idx,
+                       const struct ble_store_idx *ediv_rand_idx,
+                       int prev)
+{
+    const struct ble_store_value_sec *cur;
+    const struct ble_store_idx *idx;
+    uint32_t hash;
+    int i;
+
+    /* Walk the chain of the most selective field the key specifies. */
+    if (ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
+        idx = addr_idx;
+        hash = ble_store_idx_hash_addr(&key_sec->peer_addr);
+    } else if (key_sec->ediv_rand_present) {
+        idx = ediv_rand_idx;
+        hash = ble_store_idx_hash_ediv_rand(key_sec->ediv,
+                                            key_sec->rand_num);
+    } else {
+        idx = NULL;
+        hash = 0;
+    }
+
+    if (prev == -1) {
+        i = ble_store_idx_first(idx, hash, num_value_secs);
+    } else {
+        i = ble_store_idx_next(idx, prev, num_value_secs);
+    }
+
+    for (; i != BLE_STORE_IDX_END;
+         i = ble_store_idx_next(idx, i, num_value_secs)) {
+
+        cur = value_secs + i;
+
+        if (ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
+            if (ble_addr_cmp(&cur->peer_addr, &key_sec->peer_addr)) {
+                continue;
+            }
+        }
+
+        if (key_sec->ediv_rand_present) {
+            if (cur->ediv != key_sec->ediv) {
+                continue;
+            }
+
+            if (cur->rand_num != key_sec->rand_num) {
+                continue;
+            }
+        }
+
+        return i;
+    }
+
+    return -1;
+}
+
+/*****************************************************************************
+ * $cccd                                                                     *
+ *****************************************************************************/
+
+void
+ble_store_idx_cccd_add(struct ble_store_idx *addr_idx,
+                       struct ble_store_idx *chr_idx,
+                       const struct ble_store_value_cccd *value_cccd,
+                       int entry)
+{
+    ble_store_idx_add(addr_idx,
+                      ble_store_idx_hash_addr(&value_cccd->peer_addr),
+                      entry);
+    ble_store_idx_add(chr_idx, value_cccd->chr_val_handle, entry);
+}
+
+void
+ble_store_idx_cccd_rebuild(struct ble_store_idx *addr_idx,
+                           struct ble_store_idx *chr_idx,
+                           const struct ble_store_value_cccd *value_cccds,
+                           int num_value_cccds)
+{
+    int i;
+
+    ble_store_idx_clear(addr_idx);
+    ble_store_idx_clear(chr_idx);
+
+    for (i = 0; i < num_value_cccds; i++) {
+        ble_store_idx_cccd_add(addr_idx, chr_idx, value_cccds + i, i);
+    }
+}
+
+/**
+ * Finds the next CCCD entry matching the specified key, ignoring the key's
+ * idx field.
+ *
+ * @param prev                  The entry returned by the previous call, or -1
+ *                                  to start a new search.
+ *
+ * @return                      The index of the matching entry;
+ *                              -1 if there are no more matches.
+ */
+int
+ble_store_idx_cccd_next(const struct ble_store_key_cccd *key,
+                        const struct ble_store_value_cccd *value_cccds,
+                        int num_value_cccds,
+                        const struct ble_store_idx *addr_idx,
+                        const struct ble_store_idx *chr_idx,
+                        int prev)
+{
+    const struct ble_store_value_cccd *cccd;
+    const struct ble_store_idx *idx;
+    uint32_t hash;
+    int i;
+
+    if (ble_addr_cmp(&key->peer_addr, BLE_ADDR_ANY)) {
+        idx = addr_idx;
+        hash = ble_store_idx_hash_addr(&key->peer_addr);
+    } else if (key->chr_val_handle != 0) {
+        idx = chr_idx;
+        hash = key->chr_val_handle;
+    } else {
+        idx = NULL;
+        hash = 0;
+    }
+
+    if (prev == -1) {
+        i = ble_store_idx_first(idx, hash, num_value_cccds);
+    } else {
+        i = ble_store_idx_next(idx, prev, num_value_cccds);
+    }
+
+    for (; i != BLE_STORE_IDX_END;
+         i = ble_store_idx_next(idx, i, num_value_cccds)) {
+
+        cccd = value_cccds + i;
+
+        if (ble_addr_cmp(&key->peer_addr, BLE_ADDR_ANY)) {
+            if (ble_addr_cmp(&cccd->peer_addr, &key->peer_addr)) {
+                continue;
+            }
+        }
+
+        if (key->chr_val_handle != 0) {
+            if (cccd->chr_val_handle != key->chr_val_handle) {
+                continue;
+            }
+        }
+
+        return i;
+    }
+
+    return -1;
+}
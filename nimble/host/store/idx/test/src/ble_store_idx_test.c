@@ -0,0 +1,346 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "sysinit/sysinit.h"
+#include "syscfg/syscfg.h"
+#include "testutil/testutil.h"
+#include "host/ble_hs.h"
+#include "store/idx/ble_store_idx.h"
+
+#define BLE_STORE_IDX_TEST_MAX_ENTRIES  4
+
+static const ble_addr_t ble_store_idx_test_addr_a =
+    { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+static const ble_addr_t ble_store_idx_test_addr_b =
+    { BLE_ADDR_RANDOM, { 1, 2, 3, 4, 5, 6 } };
+static const ble_addr_t ble_store_idx_test_addr_c =
+    { BLE_ADDR_PUBLIC, { 6, 5, 4, 3, 2, 1 } };
+static const ble_addr_t ble_store_idx_test_addr_d =
+    { BLE_ADDR_PUBLIC, { 9, 9, 9, 9, 9, 9 } };
+
+static struct ble_store_value_sec
+    ble_store_idx_test_secs[BLE_STORE_IDX_TEST_MAX_ENTRIES];
+static int ble_store_idx_test_num_secs;
+
+static struct ble_store_value_cccd
+    ble_store_idx_test_cccds[BLE_STORE_IDX_TEST_MAX_ENTRIES];
+static int ble_store_idx_test_num_cccds;
+
+BLE_STORE_IDX_DEFINE(ble_store_idx_test_sec_addr_idx,
+                     BLE_STORE_IDX_TEST_MAX_ENTRIES);
+BLE_STORE_IDX_DEFINE(ble_store_idx_test_sec_ediv_rand_idx,
+                     BLE_STORE_IDX_TEST_MAX_ENTRIES);
+BLE_STORE_IDX_DEFINE(ble_store_idx_test_cccd_addr_idx,
+                     BLE_STORE_IDX_TEST_MAX_ENTRIES);
+BLE_STORE_IDX_DEFINE(ble_store_idx_test_cccd_chr_idx,
+                     BLE_STORE_IDX_TEST_MAX_ENTRIES);
+
+static void
+ble_store_idx_test_util_set_sec(int entry, const ble_addr_t *addr,
+                                uint16_t ediv, uint64_t rand_num)
+{
+    struct ble_store_value_sec *value_sec;
+
+    value_sec = ble_store_idx_test_secs + entry;
+    memset(value_sec, 0, sizeof *value_sec);
+    value_sec->peer_addr = *addr;
+    value_sec->ediv = ediv;
+    value_sec->rand_num = rand_num;
+}
+
+/**
+ * Populates the security entries.  Entries 0 and 1 have colliding EDIV/rand
+ * hashes; entries 0 and 2 share a peer address.
+ */
+static void
+ble_store_idx_test_util_init_secs(void)
+{
+    ble_store_idx_test_util_set_sec(0, &ble_store_idx_test_addr_a, 1, 2);
+    ble_store_idx_test_util_set_sec(1, &ble_store_idx_test_addr_b, 2, 1);
+    ble_store_idx_test_util_set_sec(2, &ble_store_idx_test_addr_a, 3, 4);
+    ble_store_idx_test_util_set_sec(3, &ble_store_idx_test_addr_c, 1, 3);
+    ble_store_idx_test_num_secs = 4;
+
+    ble_store_idx_sec_rebuild(&ble_store_idx_test_sec_addr_idx,
+                              &ble_store_idx_test_sec_ediv_rand_idx,
+                              ble_store_idx_test_secs,
+                              ble_store_idx_test_num_secs);
+}
+
+static void
+ble_store_idx_test_util_set_cccd(int entry, const ble_addr_t *addr,
+                                 uint16_t chr_val_handle)
+{
+    struct ble_store_value_cccd *value_cccd;
+
+    value_cccd = ble_store_idx_test_cccds + entry;
+    memset(value_cccd, 0, sizeof *value_cccd);
+    value_cccd->peer_addr = *addr;
+    value_cccd->chr_val_handle = chr_val_handle;
+}
+
+/**
+ * Populates the CCCD entries.  All characteristic handles hash to the same
+ * chain.
+ */
+static void
+ble_store_idx_test_util_init_cccds(void)
+{
+    ble_store_idx_test_util_set_cccd(0, &ble_store_idx_test_addr_a, 1);
+    ble_store_idx_test_util_set_cccd(1, &ble_store_idx_test_addr_b, 5);
+    ble_store_idx_test_util_set_cccd(2, &ble_store_idx_test_addr_a, 9);
+    ble_store_idx_test_util_set_cccd(3, &ble_store_idx_test_addr_b, 5);
+    ble_store_idx_test_num_cccds = 4;
+
+    ble_store_idx_cccd_rebuild(&ble_store_idx_test_cccd_addr_idx,
+                               &ble_store_idx_test_cccd_chr_idx,
+                               ble_store_idx_test_cccds,
+                               ble_store_idx_test_num_cccds);
+}
+
+/**
+ * Removes an entry from the security array the way the store backends do:
+ * shift the following entries down and rebuild the indices.
+ */
+static void
+ble_store_idx_test_util_remove_sec(int entry)
+{
+    ble_store_idx_test_num_secs--;
+    memmove(ble_store_idx_test_secs + entry,
+            ble_store_idx_test_secs + entry + 1,
+            (ble_store_idx_test_num_secs - entry) *
+            sizeof *ble_store_idx_test_secs);
+
+    ble_store_idx_sec_rebuild(&ble_store_idx_test_sec_addr_idx,
+                              &ble_store_idx_test_sec_ediv_rand_idx,
+                              ble_store_idx_test_secs,
+                              ble_store_idx_test_num_secs);
+}
+
+static void
+ble_store_idx_test_util_verify_sec(const ble_addr_t *addr,
+                                   int ediv_rand_present, uint16_t ediv,
+                                   uint64_t rand_num,
+                                   const int *exp_entries, int num_exp)
+{
+    struct ble_store_key_sec key_sec;
+    int entry;
+    int i;
+
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr = *addr;
+    key_sec.ediv_rand_present = ediv_rand_present;
+    key_sec.ediv = ediv;
+    key_sec.rand_num = rand_num;
+
+    entry = -1;
+    for (i = 0; ; i++) {
+        entry = ble_store_idx_sec_next(&key_sec, ble_store_idx_test_secs,
+                                       ble_store_idx_test_num_secs,
+                                       &ble_store_idx_test_sec_addr_idx,
+                                       &ble_store_idx_test_sec_ediv_rand_idx,
+                                       entry);
+        if (entry == -1) {
+            break;
+        }
+
+        TEST_ASSERT_FATAL(i < num_exp);
+        TEST_ASSERT(entry == exp_entries[i]);
+    }
+
+    TEST_ASSERT(i == num_exp);
+}
+
+static void
+ble_store_idx_test_util_verify_cccd(const ble_addr_t *addr,
+                                    uint16_t chr_val_handle,
+                                    const int *exp_entries, int num_exp)
+{
+    struct ble_store_key_cccd key_cccd;
+    int entry;
+    int i;
+
+    memset(&key_cccd, 0, sizeof key_cccd);
+    key_cccd.peer_addr = *addr;
+    key_cccd.chr_val_handle = chr_val_handle;
+
+    entry = -1;
+    for (i = 0; ; i++) {
+        entry = ble_store_idx_cccd_next(&key_cccd, ble_store_idx_test_cccds,
+                                        ble_store_idx_test_num_cccds,
+                                        &ble_store_idx_test_cccd_addr_idx,
+                                        &ble_store_idx_test_cccd_chr_idx,
+                                        entry);
+        if (entry == -1) {
+            break;
+        }
+
+        TEST_ASSERT_FATAL(i < num_exp);
+        TEST_ASSERT(entry == exp_entries[i]);
+    }
+
+    TEST_ASSERT(i == num_exp);
+}
+
+TEST_CASE(ble_store_idx_test_case_sec_addr)
+{
+    ble_store_idx_test_util_init_secs();
+
+    /* Matches are returned in array order. */
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_a, 0, 0, 0,
+                                       (int[]){ 0, 2 }, 2);
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_b, 0, 0, 0,
+                                       (int[]){ 1 }, 1);
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_d, 0, 0, 0,
+                                       NULL, 0);
+
+    /* Address and EDIV/rand must both match. */
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_a, 1, 3, 4,
+                                       (int[]){ 2 }, 1);
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_a, 1, 2, 1,
+                                       NULL, 0);
+}
+
+TEST_CASE(ble_store_idx_test_case_sec_ediv_rand)
+{
+    ble_store_idx_test_util_init_secs();
+
+    /* Entries 0 and 1 share a chain; only the exact match is returned. */
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 2,
+                                       (int[]){ 0 }, 1);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 2, 1,
+                                       (int[]){ 1 }, 1);
+
+    /* EDIV and rand must both match. */
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 3,
+                                       (int[]){ 3 }, 1);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 4,
+                                       NULL, 0);
+}
+
+TEST_CASE(ble_store_idx_test_case_sec_wildcard)
+{
+    ble_store_idx_test_util_init_secs();
+
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 0, 0, 0,
+                                       (int[]){ 0, 1, 2, 3 }, 4);
+}
+
+TEST_CASE(ble_store_idx_test_case_sec_remove)
+{
+    ble_store_idx_test_util_init_secs();
+
+    ble_store_idx_test_util_remove_sec(0);
+
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_a, 0, 0, 0,
+                                       (int[]){ 1 }, 1);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 2,
+                                       NULL, 0);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 3,
+                                       (int[]){ 2 }, 1);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 0, 0, 0,
+                                       (int[]){ 0, 1, 2 }, 3);
+
+    /* Appending an entry adds it to the end of its chains. */
+    ble_store_idx_test_util_set_sec(3, &ble_store_idx_test_addr_a, 1, 2);
+    ble_store_idx_sec_add(&ble_store_idx_test_sec_addr_idx,
+                          &ble_store_idx_test_sec_ediv_rand_idx,
+                          ble_store_idx_test_secs + 3, 3);
+    ble_store_idx_test_num_secs++;
+
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_a, 0, 0, 0,
+                                       (int[]){ 1, 3 }, 2);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 2,
+                                       (int[]){ 3 }, 1);
+}
+
+TEST_CASE(ble_store_idx_test_case_cccd)
+{
+    ble_store_idx_test_util_init_cccds();
+
+    /* By characteristic; all handles share one chain. */
+    ble_store_idx_test_util_verify_cccd(BLE_ADDR_ANY, 5,
+                                        (int[]){ 1, 3 }, 2);
+    ble_store_idx_test_util_verify_cccd(BLE_ADDR_ANY, 9,
+                                        (int[]){ 2 }, 1);
+    ble_store_idx_test_util_verify_cccd(BLE_ADDR_ANY, 13, NULL, 0);
+
+    /* By peer address. */
+    ble_store_idx_test_util_verify_cccd(&ble_store_idx_test_addr_b, 0,
+                                        (int[]){ 1, 3 }, 2);
+    ble_store_idx_test_util_verify_cccd(&ble_store_idx_test_addr_d, 0,
+                                        NULL, 0);
+
+    /* Address and characteristic must both match. */
+    ble_store_idx_test_util_verify_cccd(&ble_store_idx_test_addr_a, 9,
+                                        (int[]){ 2 }, 1);
+    ble_store_idx_test_util_verify_cccd(&ble_store_idx_test_addr_a, 5,
+                                        NULL, 0);
+
+    /* Wildcard. */
+    ble_store_idx_test_util_verify_cccd(BLE_ADDR_ANY, 0,
+                                        (int[]){ 0, 1, 2, 3 }, 4);
+}
+
+TEST_CASE(ble_store_idx_test_case_empty)
+{
+    ble_store_idx_test_num_secs = 0;
+    ble_store_idx_sec_rebuild(&ble_store_idx_test_sec_addr_idx,
+                              &ble_store_idx_test_sec_ediv_rand_idx,
+                              ble_store_idx_test_secs, 0);
+    ble_store_idx_test_num_cccds = 0;
+    ble_store_idx_cccd_rebuild(&ble_store_idx_test_cccd_addr_idx,
+                               &ble_store_idx_test_cccd_chr_idx,
+                               ble_store_idx_test_cccds, 0);
+
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 0, 0, 0, NULL, 0);
+    ble_store_idx_test_util_verify_sec(&ble_store_idx_test_addr_a, 0, 0, 0,
+                                       NULL, 0);
+    ble_store_idx_test_util_verify_sec(BLE_ADDR_ANY, 1, 1, 2, NULL, 0);
+
+    ble_store_idx_test_util_verify_cccd(BLE_ADDR_ANY, 0, NULL, 0);
+    ble_store_idx_test_util_verify_cccd(&ble_store_idx_test_addr_a, 0,
+                                        NULL, 0);
+    ble_store_idx_test_util_verify_cccd(BLE_ADDR_ANY, 1, NULL, 0);
+}
+
+TEST_SUITE(ble_store_idx_test_suite)
+{
+    ble_store_idx_test_case_sec_addr();
+    ble_store_idx_test_case_sec_ediv_rand();
+    ble_store_idx_test_case_sec_wildcard();
+    ble_store_idx_test_case_sec_remove();
+    ble_store_idx_test_case_cccd();
+    ble_store_idx_test_case_empty();
+}
+
+#if MYNEWT_VAL(SELFTEST)
+
+int
+main(int argc, char **argv)
+{
+    sysinit();
+
+    ble_store_idx_test_suite();
+
+    return tu_any_failed;
+}
+
+#endif
@@ -20,17 +20,18 @@
 #ifndef H_BLE_STORE_RAM_
 #define H_BLE_STORE_RAM_
 
+#include "host/ble_store.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-union ble_store_key;
-union ble_store_value;
-
 int ble_store_ram_read(int obj_type, const union ble_store_key *key,
                        union ble_store_value *value);
 int ble_store_ram_write(int obj_type, const union ble_store_value *val);
 int ble_store_ram_delete(int obj_type, const union ble_store_key *key);
+int ble_store_ram_iterate(int obj_type, const union ble_store_key *key,
+                          ble_store_iterator_fn *cb, void *cookie);
 
 #ifdef __cplusplus
 }
@@ -30,6 +30,7 @@
 #include "syscfg/syscfg.h"
 #include "host/ble_hs.h"
 #include "store/ram/ble_store_ram.h"
+#include "store/idx/ble_store_idx.h"
 
 static struct ble_store_value_sec
     ble_store_ram_our_secs[MYNEWT_VAL(BLE_STORE_MAX_BONDS)];
@@ -43,6 +44,42 @@ static struct ble_store_value_cccd
     ble_store_ram_cccds[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
 static int ble_store_ram_num_cccds;
 
+/*****************************************************************************
+ * $index                                                                    *
+ *****************************************************************************/
+
+BLE_STORE_IDX_DEFINE(ble_store_ram_our_sec_addr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_ram_our_sec_ediv_rand_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_ram_peer_sec_addr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_ram_peer_sec_ediv_rand_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_BONDS));
+BLE_STORE_IDX_DEFINE(ble_store_ram_cccd_addr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
+BLE_STORE_IDX_DEFINE(ble_store_ram_cccd_chr_idx,
+                     MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
+
+/**
+ * Rebuilds all lookup indices from the entry arrays.
+ */
+static void
+ble_store_ram_idx_rebuild(void)
+{
+    ble_store_idx_sec_rebuild(&ble_store_ram_our_sec_addr_idx,
+                              &ble_store_ram_our_sec_ediv_rand_idx,
+                              ble_store_ram_our_secs,
+                              ble_store_ram_num_our_secs);
+    ble_store_idx_sec_rebuild(&ble_store_ram_peer_sec_addr_idx,
+                              &ble_store_ram_peer_sec_ediv_rand_idx,
+                              ble_store_ram_peer_secs,
+                              ble_store_ram_num_peer_secs);
+    ble_store_idx_cccd_rebuild(&ble_store_ram_cccd_addr_idx,
+                               &ble_store_ram_cccd_chr_idx,
+                               ble_store_ram_cccds, ble_store_ram_num_cccds);
+}
+
 /*****************************************************************************
  * $sec                                                                      *
  *****************************************************************************/
@@ -88,42 +125,23 @@ ble_store_ram_print_key_sec(const struct ble_store_key_sec *key_sec)
 static int
 ble_store_ram_find_sec(const struct ble_store_key_sec *key_sec,
                        const struct ble_store_value_sec *value_secs,
-                       int num_value_secs)
+                       int num_value_secs,
+                       const struct ble_store_idx *addr_idx,
+                       const struct ble_store_idx *ediv_rand_idx)
 {
-    const struct ble_store_value_sec *cur;
     int skipped;
     int i;
 
-    skipped = 0;
-
-    for (i = 0; i < num_value_secs; i++) {
-        cur = value_secs + i;
-
-        if (ble_addr_cmp(&key_sec->peer_addr, BLE_ADDR_ANY)) {
-            if (ble_addr_cmp(&cur->peer_addr, &key_sec->peer_addr)) {
-                continue;
-            }
-        }
-
-        if (key_sec->ediv_rand_present) {
-            if (cur->ediv != key_sec->ediv) {
-                continue;
-            }
-
-            if (cur->rand_num != key_sec->rand_num) {
-                continue;
-            }
-        }
-
-        if (key_sec->idx > skipped) {
-            skipped++;
-            continue;
+    i = -1;
+    for (skipped = 0; skipped <= key_sec->idx; skipped++) {
+        i = ble_store_idx_sec_next(key_sec, value_secs, num_value_secs,
+                                   addr_idx, ediv_rand_idx, i);
+        if (i == -1) {
+            break;
         }
-
-        return i;
     }
 
-    return -1;
+    return i;
 }
 
 static int
@@ -133,7 +151,9 @@ ble_store_ram_read_our_sec(const struct ble_store_key_sec *key_sec,
     int idx;
 
     idx = ble_store_ram_find_sec(key_sec, ble_store_ram_our_secs,
-                                 ble_store_ram_num_our_secs);
+                                 ble_store_ram_num_our_secs,
+                                 &ble_store_ram_our_sec_addr_idx,
+                                 &ble_store_ram_our_sec_ediv_rand_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -153,7 +173,9 @@ ble_store_ram_write_our_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_key_from_value_sec(&key_sec, value_sec);
     idx = ble_store_ram_find_sec(&key_sec, ble_store_ram_our_secs,
-                                 ble_store_ram_num_our_secs);
+                                 ble_store_ram_num_our_secs,
+                                 &ble_store_ram_our_sec_addr_idx,
+                                 &ble_store_ram_our_sec_ediv_rand_idx);
     if (idx == -1) {
         if (ble_store_ram_num_our_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
             BLE_HS_LOG(DEBUG, "error persisting our sec; too many entries "
@@ -163,9 +185,14 @@ ble_store_ram_write_our_sec(const struct ble_store_value_sec *value_sec)
 
         idx = ble_store_ram_num_our_secs;
         ble_store_ram_num_our_secs++;
-    }
 
-    ble_store_ram_our_secs[idx] = *value_sec;
+        ble_store_ram_our_secs[idx] = *value_sec;
+        ble_store_idx_sec_add(&ble_store_ram_our_sec_addr_idx,
+                              &ble_store_ram_our_sec_ediv_rand_idx, value_sec,
+                              idx);
+    } else {
+        ble_store_ram_our_secs[idx] = *value_sec;
+    }
     return 0;
 }
 
@@ -184,7 +211,7 @@ ble_store_ram_delete_obj(void *values, int value_size, int idx,
         src = dst + value_size;
 
         move_count = *num_values - idx;
-        memmove(dst, src, move_count);
+        memmove(dst, src, move_count * value_size);
     }
 
     return 0;
@@ -193,12 +220,15 @@ ble_store_ram_delete_obj(void *values, int value_size, int idx,
 static int
 ble_store_ram_delete_sec(const struct ble_store_key_sec *key_sec,
                          struct ble_store_value_sec *value_secs,
-                         int *num_value_secs)
+                         int *num_value_secs,
+                         struct ble_store_idx *addr_idx,
+                         struct ble_store_idx *ediv_rand_idx)
 {
     int idx;
     int rc;
 
-    idx = ble_store_ram_find_sec(key_sec, value_secs, *num_value_secs);
+    idx = ble_store_ram_find_sec(key_sec, value_secs, *num_value_secs,
+                                 addr_idx, ediv_rand_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -209,6 +239,9 @@ ble_store_ram_delete_sec(const struct ble_store_key_sec *key_sec,
         return rc;
     }
 
+    ble_store_idx_sec_rebuild(addr_idx, ediv_rand_idx, value_secs,
+                              *num_value_secs);
+
     return 0;
 }
 
@@ -218,7 +251,9 @@ ble_store_ram_delete_our_sec(const struct ble_store_key_sec *key_sec)
     int rc;
 
     rc = ble_store_ram_delete_sec(key_sec, ble_store_ram_our_secs,
-                                  &ble_store_ram_num_our_secs);
+                                  &ble_store_ram_num_our_secs,
+                                  &ble_store_ram_our_sec_addr_idx,
+                                  &ble_store_ram_our_sec_ediv_rand_idx);
     if (rc != 0) {
         return rc;
     }
@@ -232,7 +267,9 @@ ble_store_ram_delete_peer_sec(const struct ble_store_key_sec *key_sec)
     int rc;
 
     rc = ble_store_ram_delete_sec(key_sec, ble_store_ram_peer_secs,
-                                  &ble_store_ram_num_peer_secs);
+                                  &ble_store_ram_num_peer_secs,
+                                  &ble_store_ram_peer_sec_addr_idx,
+                                  &ble_store_ram_peer_sec_ediv_rand_idx);
     if (rc != 0) {
         return rc;
     }
@@ -247,7 +284,9 @@ ble_store_ram_read_peer_sec(const struct ble_store_key_sec *key_sec,
     int idx;
 
     idx = ble_store_ram_find_sec(key_sec, ble_store_ram_peer_secs,
-                             ble_store_ram_num_peer_secs);
+                                 ble_store_ram_num_peer_secs,
+                                 &ble_store_ram_peer_sec_addr_idx,
+                                 &ble_store_ram_peer_sec_ediv_rand_idx);
     if (idx == -1) {
         return BLE_HS_ENOENT;
     }
@@ -267,7 +306,9 @@ ble_store_ram_write_peer_sec(const struct ble_store_value_sec *value_sec)
 
     ble_store_key_from_value_sec(&key_sec, value_sec);
     idx = ble_store_ram_find_sec(&key_sec, ble_store_ram_peer_secs,
-                                 ble_store_ram_num_peer_secs);
+                                 ble_store_ram_num_peer_secs,
+                                 &ble_store_ram_peer_sec_addr_idx,
+                                 &ble_store_ram_peer_sec_ediv_rand_idx);
     if (idx == -1) {
         if (ble_store_ram_num_peer_secs >= MYNEWT_VAL(BLE_STORE_MAX_BONDS)) {
             BLE_HS_LOG(DEBUG, "error persisting peer sec; too many entries "
@@ -277,9 +318,14 @@ ble_store_ram_write_peer_sec(const struct ble_store_value_sec *value_sec)
 
         idx = ble_store_ram_num_peer_secs;
         ble_store_ram_num_peer_secs++;
-    }
 
-    ble_store_ram_peer_secs[idx] = *value_sec;
+        ble_store_ram_peer_secs[idx] = *value_sec;
+        ble_store_idx_sec_add(&ble_store_ram_peer_sec_addr_idx,
+                              &ble_store_ram_peer_sec_ediv_rand_idx, value_sec,
+                              idx);
+    } else {
+        ble_store_ram_peer_secs[idx] = *value_sec;
+    }
     return 0;
 }
 
@@ -290,35 +336,21 @@ ble_store_ram_write_peer_sec(const struct ble_store_value_sec *value_sec)
 static int
 ble_store_ram_find_cccd(const struct ble_store_key_cccd *key)
 {
-    struct ble_store_value_cccd *cccd;
     int skipped;
     int i;
 
-    skipped = 0;
-    for (i = 0; i < ble_store_ram_num_cccds; i++) {
-        cccd = ble_store_ram_cccds + i;
-
-        if (ble_addr_cmp(&key->peer_addr, BLE_ADDR_ANY)) {
-            if (ble_addr_cmp(&cccd->peer_addr, &key->peer_addr)) {
-                continue;
-            }
-        }
-
-        if (key->chr_val_handle != 0) {
-            if (cccd->chr_val_handle != key->chr_val_handle) {
-                continue;
-            }
-        }
-
-        if (key->idx > skipped) {
-            skipped++;
-            continue;
+    i = -1;
+    for (skipped = 0; skipped <= key->idx; skipped++) {
+        i = ble_store_idx_cccd_next(key, ble_store_ram_cccds,
+                                    ble_store_ram_num_cccds,
+                                    &ble_store_ram_cccd_addr_idx,
+                                    &ble_store_ram_cccd_chr_idx, i);
+        if (i == -1) {
+            break;
         }
-
-        return i;
     }
 
-    return -1;
+    return i;
 }
 
 static int
@@ -340,6 +372,10 @@ ble_store_ram_delete_cccd(const struct ble_store_key_cccd *key_cccd)
         return rc;
     }
 
+    ble_store_idx_cccd_rebuild(&ble_store_ram_cccd_addr_idx,
+                               &ble_store_ram_cccd_chr_idx,
+                               ble_store_ram_cccds, ble_store_ram_num_cccds);
+
     return 0;
 }
 
@@ -375,9 +411,13 @@ ble_store_ram_write_cccd(const struct ble_store_value_cccd *value_cccd)
 
         idx = ble_store_ram_num_cccds;
         ble_store_ram_num_cccds++;
-    }
 
-    ble_store_ram_cccds[idx] = *value_cccd;
+        ble_store_ram_cccds[idx] = *value_cccd;
+        ble_store_idx_cccd_add(&ble_store_ram_cccd_addr_idx,
+                               &ble_store_ram_cccd_chr_idx, value_cccd, idx);
+    } else {
+        ble_store_ram_cccds[idx] = *value_cccd;
+    }
     return 0;
 }
 
@@ -480,6 +520,81 @@ ble_store_ram_delete(int obj_type, const union ble_store_key *key)
     }
 }
 
+/**
+ * Calls the specified function for each object matching the given key.  The
+ * key's idx field is ignored.  The callback may rewrite the object it is
+ * passed, but must not add or delete objects of the type being iterated.
+ *
+ * @return                      0 on success;
+ *                              BLE_HS_ENOTSUP if the object type is not
+ *                                  supported.
+ */
+int
+ble_store_ram_iterate(int obj_type, const union ble_store_key *key,
+                      ble_store_iterator_fn *cb, void *cookie)
+{
+    union ble_store_value value;
+    int i;
+
+    switch (obj_type) {
+    case BLE_STORE_OBJ_TYPE_PEER_SEC:
+        i = -1;
+        while (1) {
+            i = ble_store_idx_sec_next(
+                    &key->sec, ble_store_ram_peer_secs,
+                    ble_store_ram_num_peer_secs,
+                    &ble_store_ram_peer_sec_addr_idx,
+                    &ble_store_ram_peer_sec_ediv_rand_idx, i);
+            if (i == -1) {
+                return 0;
+            }
+
+            value.sec = ble_store_ram_peer_secs[i];
+            if (cb(obj_type, &value, cookie) != 0) {
+                return 0;
+            }
+        }
+
+    case BLE_STORE_OBJ_TYPE_OUR_SEC:
+        i = -1;
+        while (1) {
+            i = ble_store_idx_sec_next(
+                    &key->sec, ble_store_ram_our_secs,
+                    ble_store_ram_num_our_secs,
+                    &ble_store_ram_our_sec_addr_idx,
+                    &ble_store_ram_our_sec_ediv_rand_idx, i);
+            if (i == -1) {
+                return 0;
+            }
+
+            value.sec = ble_store_ram_our_secs[i];
+            if (cb(obj_type, &value, cookie) != 0) {
+                return 0;
+            }
+        }
+
+    case BLE_STORE_OBJ_TYPE_CCCD:
+        i = -1;
+        while (1) {
+            i = ble_store_idx_cccd_next(&key->cccd, ble_store_ram_cccds,
+                                        ble_store_ram_num_cccds,
+                                        &ble_store_ram_cccd_addr_idx,
+                                        &ble_store_ram_cccd_chr_idx, i);
+            if (i == -1) {
+                return 0;
+            }
+
+            value.cccd = ble_store_ram_cccds[i];
+            if (cb(obj_type, &value, cookie) != 0) {
+                return 0;
+            }
+        }
+
+    default:
+        return BLE_HS_ENOTSUP;
+    }
+}
+
 void
 ble_store_ram_init(void)
 {
@@ -489,9 +604,11 @@ ble_store_ram_init(void)
     ble_hs_cfg.store_read_cb = ble_store_ram_read;
     ble_hs_cfg.store_write_cb = ble_store_ram_write;
     ble_hs_cfg.store_delete_cb = ble_store_ram_delete;
+    ble_hs_cfg.store_iterate_cb = ble_store_ram_iterate;
 
     /* Re-initialize BSS values in case of unit tests. */
     ble_store_ram_num_our_secs = 0;
     ble_store_ram_num_peer_secs = 0;
     ble_store_ram_num_cccds = 0;
+    ble_store_ram_idx_rebuild();
 }
@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "sysinit/sysinit.h"
+#include "syscfg/syscfg.h"
+#include "testutil/testutil.h"
+#include "host/ble_hs.h"
+#include "store/ram/ble_store_ram.h"
+
+#define BLE_STORE_RAM_TEST_NUM_ENTRIES  3
+
+static void
+ble_store_ram_test_util_init(void)
+{
+    /* Re-initializes the store, emptying it. */
+    sysinit();
+}
+
+static void
+ble_store_ram_test_util_verify_sec(const struct ble_store_value_sec *exp)
+{
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_key_from_value_sec(&key.sec, exp);
+
+    rc = ble_store_ram_read(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &value);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(&value.sec, exp, sizeof *exp) == 0);
+}
+
+static void
+ble_store_ram_test_util_verify_cccd(const struct ble_store_value_cccd *exp)
+{
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+
+    ble_store_key_from_value_cccd(&key.cccd, exp);
+
+    rc = ble_store_ram_read(BLE_STORE_OBJ_TYPE_CCCD, &key, &value);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(&value.cccd, exp, sizeof *exp) == 0);
+}
+
+/**
+ * Deleting an entry from the middle of the array must shift every following
+ * entry down intact.
+ */
+TEST_CASE(ble_store_ram_test_case_delete_sec)
+{
+    struct ble_store_value_sec secs[BLE_STORE_RAM_TEST_NUM_ENTRIES];
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+    int i;
+
+    ble_store_ram_test_util_init();
+
+    memset(secs, 0, sizeof secs);
+    for (i = 0; i < BLE_STORE_RAM_TEST_NUM_ENTRIES; i++) {
+        secs[i].peer_addr.type = BLE_ADDR_PUBLIC;
+        memset(secs[i].peer_addr.val, i + 1, sizeof secs[i].peer_addr.val);
+        secs[i].key_size = 16;
+        secs[i].ediv = 0x1000 + i;
+        secs[i].rand_num = 0x0102030405060708ULL * (i + 1);
+        memset(secs[i].ltk, 0xa0 + i, sizeof secs[i].ltk);
+        secs[i].ltk_present = 1;
+        memset(secs[i].irk, 0xb0 + i, sizeof secs[i].irk);
+        secs[i].irk_present = 1;
+
+        value.sec = secs[i];
+        rc = ble_store_ram_write(BLE_STORE_OBJ_TYPE_PEER_SEC, &value);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    ble_store_key_from_value_sec(&key.sec, &secs[1]);
+    rc = ble_store_ram_delete(BLE_STORE_OBJ_TYPE_PEER_SEC, &key);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_store_ram_read(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &value);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    ble_store_ram_test_util_verify_sec(&secs[0]);
+    ble_store_ram_test_util_verify_sec(&secs[2]);
+
+    /* The shifted entry is now at idx 1 of a wildcard search. */
+    memset(&key, 0, sizeof key);
+    key.sec.peer_addr = *BLE_ADDR_ANY;
+    key.sec.idx = 1;
+    rc = ble_store_ram_read(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &value);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(&value.sec, &secs[2], sizeof secs[2]) == 0);
+
+    key.sec.idx = 2;
+    rc = ble_store_ram_read(BLE_STORE_OBJ_TYPE_PEER_SEC, &key, &value);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+}
+
+TEST_CASE(ble_store_ram_test_case_delete_cccd)
+{
+    struct ble_store_value_cccd cccds[BLE_STORE_RAM_TEST_NUM_ENTRIES];
+    union ble_store_value value;
+    union ble_store_key key;
+    int rc;
+    int i;
+
+    ble_store_ram_test_util_init();
+
+    memset(cccds, 0, sizeof cccds);
+    for (i = 0; i < BLE_STORE_RAM_TEST_NUM_ENTRIES; i++) {
+        cccds[i].peer_addr = (ble_addr_t){
+            BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 }
+        };
+        cccds[i].chr_val_handle = 0x10 + i;
+        cccds[i].flags = 0x0001; /* Notify. */
+        cccds[i].value_changed = i % 2;
+
+        value.cccd = cccds[i];
+        rc = ble_store_ram_write(BLE_STORE_OBJ_TYPE_CCCD, &value);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    ble_store_key_from_value_cccd(&key.cccd, &cccds[0]);
+    rc = ble_store_ram_delete(BLE_STORE_OBJ_TYPE_CCCD, &key);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_store_ram_read(BLE_STORE_OBJ_TYPE_CCCD, &key, &value);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    ble_store_ram_test_util_verify_cccd(&cccds[1]);
+    ble_store_ram_test_util_verify_cccd(&cccds[2]);
+}
+
+TEST_SUITE(ble_store_ram_test_suite)
+{
+    ble_store_ram_test_case_delete_sec();
+    ble_store_ram_test_case_delete_cccd();
+}
+
+#if MYNEWT_VAL(SELFTEST)
+
+int
+main(int argc, char **argv)
+{
+    sysinit();
+
+    ble_store_ram_test_suite();
+
+    return tu_any_failed;
+}
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "sysinit/sysinit.h"
+#include "testutil/testutil.h"
+#include "nimble/hci_common.h"
+#include "nimble/ble_hci_trans.h"
+#include "ble_ext_adv_test_util.h"
+
+#define BLE_EXT_ADV_TEST_UTIL_ACK_MAX       8
+#define BLE_EXT_ADV_TEST_UTIL_HCI_OUT_MAX   8
+
+struct ble_ext_adv_test_util_ack {
+    uint16_t opcode;
+    uint8_t status;
+    uint8_t params[32];
+    uint8_t params_len;
+};
+
+static struct ble_ext_adv_test_util_ack
+ble_ext_adv_test_util_acks[BLE_EXT_ADV_TEST_UTIL_ACK_MAX];
+static int ble_ext_adv_test_util_ack_cnt;
+
+static uint8_t
+ble_ext_adv_test_util_hci_out[BLE_EXT_ADV_TEST_UTIL_HCI_OUT_MAX][260];
+static int ble_ext_adv_test_util_hci_out_cnt;
+static uint8_t ble_ext_adv_test_util_hci_out_cur[260];
+
+struct ble_gap_event
+    ble_ext_adv_test_util_events[BLE_EXT_ADV_TEST_UTIL_EVENT_MAX];
+int ble_ext_adv_test_util_num_events;
+
+/**
+ * Phony ack callback; completes each command with the oldest queued ack.
+ */
+static int
+ble_ext_adv_test_util_ack_cb(uint8_t *ack, int ack_buf_len)
+{
+    struct ble_ext_adv_test_util_ack *entry;
+
+    if (ble_ext_adv_test_util_ack_cnt == 0) {
+        return BLE_HS_ETIMEOUT_HCI;
+    }
+
+    entry = ble_ext_adv_test_util_acks;
+    TEST_ASSERT_FATAL(ack_buf_len >= BLE_HCI_EVENT_CMD_COMPLETE_HDR_LEN + 1 +
+                                     entry->params_len);
+
+    ack[0] = BLE_HCI_EVCODE_COMMAND_COMPLETE;
+    ack[1] = 4 + entry->params_len;
+    ack[2] = 1;
+    put_le16(ack + 3, entry->opcode);
+    ack[BLE_HCI_EVENT_CMD_COMPLETE_HDR_LEN] = entry->status;
+    memcpy(ack + BLE_HCI_EVENT_CMD_COMPLETE_HDR_LEN + 1, entry->params,
+           entry->params_len);
+
+    ble_ext_adv_test_util_ack_cnt--;
+    memmove(ble_ext_adv_test_util_acks, ble_ext_adv_test_util_acks + 1,
+            sizeof *entry * ble_ext_adv_test_util_ack_cnt);
+
+    return 0;
+}
+
+static int
+ble_ext_adv_test_util_hci_txed(uint8_t *cmdbuf, void *arg)
+{
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_hci_out_cnt <
+                      BLE_EXT_ADV_TEST_UTIL_HCI_OUT_MAX);
+
+    memcpy(ble_ext_adv_test_util_hci_out[ble_ext_adv_test_util_hci_out_cnt],
+           cmdbuf, sizeof ble_ext_adv_test_util_hci_out[0]);
+    ble_ext_adv_test_util_hci_out_cnt++;
+
+    ble_hci_trans_buf_free(cmdbuf);
+    return 0;
+}
+
+static int
+ble_ext_adv_test_util_acl_txed(struct os_mbuf *om, void *arg)
+{
+    os_mbuf_free_chain(om);
+    return 0;
+}
+
+void
+ble_ext_adv_test_util_init(void)
+{
+    sysinit();
+
+    ble_ext_adv_test_util_ack_cnt = 0;
+    ble_ext_adv_test_util_hci_out_cnt = 0;
+    ble_ext_adv_test_util_num_events = 0;
+
+    ble_hci_trans_cfg_ll(ble_ext_adv_test_util_hci_txed, NULL,
+                         ble_ext_adv_test_util_acl_txed, NULL);
+    ble_hs_hci_set_phony_ack_cb(ble_ext_adv_test_util_ack_cb);
+}
+
+/**
+ * Queues the ack for the next LE controller command.
+ */
+void
+ble_ext_adv_test_util_ack_append(uint16_t ocf, uint8_t status,
+                                 const void *params, uint8_t params_len)
+{
+    struct ble_ext_adv_test_util_ack *ack;
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_ack_cnt <
+                      BLE_EXT_ADV_TEST_UTIL_ACK_MAX);
+    TEST_ASSERT_FATAL(params_len <= sizeof ack->params);
+
+    ack = ble_ext_adv_test_util_acks + ble_ext_adv_test_util_ack_cnt;
+    ack->opcode = BLE_HCI_OP(BLE_HCI_OGF_LE, ocf);
+    ack->status = status;
+    if (params_len > 0) {
+        memcpy(ack->params, params, params_len);
+    }
+    ack->params_len = params_len;
+
+    ble_ext_adv_test_util_ack_cnt++;
+}
+
+int
+ble_ext_adv_test_util_num_acks(void)
+{
+    return ble_ext_adv_test_util_ack_cnt;
+}
+
+/**
+ * Removes the oldest transmitted HCI command and verifies it is the specified
+ * LE command.
+ *
+ * @return                      The command parameters.
+ */
+uint8_t *
+ble_ext_adv_test_util_hci_out_first(uint16_t ocf, uint8_t *out_params_len)
+{
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_hci_out_cnt > 0);
+
+    memcpy(ble_ext_adv_test_util_hci_out_cur,
+           ble_ext_adv_test_util_hci_out[0],
+           sizeof ble_ext_adv_test_util_hci_out_cur);
+
+    ble_ext_adv_test_util_hci_out_cnt--;
+    memmove(ble_ext_adv_test_util_hci_out, ble_ext_adv_test_util_hci_out + 1,
+            sizeof ble_ext_adv_test_util_hci_out[0] *
+            ble_ext_adv_test_util_hci_out_cnt);
+
+    TEST_ASSERT_FATAL(get_le16(ble_ext_adv_test_util_hci_out_cur) ==
+                      BLE_HCI_OP(BLE_HCI_OGF_LE, ocf));
+
+    if (out_params_len != NULL) {
+        *out_params_len = ble_ext_adv_test_util_hci_out_cur[2];
+    }
+
+    return ble_ext_adv_test_util_hci_out_cur + BLE_HCI_CMD_HDR_LEN;
+}
+
+int
+ble_ext_adv_test_util_num_hci_out(void)
+{
+    return ble_ext_adv_test_util_hci_out_cnt;
+}
+
+/**
+ * Passes the specified HCI event to the host as if the controller had sent
+ * it.
+ */
+void
+ble_ext_adv_test_util_rx_evt(const uint8_t *evt)
+{
+    uint8_t *evbuf;
+    int rc;
+
+    evbuf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_LO);
+    TEST_ASSERT_FATAL(evbuf != NULL);
+
+    memcpy(evbuf, evt, BLE_HCI_EVENT_HDR_LEN + evt[1]);
+
+    rc = ble_hs_hci_evt_process(evbuf);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+int
+ble_ext_adv_test_util_event_cb(struct ble_gap_event *event, void *arg)
+{
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events <
+                      BLE_EXT_ADV_TEST_UTIL_EVENT_MAX);
+
+    ble_ext_adv_test_util_events[ble_ext_adv_test_util_num_events++] = *event;
+    return 0;
+}
+
+/**
+ * Configures a non-connectable, non-scannable extended advertising instance;
+ * the only kind periodic advertising can be enabled on.
+ */
+void
+ble_ext_adv_test_util_configure_nonconn(uint8_t instance)
+{
+    struct ble_gap_ext_adv_params params;
+    int8_t tx_power;
+    int rc;
+
+    memset(&params, 0, sizeof params);
+    params.own_addr_type = BLE_OWN_ADDR_PUBLIC;
+    params.primary_phy = BLE_HCI_LE_PHY_1M;
+    params.secondary_phy = BLE_HCI_LE_PHY_1M;
+    params.sid = instance;
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_EXT_ADV_PARAM, 0,
+                                     (uint8_t[]){ 0 }, 1);
+    rc = ble_gap_ext_adv_configure(instance, &params, &tx_power,
+                                   ble_ext_adv_test_util_event_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_SET_EXT_ADV_PARAM,
+                                        NULL);
+}
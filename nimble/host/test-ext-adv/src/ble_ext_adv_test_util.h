@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_BLE_EXT_ADV_TEST_UTIL_
+#define H_BLE_EXT_ADV_TEST_UTIL_
+
+#include <inttypes.h>
+#include "host/ble_gap.h"
+#include "ble_hs_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_EXT_ADV_TEST_UTIL_EVENT_MAX     8
+
+extern struct ble_gap_event
+    ble_ext_adv_test_util_events[BLE_EXT_ADV_TEST_UTIL_EVENT_MAX];
+extern int ble_ext_adv_test_util_num_events;
+
+void ble_ext_adv_test_util_init(void);
+void ble_ext_adv_test_util_ack_append(uint16_t ocf, uint8_t status,
+                                      const void *params, uint8_t params_len);
+int ble_ext_adv_test_util_num_acks(void);
+uint8_t *ble_ext_adv_test_util_hci_out_first(uint16_t ocf,
+                                             uint8_t *out_params_len);
+int ble_ext_adv_test_util_num_hci_out(void);
+void ble_ext_adv_test_util_rx_evt(const uint8_t *evt);
+int ble_ext_adv_test_util_event_cb(struct ble_gap_event *event, void *arg);
+void ble_ext_adv_test_util_configure_nonconn(uint8_t instance);
+
+int ble_gap_periodic_test_all(void);
+int ble_gap_ext_disc_test_all(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "testutil/testutil.h"
+#include "nimble/hci_common.h"
+#include "ble_ext_adv_test_util.h"
+
+/* Fits a report, with its HCI headers, in a transport event buffer. */
+#define BLE_GAP_EXT_DISC_TEST_FRAG_LEN  40
+
+static const ble_addr_t ble_gap_ext_disc_test_addr = {
+    .type = BLE_ADDR_RANDOM,
+    .val = { 1, 2, 3, 4, 5, 0xc6 },
+};
+
+static uint8_t ble_gap_ext_disc_test_data[MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_LEN)];
+static uint16_t ble_gap_ext_disc_test_data_len;
+static uint8_t ble_gap_ext_disc_test_data_status;
+static int ble_gap_ext_disc_test_num_reports;
+
+static int
+ble_gap_ext_disc_test_event_cb(struct ble_gap_event *event, void *arg)
+{
+    TEST_ASSERT_FATAL(event->type == BLE_GAP_EVENT_EXT_DISC);
+    TEST_ASSERT_FATAL(event->ext_disc.length_data <=
+                      sizeof ble_gap_ext_disc_test_data);
+
+    /* The payload is only valid for the duration of the callback. */
+    memcpy(ble_gap_ext_disc_test_data, event->ext_disc.data,
+           event->ext_disc.length_data);
+    ble_gap_ext_disc_test_data_len = event->ext_disc.length_data;
+    ble_gap_ext_disc_test_data_status = event->ext_disc.data_status;
+    ble_gap_ext_disc_test_num_reports++;
+
+    return 0;
+}
+
+static void
+ble_gap_ext_disc_test_util_start(void)
+{
+    struct ble_gap_ext_disc_params params;
+    int rc;
+
+    ble_gap_ext_disc_test_data_len = 0;
+    ble_gap_ext_disc_test_num_reports = 0;
+
+    memset(&params, 0, sizeof params);
+    params.passive = 1;
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_EXT_SCAN_PARAM, 0,
+                                     NULL, 0);
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_EXT_SCAN_ENABLE, 0,
+                                     NULL, 0);
+
+    rc = ble_gap_ext_disc(BLE_OWN_ADDR_PUBLIC, 0, 0, 0, 0, 0, &params, NULL,
+                          ble_gap_ext_disc_test_event_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/**
+ * Receives a single extended advertising report whose data is the
+ * specified slice of an incrementing byte pattern.
+ */
+static void
+ble_gap_ext_disc_test_util_rx_report(uint8_t sid, uint8_t data_status,
+                                     int off, int len)
+{
+    struct hci_ext_adv_report_param *params;
+    uint8_t buf[BLE_HCI_EVENT_HDR_LEN + 2 + sizeof *params +
+                BLE_GAP_EXT_DISC_TEST_FRAG_LEN];
+    int i;
+
+    TEST_ASSERT_FATAL(len <= BLE_GAP_EXT_DISC_TEST_FRAG_LEN);
+
+    memset(buf, 0, sizeof buf);
+    buf[0] = BLE_HCI_EVCODE_LE_META;
+    buf[1] = 2 + sizeof *params + len;
+    buf[2] = BLE_HCI_LE_SUBEV_EXT_ADV_RPT;
+    buf[3] = 1;
+
+    params = (void *)(buf + 4);
+    put_le16(&params->evt_type, data_status << 5);
+    params->addr_type = ble_gap_ext_disc_test_addr.type;
+    memcpy(params->addr, ble_gap_ext_disc_test_addr.val, 6);
+    params->prim_phy = BLE_HCI_LE_PHY_1M;
+    params->sec_phy = BLE_HCI_LE_PHY_1M;
+    params->sid = sid;
+    params->tx_power = 127;
+    params->rssi = -40;
+    params->adv_data_len = len;
+    for (i = 0; i < len; i++) {
+        params->adv_data[i] = off + i;
+    }
+
+    ble_ext_adv_test_util_rx_evt(buf);
+}
+
+/**
+ * Sends a chained advertisement of the specified total length, split into
+ * fragments that each fit in an event buffer.
+ */
+static void
+ble_gap_ext_disc_test_util_rx_chain(uint8_t sid, int total_len)
+{
+    uint8_t data_status;
+    int num_reports;
+    int frag_len;
+    int off;
+
+    num_reports = ble_gap_ext_disc_test_num_reports;
+
+    for (off = 0; off < total_len; off += frag_len) {
+        frag_len = total_len - off;
+        if (frag_len > BLE_GAP_EXT_DISC_TEST_FRAG_LEN) {
+            frag_len = BLE_GAP_EXT_DISC_TEST_FRAG_LEN;
+        }
+
+        if (off + frag_len < total_len) {
+            data_status = BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE;
+        } else {
+            data_status = BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE;
+        }
+
+        ble_gap_ext_disc_test_util_rx_report(sid, data_status, off,
+                                             frag_len);
+
+        if (data_status == BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE) {
+            /* Nothing is delivered until the last fragment. */
+            TEST_ASSERT(ble_gap_ext_disc_test_num_reports == num_reports);
+        }
+    }
+}
+
+static void
+ble_gap_ext_disc_test_util_verify_data(int len)
+{
+    int i;
+
+    TEST_ASSERT_FATAL(ble_gap_ext_disc_test_data_len == len);
+    for (i = 0; i < len; i++) {
+        TEST_ASSERT_FATAL(ble_gap_ext_disc_test_data[i] == (uint8_t)i);
+    }
+}
+
+TEST_CASE(ble_gap_ext_disc_test_case_chain)
+{
+    ble_ext_adv_test_util_init();
+    ble_gap_ext_disc_test_util_start();
+
+    /* Longer than a uint8_t can describe. */
+    ble_gap_ext_disc_test_util_rx_chain(3, 300);
+
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 1);
+    TEST_ASSERT(ble_gap_ext_disc_test_data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE);
+    ble_gap_ext_disc_test_util_verify_data(300);
+
+    /* An unchained advertisement is delivered as is. */
+    ble_gap_ext_disc_test_num_reports = 0;
+    ble_gap_ext_disc_test_util_rx_chain(3, 20);
+
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 1);
+    TEST_ASSERT(ble_gap_ext_disc_test_data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE);
+    ble_gap_ext_disc_test_util_verify_data(20);
+}
+
+TEST_CASE(ble_gap_ext_disc_test_case_chain_trunc)
+{
+    ble_ext_adv_test_util_init();
+    ble_gap_ext_disc_test_util_start();
+
+    /* Longer than the reassembly buffer. */
+    ble_gap_ext_disc_test_util_rx_chain(3,
+                                        MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_LEN) +
+                                        50);
+
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 1);
+    TEST_ASSERT(ble_gap_ext_disc_test_data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_TRUNCATED);
+    ble_gap_ext_disc_test_util_verify_data(
+        MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_LEN));
+}
+
+TEST_CASE(ble_gap_ext_disc_test_case_chain_no_mem)
+{
+    int i;
+
+    ble_ext_adv_test_util_init();
+    ble_gap_ext_disc_test_util_start();
+
+    /* Occupy every reassembly buffer. */
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_MAX); i++) {
+        ble_gap_ext_disc_test_util_rx_report(
+            10 + i, BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE, 0,
+            BLE_GAP_EXT_DISC_TEST_FRAG_LEN);
+    }
+
+    /* No buffer for this one; none of its fragments, and in particular not
+     * the last one, may be reported.
+     */
+    ble_gap_ext_disc_test_util_rx_chain(3, 100);
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 0);
+
+    /* The advertisements that got a buffer complete normally. */
+    for (i = 0; i < MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_MAX); i++) {
+        ble_gap_ext_disc_test_util_rx_report(
+            10 + i, BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+            BLE_GAP_EXT_DISC_TEST_FRAG_LEN, 10);
+    }
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports ==
+                MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_MAX));
+    ble_gap_ext_disc_test_util_verify_data(
+        BLE_GAP_EXT_DISC_TEST_FRAG_LEN + 10);
+
+    /* The next transmission of the dropped advertisement is reassembled. */
+    ble_gap_ext_disc_test_num_reports = 0;
+    ble_gap_ext_disc_test_util_rx_chain(3, 100);
+
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 1);
+    TEST_ASSERT(ble_gap_ext_disc_test_data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE);
+    ble_gap_ext_disc_test_util_verify_data(100);
+}
+
+TEST_CASE(ble_gap_ext_disc_test_case_chain_timeout)
+{
+    uint32_t ticks;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+    ble_gap_ext_disc_test_util_start();
+
+    ble_gap_ext_disc_test_util_rx_report(
+        3, BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE, 0,
+        BLE_GAP_EXT_DISC_TEST_FRAG_LEN);
+
+    /* Let the reassembly expire. */
+    rc = os_time_ms_to_ticks(MYNEWT_VAL(BLE_GAP_EXT_ADV_RSM_TIMEOUT), &ticks);
+    TEST_ASSERT_FATAL(rc == 0);
+    os_time_advance(ticks + 1);
+    ble_gap_timer();
+
+    /* The late remainder is neither a new advertisement nor a complete
+     * one.
+     */
+    ble_gap_ext_disc_test_util_rx_report(
+        3, BLE_GAP_EXT_ADV_DATA_STATUS_INCOMPLETE,
+        BLE_GAP_EXT_DISC_TEST_FRAG_LEN, BLE_GAP_EXT_DISC_TEST_FRAG_LEN);
+    ble_gap_ext_disc_test_util_rx_report(
+        3, BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE,
+        2 * BLE_GAP_EXT_DISC_TEST_FRAG_LEN, 20);
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 0);
+
+    /* The next transmission is reassembled. */
+    ble_gap_ext_disc_test_util_rx_chain(3, 100);
+
+    TEST_ASSERT(ble_gap_ext_disc_test_num_reports == 1);
+    TEST_ASSERT(ble_gap_ext_disc_test_data_status ==
+                BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE);
+    ble_gap_ext_disc_test_util_verify_data(100);
+}
+
+TEST_SUITE(ble_gap_ext_disc_test_suite)
+{
+    ble_gap_ext_disc_test_case_chain();
+    ble_gap_ext_disc_test_case_chain_trunc();
+    ble_gap_ext_disc_test_case_chain_no_mem();
+    ble_gap_ext_disc_test_case_chain_timeout();
+}
+
+int
+ble_gap_ext_disc_test_all(void)
+{
+    ble_gap_ext_disc_test_suite();
+
+    return tu_any_failed;
+}
@@ -0,0 +1,611 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "testutil/testutil.h"
+#include "nimble/hci_common.h"
+#include "ble_ext_adv_test_util.h"
+
+static const ble_addr_t ble_gap_periodic_test_adv_addr = {
+    .type = BLE_ADDR_RANDOM,
+    .val = { 1, 2, 3, 4, 5, 0xc6 },
+};
+
+static const struct ble_gap_periodic_sync_params
+ble_gap_periodic_test_sync_params = {
+    .skip = 2,
+    .sync_timeout = 0x0100,
+};
+
+static void
+ble_gap_periodic_test_util_start_adv(uint8_t instance)
+{
+    struct ble_gap_periodic_adv_params params;
+    int rc;
+
+    ble_ext_adv_test_util_configure_nonconn(instance);
+
+    memset(&params, 0, sizeof params);
+    params.itvl_min = 0x0010;
+    params.itvl_max = 0x0020;
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_configure(instance, &params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_start(instance);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS,
+                                        NULL);
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE,
+                                        NULL);
+}
+
+static void
+ble_gap_periodic_test_util_create_sync(uint8_t sid)
+{
+    int rc;
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_create_sync(&ble_gap_periodic_test_adv_addr,
+                                          sid,
+                                          &ble_gap_periodic_test_sync_params,
+                                          ble_ext_adv_test_util_event_cb,
+                                          NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC,
+                                        NULL);
+}
+
+static void
+ble_gap_periodic_test_util_rx_estab(uint8_t status, uint16_t sync_handle,
+                                    uint8_t sid)
+{
+    struct hci_le_periodic_adv_sync_estab evt;
+
+    memset(&evt, 0, sizeof evt);
+    evt.subevent_code = BLE_HCI_LE_SUBEV_PER_ADV_SYNC_ESTAB;
+    evt.status = status;
+    evt.sync_handle = sync_handle;
+    evt.sid = sid;
+    evt.adv_addr_type = ble_gap_periodic_test_adv_addr.type;
+    memcpy(evt.adv_addr, ble_gap_periodic_test_adv_addr.val,
+           sizeof evt.adv_addr);
+    evt.adv_phy = BLE_HCI_LE_PHY_2M;
+    evt.per_adv_itvl = 0x0020;
+    evt.adv_clk_accuracy = 1;
+
+    ble_gap_rx_periodic_adv_sync_estab(&evt);
+}
+
+static void
+ble_gap_periodic_test_util_rx_lost(uint16_t sync_handle)
+{
+    struct hci_le_periodic_adv_sync_lost evt;
+
+    evt.subevent_code = BLE_HCI_LE_SUBEV_PER_ADV_SYNC_LOST;
+    evt.sync_handle = sync_handle;
+
+    ble_gap_rx_periodic_adv_sync_lost(&evt);
+}
+
+static void
+ble_gap_periodic_test_util_establish(uint16_t sync_handle, uint8_t sid)
+{
+    ble_gap_periodic_test_util_create_sync(sid);
+    ble_gap_periodic_test_util_rx_estab(0, sync_handle, sid);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    TEST_ASSERT(ble_ext_adv_test_util_events[0].periodic_sync.status == 0);
+    ble_ext_adv_test_util_num_events = 0;
+}
+
+/*****************************************************************************
+ * $adv                                                                      *
+ *****************************************************************************/
+
+TEST_CASE(ble_gap_periodic_test_case_adv)
+{
+    static const uint8_t data[] = { 0x04, 0xff, 0x01, 0x02, 0x03 };
+    struct ble_gap_periodic_adv_params params;
+    struct os_mbuf *om;
+    uint8_t *cmd;
+    uint8_t len;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+
+    memset(&params, 0, sizeof params);
+    params.include_tx_power = 1;
+    params.itvl_min = 0x0010;
+    params.itvl_max = 0x0020;
+
+    /*** Instance not configured for extended advertising. */
+    rc = ble_gap_periodic_adv_configure(0, &params);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    ble_ext_adv_test_util_configure_nonconn(0);
+
+    /*** Invalid intervals. */
+    params.itvl_min = BLE_HCI_PERIODIC_ADV_ITVL_MIN - 1;
+    rc = ble_gap_periodic_adv_configure(0, &params);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    params.itvl_min = 0x0030;
+    rc = ble_gap_periodic_adv_configure(0, &params);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    params.itvl_min = 0x0010;
+
+    /*** Data and start require periodic parameters first. */
+    om = os_msys_get_pkthdr(0, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, data, sizeof data);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gap_periodic_adv_set_data(0, om);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    rc = ble_gap_periodic_adv_start(0);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+
+    /*** Configure. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_configure(0, &params);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    cmd = ble_ext_adv_test_util_hci_out_first(
+        BLE_HCI_OCF_LE_SET_PER_ADV_PARAMS, &len);
+    TEST_ASSERT(len == BLE_HCI_LE_SET_PER_ADV_PARAMS_LEN);
+    TEST_ASSERT(cmd[0] == 0);
+    TEST_ASSERT(get_le16(cmd + 1) == 0x0010);
+    TEST_ASSERT(get_le16(cmd + 3) == 0x0020);
+    TEST_ASSERT(get_le16(cmd + 5) == BLE_HCI_LE_SET_EXT_ADV_PROP_INC_TX_PWR);
+
+    /*** Controller rejects the enable; periodic advertising stays off. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE,
+                                     BLE_ERR_CMD_DISALLOWED, NULL, 0);
+    rc = ble_gap_periodic_adv_start(0);
+    TEST_ASSERT(rc == BLE_HS_HCI_ERR(BLE_ERR_CMD_DISALLOWED));
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE,
+                                        NULL);
+
+    rc = ble_gap_periodic_adv_stop(0);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** Start. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_start(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    cmd = ble_ext_adv_test_util_hci_out_first(
+        BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE, &len);
+    TEST_ASSERT(len == BLE_HCI_LE_SET_PER_ADV_ENABLE_LEN);
+    TEST_ASSERT(cmd[0] == 1);
+    TEST_ASSERT(cmd[1] == 0);
+
+    rc = ble_gap_periodic_adv_start(0);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    rc = ble_gap_periodic_adv_configure(0, &params);
+    TEST_ASSERT(rc == BLE_HS_EBUSY);
+
+    /*** Data may be replaced while the train is running. */
+    om = os_msys_get_pkthdr(0, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, data, sizeof data);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_DATA, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_set_data(0, om);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    cmd = ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_SET_PER_ADV_DATA,
+                                              &len);
+    TEST_ASSERT(len == BLE_HCI_SET_PER_ADV_DATA_HDR_LEN + sizeof data);
+    TEST_ASSERT(cmd[0] == 0);
+    TEST_ASSERT(cmd[1] == BLE_HCI_LE_SET_EXT_ADV_DATA_OPER_COMPLETE);
+    TEST_ASSERT(cmd[2] == sizeof data);
+    TEST_ASSERT(memcmp(cmd + 3, data, sizeof data) == 0);
+
+    /*** Stop. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_stop(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    cmd = ble_ext_adv_test_util_hci_out_first(
+        BLE_HCI_OCF_LE_SET_PER_ADV_ENABLE, NULL);
+    TEST_ASSERT(cmd[0] == 0);
+    TEST_ASSERT(cmd[1] == 0);
+
+    rc = ble_gap_periodic_adv_stop(0);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    TEST_ASSERT(ble_ext_adv_test_util_num_acks() == 0);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+}
+
+TEST_CASE(ble_gap_periodic_test_case_adv_conn)
+{
+    struct ble_gap_periodic_adv_params periodic_params;
+    struct ble_gap_ext_adv_params params;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+
+    /* Periodic advertising is not allowed on a connectable instance. */
+    memset(&params, 0, sizeof params);
+    params.connectable = 1;
+    params.own_addr_type = BLE_OWN_ADDR_PUBLIC;
+    params.primary_phy = BLE_HCI_LE_PHY_1M;
+    params.secondary_phy = BLE_HCI_LE_PHY_1M;
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_SET_EXT_ADV_PARAM, 0,
+                                     (uint8_t[]){ 0 }, 1);
+    rc = ble_gap_ext_adv_configure(0, &params, NULL,
+                                   ble_ext_adv_test_util_event_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_SET_EXT_ADV_PARAM,
+                                        NULL);
+
+    memset(&periodic_params, 0, sizeof periodic_params);
+    periodic_params.itvl_min = 0x0010;
+    periodic_params.itvl_max = 0x0010;
+    rc = ble_gap_periodic_adv_configure(0, &periodic_params);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+}
+
+TEST_SUITE(ble_gap_periodic_test_suite_adv)
+{
+    ble_gap_periodic_test_case_adv();
+    ble_gap_periodic_test_case_adv_conn();
+}
+
+/*****************************************************************************
+ * $sync                                                                     *
+ *****************************************************************************/
+
+TEST_CASE(ble_gap_periodic_test_case_sync_cancel)
+{
+    struct ble_gap_event *event;
+    uint8_t *cmd;
+    uint8_t len;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+
+    /*** Invalid arguments. */
+    rc = ble_gap_periodic_adv_create_sync(&ble_gap_periodic_test_adv_addr,
+                                          0x10,
+                                          &ble_gap_periodic_test_sync_params,
+                                          ble_ext_adv_test_util_event_cb,
+                                          NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    rc = ble_gap_periodic_adv_create_sync(NULL, 1,
+                                          &ble_gap_periodic_test_sync_params,
+                                          ble_ext_adv_test_util_event_cb,
+                                          NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Nothing to cancel. */
+    rc = ble_gap_periodic_adv_create_sync_cancel();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+
+    /*** Create sync. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_create_sync(&ble_gap_periodic_test_adv_addr, 3,
+                                          &ble_gap_periodic_test_sync_params,
+                                          ble_ext_adv_test_util_event_cb,
+                                          NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    cmd = ble_ext_adv_test_util_hci_out_first(
+        BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC, &len);
+    TEST_ASSERT(len == BLE_HCI_LE_PER_ADV_CREATE_SYNC_LEN);
+    TEST_ASSERT(cmd[0] == 0);
+    TEST_ASSERT(cmd[1] == 3);
+    TEST_ASSERT(cmd[2] == ble_gap_periodic_test_adv_addr.type);
+    TEST_ASSERT(memcmp(cmd + 3, ble_gap_periodic_test_adv_addr.val, 6) == 0);
+    TEST_ASSERT(get_le16(cmd + 9) == ble_gap_periodic_test_sync_params.skip);
+    TEST_ASSERT(get_le16(cmd + 11) ==
+                ble_gap_periodic_test_sync_params.sync_timeout);
+
+    /*** Only one sync procedure at a time. */
+    rc = ble_gap_periodic_adv_create_sync(&ble_gap_periodic_test_adv_addr, 4,
+                                          &ble_gap_periodic_test_sync_params,
+                                          ble_ext_adv_test_util_event_cb,
+                                          NULL);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** Cancel; the procedure ends when the controller reports it. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC_CANCEL,
+                                     0, NULL, 0);
+    rc = ble_gap_periodic_adv_create_sync_cancel();
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_ext_adv_test_util_hci_out_first(
+        BLE_HCI_OCF_LE_PER_ADV_CREATE_SYNC_CANCEL, NULL);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 0);
+
+    ble_gap_periodic_test_util_rx_estab(BLE_ERR_OPERATION_CANCELLED, 0, 3);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC);
+    TEST_ASSERT(event->periodic_sync.status == BLE_HS_EAPP);
+
+    rc = ble_gap_periodic_adv_create_sync_cancel();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /* A stray sync established event is ignored. */
+    ble_gap_periodic_test_util_rx_estab(0, 1, 3);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 1);
+
+    /*** Controller fails to synchronize. */
+    ble_ext_adv_test_util_num_events = 0;
+    ble_gap_periodic_test_util_create_sync(3);
+    ble_gap_periodic_test_util_rx_estab(BLE_ERR_CONN_ESTABLISHMENT, 0, 3);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC);
+    TEST_ASSERT(event->periodic_sync.status ==
+                BLE_HS_HCI_ERR(BLE_ERR_CONN_ESTABLISHMENT));
+
+    rc = ble_gap_periodic_adv_terminate_sync(0);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    TEST_ASSERT(ble_ext_adv_test_util_num_acks() == 0);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+}
+
+TEST_CASE(ble_gap_periodic_test_case_sync_terminate)
+{
+    struct hci_le_periodic_adv_rpt rpt;
+    struct ble_gap_event *event;
+    uint8_t data[] = { 0x02, 0x01, 0x06 };
+    uint8_t *cmd;
+    uint8_t len;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+
+    /*** Establish. */
+    ble_gap_periodic_test_util_create_sync(5);
+    ble_gap_periodic_test_util_rx_estab(0, 0x0010, 5);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC);
+    TEST_ASSERT(event->periodic_sync.status == 0);
+    TEST_ASSERT(event->periodic_sync.sync_handle == 0x0010);
+    TEST_ASSERT(event->periodic_sync.sid == 5);
+    TEST_ASSERT(ble_addr_cmp(&event->periodic_sync.adv_addr,
+                             &ble_gap_periodic_test_adv_addr) == 0);
+    TEST_ASSERT(event->periodic_sync.adv_phy == BLE_HCI_LE_PHY_2M);
+    TEST_ASSERT(event->periodic_sync.per_adv_itvl == 0x0020);
+    TEST_ASSERT(event->periodic_sync.adv_clk_accuracy == 1);
+
+    /* The procedure has completed; there is nothing left to cancel. */
+    rc = ble_gap_periodic_adv_create_sync_cancel();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** Reports are delivered to the sync's callback. */
+    ble_ext_adv_test_util_num_events = 0;
+
+    memset(&rpt, 0, sizeof rpt);
+    rpt.subevent_code = BLE_HCI_LE_SUBEV_PER_ADV_RPT;
+    rpt.sync_handle = 0x0010;
+    rpt.tx_power = -4;
+    rpt.rssi = -60;
+    rpt.data_status = BLE_GAP_EXT_ADV_DATA_STATUS_COMPLETE;
+    rpt.data_len = sizeof data;
+    rpt.data = data;
+    ble_gap_rx_periodic_adv_rpt(&rpt);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_REPORT);
+    TEST_ASSERT(event->periodic_report.sync_handle == 0x0010);
+    TEST_ASSERT(event->periodic_report.tx_power == -4);
+    TEST_ASSERT(event->periodic_report.rssi == -60);
+    TEST_ASSERT(event->periodic_report.data_length == sizeof data);
+    TEST_ASSERT(memcmp(event->periodic_report.data, data, sizeof data) == 0);
+
+    /* Reports for an unknown sync are dropped. */
+    rpt.sync_handle = 0x0011;
+    ble_gap_rx_periodic_adv_rpt(&rpt);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 1);
+
+    /*** Terminate. */
+    ble_ext_adv_test_util_num_events = 0;
+
+    rc = ble_gap_periodic_adv_terminate_sync(0x0011);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    /* A rejected terminate leaves the sync in place. */
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_PER_ADV_TERM_SYNC,
+                                     BLE_ERR_CMD_DISALLOWED, NULL, 0);
+    rc = ble_gap_periodic_adv_terminate_sync(0x0010);
+    TEST_ASSERT(rc == BLE_HS_HCI_ERR(BLE_ERR_CMD_DISALLOWED));
+    ble_ext_adv_test_util_hci_out_first(BLE_HCI_OCF_LE_PER_ADV_TERM_SYNC,
+                                        NULL);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 0);
+
+    ble_ext_adv_test_util_ack_append(BLE_HCI_OCF_LE_PER_ADV_TERM_SYNC, 0,
+                                     NULL, 0);
+    rc = ble_gap_periodic_adv_terminate_sync(0x0010);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    cmd = ble_ext_adv_test_util_hci_out_first(
+        BLE_HCI_OCF_LE_PER_ADV_TERM_SYNC, &len);
+    TEST_ASSERT(len == BLE_HCI_LE_PER_ADV_TERM_SYNC_LEN);
+    TEST_ASSERT(get_le16(cmd) == 0x0010);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC_LOST);
+    TEST_ASSERT(event->periodic_sync_lost.sync_handle == 0x0010);
+    TEST_ASSERT(event->periodic_sync_lost.reason == BLE_HS_EDONE);
+
+    rc = ble_gap_periodic_adv_terminate_sync(0x0010);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    /* No further reports after termination. */
+    rpt.sync_handle = 0x0010;
+    ble_gap_rx_periodic_adv_rpt(&rpt);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 1);
+
+    TEST_ASSERT(ble_ext_adv_test_util_num_acks() == 0);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+}
+
+TEST_CASE(ble_gap_periodic_test_case_sync_lost)
+{
+    struct ble_gap_event *event;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+
+    ble_gap_periodic_test_util_establish(0x0020, 1);
+    ble_gap_periodic_test_util_establish(0x0021, 2);
+
+    /*** Sync pool exhausted. */
+    rc = ble_gap_periodic_adv_create_sync(&ble_gap_periodic_test_adv_addr, 3,
+                                          &ble_gap_periodic_test_sync_params,
+                                          ble_ext_adv_test_util_event_cb,
+                                          NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    /*** Unknown handle is ignored. */
+    ble_gap_periodic_test_util_rx_lost(0x0022);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 0);
+
+    /*** Lose the first sync; the second one remains. */
+    ble_gap_periodic_test_util_rx_lost(0x0020);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 1);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC_LOST);
+    TEST_ASSERT(event->periodic_sync_lost.sync_handle == 0x0020);
+    TEST_ASSERT(event->periodic_sync_lost.reason == BLE_HS_ETIMEOUT);
+
+    ble_gap_periodic_test_util_rx_lost(0x0020);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 1);
+
+    rc = ble_gap_periodic_adv_terminate_sync(0x0020);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    /* The freed entry can be reused. */
+    ble_ext_adv_test_util_num_events = 0;
+    ble_gap_periodic_test_util_establish(0x0022, 3);
+
+    ble_gap_periodic_test_util_rx_lost(0x0021);
+    ble_gap_periodic_test_util_rx_lost(0x0022);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 2);
+    TEST_ASSERT(ble_ext_adv_test_util_events[0].periodic_sync_lost.sync_handle ==
+                0x0021);
+    TEST_ASSERT(ble_ext_adv_test_util_events[1].periodic_sync_lost.sync_handle ==
+                0x0022);
+}
+
+TEST_CASE(ble_gap_periodic_test_case_reset)
+{
+    struct ble_gap_event *event;
+    int rc;
+
+    ble_ext_adv_test_util_init();
+
+    ble_gap_periodic_test_util_start_adv(0);
+    ble_gap_periodic_test_util_establish(0x0030, 1);
+    ble_gap_periodic_test_util_create_sync(2);
+
+    /*** Controller reset drops the pending procedure and the sync. */
+    ble_gap_reset_state(BLE_HS_ECONTROLLER);
+
+    TEST_ASSERT_FATAL(ble_ext_adv_test_util_num_events == 2);
+    event = ble_ext_adv_test_util_events + 0;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC);
+    TEST_ASSERT(event->periodic_sync.status == BLE_HS_ECONTROLLER);
+    event = ble_ext_adv_test_util_events + 1;
+    TEST_ASSERT(event->type == BLE_GAP_EVENT_PERIODIC_SYNC_LOST);
+    TEST_ASSERT(event->periodic_sync_lost.sync_handle == 0x0030);
+    TEST_ASSERT(event->periodic_sync_lost.reason == BLE_HS_ECONTROLLER);
+
+    rc = ble_gap_periodic_adv_create_sync_cancel();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+    rc = ble_gap_periodic_adv_terminate_sync(0x0030);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    /* The periodic configuration is gone along with the train. */
+    rc = ble_gap_periodic_adv_stop(0);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+    rc = ble_gap_periodic_adv_start(0);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** All sync entries were returned to the pool. */
+    ble_ext_adv_test_util_num_events = 0;
+    ble_gap_periodic_test_util_establish(0x0031, 1);
+    ble_gap_periodic_test_util_establish(0x0032, 2);
+
+    /*** A second reset with nothing pending reports only the syncs. */
+    ble_gap_reset_state(BLE_HS_ETIMEOUT_HCI);
+    TEST_ASSERT(ble_ext_adv_test_util_num_events == 2);
+    TEST_ASSERT(ble_ext_adv_test_util_events[0].type ==
+                BLE_GAP_EVENT_PERIODIC_SYNC_LOST);
+    TEST_ASSERT(ble_ext_adv_test_util_events[1].type ==
+                BLE_GAP_EVENT_PERIODIC_SYNC_LOST);
+
+    TEST_ASSERT(ble_ext_adv_test_util_num_acks() == 0);
+    TEST_ASSERT(ble_ext_adv_test_util_num_hci_out() == 0);
+}
+
+TEST_SUITE(ble_gap_periodic_test_suite_sync)
+{
+    ble_gap_periodic_test_case_sync_cancel();
+    ble_gap_periodic_test_case_sync_terminate();
+    ble_gap_periodic_test_case_sync_lost();
+    ble_gap_periodic_test_case_reset();
+}
+
+/*****************************************************************************
+ * $all                                                                      *
+ *****************************************************************************/
+
+int
+ble_gap_periodic_test_all(void)
+{
+    ble_gap_periodic_test_suite_adv();
+    ble_gap_periodic_test_suite_sync();
+
+    return tu_any_failed;
+}
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string.h>
+#include "sysinit/sysinit.h"
+#include "syscfg/syscfg.h"
+#include "testutil/testutil.h"
+#include "host/ble_hs.h"
+#include "host/ble_store.h"
+
+static void
+ble_hs_lock_stats_test_util_init(void)
+{
+    sysinit();
+    ble_hs_lock_stats_clear();
+}
+
+/**
+ * Retrieves the statistics of the specified call site.
+ *
+ * @return                      0 if the site was found; BLE_HS_ENOENT
+ *                                  otherwise.
+ */
+static int
+ble_hs_lock_stats_test_util_find(const char *site,
+                                 struct ble_hs_lock_stats *out_stats)
+{
+    int i;
+
+    for (i = 0; ble_hs_lock_stats_get(i, out_stats) == 0; i++) {
+        if (strcmp(out_stats->site, site) == 0) {
+            return 0;
+        }
+    }
+
+    return BLE_HS_ENOENT;
+}
+
+TEST_CASE(ble_hs_lock_stats_test_case_host)
+{
+    struct ble_hs_lock_stats stats;
+    int rc;
+
+    ble_hs_lock_stats_test_util_init();
+
+    /* Nothing recorded yet. */
+    TEST_ASSERT(ble_hs_lock_stats_get(0, &stats) == BLE_HS_ENOENT);
+
+    rc = ble_gap_conn_find(1, NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+    rc = ble_gap_conn_find(2, NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    rc = ble_hs_lock_stats_test_util_find("ble_gap_conn_find", &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.acquisitions == 2);
+    TEST_ASSERT(stats.contended == 0);
+    TEST_ASSERT(stats.wait_ticks == 0);
+    TEST_ASSERT(stats.max_wait_ticks == 0);
+
+    /* Out of range indices. */
+    TEST_ASSERT(ble_hs_lock_stats_get(-1, &stats) == BLE_HS_ENOENT);
+    TEST_ASSERT(ble_hs_lock_stats_get(MYNEWT_VAL(BLE_HS_LOCK_STATS_SITES),
+                                      &stats) == BLE_HS_ENOENT);
+
+    ble_hs_lock_stats_clear();
+    TEST_ASSERT(ble_hs_lock_stats_get(0, &stats) == BLE_HS_ENOENT);
+}
+
+TEST_CASE(ble_hs_lock_stats_test_case_store)
+{
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    struct ble_hs_lock_stats stats;
+    int rc;
+    int i;
+
+    ble_hs_lock_stats_test_util_init();
+
+    memset(&value_sec, 0, sizeof value_sec);
+    value_sec.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    value_sec.ltk_present = 1;
+
+    rc = ble_store_write_our_sec(&value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr = value_sec.peer_addr;
+    rc = ble_store_read_our_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Each store access is attributed to the function taking the lock, not
+     * to the lock wrapper.
+     */
+    for (i = 0; ble_hs_lock_stats_get(i, &stats) == 0; i++) {
+        TEST_ASSERT(strcmp(stats.site, "ble_store_lock_at") != 0);
+    }
+
+    rc = ble_hs_lock_stats_test_util_find("ble_store_write", &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.acquisitions == 1);
+    TEST_ASSERT(stats.contended == 0);
+    TEST_ASSERT(stats.wait_ticks == 0);
+
+    rc = ble_hs_lock_stats_test_util_find("ble_store_read", &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.acquisitions == 1);
+    TEST_ASSERT(stats.contended == 0);
+    TEST_ASSERT(stats.wait_ticks == 0);
+}
+
+TEST_SUITE(ble_hs_lock_stats_test_suite)
+{
+    ble_hs_lock_stats_test_case_host();
+    ble_hs_lock_stats_test_case_store();
+}
+
+#if MYNEWT_VAL(SELFTEST)
+
+int
+main(int argc, char **argv)
+{
+    sysinit();
+
+    ble_hs_lock_stats_test_suite();
+
+    return tu_any_failed;
+}
+
+#endif
@@ -1100,6 +1100,177 @@ TEST_CASE(ble_att_svr_test_write)
     ble_hs_test_util_verify_tx_write_rsp();
 }
 
+#if NIMBLE_BLE_SM
+/**
+ * Receives a Signed Write Command signed with ble_hs_test_util_csrk.  The
+ * first octet of the MAC is xored with mac_xor before it is sent.
+ */
+static int
+ble_att_svr_test_misc_rx_signed_write(uint16_t conn_handle,
+                                      uint16_t attr_handle,
+                                      const void *attr_val, uint16_t attr_len,
+                                      uint32_t sign_counter, uint8_t mac_xor)
+{
+    uint8_t buf[BLE_ATT_SIGNED_WRITE_CMD_BASE_SZ + 32 + BLE_ATT_SIGNATURE_SZ];
+    struct os_mbuf *om;
+    int len;
+    int rc;
+
+    TEST_ASSERT_FATAL(attr_len <= 32);
+
+    buf[0] = BLE_ATT_OP_SIGNED_WRITE_CMD;
+    put_le16(buf + 1, attr_handle);
+    memcpy(buf + BLE_ATT_SIGNED_WRITE_CMD_BASE_SZ, attr_val, attr_len);
+    len = BLE_ATT_SIGNED_WRITE_CMD_BASE_SZ + attr_len;
+    put_le32(buf + len, sign_counter);
+    len += 4;
+
+    om = ble_hs_mbuf_from_flat(buf, len);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = ble_sm_alg_sign(ble_hs_test_util_csrk, buf[0], om, 1, len - 1,
+                         buf + len);
+    os_mbuf_free_chain(om);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    buf[len] ^= mac_xor;
+    len += 8;
+
+    return ble_hs_test_util_l2cap_rx_payload_flat(conn_handle,
+                                                  BLE_L2CAP_CID_ATT,
+                                                  buf, len);
+}
+
+TEST_CASE(ble_att_svr_test_signed_write)
+{
+    struct hci_disconn_complete disconn_evt;
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    uint16_t conn_handle;
+    uint16_t attr_handle;
+    const ble_uuid_t *uuid_enc = BLE_UUID128_DECLARE( \
+        3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const ble_uuid_t *uuid_authen = BLE_UUID128_DECLARE( \
+        4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    int rc;
+    int i;
+
+    static const uint8_t attr_val[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+    conn_handle = ble_att_svr_test_misc_init(0);
+
+    rc = ble_att_svr_register(uuid_enc, BLE_ATT_F_WRITE | BLE_ATT_F_WRITE_ENC,
+                              0, &attr_handle,
+                              ble_att_svr_test_misc_attr_fn_w_1, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** No bond with the peer; dropped. */
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               0, 0);
+    TEST_ASSERT(rc == BLE_HS_EAUTHEN);
+    TEST_ASSERT(ble_att_svr_test_attr_w_1_len == 0);
+
+    /* Bond with the peer, which distributed its CSRK. */
+    memset(&value_sec, 0, sizeof value_sec);
+    value_sec.peer_addr.type = BLE_ADDR_PUBLIC;
+    memcpy(value_sec.peer_addr.val, ((uint8_t[]){2,3,4,5,6,7}), 6);
+    memcpy(value_sec.csrk, ble_hs_test_util_csrk, 16);
+    value_sec.csrk_present = 1;
+    rc = ble_store_write_peer_sec(&value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Signature satisfies the encryption requirement. */
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               0, 0);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_att_svr_test_attr_w_1_len == sizeof attr_val);
+    TEST_ASSERT(memcmp(ble_att_svr_test_attr_w_1, attr_val,
+                       sizeof attr_val) == 0);
+
+    /*** Replayed counter. */
+    ble_att_svr_test_attr_w_1_len = 0;
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               0, 0);
+    TEST_ASSERT(rc == BLE_HS_EREJECT);
+    TEST_ASSERT(ble_att_svr_test_attr_w_1_len == 0);
+
+    /*** Bad MAC. */
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               1, 0x01);
+    TEST_ASSERT(rc == BLE_HS_EAUTHEN);
+    TEST_ASSERT(ble_att_svr_test_attr_w_1_len == 0);
+
+    /*** Counter may skip ahead; older values are rejected afterwards. */
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               5, 0);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_att_svr_test_attr_w_1_len == sizeof attr_val);
+
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               3, 0);
+    TEST_ASSERT(rc == BLE_HS_EREJECT);
+
+    /* The bond isn't rewritten for every accepted counter. */
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr = value_sec.peer_addr;
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(value_sec.sign_counter == 0);
+
+    /*** Authentication required; the bond is unauthenticated. */
+    rc = ble_att_svr_register(uuid_authen,
+                              BLE_ATT_F_WRITE | BLE_ATT_F_WRITE_AUTHEN,
+                              0, &attr_handle,
+                              ble_att_svr_test_misc_attr_fn_w_1, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_att_svr_test_attr_w_1_len = 0;
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               6, 0);
+    TEST_ASSERT(rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN));
+    TEST_ASSERT(ble_att_svr_test_attr_w_1_len == 0);
+
+    /* Commands never elicit a response. */
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    /*** The bond is brought up to date once the counter has advanced by a
+     * block.
+     */
+    for (i = 7; i < MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE); i++) {
+        rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                                   attr_val, sizeof attr_val,
+                                                   i, 0);
+        TEST_ASSERT(rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN));
+    }
+
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(value_sec.sign_counter ==
+                MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE));
+
+    /*** The last accepted counter is persisted on disconnect. */
+    rc = ble_att_svr_test_misc_rx_signed_write(conn_handle, attr_handle,
+                                               attr_val, sizeof attr_val,
+                                               100, 0);
+    TEST_ASSERT(rc == BLE_HS_ATT_ERR(BLE_ATT_ERR_INSUFFICIENT_AUTHEN));
+
+    disconn_evt.connection_handle = conn_handle;
+    disconn_evt.status = 0;
+    disconn_evt.reason = BLE_ERR_REM_USER_CONN_TERM;
+    ble_hs_test_util_hci_rx_disconn_complete_event(&disconn_evt);
+
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(value_sec.sign_counter == 101);
+}
+#endif
+
 TEST_CASE(ble_att_svr_test_find_info)
 {
     uint16_t conn_handle;
@@ -2094,6 +2265,9 @@ TEST_SUITE(ble_att_svr_suite)
     ble_att_svr_test_read_blob();
     ble_att_svr_test_read_mult();
     ble_att_svr_test_write();
+#if NIMBLE_BLE_SM
+    ble_att_svr_test_signed_write();
+#endif
     ble_att_svr_test_find_info();
     ble_att_svr_test_find_type_value();
     ble_att_svr_test_read_type();
@@ -36,6 +36,9 @@ static struct ble_gap_upd_params ble_gap_test_conn_self_params;
 static int ble_gap_test_disc_event_type;
 static struct ble_gap_disc_desc ble_gap_test_disc_desc;
 static void *ble_gap_test_disc_arg;
+static int ble_gap_test_disc_batch_num;
+static struct ble_gap_disc_desc ble_gap_test_disc_batch_descs[4];
+static uint8_t ble_gap_test_disc_batch_data[4][BLE_HS_ADV_MAX_SZ];
 
 /*****************************************************************************
  * $misc                                                                     *
@@ -52,6 +55,7 @@ ble_gap_test_util_reset_cb_info(void)
     ble_gap_test_disc_event_type = -1;
     memset(&ble_gap_test_disc_desc, 0xff, sizeof ble_gap_test_disc_desc);
     ble_gap_test_disc_arg = (void *)-1;
+    ble_gap_test_disc_batch_num = -1;
 }
 
 static void
@@ -65,6 +69,8 @@ ble_gap_test_util_init(void)
 static int
 ble_gap_test_util_disc_cb(struct ble_gap_event *event, void *arg)
 {
+    int i;
+
     ble_gap_test_disc_event_type = event->type;
     ble_gap_test_disc_arg = arg;
 
@@ -72,6 +78,20 @@ ble_gap_test_util_disc_cb(struct ble_gap_event *event, void *arg)
         ble_gap_test_disc_desc = event->disc;
     }
 
+    if (event->type == BLE_GAP_EVENT_DISC_BATCH) {
+        TEST_ASSERT_FATAL(event->disc_batch.num_descs <=
+                          sizeof ble_gap_test_disc_batch_descs /
+                          sizeof ble_gap_test_disc_batch_descs[0]);
+
+        ble_gap_test_disc_batch_num = event->disc_batch.num_descs;
+        for (i = 0; i < event->disc_batch.num_descs; i++) {
+            ble_gap_test_disc_batch_descs[i] = event->disc_batch.descs[i];
+            memcpy(ble_gap_test_disc_batch_data[i],
+                   event->disc_batch.descs[i].data,
+                   event->disc_batch.descs[i].length_data);
+        }
+    }
+
     return 0;
 }
 
@@ -798,6 +818,157 @@ TEST_CASE(ble_gap_test_case_disc_busy)
     TEST_ASSERT(rc == BLE_HS_EBUSY);
 }
 
+TEST_CASE(ble_gap_test_case_disc_batch)
+{
+    static const struct ble_gap_disc_params disc_params = { 0 };
+    struct ble_gap_disc_desc desc;
+    uint8_t adv_data[3] = { 0x02, BLE_HS_ADV_TYPE_FLAGS, 0 };
+    uint32_t window_ticks;
+    int32_t ticks;
+    int rc;
+    int i;
+
+    ble_gap_test_util_init();
+
+    memset(&desc, 0, sizeof desc);
+    desc.event_type = BLE_HCI_ADV_TYPE_ADV_IND;
+    desc.addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    desc.data = adv_data;
+    desc.length_data = sizeof adv_data;
+
+    /*** Batch too large. */
+    rc = ble_gap_disc_batch_set(5, 0);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Batches are delivered when full. */
+    rc = ble_gap_disc_batch_set(3, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_cb, NULL,
+                               -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_disc_batch_set(2, 0);
+    TEST_ASSERT(rc == BLE_HS_EBUSY);
+
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(ble_gap_test_disc_event_type == -1);
+
+        /* Reports must be copied out of the transient HCI buffer. */
+        adv_data[2] = i;
+        ble_gap_rx_adv_report(&desc);
+    }
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC_BATCH);
+    TEST_ASSERT_FATAL(ble_gap_test_disc_batch_num == 3);
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT(ble_gap_test_disc_batch_descs[i].length_data == 3);
+        TEST_ASSERT(ble_gap_test_disc_batch_data[i][2] == i);
+        TEST_ASSERT(ble_addr_cmp(&ble_gap_test_disc_batch_descs[i].addr,
+                                 &desc.addr) == 0);
+    }
+
+    /*** Cancelling discovery discards pending reports. */
+    ble_gap_test_util_reset_cb_info();
+    ble_gap_rx_adv_report(&desc);
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_gap_test_disc_event_type == -1);
+
+    /*** Partial batches are delivered when the window elapses. */
+    rc = ble_gap_disc_batch_set(4, 50);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_cb, NULL,
+                               -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+
+    ble_gap_rx_adv_report(&desc);
+    ble_gap_rx_adv_report(&desc);
+    rc = os_time_ms_to_ticks(50, &window_ticks);
+    TEST_ASSERT_FATAL(rc == 0);
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == window_ticks);
+    TEST_ASSERT(ble_gap_test_disc_event_type == -1);
+
+    os_time_advance(ticks);
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC_BATCH);
+    TEST_ASSERT(ble_gap_test_disc_batch_num == 2);
+
+    /*** Disabling batching restores per-report events. */
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gap_disc_batch_set(0, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_cb, NULL,
+                               -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gap_rx_adv_report(&desc);
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC);
+}
+
+TEST_CASE(ble_gap_test_case_disc_dedup)
+{
+    static const struct ble_gap_disc_params disc_params = { 0 };
+    struct ble_gap_disc_desc desc;
+    struct ble_hs_adv_filt filt;
+    uint8_t adv_data[3] = { 0x02, BLE_HS_ADV_TYPE_FLAGS, 0 };
+    int rc;
+
+    ble_gap_test_util_init();
+
+    memset(&desc, 0, sizeof desc);
+    desc.event_type = BLE_HCI_ADV_TYPE_ADV_IND;
+    desc.addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    desc.data = adv_data;
+    desc.length_data = sizeof adv_data;
+    desc.rssi = -70;
+
+    rc = ble_hs_adv_dedup_set(1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_cb, NULL,
+                               -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Duplicates are withheld from the application. */
+    ble_gap_rx_adv_report(&desc);
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC);
+
+    ble_gap_test_util_reset_cb_info();
+    ble_gap_rx_adv_report(&desc);
+    TEST_ASSERT(ble_gap_test_disc_event_type == -1);
+
+    /*** A report rejected by the host filters doesn't count as delivered. */
+    memset(&filt, 0, sizeof filt);
+    filt.criteria = BLE_HS_ADV_FILT_F_RSSI;
+    filt.rssi_min = -60;
+    rc = ble_hs_adv_filt_set(&filt, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    adv_data[2] = 1;
+    ble_gap_rx_adv_report(&desc);
+    TEST_ASSERT(ble_gap_test_disc_event_type == -1);
+
+    desc.rssi = -50;
+    ble_gap_rx_adv_report(&desc);
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC);
+
+    rc = ble_hs_adv_filt_set(NULL, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_hs_adv_dedup_set(0, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
 TEST_SUITE(ble_gap_test_suite_disc)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -809,6 +980,8 @@ TEST_SUITE(ble_gap_test_suite_disc)
     ble_gap_test_case_disc_dflts();
     ble_gap_test_case_disc_already();
     ble_gap_test_case_disc_busy();
+    ble_gap_test_case_disc_batch();
+    ble_gap_test_case_disc_dedup();
 }
 
 /*****************************************************************************
@@ -1017,6 +1190,190 @@ TEST_CASE(ble_gap_test_case_conn_gen_fail_evt)
                 BLE_HS_HCI_ERR(BLE_ERR_CONN_ACCEPT_TMO));
 }
 
+static int ble_gap_test_reconn_num_connects;
+
+static int
+ble_gap_test_util_reconn_cb(struct ble_gap_event *event, void *arg)
+{
+    if (event->type == BLE_GAP_EVENT_CONNECT) {
+        ble_gap_test_reconn_num_connects++;
+        ble_gap_test_conn_status = event->connect.status;
+    } else {
+        ble_gap_test_event = *event;
+    }
+
+    return 0;
+}
+
+static void
+ble_gap_test_util_reconn_arm_acks(int num_addrs)
+{
+    struct ble_hs_test_util_hci_ack acks[8];
+    int i;
+
+    TEST_ASSERT_FATAL(num_addrs + 3 <= sizeof acks / sizeof acks[0]);
+
+    acks[0] = (struct ble_hs_test_util_hci_ack) {
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CLEAR_WHITE_LIST),
+    };
+    for (i = 0; i < num_addrs; i++) {
+        acks[1 + i] = (struct ble_hs_test_util_hci_ack) {
+            BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_ADD_WHITE_LIST),
+        };
+    }
+    acks[1 + i] = (struct ble_hs_test_util_hci_ack) {
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CREATE_CONN),
+    };
+    memset(acks + 2 + i, 0, sizeof acks[0]);
+
+    ble_hs_test_util_hci_ack_set_seq(acks);
+}
+
+static void
+ble_gap_test_util_reconn_verify_arm(ble_addr_t *addrs, int num_addrs)
+{
+    uint8_t param_len;
+    uint8_t *param;
+    int i;
+
+    ble_gap_test_util_verify_tx_clear_wl();
+    for (i = 0; i < num_addrs; i++) {
+        ble_gap_test_util_verify_tx_add_wl(addrs + i);
+    }
+
+    param = ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                           BLE_HCI_OCF_LE_CREATE_CONN,
+                                           &param_len);
+    TEST_ASSERT(param_len == BLE_HCI_CREATE_CONN_LEN);
+    TEST_ASSERT(param[4] == BLE_HCI_CONN_FILT_USE_WL);
+
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+}
+
+static void
+ble_gap_test_util_reconn_rx_conn(uint16_t handle, const ble_addr_t *addr)
+{
+    struct hci_le_conn_complete evt;
+    int rc;
+
+    ble_hs_test_util_hci_ack_set(ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
+                             BLE_HCI_OCF_LE_RD_REM_FEAT), 0);
+
+    memset(&evt, 0, sizeof evt);
+    evt.subevent_code = BLE_HCI_LE_SUBEV_CONN_COMPLETE;
+    evt.status = BLE_ERR_SUCCESS;
+    evt.connection_handle = handle;
+    evt.role = BLE_HCI_LE_CONN_COMPLETE_ROLE_MASTER;
+    evt.peer_addr_type = addr->type;
+    memcpy(evt.peer_addr, addr->val, 6);
+    rc = ble_gap_rx_conn_complete(&evt, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_hci_out_clear();
+}
+
+TEST_CASE(ble_gap_test_case_conn_reconnect)
+{
+    struct hci_le_conn_complete evt;
+    ble_addr_t addrs[] = {
+        { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } },
+        { BLE_ADDR_RANDOM, { 2, 3, 4, 5, 6, 0xc0 } },
+        { BLE_ADDR_PUBLIC, { 3, 4, 5, 6, 7, 8 } },
+        { BLE_ADDR_PUBLIC, { 4, 5, 6, 7, 8, 9 } },
+        { BLE_ADDR_PUBLIC, { 5, 6, 7, 8, 9, 10 } },
+    };
+    int32_t ticks;
+    int rc;
+
+    ble_gap_test_util_init();
+    ble_gap_test_reconn_num_connects = 0;
+
+    /*** Invalid peer lists. */
+    rc = ble_gap_reconnect_start(BLE_OWN_ADDR_PUBLIC, addrs, 0, NULL,
+                                 ble_gap_test_util_reconn_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_gap_reconnect_start(BLE_OWN_ADDR_PUBLIC, addrs, 5, NULL,
+                                 ble_gap_test_util_reconn_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_gap_reconnect_stop();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** Both peers go in the white list. */
+    ble_gap_test_util_reconn_arm_acks(2);
+    rc = ble_gap_reconnect_start(BLE_OWN_ADDR_PUBLIC, addrs, 2, NULL,
+                                 ble_gap_test_util_reconn_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gap_test_util_reconn_verify_arm(addrs, 2);
+    TEST_ASSERT(ble_gap_master_in_progress());
+
+    rc = ble_gap_reconnect_start(BLE_OWN_ADDR_PUBLIC, addrs, 2, NULL,
+                                 ble_gap_test_util_reconn_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** The second peer advertises first. */
+    ble_gap_test_util_reconn_rx_conn(2, addrs + 1);
+    TEST_ASSERT(ble_gap_test_reconn_num_connects == 1);
+    TEST_ASSERT(ble_gap_test_conn_status == 0);
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_RECONNECT);
+    TEST_ASSERT(ble_gap_test_event.reconnect.status == 0);
+    TEST_ASSERT(ble_gap_test_event.reconnect.num_connected == 1);
+    TEST_ASSERT(ble_gap_test_event.reconnect.num_targets == 2);
+
+    /* The connection now reports to the application callback. */
+    ble_gap_test_util_reset_cb_info();
+    ble_gap_mtu_event(2, BLE_L2CAP_CID_ATT, 100);
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_MTU);
+
+    /*** The initiator is re-armed with the remaining peer. */
+    ble_gap_test_util_reconn_arm_acks(1);
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+    ble_gap_test_util_reconn_verify_arm(addrs, 1);
+
+    ble_gap_test_util_reconn_rx_conn(3, addrs + 0);
+    TEST_ASSERT(ble_gap_test_reconn_num_connects == 2);
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_RECONNECT);
+    TEST_ASSERT(ble_gap_test_event.reconnect.num_connected == 2);
+    TEST_ASSERT(ble_gap_test_event.reconnect.num_targets == 2);
+
+    /*** All peers connected; the procedure is over. */
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+    TEST_ASSERT(!ble_gap_master_in_progress());
+    rc = ble_gap_reconnect_stop();
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /*** Connected peers are skipped when the procedure starts. */
+    ble_gap_test_util_reconn_arm_acks(1);
+    rc = ble_gap_reconnect_start(BLE_OWN_ADDR_PUBLIC, addrs + 1, 2, NULL,
+                                 ble_gap_test_util_reconn_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gap_test_util_reconn_verify_arm(addrs + 2, 1);
+
+    /*** Stopping cancels the initiator without further events. */
+    ble_gap_test_util_reset_cb_info();
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CREATE_CONN_CANCEL), 0);
+    rc = ble_gap_reconnect_stop();
+    TEST_ASSERT(rc == 0);
+    ble_hs_test_util_hci_verify_tx_create_conn_cancel();
+
+    memset(&evt, 0, sizeof evt);
+    evt.subevent_code = BLE_HCI_LE_SUBEV_CONN_COMPLETE;
+    evt.status = BLE_ERR_UNK_CONN_ID;
+    rc = ble_gap_rx_conn_complete(&evt, 0);
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(!ble_gap_master_in_progress());
+
+    TEST_ASSERT(ble_gap_test_reconn_num_connects == 2);
+    TEST_ASSERT(ble_gap_test_event.type == 0xff);
+
+    ticks = ble_gap_timer();
+    TEST_ASSERT(ticks == BLE_HS_FOREVER);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+}
+
 TEST_SUITE(ble_gap_test_suite_conn_gen)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -1028,6 +1385,7 @@ TEST_SUITE(ble_gap_test_suite_conn_gen)
     ble_gap_test_case_conn_gen_done();
     ble_gap_test_case_conn_gen_busy();
     ble_gap_test_case_conn_gen_fail_evt();
+    ble_gap_test_case_conn_reconnect();
 }
 
 /*****************************************************************************
@@ -1710,6 +2068,54 @@ TEST_CASE(ble_gap_test_case_adv_hci_fail)
     }
 }
 
+TEST_CASE(ble_gap_test_case_adv_update_data)
+{
+    uint8_t data[BLE_HS_ADV_MAX_SZ + 1];
+    uint8_t param_len;
+    uint8_t *param;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    memset(data, 0xa5, sizeof data);
+
+    /*** Invalid instance and oversized data. */
+    rc = ble_gap_adv_update_data(1, data, 3);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_gap_adv_update_data(0, data, sizeof data);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    rc = ble_hs_test_util_adv_start(BLE_OWN_ADDR_PUBLIC, NULL,
+                                    &ble_hs_test_util_adv_params,
+                                    BLE_HS_FOREVER,
+                                    ble_gap_test_util_connect_cb, NULL, 0, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_hs_test_util_hci_out_clear();
+
+    /*** Data is replaced with a single command while advertising. */
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_DATA), 0);
+    rc = ble_gap_adv_update_data(0, data, 5);
+    TEST_ASSERT(rc == 0);
+
+    param = ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                           BLE_HCI_OCF_LE_SET_ADV_DATA,
+                                           &param_len);
+    TEST_ASSERT(param_len == BLE_HCI_SET_ADV_DATA_LEN);
+    TEST_ASSERT(param[0] == 5);
+    TEST_ASSERT(memcmp(param + 1, data, 5) == 0);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+    TEST_ASSERT(ble_gap_adv_active());
+
+    /*** Controller failure is reported. */
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_DATA),
+        BLE_ERR_UNSPECIFIED);
+    rc = ble_gap_adv_update_data(0, data, BLE_HS_ADV_MAX_SZ);
+    TEST_ASSERT(rc == BLE_HS_HCI_ERR(BLE_ERR_UNSPECIFIED));
+    TEST_ASSERT(ble_gap_adv_active());
+}
+
 TEST_SUITE(ble_gap_test_suite_adv)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -1719,6 +2125,7 @@ TEST_SUITE(ble_gap_test_suite_adv)
     ble_gap_test_case_adv_good();
     ble_gap_test_case_adv_ctlr_fail();
     ble_gap_test_case_adv_hci_fail();
+    ble_gap_test_case_adv_update_data();
 }
 
 /*****************************************************************************
@@ -2678,6 +3085,123 @@ TEST_CASE(ble_gap_test_case_update_concurrent_hci_fail)
         1, BLE_ERR_UNSUPPORTED);
 }
 
+TEST_CASE(ble_gap_test_case_update_plan)
+{
+    struct hci_le_conn_upd_complete evt;
+    struct ble_gap_plan_link_stats stats;
+    struct ble_gap_upd_params params;
+    struct ble_gap_upd_params peer;
+    int cmd_idx;
+    int rc;
+
+    ble_gap_test_util_init();
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[6]){ 1, 2, 3, 4, 5, 6 }),
+                                 ble_gap_test_util_connect_cb, NULL);
+    ble_hs_test_util_create_conn(3, ((uint8_t[6]){ 2, 3, 4, 5, 6, 7 }),
+                                 ble_gap_test_util_connect_cb, NULL);
+    ble_hs_test_util_create_conn(4, ((uint8_t[6]){ 3, 4, 5, 6, 7, 8 }),
+                                 ble_gap_test_util_connect_cb, NULL);
+
+    /*** Invalid configuration. */
+    rc = ble_gap_plan_configure(8, 17);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_gap_plan_configure(5, 2);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /* Each link at the base interval takes half the air time. */
+    rc = ble_gap_plan_configure(8, 8);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_plan_link(2, 7, 0, 400);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_gap_plan_link(5, 30, 0, 400);
+    TEST_ASSERT(rc == BLE_HS_ENOTCONN);
+
+    /*** The longest power-of-two multiple of the base interval is used. */
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE), 0);
+    rc = ble_gap_plan_link(2, 30, 0, 400);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    params = (struct ble_gap_upd_params) { 16, 16, 0, 400, 8, 8 };
+    ble_gap_test_util_verify_tx_update_conn(&params);
+
+    rc = ble_gap_plan_link(2, 30, 0, 400);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+    rc = ble_gap_plan_configure(8, 2);
+    TEST_ASSERT(rc == BLE_HS_EBUSY);
+
+    ble_gap_test_util_rx_update_complete(0, &params);
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_CONN_UPDATE);
+    TEST_ASSERT(ble_gap_test_conn_status == 0);
+
+    rc = ble_gap_plan_link_stats(2, &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.planned_itvl == 16);
+    TEST_ASSERT(stats.conn_itvl == 16);
+    TEST_ASSERT(stats.num_updates == 1);
+    TEST_ASSERT(stats.num_on_plan == 1);
+
+    /*** Peer requests are answered with the planned interval. */
+    peer = (struct ble_gap_upd_params) { 6, 10, 0, 400, 0, 0 };
+    ble_gap_test_conn_self_params = peer;
+    cmd_idx = 0;
+    ble_gap_test_util_rx_param_req(&peer, 1, &cmd_idx, -1, 0);
+
+    ble_gap_test_conn_self_params = params;
+    ble_gap_test_util_verify_tx_params_reply_pos();
+
+    /*** Updates that miss the plan are counted. */
+    ble_gap_test_util_rx_update_complete(0, &peer);
+    rc = ble_gap_plan_link_stats(2, &stats);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(stats.conn_itvl == 10);
+    TEST_ASSERT(stats.num_updates == 2);
+    TEST_ASSERT(stats.num_on_plan == 1);
+
+    /*** Links that don't fit in the remaining air time are refused. */
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE), 0);
+    rc = ble_gap_plan_link(3, 8, 0, 400);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_hs_test_util_hci_out_clear();
+
+    rc = ble_gap_plan_link(4, 8, 0, 400);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE), 0);
+    rc = ble_gap_plan_link(4, 20, 0, 400);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_hs_test_util_hci_out_clear();
+
+    memset(&evt, 0, sizeof evt);
+    evt.subevent_code = BLE_HCI_LE_SUBEV_CONN_UPD_COMPLETE;
+    evt.connection_handle = 4;
+    evt.conn_itvl = 16;
+    evt.supervision_timeout = 400;
+    ble_gap_rx_update_complete(&evt);
+
+    /*** Removing a link releases its air time. */
+    rc = ble_gap_plan_unlink(4);
+    TEST_ASSERT(rc == 0);
+    rc = ble_gap_plan_unlink(4);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+    rc = ble_gap_plan_link_stats(4, &stats);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /*** So does a disconnect. */
+    ble_hs_test_util_conn_disconnect(3);
+    rc = ble_gap_plan_link_stats(3, &stats);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_CONN_UPDATE), 0);
+    rc = ble_gap_plan_link(4, 8, 0, 400);
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_SUITE(ble_gap_test_suite_update_conn)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -2693,6 +3217,7 @@ TEST_SUITE(ble_gap_test_suite_update_conn)
     ble_gap_test_case_update_concurrent_good();
     ble_gap_test_case_update_concurrent_hci_fail();
     ble_gap_test_case_update_conn_verify_params();
+    ble_gap_test_case_update_plan();
 }
 
 /*****************************************************************************
@@ -3093,12 +3618,246 @@ TEST_CASE(ble_gap_test_case_set_cb_bad)
     TEST_ASSERT(rc == BLE_HS_ENOTCONN);
 }
 
+static int ble_gap_test_listener_num_events;
+
+static int
+ble_gap_test_util_listener_cb(struct ble_gap_event *event, void *arg)
+{
+    ble_gap_test_listener_num_events++;
+    return ble_gap_test_util_set_cb_event(event, arg);
+}
+
+TEST_CASE(ble_gap_test_case_set_cb_listener)
+{
+    const uint8_t peer_addr[6] = { 1,2,3,4,5,6 };
+    struct hci_disconn_complete disconn_evt;
+    struct ble_gap_event_listener listener;
+    struct ble_gap_event event;
+    int rc;
+
+    ble_gap_test_util_init();
+    ble_gap_test_listener_num_events = 0;
+
+    rc = ble_gap_event_listener_register(&listener,
+                                         BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_MTU),
+                                         ble_gap_test_util_listener_cb,
+                                         &event);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_gap_event_listener_register(&listener,
+                                         BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_MTU),
+                                         ble_gap_test_util_listener_cb,
+                                         &event);
+    TEST_ASSERT(rc == BLE_HS_EALREADY);
+
+    /* Connect event is not in the mask. */
+    ble_hs_test_util_create_conn(2, peer_addr, ble_gap_test_util_connect_cb,
+                                 NULL);
+    TEST_ASSERT(ble_gap_test_listener_num_events == 0);
+
+    /* MTU event is delivered to both the connection callback and the
+     * listener.
+     */
+    rc = ble_hs_test_util_rx_att_mtu_cmd(2, 1, 123);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_gap_test_listener_num_events == 1);
+    TEST_ASSERT(event.type == BLE_GAP_EVENT_MTU);
+    TEST_ASSERT(event.mtu.conn_handle == 2);
+    TEST_ASSERT(event.mtu.value == 123);
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_MTU);
+
+    /* Unregistered listener no longer receives events. */
+    rc = ble_gap_event_listener_unregister(&listener);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gap_event_listener_unregister(&listener);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    rc = ble_gap_event_listener_register(&listener,
+                                         BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_MTU),
+                                         ble_gap_test_util_listener_cb,
+                                         &event);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gap_event_listener_unregister(&listener);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_test_util_conn_terminate(2, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    disconn_evt.connection_handle = 2;
+    disconn_evt.status = 0;
+    disconn_evt.reason = BLE_ERR_REM_USER_CONN_TERM;
+    ble_hs_test_util_hci_rx_disconn_complete_event(&disconn_evt);
+
+    TEST_ASSERT(ble_gap_test_event.type == BLE_GAP_EVENT_DISCONNECT);
+    TEST_ASSERT(ble_gap_test_listener_num_events == 1);
+}
+
+static struct ble_gap_event_listener ble_gap_test_listeners[2];
+static struct ble_gap_event ble_gap_test_listener_event;
+
+static int
+ble_gap_test_util_listener_unreg_cb(struct ble_gap_event *event, void *arg)
+{
+    int rc;
+
+    ble_gap_test_listener_num_events++;
+
+    /* Unregistering from within a callback must be safe. */
+    rc = ble_gap_event_listener_unregister(arg);
+    TEST_ASSERT(rc == 0);
+
+    return 0;
+}
+
+TEST_CASE(ble_gap_test_case_set_cb_listener_procs)
+{
+    struct ble_gap_disc_params disc_params;
+    struct ble_gap_disc_desc desc;
+    uint8_t adv_data[] = { 0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06 };
+    int rc;
+
+    ble_gap_test_util_init();
+    ble_gap_test_listener_num_events = 0;
+
+    rc = ble_gap_event_listener_register(
+        ble_gap_test_listeners,
+        BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_DISC) |
+        BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_CONNECT) |
+        BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_ADV_COMPLETE),
+        ble_gap_test_util_listener_cb, &ble_gap_test_listener_event);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Discovery reports reach both the application and the listener. */
+    memset(&disc_params, 0, sizeof disc_params);
+    rc = ble_hs_test_util_disc(BLE_OWN_ADDR_PUBLIC, BLE_HS_FOREVER,
+                               &disc_params, ble_gap_test_util_disc_cb, NULL,
+                               -1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    memset(&desc, 0, sizeof desc);
+    desc.event_type = BLE_HCI_ADV_RPT_EVTYPE_ADV_IND;
+    desc.addr.type = BLE_ADDR_PUBLIC;
+    memcpy(desc.addr.val, ((uint8_t[6]){ 1, 2, 3, 4, 5, 6 }), 6);
+    desc.rssi = -40;
+    desc.data = adv_data;
+    desc.length_data = sizeof adv_data;
+    ble_gap_rx_adv_report(&desc);
+
+    TEST_ASSERT(ble_gap_test_disc_event_type == BLE_GAP_EVENT_DISC);
+    TEST_ASSERT(ble_gap_test_listener_num_events == 1);
+    TEST_ASSERT(ble_gap_test_listener_event.type == BLE_GAP_EVENT_DISC);
+    TEST_ASSERT(ble_gap_test_listener_event.disc.length_data ==
+                sizeof adv_data);
+
+    rc = ble_hs_test_util_disc_cancel(0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Connect cancel. */
+    rc = ble_hs_test_util_connect(
+        BLE_OWN_ADDR_PUBLIC,
+        &((ble_addr_t) { BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 }}),
+        0, NULL, ble_gap_test_util_connect_cb, NULL, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_gap_test_util_conn_cancel(0);
+
+    TEST_ASSERT(ble_gap_test_listener_num_events == 2);
+    TEST_ASSERT(ble_gap_test_listener_event.type == BLE_GAP_EVENT_CONNECT);
+    TEST_ASSERT(ble_gap_test_listener_event.connect.status == BLE_HS_EAPP);
+
+    /*** Connect timeout. */
+    ble_gap_test_util_reset_cb_info();
+    ble_gap_test_util_conn_timeout(30);
+
+    TEST_ASSERT(ble_gap_test_listener_num_events == 3);
+    TEST_ASSERT(ble_gap_test_listener_event.type == BLE_GAP_EVENT_CONNECT);
+    TEST_ASSERT(ble_gap_test_listener_event.connect.status ==
+                BLE_HS_ETIMEOUT);
+
+    /*** Advertising timeout; listeners are told even without an app cb. */
+    rc = ble_hs_test_util_adv_start(BLE_OWN_ADDR_PUBLIC, NULL,
+                                    &ble_hs_test_util_adv_params, 30,
+                                    NULL, NULL, 0, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    os_time_advance(30);
+    ble_hs_test_util_hci_ack_set(
+        BLE_HS_TEST_UTIL_LE_OPCODE(BLE_HCI_OCF_LE_SET_ADV_ENABLE), 0);
+    ble_gap_timer();
+
+    TEST_ASSERT(!ble_gap_adv_active());
+    TEST_ASSERT(ble_gap_test_listener_num_events == 4);
+    TEST_ASSERT(ble_gap_test_listener_event.type ==
+                BLE_GAP_EVENT_ADV_COMPLETE);
+    TEST_ASSERT(ble_gap_test_listener_event.adv_complete.reason ==
+                BLE_HS_ETIMEOUT);
+}
+
+TEST_CASE(ble_gap_test_case_set_cb_listener_unreg)
+{
+    struct ble_gap_event_listener extra[MYNEWT_VAL(BLE_GAP_EVENT_LISTENER_MAX)];
+    const uint8_t peer_addr[6] = { 1,2,3,4,5,6 };
+    uint32_t mask;
+    int rc;
+    int i;
+
+    ble_gap_test_util_init();
+    ble_gap_test_listener_num_events = 0;
+
+    mask = BLE_GAP_EVENT_MASK(BLE_GAP_EVENT_MTU);
+
+    /* Listeners are called most recently registered first; the first one
+     * called removes itself, which must not prevent the other from being
+     * called.
+     */
+    rc = ble_gap_event_listener_register(ble_gap_test_listeners + 0, mask,
+                                         ble_gap_test_util_listener_cb,
+                                         &ble_gap_test_listener_event);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gap_event_listener_register(ble_gap_test_listeners + 1, mask,
+                                         ble_gap_test_util_listener_unreg_cb,
+                                         ble_gap_test_listeners + 1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_create_conn(2, peer_addr, ble_gap_test_util_connect_cb,
+                                 NULL);
+
+    rc = ble_hs_test_util_rx_att_mtu_cmd(2, 1, 123);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_gap_test_listener_num_events == 2);
+    TEST_ASSERT(ble_gap_test_listener_event.type == BLE_GAP_EVENT_MTU);
+
+    rc = ble_gap_event_listener_unregister(ble_gap_test_listeners + 1);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /*** Registrations are bounded by BLE_GAP_EVENT_LISTENER_MAX. */
+    for (i = 1; i < MYNEWT_VAL(BLE_GAP_EVENT_LISTENER_MAX); i++) {
+        rc = ble_gap_event_listener_register(extra + i, mask,
+                                             ble_gap_test_util_listener_cb,
+                                             &ble_gap_test_listener_event);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    rc = ble_gap_event_listener_register(extra, mask,
+                                         ble_gap_test_util_listener_cb,
+                                         &ble_gap_test_listener_event);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    rc = ble_gap_event_listener_unregister(ble_gap_test_listeners + 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_gap_event_listener_register(extra, mask,
+                                         ble_gap_test_util_listener_cb,
+                                         &ble_gap_test_listener_event);
+    TEST_ASSERT(rc == 0);
+}
+
 TEST_SUITE(ble_gap_test_suite_set_cb)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_gap_test_case_set_cb_good();
     ble_gap_test_case_set_cb_bad();
+    ble_gap_test_case_set_cb_listener();
+    ble_gap_test_case_set_cb_listener_procs();
+    ble_gap_test_case_set_cb_listener_unreg();
 }
 
 /*****************************************************************************
@@ -386,6 +386,104 @@ TEST_CASE(ble_gatt_write_test_no_rsp)
     TEST_ASSERT(!ble_gatt_write_test_cb_called);
 }
 
+#if NIMBLE_BLE_SM && MYNEWT_VAL(BLE_GATT_SIGNED_WRITE)
+static void
+ble_gatt_write_test_verify_tx_signed(uint16_t attr_handle,
+                                     const uint8_t *attr_val, int attr_len,
+                                     uint32_t sign_counter)
+{
+    struct os_mbuf *om;
+    uint8_t mac[8];
+    int len;
+    int rc;
+
+    om = ble_hs_test_util_prev_tx_dequeue_pullup();
+    TEST_ASSERT_FATAL(om != NULL);
+
+    len = BLE_ATT_SIGNED_WRITE_CMD_BASE_SZ + attr_len;
+    TEST_ASSERT_FATAL(OS_MBUF_PKTLEN(om) == len + BLE_ATT_SIGNATURE_SZ);
+    TEST_ASSERT(om->om_data[0] == BLE_ATT_OP_SIGNED_WRITE_CMD);
+    TEST_ASSERT(get_le16(om->om_data + 1) == attr_handle);
+    TEST_ASSERT(memcmp(om->om_data + BLE_ATT_SIGNED_WRITE_CMD_BASE_SZ,
+                       attr_val, attr_len) == 0);
+    TEST_ASSERT(get_le32(om->om_data + len) == sign_counter);
+
+    rc = ble_sm_alg_sign(ble_hs_test_util_csrk, om->om_data[0], om, 1,
+                         len + 4 - 1, mac);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(om->om_data + len + 4, mac, sizeof mac) == 0);
+}
+
+TEST_CASE(ble_gatt_write_test_signed)
+{
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    struct ble_hs_conn *conn;
+    struct os_mbuf *om;
+    int attr_len;
+    int rc;
+
+    ble_gatt_write_test_init();
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[]){2,3,4,5,6,7,8,9}),
+                                 NULL, NULL);
+
+    attr_len = 4;
+
+    /*** No CSRK distributed to the peer. */
+    om = ble_hs_mbuf_from_flat(ble_gatt_write_test_attr_value, attr_len);
+    rc = ble_gattc_signed_write(2, 100, om);
+    TEST_ASSERT(rc == BLE_HS_EAUTHEN);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_dequeue() == NULL);
+
+    memset(&value_sec, 0, sizeof value_sec);
+    value_sec.peer_addr.type = BLE_ADDR_PUBLIC;
+    memcpy(value_sec.peer_addr.val, ((uint8_t[]){2,3,4,5,6,7}), 6);
+    memcpy(value_sec.csrk, ble_hs_test_util_csrk, 16);
+    value_sec.csrk_present = 1;
+    rc = ble_store_write_our_sec(&value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** First write reserves a block of counters in the bond. */
+    om = ble_hs_mbuf_from_flat(ble_gatt_write_test_attr_value, attr_len);
+    rc = ble_gattc_signed_write(2, 100, om);
+    TEST_ASSERT(rc == 0);
+    ble_gatt_write_test_verify_tx_signed(100, ble_gatt_write_test_attr_value,
+                                         attr_len, 0);
+
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr = value_sec.peer_addr;
+    rc = ble_store_read_our_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(value_sec.sign_counter ==
+                MYNEWT_VAL(BLE_SM_SIGN_COUNTER_RESERVE));
+
+    /*** Subsequent writes draw from the reserved block. */
+    om = ble_hs_mbuf_from_flat(ble_gatt_write_test_attr_value, attr_len);
+    rc = ble_gattc_signed_write(2, 100, om);
+    TEST_ASSERT(rc == 0);
+    ble_gatt_write_test_verify_tx_signed(100, ble_gatt_write_test_attr_value,
+                                         attr_len, 1);
+
+    /*** Encrypted link; a plain Write Command is sent instead. */
+    ble_hs_lock();
+    conn = ble_hs_conn_find(2);
+    conn->bhc_sec_state.encrypted = 1;
+    ble_hs_unlock();
+
+    om = ble_hs_mbuf_from_flat(ble_gatt_write_test_attr_value, attr_len);
+    rc = ble_gattc_signed_write(2, 100, om);
+    TEST_ASSERT(rc == 0);
+
+    om = ble_hs_test_util_prev_tx_dequeue_pullup();
+    TEST_ASSERT_FATAL(om != NULL);
+    TEST_ASSERT(om->om_data[0] == BLE_ATT_OP_WRITE_CMD);
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == BLE_ATT_WRITE_CMD_BASE_SZ + attr_len);
+
+    TEST_ASSERT(!ble_gatt_write_test_cb_called);
+}
+#endif
+
 TEST_CASE(ble_gatt_write_test_rsp)
 {
     int attr_len;
@@ -799,6 +897,9 @@ TEST_SUITE(ble_gatt_write_test_suite)
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_gatt_write_test_no_rsp();
+#if NIMBLE_BLE_SM && MYNEWT_VAL(BLE_GATT_SIGNED_WRITE)
+    ble_gatt_write_test_signed();
+#endif
     ble_gatt_write_test_rsp();
     ble_gatt_write_test_long_good();
     ble_gatt_write_test_long_bad_handle();
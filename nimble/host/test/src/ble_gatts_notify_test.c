@@ -919,6 +919,43 @@ TEST_CASE(ble_gatts_notify_test_bonded_i)
     TEST_ASSERT(ble_hs_test_util_num_cccds() == 2);
 }
 
+TEST_CASE(ble_gatts_notify_test_bonded_n_connected)
+{
+    struct ble_store_value_cccd value_cccd;
+    struct ble_store_key_cccd key_cccd;
+    uint16_t conn_handle;
+    int rc;
+
+    ble_gatts_notify_test_misc_init(&conn_handle, 1,
+                                    BLE_GATTS_CLT_CFG_F_NOTIFY, 0);
+
+    /* Update characteristic 1's value. */
+    ble_gatts_notify_test_chr_1_len = 1;
+    ble_gatts_notify_test_chr_1_val[0] = 0xcd;
+    ble_gatts_chr_updated(ble_gatts_notify_test_chr_1_def_handle + 1);
+
+    /* Verify notification sent properly. */
+    ble_gatts_notify_test_misc_verify_tx_n(
+        conn_handle,
+        ble_gatts_notify_test_chr_1_def_handle + 1,
+        ble_gatts_notify_test_chr_1_val,
+        ble_gatts_notify_test_chr_1_len);
+
+    /* The peer is connected and has received the notification; the
+     * 'updated' state must not be persisted.
+     */
+    key_cccd.peer_addr = *BLE_ADDR_ANY;
+    key_cccd.chr_val_handle = ble_gatts_notify_test_chr_1_def_handle + 1;
+    key_cccd.idx = 0;
+
+    rc = ble_store_read_cccd(&key_cccd, &value_cccd);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(!value_cccd.value_changed);
+
+    /* Ensure CCCD still persisted. */
+    TEST_ASSERT(ble_hs_test_util_num_cccds() == 1);
+}
+
 TEST_CASE(ble_gatts_notify_test_bonded_i_no_ack)
 {
     struct ble_store_value_cccd value_cccd;
@@ -1069,6 +1106,7 @@ TEST_SUITE(ble_gatts_notify_suite)
     ble_gatts_notify_test_bonded_n();
     ble_gatts_notify_test_bonded_i();
 
+    ble_gatts_notify_test_bonded_n_connected();
     ble_gatts_notify_test_bonded_i_no_ack();
 
     ble_gatts_notify_test_disallowed();
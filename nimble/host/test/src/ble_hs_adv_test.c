@@ -1263,6 +1263,306 @@ TEST_CASE(ble_hs_adv_test_case_user_full_payload)
     TEST_ASSERT(rc == BLE_HS_EMSGSIZE);
 }
 
+TEST_CASE(ble_hs_adv_test_case_filt)
+{
+    static const uint8_t adv_data[] = {
+        0x02, BLE_HS_ADV_TYPE_FLAGS, 0x06,
+        0x05, BLE_HS_ADV_TYPE_COMP_UUIDS16, 0x0d, 0x18, 0x0f, 0x18,
+        0x05, BLE_HS_ADV_TYPE_MFG_DATA, 0x59, 0x00, 0xaa, 0xbb,
+    };
+    static const ble_addr_t addr = {
+        BLE_ADDR_PUBLIC, { 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 }
+    };
+    static const ble_addr_t other_addr = {
+        BLE_ADDR_PUBLIC, { 0x06, 0x05, 0x04, 0x03, 0x02, 0x09 }
+    };
+    struct ble_hs_adv_filt filts[4];
+    uint32_t hits;
+    int rc;
+
+    ble_hs_test_util_init();
+
+    /*** No filters; everything passes. */
+    TEST_ASSERT(ble_hs_adv_filt_match(&addr, -50, adv_data,
+                                      sizeof adv_data));
+
+    /*** Manufacturer data with a prefix. */
+    memset(filts, 0, sizeof filts);
+    filts[0].criteria = BLE_HS_ADV_FILT_F_MFG;
+    filts[0].mfg_id = 0x0059;
+    filts[0].mfg_prefix[0] = 0xaa;
+    filts[0].mfg_prefix_len = 1;
+    rc = ble_hs_adv_filt_set(filts, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_adv_filt_match(&addr, -50, adv_data,
+                                      sizeof adv_data));
+
+    filts[0].mfg_prefix[0] = 0xbb;
+    rc = ble_hs_adv_filt_set(filts, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(!ble_hs_adv_filt_match(&addr, -50, adv_data,
+                                       sizeof adv_data));
+
+    /*** UUID combined with RSSI. */
+    memset(filts, 0, sizeof filts);
+    filts[0].criteria = BLE_HS_ADV_FILT_F_UUID | BLE_HS_ADV_FILT_F_RSSI;
+    filts[0].uuid.u16 = (ble_uuid16_t)BLE_UUID16_INIT(0x180f);
+    filts[0].rssi_min = -60;
+    rc = ble_hs_adv_filt_set(filts, 1);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_adv_filt_match(&addr, -50, adv_data,
+                                      sizeof adv_data));
+    TEST_ASSERT(!ble_hs_adv_filt_match(&addr, -70, adv_data,
+                                       sizeof adv_data));
+
+    /*** Address prefix OR AD type; hit counters. */
+    memset(filts, 0, sizeof filts);
+    filts[0].criteria = BLE_HS_ADV_FILT_F_ADDR;
+    filts[0].addr = addr;
+    filts[0].addr_len = 2;
+    filts[1].criteria = BLE_HS_ADV_FILT_F_AD_TYPE;
+    filts[1].ad_type = BLE_HS_ADV_TYPE_TX_PWR_LVL;
+    rc = ble_hs_adv_filt_set(filts, 2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    TEST_ASSERT(ble_hs_adv_filt_match(&addr, -50, adv_data,
+                                      sizeof adv_data));
+    TEST_ASSERT(!ble_hs_adv_filt_match(&other_addr, -50, adv_data,
+                                       sizeof adv_data));
+    TEST_ASSERT(ble_hs_adv_filt_match(&other_addr, -50,
+                                      (uint8_t[]){ 0x02, 0x0a, 0x00 }, 3));
+
+    rc = ble_hs_adv_filt_hits(0, &hits);
+    TEST_ASSERT(rc == 0 && hits == 1);
+    rc = ble_hs_adv_filt_hits(1, &hits);
+    TEST_ASSERT(rc == 0 && hits == 1);
+    rc = ble_hs_adv_filt_hits(2, &hits);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /*** Malformed filters. */
+    filts[0].addr_len = 7;
+    rc = ble_hs_adv_filt_set(filts, 1);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    rc = ble_hs_adv_filt_set(filts, 5);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Clearing the filters lets everything through again. */
+    rc = ble_hs_adv_filt_set(NULL, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_adv_filt_match(&other_addr, -50, adv_data,
+                                      sizeof adv_data));
+}
+
+/** Advertising payloads captured from common devices. */
+static const uint8_t ble_hs_adv_test_corpus_ibeacon[] = {
+    0x02, 0x01, 0x06,
+    0x1a, 0xff, 0x4c, 0x00, 0x02, 0x15,
+    0xe2, 0xc5, 0x6d, 0xb5, 0xdf, 0xfb, 0x48, 0xd2,
+    0xb0, 0x60, 0xd0, 0xf5, 0xa7, 0x10, 0x96, 0xe0,
+    0x00, 0x01, 0x00, 0x02, 0xc5,
+};
+static const uint8_t ble_hs_adv_test_corpus_eddystone[] = {
+    0x02, 0x01, 0x06,
+    0x03, 0x03, 0xaa, 0xfe,
+    0x0c, 0x16, 0xaa, 0xfe, 0x10, 0xeb, 0x03, 'n', 'i', 'm', 'b', 'l', 'e',
+};
+static const uint8_t ble_hs_adv_test_corpus_sensor[] = {
+    0x02, 0x01, 0x05,
+    0x05, 0x03, 0x0d, 0x18, 0x0f, 0x18,
+    0x02, 0x0a, 0xf4,
+    0x03, 0x19, 0x41, 0x03,
+    0x08, 0x09, 'H', 'R', ' ', 'b', 'e', 'l', 't',
+};
+static const uint8_t ble_hs_adv_test_corpus_uuid128[] = {
+    0x02, 0x01, 0x06,
+    0x11, 0x07,
+    0x9e, 0xca, 0xdc, 0x24, 0x0e, 0xe5, 0xa9, 0xe0,
+    0x93, 0xf3, 0xa3, 0xb5, 0x01, 0x00, 0x40, 0x6e,
+    0x05, 0x08, 'U', 'A', 'R', 'T',
+};
+
+static const struct {
+    const uint8_t *data;
+    uint8_t len;
+} ble_hs_adv_test_corpus[] = {
+    { ble_hs_adv_test_corpus_ibeacon,
+      sizeof ble_hs_adv_test_corpus_ibeacon },
+    { ble_hs_adv_test_corpus_eddystone,
+      sizeof ble_hs_adv_test_corpus_eddystone },
+    { ble_hs_adv_test_corpus_sensor,
+      sizeof ble_hs_adv_test_corpus_sensor },
+    { ble_hs_adv_test_corpus_uuid128,
+      sizeof ble_hs_adv_test_corpus_uuid128 },
+};
+
+TEST_CASE(ble_hs_adv_test_case_lazy_parse)
+{
+    struct ble_hs_adv_extract reqs[4];
+    const struct ble_hs_adv_field *field;
+    struct ble_hs_adv_fields fields;
+    struct ble_hs_adv_iter iter;
+    ble_uuid_any_t uuid;
+    uint8_t buf[BLE_HS_ADV_MAX_SZ];
+    int num_uuids;
+    int rc;
+    int i;
+    int j;
+
+    /*** Lazy parsing agrees with ble_hs_adv_parse_fields() on the corpus. */
+    for (i = 0;
+         i < sizeof ble_hs_adv_test_corpus / sizeof ble_hs_adv_test_corpus[0];
+         i++) {
+
+        memcpy(buf, ble_hs_adv_test_corpus[i].data,
+               ble_hs_adv_test_corpus[i].len);
+        rc = ble_hs_adv_parse_fields(&fields, buf,
+                                     ble_hs_adv_test_corpus[i].len);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        reqs[0].type = BLE_HS_ADV_TYPE_FLAGS;
+        reqs[1].type = BLE_HS_ADV_TYPE_MFG_DATA;
+        reqs[2].type = BLE_HS_ADV_TYPE_COMP_NAME;
+        reqs[3].type = BLE_HS_ADV_TYPE_COMP_UUIDS16;
+        rc = ble_hs_adv_extract(buf, ble_hs_adv_test_corpus[i].len, reqs, 4);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        TEST_ASSERT_FATAL(reqs[0].field != NULL);
+        TEST_ASSERT(reqs[0].field->value[0] == fields.flags);
+
+        if (fields.mfg_data != NULL) {
+            TEST_ASSERT_FATAL(reqs[1].field != NULL);
+            TEST_ASSERT(reqs[1].field->value == fields.mfg_data);
+            TEST_ASSERT(reqs[1].field->length - 1 == fields.mfg_data_len);
+        } else {
+            TEST_ASSERT(reqs[1].field == NULL);
+        }
+
+        if (fields.name != NULL && fields.name_is_complete) {
+            TEST_ASSERT_FATAL(reqs[2].field != NULL);
+            TEST_ASSERT(reqs[2].field->value == fields.name);
+        } else {
+            TEST_ASSERT(reqs[2].field == NULL);
+        }
+
+        if (fields.num_uuids16 != 0) {
+            TEST_ASSERT_FATAL(reqs[3].field != NULL);
+            rc = ble_hs_adv_field_num_uuids(reqs[3].field, &num_uuids);
+            TEST_ASSERT_FATAL(rc == 0);
+            TEST_ASSERT_FATAL(num_uuids == fields.num_uuids16);
+            for (j = 0; j < num_uuids; j++) {
+                rc = ble_hs_adv_field_uuid(reqs[3].field, j, &uuid);
+                TEST_ASSERT_FATAL(rc == 0);
+                TEST_ASSERT(ble_uuid_cmp(&uuid.u,
+                                         &fields.uuids16[j].u) == 0);
+            }
+            rc = ble_hs_adv_field_uuid(reqs[3].field, j, &uuid);
+            TEST_ASSERT(rc == BLE_HS_ENOENT);
+        }
+    }
+
+    /*** Service data yields its UUID; zero-length padding is skipped. */
+    memcpy(buf, ble_hs_adv_test_corpus_eddystone,
+           sizeof ble_hs_adv_test_corpus_eddystone);
+    memset(buf + sizeof ble_hs_adv_test_corpus_eddystone, 0, 2);
+    ble_hs_adv_iter_init(&iter, buf,
+                         sizeof ble_hs_adv_test_corpus_eddystone + 2);
+    for (i = 0; ; i++) {
+        rc = ble_hs_adv_iter_next(&iter, &field);
+        if (rc != 0) {
+            break;
+        }
+        if (field->type == BLE_HS_ADV_TYPE_SVC_DATA_UUID16) {
+            rc = ble_hs_adv_field_uuid(field, 0, &uuid);
+            TEST_ASSERT(rc == 0);
+            TEST_ASSERT(ble_uuid_cmp(&uuid.u, BLE_UUID16_DECLARE(0xfeaa)) == 0);
+        }
+    }
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+    TEST_ASSERT(i == 3);
+
+    /*** Non-UUID field. */
+    ble_hs_adv_iter_init(&iter, ble_hs_adv_test_corpus_sensor,
+                         sizeof ble_hs_adv_test_corpus_sensor);
+    rc = ble_hs_adv_iter_next(&iter, &field);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_hs_adv_field_uuid(field, 0, &uuid);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /*** Truncated payload. */
+    ble_hs_adv_iter_init(&iter, ble_hs_adv_test_corpus_sensor, 7);
+    rc = ble_hs_adv_iter_next(&iter, &field);
+    TEST_ASSERT(rc == 0);
+    rc = ble_hs_adv_iter_next(&iter, &field);
+    TEST_ASSERT(rc == BLE_HS_EBADDATA);
+    rc = ble_hs_adv_iter_next(&iter, &field);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+}
+
+TEST_CASE(ble_hs_adv_test_case_dedup)
+{
+    static const ble_addr_t addr = {
+        BLE_ADDR_PUBLIC, { 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 }
+    };
+    uint8_t data[] = { 0x04, BLE_HS_ADV_TYPE_MFG_DATA, 0xff, 0xff, 0x00 };
+    ble_addr_t other_addr;
+    uint32_t expiry_ticks;
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+
+    /*** Disabled by default. */
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+
+    rc = ble_hs_adv_dedup_set(1, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /*** Identical reports are suppressed; changed payloads are not. */
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    TEST_ASSERT(ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    data[4] = 1;
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    TEST_ASSERT(ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+
+    /*** Report type and advertiser are part of the key. */
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, BLE_HCI_ADV_RPT_EVTYPE_SCAN_RSP,
+                                        data, sizeof data));
+    other_addr = addr;
+    other_addr.val[5] = 0x09;
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&other_addr, 0, data, sizeof data));
+
+    /*** The least recently seen advertisement is evicted when full. */
+    TEST_ASSERT(ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    for (i = 0; i < MYNEWT_VAL(BLE_HS_ADV_DEDUP_MAX) - 1; i++) {
+        other_addr.val[0] = i;
+        TEST_ASSERT(!ble_hs_adv_dedup_check(&other_addr, 0, data,
+                                            sizeof data));
+    }
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&other_addr, 1, data, sizeof data));
+    other_addr.val[0] = 0;
+    TEST_ASSERT(ble_hs_adv_dedup_check(&other_addr, 0, data, sizeof data));
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+
+    /*** Unchanged advertisements are reported again after the expiry. */
+    rc = ble_hs_adv_dedup_set(1, 100);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = os_time_ms_to_ticks(100, &expiry_ticks);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    os_time_advance(expiry_ticks - 1);
+    TEST_ASSERT(ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    os_time_advance(1);
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+    TEST_ASSERT(ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+
+    /*** Disabling forgets everything. */
+    rc = ble_hs_adv_dedup_set(0, 0);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(!ble_hs_adv_dedup_check(&addr, 0, data, sizeof data));
+}
+
 TEST_SUITE(ble_hs_adv_test_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -1270,6 +1570,9 @@ TEST_SUITE(ble_hs_adv_test_suite)
     ble_hs_adv_test_case_user();
     ble_hs_adv_test_case_user_rsp();
     ble_hs_adv_test_case_user_full_payload();
+    ble_hs_adv_test_case_filt();
+    ble_hs_adv_test_case_lazy_parse();
+    ble_hs_adv_test_case_dedup();
 }
 
 int
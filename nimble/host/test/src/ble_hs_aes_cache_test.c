@@ -0,0 +1,408 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "testutil/testutil.h"
+#include "host/ble_hs_test.h"
+#include "tinycrypt/aes.h"
+#include "tinycrypt/cmac_mode.h"
+#include "tinycrypt/constants.h"
+#include "ble_hs_test_util.h"
+
+/* FIPS-197, appendix C.1. */
+static const uint8_t ble_hs_aes_cache_test_key[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+static const uint8_t ble_hs_aes_cache_test_pt[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+static const uint8_t ble_hs_aes_cache_test_ct[16] = {
+    0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+};
+
+/* RFC 4493, section 4. */
+static const uint8_t ble_hs_aes_cache_test_cmac_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+static const uint8_t ble_hs_aes_cache_test_cmac_msg[16] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+    0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+};
+static const uint8_t ble_hs_aes_cache_test_cmac_empty[16] = {
+    0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28,
+    0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46,
+};
+static const uint8_t ble_hs_aes_cache_test_cmac_16[16] = {
+    0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44,
+    0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c,
+};
+
+static void
+ble_hs_aes_cache_test_util_cmac(const uint8_t *key, const uint8_t *msg,
+                                size_t len, uint8_t *out)
+{
+    struct tc_aes_key_sched_struct sched;
+    struct tc_cmac_struct state;
+    int rc;
+
+    rc = ble_hs_aes_cache_cmac_setup(&state, key, &sched);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = tc_cmac_update(&state, msg, len);
+    TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+
+    rc = tc_cmac_final(out, &state);
+    TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+}
+
+TEST_CASE(ble_hs_aes_cache_test_case_encrypt)
+{
+    uint8_t key[16];
+    uint8_t out[16];
+    int rc;
+    int i;
+
+    ble_hs_aes_cache_clear();
+
+    /* Miss, then hit. */
+    for (i = 0; i < 2; i++) {
+        rc = ble_hs_aes_cache_encrypt(ble_hs_aes_cache_test_key,
+                                      ble_hs_aes_cache_test_pt, out);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(out, ble_hs_aes_cache_test_ct, 16) == 0);
+    }
+
+    /* Evict the key by cycling more keys than the cache holds; results
+     * must not depend on whether a key is cached.
+     */
+    memcpy(key, ble_hs_aes_cache_test_key, sizeof key);
+    for (i = 0; i < MYNEWT_VAL(BLE_HS_AES_CACHE_SIZE) + 2; i++) {
+        key[15] = 0x80 + i;
+        rc = ble_hs_aes_cache_encrypt(key, ble_hs_aes_cache_test_pt, out);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(out, ble_hs_aes_cache_test_ct, 16) != 0);
+    }
+
+    /* In-place encryption. */
+    memcpy(out, ble_hs_aes_cache_test_pt, sizeof out);
+    rc = ble_hs_aes_cache_encrypt(ble_hs_aes_cache_test_key, out, out);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(out, ble_hs_aes_cache_test_ct, 16) == 0);
+}
+
+TEST_CASE(ble_hs_aes_cache_test_case_cmac)
+{
+    uint8_t out[16];
+    int i;
+
+    ble_hs_aes_cache_clear();
+
+    /* Key not cached at all. */
+    ble_hs_aes_cache_test_util_cmac(ble_hs_aes_cache_test_cmac_key,
+                                    NULL, 0, out);
+    TEST_ASSERT(memcmp(out, ble_hs_aes_cache_test_cmac_empty, 16) == 0);
+
+    /* Subkeys cached. */
+    for (i = 0; i < 2; i++) {
+        ble_hs_aes_cache_test_util_cmac(ble_hs_aes_cache_test_cmac_key,
+                                        ble_hs_aes_cache_test_cmac_msg, 16,
+                                        out);
+        TEST_ASSERT(memcmp(out, ble_hs_aes_cache_test_cmac_16, 16) == 0);
+    }
+
+    /* Schedule cached by a block encryption, but no subkeys yet. */
+    ble_hs_aes_cache_clear();
+    ble_hs_aes_cache_encrypt(ble_hs_aes_cache_test_cmac_key,
+                             ble_hs_aes_cache_test_pt, out);
+    ble_hs_aes_cache_test_util_cmac(ble_hs_aes_cache_test_cmac_key,
+                                    ble_hs_aes_cache_test_cmac_msg, 16, out);
+    TEST_ASSERT(memcmp(out, ble_hs_aes_cache_test_cmac_16, 16) == 0);
+}
+
+#if MYNEWT_VAL(BLE_SM_SC)
+
+TEST_CASE(ble_hs_aes_cache_test_case_sm_one_shot)
+{
+    uint8_t mackey[16];
+    uint8_t check[16];
+    uint8_t ltk[16];
+    uint8_t a1[6];
+    uint8_t a2[6];
+    uint8_t w[32];
+    uint8_t n1[16];
+    uint8_t n2[16];
+    uint8_t iocap[3];
+    int rc;
+
+    memset(w, 0x11, sizeof w);
+    memset(n1, 0x22, sizeof n1);
+    memset(n2, 0x33, sizeof n2);
+    memset(a1, 0x44, sizeof a1);
+    memset(a2, 0x55, sizeof a2);
+    memset(iocap, 0, sizeof iocap);
+
+    ble_hs_aes_cache_clear();
+
+    /* f5 caches only its constant SALT key, not T. */
+    rc = ble_sm_alg_f5(w, n1, n2, 0, a1, 0, a2, mackey, ltk);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_aes_cache_dbg_num_entries() == 1);
+
+    /* MacKey is never cached. */
+    rc = ble_sm_alg_f6(mackey, n1, n2, n1, iocap, 0, a1, 0, a2, check);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_aes_cache_dbg_num_entries() == 1);
+
+    /* Nor is the legacy TK. */
+    rc = ble_sm_alg_c1(n1, n2, n1, n2, 0, 0, a1, a2, check);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_hs_aes_cache_dbg_num_entries() == 1);
+}
+
+#endif
+
+#if MYNEWT_VAL(BLE_HS_AES_CACHE_TEST_BENCH)
+
+#define BLE_HS_AES_CACHE_TEST_BENCH_MSGS        10000
+
+/* AES blocks per message in the mesh CCM bench: C_mic, X_0, and one CBC-MAC
+ * and one CTR block for a single-block payload.
+ */
+#define BLE_HS_AES_CACHE_TEST_BENCH_CCM_BLOCKS  4
+
+static clock_t ble_hs_aes_cache_test_bench_start;
+
+static void
+ble_hs_aes_cache_test_bench_begin(void)
+{
+    ble_hs_aes_cache_clear();
+    ble_hs_aes_cache_test_bench_start = clock();
+}
+
+static double
+ble_hs_aes_cache_test_bench_end(int blocks)
+{
+    double secs;
+
+    secs = (double)(clock() - ble_hs_aes_cache_test_bench_start) /
+           CLOCKS_PER_SEC;
+    if (secs <= 0) {
+        return 0;
+    }
+
+    return blocks / secs;
+}
+
+static void
+ble_hs_aes_cache_test_bench_print(const char *name, double uncached,
+                                  double cached)
+{
+    printf("ble_hs_aes_cache bench: %-9s uncached %9.0f blocks/s, "
+           "cached %9.0f blocks/s\n", name, uncached, cached);
+}
+
+/**
+ * Security manager: signs a 47-byte ATT PDU (three CMAC blocks) with
+ * ble_sm_alg_sign().  The uncached figure empties the cache before every
+ * signature, so the CSRK is expanded and its subkeys derived each time.
+ */
+static void
+ble_hs_aes_cache_test_bench_sm_sign(void)
+{
+    uint8_t pdu[1 + 2 + 40 + 4];
+    uint8_t mac[8];
+    struct os_mbuf *om;
+    double uncached;
+    double cached;
+    int blocks;
+    int rc;
+    int i;
+
+    memset(pdu, 0x5a, sizeof pdu);
+    pdu[0] = BLE_ATT_OP_SIGNED_WRITE_CMD;
+    om = ble_hs_mbuf_from_flat(pdu, sizeof pdu);
+    TEST_ASSERT_FATAL(om != NULL);
+
+    blocks = BLE_HS_AES_CACHE_TEST_BENCH_MSGS * ((sizeof pdu + 15) / 16);
+
+    ble_hs_aes_cache_test_bench_begin();
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_MSGS; i++) {
+        ble_hs_aes_cache_clear();
+        rc = ble_sm_alg_sign(ble_hs_test_util_csrk, pdu[0], om, 1,
+                             sizeof pdu - 1, mac);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    uncached = ble_hs_aes_cache_test_bench_end(blocks);
+
+    ble_hs_aes_cache_test_bench_begin();
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_MSGS; i++) {
+        rc = ble_sm_alg_sign(ble_hs_test_util_csrk, pdu[0], om, 1,
+                             sizeof pdu - 1, mac);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    cached = ble_hs_aes_cache_test_bench_end(blocks);
+
+    os_mbuf_free_chain(om);
+
+    ble_hs_aes_cache_test_bench_print("sm sign", uncached, cached);
+}
+
+/**
+ * Mesh: single-block CMACs alternating between two keys, the way
+ * bt_mesh_aes_cmac() computes them (cached subkeys) versus a plain
+ * tc_cmac_setup() per message.  The mesh package is not a dependency of
+ * this test package, so its calls into the cache are reproduced here.
+ */
+static void
+ble_hs_aes_cache_test_bench_mesh_cmac(void)
+{
+    struct tc_aes_key_sched_struct sched;
+    struct tc_cmac_struct state;
+    const uint8_t *keys[2];
+    uint8_t out[16];
+    double uncached;
+    double cached;
+    int blocks;
+    int rc;
+    int i;
+
+    keys[0] = ble_hs_aes_cache_test_key;
+    keys[1] = ble_hs_aes_cache_test_cmac_key;
+
+    blocks = BLE_HS_AES_CACHE_TEST_BENCH_MSGS;
+
+    ble_hs_aes_cache_test_bench_begin();
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_MSGS; i++) {
+        rc = tc_cmac_setup(&state, keys[i & 1], &sched);
+        TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+        rc = tc_cmac_update(&state, ble_hs_aes_cache_test_cmac_msg, 16);
+        TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+        rc = tc_cmac_final(out, &state);
+        TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+    }
+    uncached = ble_hs_aes_cache_test_bench_end(blocks);
+
+    ble_hs_aes_cache_test_bench_begin();
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_MSGS; i++) {
+        ble_hs_aes_cache_test_util_cmac(keys[i & 1],
+                                        ble_hs_aes_cache_test_cmac_msg, 16,
+                                        out);
+    }
+    cached = ble_hs_aes_cache_test_bench_end(blocks);
+
+    ble_hs_aes_cache_test_bench_print("mesh cmac", uncached, cached);
+}
+
+static void
+ble_hs_aes_cache_test_bench_ccm_blocks(struct tc_aes_key_sched_struct *sched)
+{
+    uint8_t blk[16];
+    int rc;
+    int i;
+
+    memcpy(blk, ble_hs_aes_cache_test_pt, sizeof blk);
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_CCM_BLOCKS; i++) {
+        rc = tc_aes_encrypt(blk, blk, sched);
+        TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+    }
+}
+
+/**
+ * Mesh: CCM on a single-block payload, alternating between two keys.  The
+ * schedule comes from ble_hs_aes_cache_sched(), as in bt_mesh_ccm_encrypt()
+ * and bt_mesh_ccm_decrypt(), versus tc_aes128_set_encrypt_key() per message.
+ */
+static void
+ble_hs_aes_cache_test_bench_mesh_ccm(void)
+{
+    struct tc_aes_key_sched_struct sched;
+    const uint8_t *keys[2];
+    double uncached;
+    double cached;
+    int blocks;
+    int rc;
+    int i;
+
+    keys[0] = ble_hs_aes_cache_test_key;
+    keys[1] = ble_hs_aes_cache_test_cmac_key;
+
+    blocks = BLE_HS_AES_CACHE_TEST_BENCH_MSGS *
+             BLE_HS_AES_CACHE_TEST_BENCH_CCM_BLOCKS;
+
+    ble_hs_aes_cache_test_bench_begin();
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_MSGS; i++) {
+        rc = tc_aes128_set_encrypt_key(&sched, keys[i & 1]);
+        TEST_ASSERT_FATAL(rc == TC_CRYPTO_SUCCESS);
+        ble_hs_aes_cache_test_bench_ccm_blocks(&sched);
+    }
+    uncached = ble_hs_aes_cache_test_bench_end(blocks);
+
+    ble_hs_aes_cache_test_bench_begin();
+    for (i = 0; i < BLE_HS_AES_CACHE_TEST_BENCH_MSGS; i++) {
+        rc = ble_hs_aes_cache_sched(keys[i & 1], &sched);
+        TEST_ASSERT_FATAL(rc == 0);
+        ble_hs_aes_cache_test_bench_ccm_blocks(&sched);
+    }
+    cached = ble_hs_aes_cache_test_bench_end(blocks);
+
+    ble_hs_aes_cache_test_bench_print("mesh ccm", uncached, cached);
+}
+
+/**
+ * Micro-benchmark: throughput with and without the cache for the security
+ * manager's and mesh's uses of it.  Reports blocks per second; not a
+ * pass/fail test.
+ */
+TEST_CASE(ble_hs_aes_cache_test_case_bench)
+{
+    ble_hs_aes_cache_test_bench_sm_sign();
+    ble_hs_aes_cache_test_bench_mesh_cmac();
+    ble_hs_aes_cache_test_bench_mesh_ccm();
+
+    ble_hs_aes_cache_clear();
+}
+
+#endif
+
+TEST_SUITE(ble_hs_aes_cache_test_suite)
+{
+    ble_hs_aes_cache_test_case_encrypt();
+    ble_hs_aes_cache_test_case_cmac();
+#if MYNEWT_VAL(BLE_SM_SC)
+    ble_hs_aes_cache_test_case_sm_one_shot();
+#endif
+#if MYNEWT_VAL(BLE_HS_AES_CACHE_TEST_BENCH)
+    ble_hs_aes_cache_test_case_bench();
+#endif
+}
+
+int
+ble_hs_aes_cache_test_all(void)
+{
+    ble_hs_aes_cache_test_suite();
+
+    return tu_any_failed;
+}
@@ -20,6 +20,8 @@
 #include <stddef.h>
 #include <errno.h>
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
 #include "nimble/hci_common.h"
 #include "nimble/ble_hci_trans.h"
 #include "host/ble_hs_test.h"
@@ -83,6 +85,364 @@ TEST_CASE(ble_hs_hci_test_rssi)
     TEST_ASSERT(rc == BLE_HS_ECONTROLLER);
 }
 
+#define BLE_HS_HCI_TEST_ASYNC_MAX_CBS   4
+
+struct ble_hs_hci_test_async_cb {
+    uint16_t opcode;
+    int status;
+    uint8_t params[BLE_HCI_READ_RSSI_ACK_PARAM_LEN];
+    uint8_t params_len;
+    void *arg;
+};
+
+static struct ble_hs_hci_test_async_cb
+ble_hs_hci_test_async_cbs[BLE_HS_HCI_TEST_ASYNC_MAX_CBS];
+static int ble_hs_hci_test_async_num_cbs;
+
+static void
+ble_hs_hci_test_async_cb(uint16_t opcode, int status, const uint8_t *params,
+                         uint8_t params_len, void *arg)
+{
+    struct ble_hs_hci_test_async_cb *cb;
+
+    TEST_ASSERT_FATAL(ble_hs_hci_test_async_num_cbs <
+                      BLE_HS_HCI_TEST_ASYNC_MAX_CBS);
+    TEST_ASSERT_FATAL(params_len <= sizeof cb->params);
+
+    cb = ble_hs_hci_test_async_cbs + ble_hs_hci_test_async_num_cbs++;
+    cb->opcode = opcode;
+    cb->status = status;
+    cb->params_len = params_len;
+    if (params_len > 0) {
+        memcpy(cb->params, params, params_len);
+    }
+    cb->arg = arg;
+}
+
+TEST_CASE(ble_hs_hci_test_async)
+{
+    uint8_t params[BLE_HCI_READ_RSSI_ACK_PARAM_LEN];
+    uint8_t cmd[BLE_HCI_READ_RSSI_LEN];
+    uint8_t big[65];
+    uint16_t rssi_opcode;
+    uint16_t evmask_opcode;
+    uint8_t *param;
+    uint8_t param_len;
+    int rc;
+
+    ble_hs_test_util_init();
+
+    ble_hs_hci_test_async_num_cbs = 0;
+    memset(big, 0, sizeof big);
+
+    rssi_opcode = ble_hs_hci_util_opcode_join(BLE_HCI_OGF_STATUS_PARAMS,
+                                              BLE_HCI_OCF_RD_RSSI);
+    evmask_opcode = ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
+                                                BLE_HCI_OCF_LE_SET_EVENT_MASK);
+
+    /*** Two commands queued back-to-back; second one fails. */
+    put_le16(params + 0, 1);
+    params[2] = -30;
+    ble_hs_test_util_hci_ack_set_params(rssi_opcode, 0,
+                                        params, sizeof params);
+    ble_hs_test_util_hci_ack_append(evmask_opcode, BLE_ERR_UNK_CONN_ID);
+
+    put_le16(cmd, 1);
+    rc = ble_hs_hci_cmd_tx_async(rssi_opcode, cmd, sizeof cmd,
+                                 ble_hs_hci_test_async_cb, (void *)1);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_hci_cmd_tx_async(evmask_opcode, big,
+                                 BLE_HCI_SET_LE_EVENT_MASK_LEN,
+                                 ble_hs_hci_test_async_cb, (void *)2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    /* Verify commands were sent in submission order. */
+    param = ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_STATUS_PARAMS,
+                                           BLE_HCI_OCF_RD_RSSI, &param_len);
+    TEST_ASSERT(param_len == sizeof cmd);
+    TEST_ASSERT(get_le16(param) == 1);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_SET_EVENT_MASK, NULL);
+
+    /* Verify callbacks. */
+    TEST_ASSERT_FATAL(ble_hs_hci_test_async_num_cbs == 2);
+
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[0].opcode == rssi_opcode);
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[0].status == 0);
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[0].arg == (void *)1);
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[0].params_len == sizeof params);
+    TEST_ASSERT(memcmp(ble_hs_hci_test_async_cbs[0].params, params,
+                       sizeof params) == 0);
+
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[1].opcode == evmask_opcode);
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[1].status ==
+                BLE_HS_HCI_ERR(BLE_ERR_UNK_CONN_ID));
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[1].arg == (void *)2);
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[1].params_len == 0);
+
+    /*** Failure: parameters too long. */
+    rc = ble_hs_hci_cmd_tx_async(evmask_opcode, big, sizeof big,
+                                 ble_hs_hci_test_async_cb, NULL);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+    TEST_ASSERT(ble_hs_hci_test_async_num_cbs == 2);
+
+    /*** Failure: unexpected ack opcode. */
+    ble_hs_test_util_hci_ack_set(rssi_opcode, 0);
+    rc = ble_hs_hci_cmd_tx_async(evmask_opcode, big,
+                                 BLE_HCI_SET_LE_EVENT_MASK_LEN,
+                                 ble_hs_hci_test_async_cb, NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(ble_hs_hci_test_async_num_cbs == 3);
+    TEST_ASSERT(ble_hs_hci_test_async_cbs[2].status == BLE_HS_ECONTROLLER);
+}
+
+/**
+ * Startup acks from the controller of ble_hs_test_util_hci_ack_set_startup(),
+ * when its capabilities are already cached.
+ */
+static const struct ble_hs_test_util_hci_ack ble_hs_hci_test_cached_seq[] = {
+    {
+        .opcode = ble_hs_hci_util_opcode_join(BLE_HCI_OGF_CTLR_BASEBAND,
+                                              BLE_HCI_OCF_CB_RESET),
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOCAL_VER),
+        .evt_params = { 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        .evt_params_len = 8,
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_BD_ADDR),
+        .evt_params = BLE_HS_TEST_UTIL_PUB_ADDR_VAL,
+        .evt_params_len = 6,
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT),
+        .evt_params = { 0 },
+        .evt_params_len = 8,
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_CMD),
+        .evt_params = { 0 },
+        .evt_params_len = 64,
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_CTLR_BASEBAND, BLE_HCI_OCF_CB_SET_EVENT_MASK),
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_CTLR_BASEBAND, BLE_HCI_OCF_CB_SET_EVENT_MASK2),
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_EVENT_MASK),
+    },
+
+    /* The reset emptied the resolving list; it gets reprogrammed. */
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_ADDR_RES_EN),
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_ADD_RESOLV_LIST),
+    },
+    {
+        .opcode = ble_hs_hci_util_opcode_join(
+            BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_PRIVACY_MODE),
+    },
+    { 0 }
+};
+
+TEST_CASE(ble_hs_hci_test_startup_cached)
+{
+    int rc;
+
+    ble_hs_test_util_init();
+
+    /*** Same controller; capability reads are skipped. */
+    ble_hs_test_util_hci_ack_set_seq(ble_hs_hci_test_cached_seq);
+    rc = ble_hs_startup_go();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_CTLR_BASEBAND,
+                                   BLE_HCI_OCF_CB_RESET, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_INFO_PARAMS,
+                                   BLE_HCI_OCF_IP_RD_LOCAL_VER, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_INFO_PARAMS,
+                                   BLE_HCI_OCF_IP_RD_BD_ADDR, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_INFO_PARAMS,
+                                   BLE_HCI_OCF_IP_RD_LOC_SUPP_CMD, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_CTLR_BASEBAND,
+                                   BLE_HCI_OCF_CB_SET_EVENT_MASK, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_CTLR_BASEBAND,
+                                   BLE_HCI_OCF_CB_SET_EVENT_MASK2, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_SET_EVENT_MASK, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_SET_ADDR_RES_EN, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_ADD_RESOLV_LIST, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_SET_PRIVACY_MODE, NULL);
+
+    /* Cached buffer parameters are restored. */
+    TEST_ASSERT(ble_hs_hci_avail_pkts == 200);
+
+    /*** Cache cleared; full sequence is performed. */
+    ble_hs_startup_clear_ctlr_info();
+    ble_hs_test_util_hci_ack_set_startup();
+    rc = ble_hs_startup_go();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_hci_out_adj(5);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_INFO_PARAMS,
+                                   BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_RD_BUF_SIZE, NULL);
+}
+
+TEST_CASE(ble_hs_hci_test_startup_ctlr_changed)
+{
+    uint8_t bd_addr[6] = BLE_HS_TEST_UTIL_PUB_ADDR_VAL;
+    uint8_t local_ver[8] = { 0x09 };
+    uint8_t sup_feat[8] = { 0x00, 0x00, 0x00, 0x00, 0x60 };
+    uint8_t sup_cmds[64] = { 0 };
+    uint8_t le_feat[8] = { 0 };
+    uint8_t le_buf_sz[3] = { 0x1b, 0x00, 10 };
+    int rc;
+
+    ble_hs_test_util_init();
+
+    /*** Same version and address, but new LE features (e.g., after a
+     * firmware update); the capabilities are read again.
+     */
+    le_feat[0] = 0x01;
+
+    ble_hs_test_util_hci_ack_set(
+        BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND, BLE_HCI_OCF_CB_RESET), 0);
+    ble_hs_test_util_hci_ack_append_params(
+        BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOCAL_VER), 0,
+        local_ver, sizeof local_ver);
+    ble_hs_test_util_hci_ack_append_params(
+        BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_BD_ADDR), 0,
+        bd_addr, sizeof bd_addr);
+    ble_hs_test_util_hci_ack_append_params(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_LOC_SUPP_FEAT), 0,
+        le_feat, sizeof le_feat);
+    ble_hs_test_util_hci_ack_append_params(
+        BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_CMD), 0,
+        sup_cmds, sizeof sup_cmds);
+    ble_hs_test_util_hci_ack_append_params(
+        BLE_HCI_OP(BLE_HCI_OGF_INFO_PARAMS, BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT),
+        0, sup_feat, sizeof sup_feat);
+    ble_hs_test_util_hci_ack_append_params(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RD_BUF_SIZE), 0,
+        le_buf_sz, sizeof le_buf_sz);
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND, BLE_HCI_OCF_CB_SET_EVENT_MASK),
+        0);
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_CTLR_BASEBAND, BLE_HCI_OCF_CB_SET_EVENT_MASK2),
+        0);
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_EVENT_MASK), 0);
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_ADDR_RES_EN), 0);
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_ADD_RESOLV_LIST), 0);
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_SET_PRIVACY_MODE), 0);
+
+    ble_hs_test_util_hci_out_clear();
+    rc = ble_hs_startup_go();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_hci_out_adj(5);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_INFO_PARAMS,
+                                   BLE_HCI_OCF_IP_RD_LOC_SUPP_FEAT, NULL);
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_RD_BUF_SIZE, NULL);
+
+    /* The new controller's capabilities are in effect. */
+    TEST_ASSERT(ble_hs_hci_get_le_supported_feat() == 0x01);
+    TEST_ASSERT(ble_hs_hci_avail_pkts == 10);
+}
+
+#if MYNEWT_VAL(BLE_HS_SYNC_TEST_BENCH)
+
+#define BLE_HS_HCI_TEST_BENCH_SYNCS     1000
+
+/**
+ * Returns the mean time, in microseconds, that ble_hs_sync() takes with the
+ * specified controller responses.
+ */
+static double
+ble_hs_hci_test_bench_sync(const struct ble_hs_test_util_hci_ack *acks,
+                           int cold)
+{
+    clock_t elapsed;
+    clock_t start;
+    int rc;
+    int i;
+
+    elapsed = 0;
+    for (i = 0; i < BLE_HS_HCI_TEST_BENCH_SYNCS; i++) {
+        if (cold) {
+            ble_hs_startup_clear_ctlr_info();
+        }
+        if (acks == NULL) {
+            ble_hs_test_util_hci_ack_set_startup();
+        } else {
+            ble_hs_test_util_hci_ack_set_seq(acks);
+        }
+        ble_hs_test_util_hci_out_clear();
+
+        start = clock();
+        rc = ble_hs_sync();
+        elapsed += clock() - start;
+
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    return (double)elapsed * 1000000 / CLOCKS_PER_SEC /
+           BLE_HS_HCI_TEST_BENCH_SYNCS;
+}
+
+/**
+ * Time-to-sync benchmark: host synchronization with a controller it has not
+ * seen (all capabilities read) and with the same controller again (cached
+ * capabilities).  Commands go through the RAM transport and are acked by
+ * the phony controller, so the figures cover the host's own processing,
+ * not controller or link latency.  Not a pass/fail test.
+ */
+TEST_CASE(ble_hs_hci_test_bench_sync_time)
+{
+    double cold_us;
+    double warm_us;
+
+    ble_hs_test_util_init();
+
+    cold_us = ble_hs_hci_test_bench_sync(NULL, 1);
+    warm_us = ble_hs_hci_test_bench_sync(ble_hs_hci_test_cached_seq, 0);
+
+    printf("ble_hs_sync bench: %d syncs; cold %.1f us (%d cmds), "
+           "warm %.1f us (%d cmds)\n",
+           BLE_HS_HCI_TEST_BENCH_SYNCS,
+           cold_us, ble_hs_test_util_hci_startup_seq_cnt(),
+           warm_us, (int)(sizeof ble_hs_hci_test_cached_seq /
+                          sizeof ble_hs_hci_test_cached_seq[0]) - 1);
+}
+
+#endif
+
 TEST_CASE(ble_hs_hci_acl_one_conn)
 {
     struct ble_hs_test_util_hci_num_completed_pkts_entry ncpe[2];
@@ -327,14 +687,213 @@ TEST_CASE(ble_hs_hci_acl_two_conn)
     ble_hs_test_util_verify_tx_write_cmd(100, data + 30, 70);
 }
 
+TEST_CASE(ble_hs_hci_acl_frag_chain)
+{
+    static const uint16_t mbuf_lens[] = { 10, 30, 5, 17 };
+    uint8_t peer_addr[6] = { 1, 2, 3, 4, 5, 6 };
+    struct ble_hs_conn *conn;
+    struct os_mbuf *om;
+    struct os_mbuf *m;
+    uint8_t data[128];
+    int off;
+    int rc;
+    int i;
+
+    for (i = 0; i < sizeof data; i++) {
+        data[i] = i;
+    }
+
+    ble_hs_test_util_init();
+
+    /* The controller accepts 20-byte payloads (+ 4-byte header). */
+    rc = ble_hs_hci_set_buf_sz(24, 10);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_hs_test_util_create_conn(1, peer_addr, NULL, NULL);
+
+    /* Build an L2CAP packet whose mbuf boundaries don't line up with the
+     * fragment boundaries.  The first mbuf holds the L2CAP header.
+     */
+    om = ble_hs_mbuf_l2cap_pkt();
+    TEST_ASSERT_FATAL(om != NULL);
+
+    off = 0;
+    for (i = 0; i < sizeof mbuf_lens / sizeof mbuf_lens[0]; i++) {
+        m = os_msys_get(0, 0);
+        TEST_ASSERT_FATAL(m != NULL);
+        memcpy(m->om_data, data + off, mbuf_lens[i]);
+        m->om_len = mbuf_lens[i];
+        os_mbuf_concat(om, m);
+        off += mbuf_lens[i];
+    }
+
+    om = ble_l2cap_prepend_hdr(om, BLE_L2CAP_CID_ATT, off);
+    TEST_ASSERT_FATAL(om != NULL);
+
+    ble_hs_test_util_prev_tx_queue_clear();
+
+    /* 4 + 62 bytes: three full fragments and a partial one. */
+    ble_hs_lock();
+    conn = ble_hs_conn_find(1);
+    TEST_ASSERT_FATAL(conn != NULL);
+    rc = ble_hs_hci_acl_tx(conn, &om);
+    ble_hs_unlock();
+    TEST_ASSERT_FATAL(rc == 0);
+
+    TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 4);
+
+    om = ble_hs_test_util_prev_tx_dequeue_pullup();
+    TEST_ASSERT_FATAL(om != NULL);
+    TEST_ASSERT(OS_MBUF_PKTLEN(om) == off);
+    TEST_ASSERT(memcmp(om->om_data, data, off) == 0);
+}
+
+#define BLE_HS_HCI_TEST_RX_EVENT_MAX    (MYNEWT_VAL(BLE_HS_RX_RING_SIZE) + 8)
+
+static uint8_t ble_hs_hci_test_rx_events[BLE_HS_HCI_TEST_RX_EVENT_MAX];
+static int ble_hs_hci_test_rx_num_events;
+
+static int
+ble_hs_hci_test_rx_gap_cb(struct ble_gap_event *event, void *arg)
+{
+    TEST_ASSERT_FATAL(ble_hs_hci_test_rx_num_events <
+                      BLE_HS_HCI_TEST_RX_EVENT_MAX);
+
+    ble_hs_hci_test_rx_events[ble_hs_hci_test_rx_num_events++] = event->type;
+    return 0;
+}
+
+/**
+ * Delivers an incoming ATT notification through the transport, as the
+ * controller would.
+ */
+static void
+ble_hs_hci_test_rx_notify(uint16_t conn_handle)
+{
+    static const uint8_t pdu[] = {
+        /* L2CAP header: ATT channel. */
+        0x04, 0x00, 0x04, 0x00,
+
+        /* Handle value notification: handle 0x0010, one byte of data. */
+        BLE_ATT_OP_NOTIFY_REQ, 0x10, 0x00, 0xab,
+    };
+    struct os_mbuf *om;
+    uint8_t hdr[BLE_HCI_DATA_HDR_SZ];
+    int rc;
+
+    put_le16(hdr + 0, conn_handle | (BLE_HCI_PB_FIRST_FLUSH << 12));
+    put_le16(hdr + 2, sizeof pdu);
+
+    om = os_msys_get_pkthdr(0, 0);
+    TEST_ASSERT_FATAL(om != NULL);
+    rc = os_mbuf_append(om, hdr, sizeof hdr);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = os_mbuf_append(om, pdu, sizeof pdu);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hci_trans_ll_acl_tx(om);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_hs_hci_test_rx_disconnect(uint16_t conn_handle)
+{
+    uint8_t *buf;
+    int rc;
+
+    buf = ble_hci_trans_buf_alloc(BLE_HCI_TRANS_BUF_EVT_HI);
+    TEST_ASSERT_FATAL(buf != NULL);
+
+    buf[0] = BLE_HCI_EVCODE_DISCONN_CMP;
+    buf[1] = BLE_HCI_EVENT_DISCONN_COMPLETE_LEN;
+    buf[2] = 0;
+    put_le16(buf + 3, conn_handle);
+    buf[5] = BLE_ERR_REM_USER_CONN_TERM;
+
+    rc = ble_hci_trans_ll_evt_tx(buf);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_hs_hci_test_rx_run_evq(struct os_eventq *evq)
+{
+    struct os_event *ev;
+
+    while ((ev = os_eventq_get_no_wait(evq)) != NULL) {
+        ev->ev_cb(ev);
+    }
+}
+
+TEST_CASE(ble_hs_hci_test_rx_ring_full)
+{
+    uint8_t peer_addr[6] = { 1, 2, 3, 4, 5, 6 };
+    struct os_eventq evq;
+    int num_notify;
+    int i;
+
+    ble_hs_test_util_init();
+
+    ble_hs_test_util_create_conn(2, peer_addr, ble_hs_hci_test_rx_gap_cb,
+                                 NULL);
+    ble_hs_hci_test_rx_num_events = 0;
+
+    /* Hold received packets until the host task runs. */
+    os_eventq_init(&evq);
+    ble_hs_evq_set(&evq);
+
+    /* Fill the ring and push past it: data, then the disconnect, then data
+     * for the dead connection.  Nothing may be dropped or reordered.
+     */
+    num_notify = MYNEWT_VAL(BLE_HS_RX_RING_SIZE) + 2;
+    for (i = 0; i < num_notify; i++) {
+        ble_hs_hci_test_rx_notify(2);
+    }
+    ble_hs_hci_test_rx_disconnect(2);
+    ble_hs_hci_test_rx_notify(2);
+
+    TEST_ASSERT(ble_hs_hci_test_rx_num_events == 0);
+    TEST_ASSERT(ble_hs_atomic_conn_flags(2, NULL) == 0);
+
+    ble_hs_hci_test_rx_run_evq(&evq);
+
+    TEST_ASSERT_FATAL(ble_hs_hci_test_rx_num_events == num_notify + 1);
+    for (i = 0; i < num_notify; i++) {
+        TEST_ASSERT(ble_hs_hci_test_rx_events[i] ==
+                    BLE_GAP_EVENT_NOTIFY_RX);
+    }
+    TEST_ASSERT(ble_hs_hci_test_rx_events[num_notify] ==
+                BLE_GAP_EVENT_DISCONNECT);
+    TEST_ASSERT(ble_hs_atomic_conn_flags(2, NULL) == BLE_HS_ENOTCONN);
+
+    /* The ring is used again once the overflow queue has drained. */
+    ble_hs_test_util_create_conn(3, peer_addr, ble_hs_hci_test_rx_gap_cb,
+                                 NULL);
+    ble_hs_hci_test_rx_num_events = 0;
+
+    ble_hs_hci_test_rx_notify(3);
+    ble_hs_hci_test_rx_run_evq(&evq);
+    TEST_ASSERT(ble_hs_hci_test_rx_num_events == 1);
+    TEST_ASSERT(ble_hs_hci_test_rx_events[0] == BLE_GAP_EVENT_NOTIFY_RX);
+
+    ble_hs_evq_set(os_eventq_dflt_get());
+}
+
 TEST_SUITE(ble_hs_hci_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
     ble_hs_hci_test_event_bad();
     ble_hs_hci_test_rssi();
+    ble_hs_hci_test_async();
+    ble_hs_hci_test_startup_cached();
+    ble_hs_hci_test_startup_ctlr_changed();
+#if MYNEWT_VAL(BLE_HS_SYNC_TEST_BENCH)
+    ble_hs_hci_test_bench_sync_time();
+#endif
     ble_hs_hci_acl_one_conn();
     ble_hs_hci_acl_two_conn();
+    ble_hs_hci_acl_frag_chain();
+    ble_hs_hci_test_rx_ring_full();
 }
 
 int
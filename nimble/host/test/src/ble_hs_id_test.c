@@ -104,6 +104,70 @@ TEST_CASE(ble_hs_id_test_case_auto_rpa_rnd)
     TEST_ASSERT(own_addr_type == BLE_OWN_ADDR_RPA_RANDOM_DEFAULT);
 }
 
+TEST_CASE(ble_hs_id_test_case_resolve_rpa)
+{
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    ble_addr_t id_addr;
+    ble_addr_t rpa;
+    int rc;
+
+    /* Sample data from the Bluetooth Core Specification (ah function). */
+    static const uint8_t irk[16] = {
+        0x9b, 0x7d, 0x39, 0x0a, 0xa6, 0x10, 0x10, 0x34,
+        0x05, 0xad, 0xc8, 0x57, 0xa3, 0x34, 0x02, 0xec,
+    };
+
+    ble_hs_test_util_init();
+
+    rpa.type = BLE_ADDR_RANDOM;
+    memcpy(rpa.val, ((uint8_t[6]){ 0xaa, 0xfb, 0x0d, 0x94, 0x81, 0x70 }), 6);
+
+    /* Not an RPA. */
+    rc = ble_hs_id_resolve_rpa(BLE_ADDR_ANY, &id_addr);
+    TEST_ASSERT(rc == BLE_HS_EINVAL);
+
+    /* No bonds yet. */
+    rc = ble_hs_id_resolve_rpa(&rpa, &id_addr);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /* Bonding with the peer discards the cached failure. */
+    memset(&value_sec, 0, sizeof value_sec);
+    value_sec.peer_addr.type = BLE_ADDR_PUBLIC;
+    memcpy(value_sec.peer_addr.val, ((uint8_t[6]){ 1, 2, 3, 4, 5, 6 }), 6);
+    value_sec.irk_present = 1;
+    memcpy(value_sec.irk, irk, sizeof irk);
+    rc = ble_store_write(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                         (union ble_store_value *)&value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_id_resolve_rpa(&rpa, &id_addr);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_addr_cmp(&id_addr, &value_sec.peer_addr) == 0);
+
+    /* Cached result. */
+    memset(&id_addr, 0, sizeof id_addr);
+    rc = ble_hs_id_resolve_rpa(&rpa, &id_addr);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(ble_addr_cmp(&id_addr, &value_sec.peer_addr) == 0);
+
+    /* An RPA generated from a different IRK does not resolve. */
+    rpa.val[0] ^= 0x01;
+    rc = ble_hs_id_resolve_rpa(&rpa, NULL);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+    rpa.val[0] ^= 0x01;
+
+    /* Deleting the bond discards the cached success. */
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr = value_sec.peer_addr;
+    rc = ble_store_delete(BLE_STORE_OBJ_TYPE_PEER_SEC,
+                          (union ble_store_key *)&key_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_hs_id_resolve_rpa(&rpa, &id_addr);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+}
+
 TEST_SUITE(ble_hs_id_test_suite_auto)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -113,6 +177,7 @@ TEST_SUITE(ble_hs_id_test_suite_auto)
     ble_hs_id_test_case_auto_random();
     ble_hs_id_test_case_auto_rpa_pub();
     ble_hs_id_test_case_auto_rpa_rnd();
+    ble_hs_id_test_case_resolve_rpa();
 }
 
 int
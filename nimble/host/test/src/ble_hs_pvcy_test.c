@@ -22,6 +22,7 @@
 #include <string.h>
 #include "testutil/testutil.h"
 #include "host/ble_hs_test.h"
+#include "store/config/ble_store_config.h"
 #include "ble_hs_test_util.h"
 
 #define BLE_HS_PVCY_TEST_MAX_GAP_EVENTS 256
@@ -115,6 +116,11 @@ ble_hs_pvcy_test_util_start_host(int num_expected_irks)
     TEST_ASSERT_FATAL(rc == 0);
     ble_hs_test_util_hci_out_clear();
 
+    /* Likewise, forget the controller's capabilities so that they are read
+     * again.
+     */
+    ble_hs_startup_clear_ctlr_info();
+
     ble_hs_test_util_hci_ack_set_startup();
 
     for (i = 0; i < num_expected_irks; i++) {
@@ -450,6 +456,236 @@ TEST_CASE(ble_hs_pvcy_test_case_add_irk_adv_conn)
     ble_hs_pvcy_test_util_all_gap_procs(0, 0, 0);
 }
 
+static const uint8_t ble_hs_pvcy_test_irk1[16] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+};
+static const uint8_t ble_hs_pvcy_test_irk2[16] = {
+    4, 4, 4, 4, 5, 5, 5, 6, 6, 6, 9, 9, 9, 9, 9, 10
+};
+
+static ble_addr_t
+ble_hs_pvcy_test_util_peer_addr(int idx)
+{
+    return (ble_addr_t){ BLE_ADDR_PUBLIC, { idx + 1, 2, 3, 4, 5, 6 } };
+}
+
+/**
+ * Starts the host and adds the specified number of peers to the resolving
+ * list, all with the same IRK.  None of the peers is persisted.
+ */
+static void
+ble_hs_pvcy_test_util_sync_init(int num_peers)
+{
+    ble_addr_t peer_addr;
+    int i;
+
+    ble_hs_pvcy_test_util_init();
+    ble_hs_pvcy_test_util_start_host(0);
+
+    for (i = 0; i < num_peers; i++) {
+        peer_addr = ble_hs_pvcy_test_util_peer_addr(i);
+        ble_hs_pvcy_test_util_add_irk(&peer_addr, ble_hs_pvcy_test_irk1,
+                                      ble_hs_pvcy_default_irk);
+    }
+
+    ble_hs_test_util_hci_out_clear();
+}
+
+/**
+ * Persists a peer IRK without adding it to the resolving list.
+ */
+static void
+ble_hs_pvcy_test_util_store_irk(int peer_idx, const uint8_t *irk)
+{
+    union ble_store_value value;
+    int rc;
+
+    memset(&value, 0, sizeof value);
+    value.sec.peer_addr = ble_hs_pvcy_test_util_peer_addr(peer_idx);
+    value.sec.key_size = 16;
+    memcpy(value.sec.irk, irk, 16);
+    value.sec.irk_present = 1;
+
+    rc = ble_store_config_write(BLE_STORE_OBJ_TYPE_PEER_SEC, &value);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_hs_pvcy_test_util_remove_irk_set_ack(uint8_t status)
+{
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_RMV_RESOLV_LIST), status);
+}
+
+static void
+ble_hs_pvcy_test_util_remove_irk_verify_tx(int peer_idx)
+{
+    ble_addr_t peer_addr;
+    uint8_t param_len;
+    uint8_t *param;
+
+    peer_addr = ble_hs_pvcy_test_util_peer_addr(peer_idx);
+
+    param = ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                           BLE_HCI_OCF_LE_RMV_RESOLV_LIST,
+                                           &param_len);
+    TEST_ASSERT(param_len == BLE_HCI_RMV_FROM_RESOLV_LIST_LEN);
+
+    TEST_ASSERT(param[0] == peer_addr.type);
+    TEST_ASSERT(memcmp(param + 1, peer_addr.val, 6) == 0);
+}
+
+static void
+ble_hs_pvcy_test_util_peer_irk_verify_tx(int peer_idx, const uint8_t *irk)
+{
+    ble_addr_t peer_addr;
+
+    peer_addr = ble_hs_pvcy_test_util_peer_addr(peer_idx);
+    ble_hs_pvcy_test_util_add_irk_verify_tx(&peer_addr, irk,
+                                            ble_hs_pvcy_default_irk);
+}
+
+/**
+ * Verifies that a sync with no changes in the store doesn't talk to the
+ * controller.
+ */
+static void
+ble_hs_pvcy_test_util_sync_verify_idle(void)
+{
+    int rc;
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+}
+
+TEST_CASE(ble_hs_pvcy_test_case_sync_diff)
+{
+    int rc;
+
+    /* List: peers 0 and 1.  Store: peers 0 and 2. */
+    ble_hs_pvcy_test_util_sync_init(2);
+    ble_hs_pvcy_test_util_store_irk(0, ble_hs_pvcy_test_irk1);
+    ble_hs_pvcy_test_util_store_irk(2, ble_hs_pvcy_test_irk1);
+
+    ble_hs_pvcy_test_util_remove_irk_set_ack(0);
+    ble_hs_pvcy_test_util_add_irk_set_acks();
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == 0);
+
+    /* Only the differences are sent; peer 0 is left alone. */
+    ble_hs_pvcy_test_util_remove_irk_verify_tx(1);
+    ble_hs_pvcy_test_util_peer_irk_verify_tx(2, ble_hs_pvcy_test_irk1);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+
+    ble_hs_pvcy_test_util_sync_verify_idle();
+}
+
+TEST_CASE(ble_hs_pvcy_test_case_sync_clear)
+{
+    int rc;
+    int i;
+
+    /*** Removing three entries costs as much as clearing the list and
+     * re-adding the local entry; the entries are removed individually.
+     */
+    ble_hs_pvcy_test_util_sync_init(3);
+
+    for (i = 0; i < 3; i++) {
+        ble_hs_pvcy_test_util_remove_irk_set_ack(0);
+    }
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == 0);
+
+    for (i = 0; i < 3; i++) {
+        ble_hs_pvcy_test_util_remove_irk_verify_tx(i);
+    }
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+
+    ble_hs_pvcy_test_util_sync_verify_idle();
+
+    /*** Removing four entries costs more; the list is cleared instead. */
+    ble_hs_pvcy_test_util_sync_init(4);
+
+    ble_hs_test_util_hci_ack_append(
+        BLE_HCI_OP(BLE_HCI_OGF_LE, BLE_HCI_OCF_LE_CLR_RESOLV_LIST), 0);
+    ble_hs_pvcy_test_util_add_irk_set_acks();
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_test_util_hci_verify_tx(BLE_HCI_OGF_LE,
+                                   BLE_HCI_OCF_LE_CLR_RESOLV_LIST, NULL);
+    ble_hs_pvcy_test_util_add_irk_verify_tx(&(ble_addr_t){ 0 },
+                                            (uint8_t[16]){ 0 },
+                                            ble_hs_pvcy_default_irk);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+
+    ble_hs_pvcy_test_util_sync_verify_idle();
+}
+
+TEST_CASE(ble_hs_pvcy_test_case_sync_irk_change)
+{
+    int rc;
+
+    /* The peer's IRK in the store differs from the one in the list. */
+    ble_hs_pvcy_test_util_sync_init(1);
+    ble_hs_pvcy_test_util_store_irk(0, ble_hs_pvcy_test_irk2);
+
+    ble_hs_pvcy_test_util_remove_irk_set_ack(0);
+    ble_hs_pvcy_test_util_add_irk_set_acks();
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == 0);
+
+    /* The stale entry is replaced. */
+    ble_hs_pvcy_test_util_remove_irk_verify_tx(0);
+    ble_hs_pvcy_test_util_peer_irk_verify_tx(0, ble_hs_pvcy_test_irk2);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+
+    ble_hs_pvcy_test_util_sync_verify_idle();
+}
+
+TEST_CASE(ble_hs_pvcy_test_case_sync_partial_fail)
+{
+    int rc;
+
+    /* List: peers 0 and 1.  Store: peers 2 and 3. */
+    ble_hs_pvcy_test_util_sync_init(2);
+    ble_hs_pvcy_test_util_store_irk(2, ble_hs_pvcy_test_irk1);
+    ble_hs_pvcy_test_util_store_irk(3, ble_hs_pvcy_test_irk1);
+
+    /* All four operations go out in one batch; removing peer 1 fails. */
+    ble_hs_pvcy_test_util_remove_irk_set_ack(0);
+    ble_hs_pvcy_test_util_remove_irk_set_ack(BLE_ERR_UNK_CONN_ID);
+    ble_hs_pvcy_test_util_add_irk_set_acks();
+    ble_hs_pvcy_test_util_add_irk_set_acks();
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == BLE_HS_HCI_ERR(BLE_ERR_UNK_CONN_ID));
+
+    ble_hs_pvcy_test_util_remove_irk_verify_tx(0);
+    ble_hs_pvcy_test_util_remove_irk_verify_tx(1);
+    ble_hs_pvcy_test_util_peer_irk_verify_tx(2, ble_hs_pvcy_test_irk1);
+    ble_hs_pvcy_test_util_peer_irk_verify_tx(3, ble_hs_pvcy_test_irk1);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+
+    /* The host's copy of the list reflects the operations that succeeded;
+     * only the failed removal is retried.
+     */
+    ble_hs_pvcy_test_util_remove_irk_set_ack(0);
+
+    rc = ble_hs_pvcy_sync();
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_pvcy_test_util_remove_irk_verify_tx(1);
+    TEST_ASSERT(ble_hs_test_util_hci_out_first() == NULL);
+
+    ble_hs_pvcy_test_util_sync_verify_idle();
+}
+
 TEST_SUITE(ble_hs_pvcy_test_suite_irk)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -463,10 +699,21 @@ TEST_SUITE(ble_hs_pvcy_test_suite_irk)
     ble_hs_pvcy_test_case_add_irk_adv_conn();
 }
 
+TEST_SUITE(ble_hs_pvcy_test_suite_sync)
+{
+    tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
+
+    ble_hs_pvcy_test_case_sync_diff();
+    ble_hs_pvcy_test_case_sync_clear();
+    ble_hs_pvcy_test_case_sync_irk_change();
+    ble_hs_pvcy_test_case_sync_partial_fail();
+}
+
 int
 ble_hs_pvcy_test_all(void)
 {
     ble_hs_pvcy_test_suite_irk();
+    ble_hs_pvcy_test_suite_sync();
 
     return tu_any_failed;
 }
@@ -46,6 +46,7 @@ main(int argc, char **argv)
     ble_gatts_read_test_suite();
     ble_gatts_reg_test_all();
     ble_hs_adv_test_all();
+    ble_hs_aes_cache_test_all();
     ble_hs_conn_test_all();
     ble_hs_hci_test_all();
     ble_hs_id_test_all();
@@ -39,6 +39,7 @@ struct hci_create_conn;
 #define BLE_HS_TEST_UTIL_PUB_ADDR_VAL { 0x0a, 0x54, 0xab, 0x49, 0x7f, 0x06 }
 
 extern const struct ble_gap_adv_params ble_hs_test_util_adv_params;
+extern const uint8_t ble_hs_test_util_csrk[16];
 
 struct ble_hs_test_util_flat_attr {
     uint16_t handle;
@@ -1538,11 +1538,10 @@ TEST_CASE(ble_sm_sc_peer_nc_iio1_rio1_b1_iat0_rat0_ik5_rk7)
  * Initiator key distribution: 7
  * Responder key distribution: 5
  */
-TEST_CASE(ble_sm_sc_us_jw_iio3_rio4_b1_iat0_rat0_ik7_rk5)
+static void
+ble_sm_sc_test_util_us_jw_params(struct ble_sm_test_params *params)
 {
-    struct ble_sm_test_params params;
-
-    params = (struct ble_sm_test_params) {
+    *params = (struct ble_sm_test_params) {
         .init_id_addr = {
             0x01, 0x01, 0x01, 0x07, 0x08, 0x01,
         },
@@ -1665,6 +1664,13 @@ TEST_CASE(ble_sm_sc_us_jw_iio3_rio4_b1_iat0_rat0_ik7_rk5)
             },
         },
     };
+}
+
+TEST_CASE(ble_sm_sc_us_jw_iio3_rio4_b1_iat0_rat0_ik7_rk5)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
     ble_sm_test_util_us_sc_good(&params);
 }
 
@@ -4876,10 +4882,226 @@ TEST_CASE(ble_sm_sc_us_pk_iio2_rio0_b1_iat2_rat2_ik7_rk3)
     ble_sm_test_util_us_sc_good(&params);
 }
 
+static struct os_eventq ble_sm_sc_test_evq;
+
+/**
+ * Points the host at a private event queue so that key pair requests can be
+ * observed.  The requests are never run; generating a key pair needs a
+ * controller.
+ */
+static void
+ble_sm_sc_test_key_pool_init(void)
+{
+    ble_hs_test_util_init();
+
+    os_eventq_init(&ble_sm_sc_test_evq);
+    ble_hs_evq_set(&ble_sm_sc_test_evq);
+}
+
+static int
+ble_sm_sc_test_key_pool_get(uint8_t *pub)
+{
+    uint8_t priv[32];
+    int rc;
+
+    ble_hs_lock();
+    rc = ble_sm_alg_key_pool_get(pub, priv);
+    ble_hs_unlock();
+
+    return rc;
+}
+
+/**
+ * @return                      The number of key pair generations the pool
+ *                                  requested from the host task.
+ */
+static int
+ble_sm_sc_test_key_pool_num_requests(void)
+{
+    int count;
+
+    count = 0;
+    while (os_eventq_get_no_wait(&ble_sm_sc_test_evq) != NULL) {
+        count++;
+    }
+
+    return count;
+}
+
+TEST_CASE(ble_sm_sc_test_key_pool_max_uses)
+{
+    uint8_t pub_a[64];
+    uint8_t pub_b[64];
+    uint8_t priv[32];
+    uint8_t pub[64];
+    int rc;
+    int i;
+
+    ble_sm_sc_test_key_pool_init();
+
+    memset(pub_a, 0xaa, sizeof pub_a);
+    memset(pub_b, 0xbb, sizeof pub_b);
+    memset(priv, 0x11, sizeof priv);
+
+    rc = ble_sm_dbg_key_pool_add(pub_a, priv);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_sm_dbg_key_pool_add(pub_b, priv);
+    TEST_ASSERT_FATAL(rc == 0);
+    rc = ble_sm_dbg_key_pool_add(pub_b, priv);
+    TEST_ASSERT(rc == BLE_HS_ENOMEM);
+
+    /* Pairs are handed out round-robin until each has been used
+     * BLE_SM_SC_KEY_MAX_USES times.
+     */
+    for (i = 0; i < MYNEWT_VAL(BLE_SM_SC_KEY_MAX_USES); i++) {
+        rc = ble_sm_sc_test_key_pool_get(pub);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(pub, pub_a, sizeof pub) == 0);
+
+        rc = ble_sm_sc_test_key_pool_get(pub);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(pub, pub_b, sizeof pub) == 0);
+    }
+
+#if !MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    /* No speculative refill on the host task. */
+    TEST_ASSERT(ble_sm_sc_test_key_pool_num_requests() == 0);
+#endif
+
+    /* Both pairs are used up; the caller has to wait for a new one. */
+    rc = ble_sm_sc_test_key_pool_get(pub);
+    TEST_ASSERT(rc == BLE_HS_EAGAIN);
+
+#if !MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    TEST_ASSERT(ble_sm_sc_test_key_pool_num_requests() == 1);
+#endif
+
+    /* Retired slots can be refilled. */
+    rc = ble_sm_dbg_key_pool_add(pub_a, priv);
+    TEST_ASSERT(rc == 0);
+
+    ble_hs_evq_set(os_eventq_dflt_get());
+}
+
+TEST_CASE(ble_sm_sc_test_key_pool_lifetime)
+{
+    uint8_t pub_a[64];
+    uint8_t priv[32];
+    uint8_t pub[64];
+    int rc;
+
+    ble_sm_sc_test_key_pool_init();
+
+    memset(pub_a, 0xaa, sizeof pub_a);
+    memset(priv, 0x11, sizeof priv);
+
+    rc = ble_sm_dbg_key_pool_add(pub_a, priv);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    rc = ble_sm_sc_test_key_pool_get(pub);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(pub, pub_a, sizeof pub) == 0);
+
+    /* Still valid one tick before it expires. */
+    os_time_advance(MYNEWT_VAL(BLE_SM_SC_KEY_LIFETIME) * OS_TICKS_PER_SEC -
+                    1);
+    rc = ble_sm_sc_test_key_pool_get(pub);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(pub, pub_a, sizeof pub) == 0);
+
+    /* Expired pairs are discarded even though they have uses left. */
+    os_time_advance(1);
+    rc = ble_sm_sc_test_key_pool_get(pub);
+    TEST_ASSERT(rc == BLE_HS_EAGAIN);
+
+#if !MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    TEST_ASSERT(ble_sm_sc_test_key_pool_num_requests() == 1);
+#endif
+
+    ble_hs_evq_set(os_eventq_dflt_get());
+}
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+
+/*** DHKey computed by the ECC task before the peer's random arrives. */
+TEST_CASE(ble_sm_sc_test_dhkey_job_before_random)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
+    ble_sm_test_util_us_sc_dhkey_job(&params,
+                                     BLE_SM_TEST_UTIL_DHKEY_BEFORE_RANDOM);
+}
+
+/*** Peer's random arrives first; the procedure resumes with the DHKey. */
+TEST_CASE(ble_sm_sc_test_dhkey_job_after_random)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
+    ble_sm_test_util_us_sc_dhkey_job(&params,
+                                     BLE_SM_TEST_UTIL_DHKEY_AFTER_RANDOM);
+}
+
+/*** DHKey computation fails; pairing fails with a DHKey check error. */
+TEST_CASE(ble_sm_sc_test_dhkey_job_fail)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
+    ble_sm_test_util_us_sc_dhkey_job(&params, BLE_SM_TEST_UTIL_DHKEY_FAIL);
+}
+
+/*** Procedure times out while the DHKey is computed. */
+TEST_CASE(ble_sm_sc_test_dhkey_job_timeout)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
+    ble_sm_test_util_us_sc_dhkey_job(&params,
+                                     BLE_SM_TEST_UTIL_DHKEY_AFTER_TIMEOUT);
+}
+
+/*** Connection drops while the DHKey is computed. */
+TEST_CASE(ble_sm_sc_test_dhkey_job_disconnect)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
+    ble_sm_test_util_us_sc_dhkey_job(&params,
+                                     BLE_SM_TEST_UTIL_DHKEY_AFTER_DISCONNECT);
+}
+
+/*** A new procedure with the same keys ignores the old procedure's DHKey. */
+TEST_CASE(ble_sm_sc_test_dhkey_job_restart)
+{
+    struct ble_sm_test_params params;
+
+    ble_sm_sc_test_util_us_jw_params(&params);
+    ble_sm_test_util_us_sc_dhkey_job(&params,
+                                     BLE_SM_TEST_UTIL_DHKEY_AFTER_RESTART);
+}
+
+#endif
+
 TEST_SUITE(ble_sm_sc_test_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
 
+    /*** Key pool policy. */
+    ble_sm_sc_test_key_pool_max_uses();
+    ble_sm_sc_test_key_pool_lifetime();
+
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+    /*** DHKey computed by the ECC task. */
+    ble_sm_sc_test_dhkey_job_before_random();
+    ble_sm_sc_test_dhkey_job_after_random();
+    ble_sm_sc_test_dhkey_job_fail();
+    ble_sm_sc_test_dhkey_job_timeout();
+    ble_sm_sc_test_dhkey_job_disconnect();
+    ble_sm_sc_test_dhkey_job_restart();
+#endif
+
     /*** No privacy. */
 
     /* Peer as initiator. */
@@ -134,6 +134,65 @@ TEST_CASE(ble_sm_test_case_g2)
 	TEST_ASSERT(val == exp_val);
 }
 
+TEST_CASE(ble_sm_test_case_sign)
+{
+    uint8_t exp_mac[8] = { 0x21, 0x7b, 0x14, 0x9a, 0x70, 0xbe, 0x96, 0x1d };
+    uint8_t pdu[1 + 2 + 40 + 4];
+    uint8_t mac[8];
+    struct os_mbuf *frag;
+    struct os_mbuf *om;
+    int off;
+    int len;
+    int rc;
+    int i;
+
+    /* Signed write: handle 3, value 0..39, SignCounter 1. */
+    pdu[0] = BLE_ATT_OP_SIGNED_WRITE_CMD;
+    put_le16(pdu + 1, 3);
+    for (i = 0; i < 40; i++) {
+        pdu[3 + i] = i;
+    }
+    put_le32(pdu + 43, 1);
+
+    /* Contiguous PDU, opcode included. */
+    om = ble_hs_mbuf_from_flat(pdu, sizeof pdu);
+    TEST_ASSERT_FATAL(om != NULL);
+
+    rc = ble_sm_alg_sign(ble_hs_test_util_csrk, pdu[0], om, 1,
+                         sizeof pdu - 1, mac);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(mac, exp_mac, sizeof mac) == 0);
+    os_mbuf_free_chain(om);
+
+    /* Opcode stripped; the rest split into fragments that don't line up with
+     * AES blocks.
+     */
+    om = NULL;
+    for (off = 1; off < sizeof pdu; off += len) {
+        len = min(7, sizeof pdu - off);
+        frag = ble_hs_mbuf_from_flat(pdu + off, len);
+        TEST_ASSERT_FATAL(frag != NULL);
+        if (om == NULL) {
+            om = frag;
+        } else {
+            os_mbuf_concat(om, frag);
+        }
+    }
+
+    rc = ble_sm_alg_sign(ble_hs_test_util_csrk, pdu[0], om, 0,
+                         sizeof pdu - 1, mac);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(mac, exp_mac, sizeof mac) == 0);
+
+    /* Any change to the message changes the MAC. */
+    rc = ble_sm_alg_sign(ble_hs_test_util_csrk, BLE_ATT_OP_WRITE_CMD, om, 0,
+                         sizeof pdu - 1, mac);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(mac, exp_mac, sizeof mac) != 0);
+
+    os_mbuf_free_chain(om);
+}
+
 TEST_CASE(ble_sm_test_case_conn_broken)
 {
     struct hci_disconn_complete disconn_evt;
@@ -385,6 +444,7 @@ TEST_SUITE(ble_sm_gen_test_suite)
     ble_sm_test_case_f5();
     ble_sm_test_case_f6();
     ble_sm_test_case_g2();
+    ble_sm_test_case_sign();
 
     ble_sm_test_case_peer_fail_inval();
     ble_sm_test_case_peer_lgcy_fail_confirm();
@@ -401,10 +461,27 @@ ble_sm_test_all(void)
 #if !NIMBLE_BLE_SM
     return 0;
 #else
+#if MYNEWT_VAL(BLE_SM_TEST_BENCH)
+    struct ble_sm_test_util_bench bench;
+#endif
+
     ble_sm_gen_test_suite();
+
+#if MYNEWT_VAL(BLE_SM_TEST_BENCH)
+    /* Every successful pairing in the legacy and secure connections suites
+     * also serves as a benchmark sample.
+     */
+    ble_sm_test_util_bench_start(&bench);
+#endif
+
     ble_sm_lgcy_test_suite();
     ble_sm_sc_test_suite();
 
+#if MYNEWT_VAL(BLE_SM_TEST_BENCH)
+    ble_sm_test_util_bench_stop();
+    ble_sm_test_util_bench_report(&bench);
+#endif
+
     return tu_any_failed;
 #endif
 }
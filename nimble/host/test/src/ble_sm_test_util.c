@@ -18,6 +18,7 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include "testutil/testutil.h"
@@ -85,6 +86,298 @@ struct ble_sm_test_util_entity {
 static void ble_sm_test_util_repeat_pairing(struct ble_sm_test_params *params,
                                             int sc);
 
+/* Guard left unpainted below the painting function's frame, in stack words. */
+#define BLE_SM_TEST_UTIL_BENCH_STACK_GUARD  64
+
+/**
+ * Pairing benchmark.  While a benchmark is running, the successful pairing
+ * flows below record the CPU time spent inside the host's security manager
+ * entry points, split by pairing phase, along with the deepest stack use and
+ * the most msys blocks in use, separately for each pairing method.  Time the
+ * test spends building and verifying packets is not counted.  Store writes
+ * are charged to their own phase wherever they occur.
+ */
+static struct ble_sm_test_util_bench *ble_sm_test_util_bench_cur;
+static struct ble_sm_test_util_bench_method *ble_sm_test_util_bench_meth;
+static int ble_sm_test_util_bench_phase;
+static int ble_sm_test_util_bench_store_prev;
+static int ble_sm_test_util_bench_entered;
+static clock_t ble_sm_test_util_bench_phase_start;
+static os_stack_t *ble_sm_test_util_bench_stack_bottom;
+static os_stack_t *ble_sm_test_util_bench_stack_top;
+
+static const char *const
+ble_sm_test_util_bench_phase_names[BLE_SM_TEST_UTIL_PHASE_CNT] = {
+    [BLE_SM_TEST_UTIL_PHASE_FEATURES]   = "features",
+    [BLE_SM_TEST_UTIL_PHASE_ECDH]       = "ecdh",
+    [BLE_SM_TEST_UTIL_PHASE_CONFIRM]    = "confirm",
+    [BLE_SM_TEST_UTIL_PHASE_ENCRYPT]    = "encrypt",
+    [BLE_SM_TEST_UTIL_PHASE_KEY_DIST]   = "key_dist",
+    [BLE_SM_TEST_UTIL_PHASE_STORE]      = "store",
+};
+
+static const char *const
+ble_sm_test_util_bench_method_names[BLE_SM_TEST_UTIL_BENCH_NUM_METHODS] = {
+    [BLE_SM_PAIR_ALG_JW]                = "legacy just works",
+    [BLE_SM_PAIR_ALG_PASSKEY]           = "legacy passkey",
+    [BLE_SM_PAIR_ALG_OOB]               = "legacy oob",
+    [4 + BLE_SM_PAIR_ALG_JW]            = "sc just works",
+    [4 + BLE_SM_PAIR_ALG_PASSKEY]       = "sc passkey",
+    [4 + BLE_SM_PAIR_ALG_OOB]           = "sc oob",
+    [4 + BLE_SM_PAIR_ALG_NUMCMP]        = "sc numeric comparison",
+};
+
+/**
+ * Refills the unused part of the current task's stack, from its bottom up to
+ * a guard region below the caller's frame, with the pattern the OS fills new
+ * task stacks with.  Stack use is not measured if there is no current task.
+ */
+static void
+ble_sm_test_util_bench_stack_paint(void)
+{
+    struct os_task *t;
+    os_stack_t *top;
+    os_stack_t *p;
+
+    ble_sm_test_util_bench_stack_bottom = NULL;
+
+    t = os_sched_get_current_task();
+    if (t == NULL) {
+        return;
+    }
+
+    top = (os_stack_t *)__builtin_frame_address(0) -
+          BLE_SM_TEST_UTIL_BENCH_STACK_GUARD;
+    if (top <= t->t_stackbottom ||
+        top >= t->t_stackbottom + t->t_stacksize) {
+
+        return;
+    }
+
+    for (p = t->t_stackbottom; p < top; p++) {
+        *p = OS_STACK_PATTERN;
+    }
+
+    ble_sm_test_util_bench_stack_bottom = t->t_stackbottom;
+    ble_sm_test_util_bench_stack_top = top;
+}
+
+/**
+ * Returns the number of bytes of stack used below the frame of the function
+ * that painted it, scanning up from the stack bottom the way the OS computes
+ * a task's stack high-water mark.
+ */
+static int
+ble_sm_test_util_bench_stack_used(void)
+{
+    const volatile os_stack_t *p;
+
+    if (ble_sm_test_util_bench_stack_bottom == NULL) {
+        return 0;
+    }
+
+    p = ble_sm_test_util_bench_stack_bottom;
+    while (p < ble_sm_test_util_bench_stack_top && *p == OS_STACK_PATTERN) {
+        p++;
+    }
+
+    return (ble_sm_test_util_bench_stack_top - p +
+            BLE_SM_TEST_UTIL_BENCH_STACK_GUARD) * sizeof (os_stack_t);
+}
+
+/**
+ * Charges the time since the last checkpoint to the current phase.  Only
+ * called while inside an SM entry point.
+ */
+static void
+ble_sm_test_util_bench_charge(void)
+{
+    clock_t now;
+
+    now = clock();
+    ble_sm_test_util_bench_meth->phase_clocks[ble_sm_test_util_bench_phase] +=
+        now - ble_sm_test_util_bench_phase_start;
+    ble_sm_test_util_bench_phase_start = now;
+}
+
+/**
+ * Selects the phase that subsequent SM entry points are charged to.
+ */
+static void
+ble_sm_test_util_bench_mark(int phase)
+{
+    if (ble_sm_test_util_bench_meth == NULL) {
+        return;
+    }
+
+    ble_sm_test_util_bench_phase = phase;
+}
+
+/**
+ * Called immediately before the test hands control to the host (an incoming
+ * SM or HCI message, an I/O injection or a security initiation).
+ */
+static void
+ble_sm_test_util_bench_enter(void)
+{
+    if (ble_sm_test_util_bench_meth == NULL) {
+        return;
+    }
+
+    ble_sm_test_util_bench_entered = 1;
+    ble_sm_test_util_bench_phase_start = clock();
+}
+
+/**
+ * Called immediately after the host returns control to the test.
+ */
+static void
+ble_sm_test_util_bench_exit(void)
+{
+    struct ble_sm_test_util_bench_method *meth;
+    int used;
+
+    meth = ble_sm_test_util_bench_meth;
+    if (meth == NULL) {
+        return;
+    }
+
+    ble_sm_test_util_bench_charge();
+    ble_sm_test_util_bench_entered = 0;
+
+    used = os_msys_count() - os_msys_num_free();
+    if (used > meth->max_msys_used) {
+        meth->max_msys_used = used;
+    }
+}
+
+static void
+ble_sm_test_util_bench_begin(const struct ble_sm_test_params *params)
+{
+    int sc;
+
+    if (ble_sm_test_util_bench_cur == NULL) {
+        return;
+    }
+
+    sc = params->pair_req.authreq & BLE_SM_PAIR_AUTHREQ_SC &&
+         params->pair_rsp.authreq & BLE_SM_PAIR_AUTHREQ_SC;
+
+    ble_sm_test_util_bench_meth =
+        ble_sm_test_util_bench_cur->methods + sc * 4 + params->pair_alg;
+
+    ble_sm_test_util_bench_stack_paint();
+    ble_sm_test_util_bench_entered = 0;
+    ble_sm_test_util_bench_phase = BLE_SM_TEST_UTIL_PHASE_FEATURES;
+}
+
+static void
+ble_sm_test_util_bench_end(void)
+{
+    struct ble_sm_test_util_bench_method *meth;
+    int used;
+
+    meth = ble_sm_test_util_bench_meth;
+    if (meth == NULL) {
+        return;
+    }
+
+    meth->num_pairings++;
+
+    used = ble_sm_test_util_bench_stack_used();
+    if (used > meth->max_stack) {
+        meth->max_stack = used;
+    }
+
+    ble_sm_test_util_bench_meth = NULL;
+}
+
+/**
+ * Starts recording pairing statistics into the specified benchmark.  Every
+ * successful pairing performed until ble_sm_test_util_bench_stop() is
+ * called contributes to the results.
+ */
+void
+ble_sm_test_util_bench_start(struct ble_sm_test_util_bench *bench)
+{
+    memset(bench, 0, sizeof *bench);
+    ble_sm_test_util_bench_cur = bench;
+    ble_sm_test_util_bench_meth = NULL;
+}
+
+void
+ble_sm_test_util_bench_stop(void)
+{
+    ble_sm_test_util_bench_cur = NULL;
+    ble_sm_test_util_bench_meth = NULL;
+}
+
+/**
+ * Called by the test store around each write so that flash or RAM store
+ * time is reported separately from key distribution.  Writes made outside an
+ * SM entry point are not timed.
+ */
+void
+ble_sm_test_util_bench_store_begin(void)
+{
+    if (ble_sm_test_util_bench_meth == NULL ||
+        !ble_sm_test_util_bench_entered) {
+
+        return;
+    }
+
+    ble_sm_test_util_bench_charge();
+    ble_sm_test_util_bench_store_prev = ble_sm_test_util_bench_phase;
+    ble_sm_test_util_bench_phase = BLE_SM_TEST_UTIL_PHASE_STORE;
+}
+
+void
+ble_sm_test_util_bench_store_end(void)
+{
+    if (ble_sm_test_util_bench_meth == NULL ||
+        !ble_sm_test_util_bench_entered) {
+
+        return;
+    }
+
+    ble_sm_test_util_bench_charge();
+    ble_sm_test_util_bench_phase = ble_sm_test_util_bench_store_prev;
+}
+
+/**
+ * Prints the average time per pairing phase and the peak resource use of
+ * each pairing method the benchmark saw.  Not a pass/fail check.
+ */
+void
+ble_sm_test_util_bench_report(const struct ble_sm_test_util_bench *bench)
+{
+    const struct ble_sm_test_util_bench_method *meth;
+    int phase;
+    int i;
+
+    for (i = 0; i < BLE_SM_TEST_UTIL_BENCH_NUM_METHODS; i++) {
+        meth = bench->methods + i;
+        if (meth->num_pairings == 0) {
+            continue;
+        }
+
+        printf("ble_sm bench: %s: %d pairings; us/pairing:",
+               ble_sm_test_util_bench_method_names[i], meth->num_pairings);
+        for (phase = BLE_SM_TEST_UTIL_PHASE_FEATURES;
+             phase < BLE_SM_TEST_UTIL_PHASE_CNT;
+             phase++) {
+
+            printf(" %s %.0f", ble_sm_test_util_bench_phase_names[phase],
+                   (double)meth->phase_clocks[phase] * 1000000 /
+                   CLOCKS_PER_SEC / meth->num_pairings);
+        }
+        if (meth->max_stack > 0) {
+            printf("; max stack %d B", meth->max_stack);
+        }
+        printf("; max msys blocks %d\n", meth->max_msys_used);
+    }
+}
+
 #define BLE_SM_TEST_UTIL_HCI_HDR(handle, pb, len) \
     ((struct hci_data_hdr) {                            \
         .hdh_handle_pb_bc = ((handle)  << 0) |          \
@@ -696,8 +989,10 @@ ble_sm_test_util_rx_pair_cmd(uint16_t conn_handle, uint8_t op,
 
     ble_sm_pair_cmd_write(v, payload_len, op == BLE_SM_OP_PAIR_REQ, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT(rc == rx_status);
 }
 
@@ -744,8 +1039,10 @@ ble_sm_test_util_rx_confirm(uint16_t conn_handle,
 
     ble_sm_pair_confirm_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == 0);
 }
 
@@ -774,8 +1071,10 @@ ble_sm_test_util_rx_random(uint16_t conn_handle,
 
     ble_sm_pair_random_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -803,8 +1102,10 @@ ble_sm_test_util_rx_sec_req(uint16_t conn_handle, struct ble_sm_sec_req *cmd,
 
     ble_sm_sec_req_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -832,8 +1133,10 @@ ble_sm_test_util_rx_public_key(uint16_t conn_handle,
 
     ble_sm_public_key_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == 0);
 }
 
@@ -862,8 +1165,10 @@ ble_sm_test_util_rx_dhkey_check(uint16_t conn_handle,
 
     ble_sm_dhkey_check_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -892,8 +1197,10 @@ ble_sm_test_util_rx_enc_info(uint16_t conn_handle,
 
     ble_sm_enc_info_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -922,8 +1229,10 @@ ble_sm_test_util_rx_master_id(uint16_t conn_handle,
 
     ble_sm_master_id_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -952,8 +1261,10 @@ ble_sm_test_util_rx_id_info(uint16_t conn_handle,
 
     ble_sm_id_info_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -982,8 +1293,10 @@ ble_sm_test_util_rx_id_addr_info(uint16_t conn_handle,
 
     ble_sm_id_addr_info_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -1012,8 +1325,10 @@ ble_sm_test_util_rx_sign_info(uint16_t conn_handle,
 
     ble_sm_sign_info_write(v, payload_len, cmd);
 
+    ble_sm_test_util_bench_enter();
     rc = ble_hs_test_util_l2cap_rx_first_frag(conn_handle, BLE_L2CAP_CID_SM,
                                               &hci_hdr, om);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == exp_status);
 }
 
@@ -1247,7 +1562,9 @@ ble_sm_test_util_rx_lt_key_req(uint16_t conn_handle, uint64_t r, uint16_t ediv)
     evt.random_number = r;
     evt.encrypted_diversifier = ediv;
 
+    ble_sm_test_util_bench_enter();
     rc = ble_sm_ltk_req_rx(&evt);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT_FATAL(rc == 0);
 }
 
@@ -1313,7 +1630,9 @@ ble_sm_test_util_rx_enc_change(uint16_t conn_handle, uint8_t status,
     evt.encryption_enabled = encryption_enabled;
     evt.connection_handle = conn_handle;
 
+    ble_sm_test_util_bench_enter();
     ble_sm_enc_change_rx(&evt);
+    ble_sm_test_util_bench_exit();
 }
 
 static void
@@ -1375,7 +1694,9 @@ ble_sm_test_util_io_inject(struct ble_sm_test_passkey_info *passkey_info,
         TEST_ASSERT(ble_sm_test_ioact.numcmp == passkey_info->exp_numcmp);
     }
 
+    ble_sm_test_util_bench_enter();
     rc = ble_sm_inject_io(2, &passkey_info->passkey);
+    ble_sm_test_util_bench_exit();
     TEST_ASSERT(rc == 0);
 
     ble_sm_test_ioact.action = BLE_SM_IOACT_NONE;
@@ -2111,6 +2432,8 @@ ble_sm_test_util_us_lgcy_good_once_no_init(
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
+    ble_sm_test_util_bench_begin(params);
+
     ble_hs_test_util_hci_ack_set(
         ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
                                     BLE_HCI_OCF_LE_START_ENCRYPT), 0);
@@ -2118,7 +2441,9 @@ ble_sm_test_util_us_lgcy_good_once_no_init(
         ble_sm_test_util_rx_sec_req(2, &params->sec_req, 0);
     } else {
         /* Initiate the pairing procedure. */
+        ble_sm_test_util_bench_enter();
         rc = ble_gap_security_initiate(2);
+        ble_sm_test_util_bench_exit();
         TEST_ASSERT_FATAL(rc == 0);
     }
 
@@ -2134,6 +2459,8 @@ ble_sm_test_util_us_lgcy_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_CONFIRM);
+
     ble_sm_test_util_io_inject(&params->passkey_info,
                                BLE_SM_PROC_STATE_CONFIRM);
 
@@ -2161,12 +2488,16 @@ ble_sm_test_util_us_lgcy_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_ENCRYPT);
+
     /* Ensure we sent the expected start encryption command. */
     ble_sm_test_util_verify_tx_start_enc(2, 0, 0, params->stk);
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_KEY_DIST);
+
     /* Receive an encryption changed event. */
     ble_sm_test_util_rx_enc_change(2, 0, 1);
 
@@ -2176,6 +2507,8 @@ ble_sm_test_util_us_lgcy_good_once_no_init(
     /* Verify key material gets sent to peer. */
     ble_sm_test_util_verify_tx_keys(params, 1);
 
+    ble_sm_test_util_bench_end();
+
     /* Pairing should now be complete. */
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
@@ -2250,6 +2583,8 @@ ble_sm_test_util_peer_lgcy_good_once_no_init(
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
+    ble_sm_test_util_bench_begin(params);
+
     if (params->sec_req.authreq != 0) {
         rc = ble_sm_slave_initiate(2);
         TEST_ASSERT(rc == 0);
@@ -2270,6 +2605,8 @@ ble_sm_test_util_peer_lgcy_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_CONFIRM);
+
     ble_sm_test_util_io_check_pre(&params->passkey_info,
                                   BLE_SM_PROC_STATE_CONFIRM);
 
@@ -2300,6 +2637,8 @@ ble_sm_test_util_peer_lgcy_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_ENCRYPT);
+
     /* Receive a long term key request from the controller. */
     ble_sm_test_util_set_lt_key_req_reply_ack(0, 2);
     ble_sm_test_util_rx_lt_key_req(2, 0, 0);
@@ -2313,6 +2652,8 @@ ble_sm_test_util_peer_lgcy_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_KEY_DIST);
+
     /* Receive an encryption changed event. */
     ble_sm_test_util_rx_enc_change(2, 0, 1);
 
@@ -2322,6 +2663,8 @@ ble_sm_test_util_peer_lgcy_good_once_no_init(
     /* Receive key material from peer. */
     ble_sm_test_util_rx_keys(params, 0);
 
+    ble_sm_test_util_bench_end();
+
     /* Pairing should now be complete. */
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
@@ -2416,6 +2759,8 @@ ble_sm_test_util_us_sc_good_once_no_init(
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
+    ble_sm_test_util_bench_begin(params);
+
     ble_hs_test_util_hci_ack_set(
         ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
                                     BLE_HCI_OCF_LE_START_ENCRYPT), 0);
@@ -2423,7 +2768,9 @@ ble_sm_test_util_us_sc_good_once_no_init(
         ble_sm_test_util_rx_sec_req(2, &params->sec_req, 0);
     } else {
         /* Initiate the pairing procedure. */
+        ble_sm_test_util_bench_enter();
         rc = ble_gap_security_initiate(2);
+        ble_sm_test_util_bench_exit();
         TEST_ASSERT_FATAL(rc == 0);
     }
 
@@ -2439,6 +2786,8 @@ ble_sm_test_util_us_sc_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_ECDH);
+
     /* Ensure we sent the expected public key. */
     ble_sm_test_util_verify_tx_public_key(our_entity->public_key);
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
@@ -2461,6 +2810,8 @@ ble_sm_test_util_us_sc_good_once_no_init(
         break;
     }
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_CONFIRM);
+
     ble_sm_test_util_io_inject(&params->passkey_info,
                                BLE_SM_PROC_STATE_CONFIRM);
 
@@ -2515,12 +2866,16 @@ ble_sm_test_util_us_sc_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_ENCRYPT);
+
     /* Ensure we sent the expected start encryption command. */
     ble_sm_test_util_verify_tx_start_enc(2, 0, 0, params->ltk);
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_KEY_DIST);
+
     /* Receive an encryption changed event. */
     ble_sm_test_util_rx_enc_change(2, 0, 1);
 
@@ -2530,6 +2885,8 @@ ble_sm_test_util_us_sc_good_once_no_init(
     /* Verify key material gets sent to peer. */
     ble_sm_test_util_verify_tx_keys(params, 1);
 
+    ble_sm_test_util_bench_end();
+
     /* Pairing should now be complete. */
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
@@ -2609,6 +2966,8 @@ ble_sm_test_util_peer_sc_good_once_no_init(
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
+    ble_sm_test_util_bench_begin(params);
+
     if (params->sec_req.authreq != 0) {
         rc = ble_sm_slave_initiate(2);
         TEST_ASSERT(rc == 0);
@@ -2629,6 +2988,8 @@ ble_sm_test_util_peer_sc_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_ECDH);
+
     /* Receive a public key from the peer. */
     ble_sm_test_util_rx_public_key(2, peer_entity->public_key);
     TEST_ASSERT(!conn->bhc_sec_state.encrypted);
@@ -2651,6 +3012,8 @@ ble_sm_test_util_peer_sc_good_once_no_init(
         break;
     }
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_CONFIRM);
+
     ble_sm_test_util_io_check_pre(&params->passkey_info,
                                   BLE_SM_PROC_STATE_CONFIRM);
 
@@ -2714,6 +3077,8 @@ ble_sm_test_util_peer_sc_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_ENCRYPT);
+
     /* Receive a long term key request from the controller. */
     ble_sm_test_util_set_lt_key_req_reply_ack(0, 2);
     ble_sm_test_util_rx_lt_key_req(2, 0, 0);
@@ -2727,6 +3092,8 @@ ble_sm_test_util_peer_sc_good_once_no_init(
     TEST_ASSERT(ble_sm_num_procs() == 1);
     ble_sm_test_util_io_inject_bad(2, params->passkey_info.passkey.action);
 
+    ble_sm_test_util_bench_mark(BLE_SM_TEST_UTIL_PHASE_KEY_DIST);
+
     /* Receive an encryption changed event. */
     ble_sm_test_util_rx_enc_change(2, 0, 1);
 
@@ -2736,6 +3103,8 @@ ble_sm_test_util_peer_sc_good_once_no_init(
     /* Receive key material from peer. */
     ble_sm_test_util_rx_keys(params, 0);
 
+    ble_sm_test_util_bench_end();
+
     /* Pairing should now be complete. */
     TEST_ASSERT(ble_sm_num_procs() == 0);
 
@@ -2770,6 +3139,210 @@ ble_sm_test_util_peer_sc_good_once(struct ble_sm_test_params *params)
         params, conn, &our_entity, &peer_entity);
 }
 
+#if MYNEWT_VAL(BLE_SM_SC_ECC_TASK)
+
+static struct os_eventq ble_sm_test_util_evq;
+
+static ble_sm_proc_flags
+ble_sm_test_util_proc_flags(uint16_t conn_handle)
+{
+    struct ble_sm_proc *proc;
+    ble_sm_proc_flags flags;
+
+    ble_hs_lock();
+    proc = ble_sm_proc_find(conn_handle, BLE_SM_PROC_STATE_NONE, -1, NULL);
+    flags = proc != NULL ? proc->flags : 0;
+    ble_hs_unlock();
+
+    TEST_ASSERT_FATAL(proc != NULL);
+
+    return flags;
+}
+
+/**
+ * Runs the job queued for the ECC task and delivers its result, as the ECC
+ * task and then the host task would.
+ */
+static void
+ble_sm_test_util_ecc_run(int status)
+{
+    struct os_event *ev;
+    int rc;
+
+    rc = ble_sm_dbg_ecc_task_run(status);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ev = os_eventq_get_no_wait(&ble_sm_test_util_evq);
+    TEST_ASSERT_FATAL(ev != NULL);
+    do {
+        ev->ev_cb(ev);
+    } while ((ev = os_eventq_get_no_wait(&ble_sm_test_util_evq)) != NULL);
+}
+
+/**
+ * Performs a just works secure connections pairing as initiator with the
+ * DHKey computed by the ECC task.  The ECC task finishes at the point in the
+ * procedure indicated by `when` (BLE_SM_TEST_UTIL_DHKEY_[...]).
+ */
+void
+ble_sm_test_util_us_sc_dhkey_job(struct ble_sm_test_params *params, int when)
+{
+    struct ble_sm_test_util_entity peer_entity;
+    struct ble_sm_test_util_entity our_entity;
+    struct ble_sm_pair_fail fail;
+    struct ble_hs_conn *conn;
+    int rc;
+
+    TEST_ASSERT_FATAL(params->pair_alg == BLE_SM_PAIR_ALG_JW);
+
+    ble_sm_test_util_init_good(params, 1, &conn, &our_entity, &peer_entity);
+
+    /* Capture the job completions posted to the host. */
+    os_eventq_init(&ble_sm_test_util_evq);
+    ble_hs_evq_set(&ble_sm_test_util_evq);
+    ble_sm_dbg_ecc_task_enable(1);
+
+    ble_hs_test_util_hci_ack_set(
+        ble_hs_hci_util_opcode_join(BLE_HCI_OGF_LE,
+                                    BLE_HCI_OCF_LE_START_ENCRYPT), 0);
+    rc = ble_gap_security_initiate(2);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    ble_sm_test_util_verify_tx_pair_req(our_entity.pair_cmd);
+    ble_sm_test_util_rx_pair_rsp(2, peer_entity.pair_cmd, 0);
+    ble_sm_test_util_verify_tx_public_key(our_entity.public_key);
+
+    /* The peer's public key starts the DHKey computation. */
+    ble_sm_test_util_rx_public_key(2, peer_entity.public_key);
+    TEST_ASSERT(ble_sm_test_util_proc_flags(2) &
+                BLE_SM_PROC_F_DHKEY_PENDING);
+    TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+
+    switch (when) {
+    case BLE_SM_TEST_UTIL_DHKEY_BEFORE_RANDOM:
+        ble_sm_test_util_ecc_run(0);
+        TEST_ASSERT(!(ble_sm_test_util_proc_flags(2) &
+                      BLE_SM_PROC_F_DHKEY_PENDING));
+        TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+        break;
+
+    case BLE_SM_TEST_UTIL_DHKEY_AFTER_RANDOM:
+        break;
+
+    case BLE_SM_TEST_UTIL_DHKEY_FAIL:
+        ble_sm_test_util_ecc_run(BLE_HS_EUNKNOWN);
+
+        fail.reason = BLE_SM_ERR_DHKEY;
+        ble_sm_test_util_verify_tx_pair_fail(&fail);
+        TEST_ASSERT(ble_sm_num_procs() == 0);
+        TEST_ASSERT(ble_sm_test_gap_event_type == BLE_GAP_EVENT_ENC_CHANGE);
+        TEST_ASSERT(ble_sm_test_gap_status ==
+                    BLE_HS_SM_US_ERR(BLE_SM_ERR_DHKEY));
+        TEST_ASSERT(!conn->bhc_sec_state.encrypted);
+        goto done;
+
+    case BLE_SM_TEST_UTIL_DHKEY_AFTER_TIMEOUT:
+        os_time_advance(30 * OS_TICKS_PER_SEC);
+        ble_sm_timer();
+        TEST_ASSERT(ble_sm_num_procs() == 0);
+        TEST_ASSERT(ble_sm_test_gap_status == BLE_HS_ETIMEOUT);
+
+        /* The late result is discarded. */
+        ble_sm_test_util_ecc_run(0);
+        TEST_ASSERT(ble_sm_num_procs() == 0);
+        TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+        goto done;
+
+    case BLE_SM_TEST_UTIL_DHKEY_AFTER_DISCONNECT:
+        ble_hs_test_util_conn_disconnect(2);
+        TEST_ASSERT(ble_sm_num_procs() == 0);
+        TEST_ASSERT(ble_sm_test_gap_status == BLE_HS_ENOTCONN);
+
+        /* The late result is discarded. */
+        ble_sm_test_util_ecc_run(0);
+        TEST_ASSERT(ble_sm_num_procs() == 0);
+        TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+        goto done;
+
+    case BLE_SM_TEST_UTIL_DHKEY_AFTER_RESTART:
+        os_time_advance(30 * OS_TICKS_PER_SEC);
+        ble_sm_timer();
+        TEST_ASSERT(ble_sm_num_procs() == 0);
+        TEST_ASSERT(ble_sm_test_gap_status == BLE_HS_ETIMEOUT);
+
+        /* Pair again with the same keys while the first job is still
+         * queued.
+         */
+        ble_sm_dbg_set_next_pair_rand(our_entity.randoms[0].value);
+        ble_sm_dbg_set_sc_keys((uint8_t *)our_entity.public_key,
+                               params->our_priv_key);
+
+        rc = ble_gap_security_initiate(2);
+        TEST_ASSERT_FATAL(rc == 0);
+
+        ble_sm_test_util_verify_tx_pair_req(our_entity.pair_cmd);
+        ble_sm_test_util_rx_pair_rsp(2, peer_entity.pair_cmd, 0);
+        ble_sm_test_util_verify_tx_public_key(our_entity.public_key);
+        ble_sm_test_util_rx_public_key(2, peer_entity.public_key);
+        TEST_ASSERT(ble_sm_test_util_proc_flags(2) &
+                    BLE_SM_PROC_F_DHKEY_PENDING);
+
+        /* The first job's result has the same connection and peer key but
+         * belongs to the old procedure; it is discarded.
+         */
+        ble_sm_test_util_ecc_run(0);
+        TEST_ASSERT(ble_sm_test_util_proc_flags(2) &
+                    BLE_SM_PROC_F_DHKEY_PENDING);
+        TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+
+        ble_sm_test_util_ecc_run(0);
+        TEST_ASSERT(!(ble_sm_test_util_proc_flags(2) &
+                      BLE_SM_PROC_F_DHKEY_PENDING));
+        TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+        break;
+
+    default:
+        TEST_ASSERT_FATAL(0);
+        break;
+    }
+
+    ble_sm_test_util_rx_confirm(2, peer_entity.confirms);
+    ble_sm_test_util_verify_tx_pair_random(our_entity.randoms);
+    ble_sm_test_util_rx_random(2, peer_entity.randoms, 0);
+
+    if (when == BLE_SM_TEST_UTIL_DHKEY_AFTER_RANDOM) {
+        /* The procedure waits for the DHKey before sending its check. */
+        TEST_ASSERT(ble_sm_test_util_proc_flags(2) &
+                    BLE_SM_PROC_F_DHKEY_WAIT);
+        TEST_ASSERT(ble_hs_test_util_prev_tx_queue_sz() == 0);
+
+        ble_sm_test_util_ecc_run(0);
+        TEST_ASSERT(!(ble_sm_test_util_proc_flags(2) &
+                      (BLE_SM_PROC_F_DHKEY_PENDING |
+                       BLE_SM_PROC_F_DHKEY_WAIT)));
+    }
+
+    ble_sm_test_util_verify_tx_dhkey_check(our_entity.dhkey_check);
+    ble_sm_test_util_rx_dhkey_check(2, peer_entity.dhkey_check, 0);
+    ble_sm_test_util_verify_tx_start_enc(2, 0, 0, params->ltk);
+
+    ble_sm_test_util_rx_enc_change(2, 0, 1);
+    ble_sm_test_util_rx_keys(params, 1);
+    ble_sm_test_util_verify_tx_keys(params, 1);
+
+    TEST_ASSERT(ble_sm_num_procs() == 0);
+    TEST_ASSERT(ble_sm_test_gap_event_type == BLE_GAP_EVENT_ENC_CHANGE);
+    TEST_ASSERT(ble_sm_test_gap_status == 0);
+    TEST_ASSERT(conn->bhc_sec_state.encrypted);
+    ble_sm_test_util_verify_persist(params, 1);
+
+done:
+    ble_sm_dbg_ecc_task_enable(0);
+    ble_hs_evq_set(os_eventq_dflt_get());
+}
+
+#endif
+
 void
 ble_sm_test_util_peer_sc_good(struct ble_sm_test_params *params)
 {
@@ -20,10 +20,34 @@
 #ifndef H_BLE_SM_TEST_UTIL_
 #define H_BLE_SM_TEST_UTIL_
 
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define BLE_SM_TEST_UTIL_PHASE_NONE             0
+#define BLE_SM_TEST_UTIL_PHASE_FEATURES         1
+#define BLE_SM_TEST_UTIL_PHASE_ECDH             2
+#define BLE_SM_TEST_UTIL_PHASE_CONFIRM          3
+#define BLE_SM_TEST_UTIL_PHASE_ENCRYPT          4
+#define BLE_SM_TEST_UTIL_PHASE_KEY_DIST         5
+#define BLE_SM_TEST_UTIL_PHASE_STORE            6
+#define BLE_SM_TEST_UTIL_PHASE_CNT              7
+
+/* When the ECC task completes a DHKey computation, relative to the rest of
+ * the pairing procedure.
+ */
+#define BLE_SM_TEST_UTIL_DHKEY_BEFORE_RANDOM    0
+#define BLE_SM_TEST_UTIL_DHKEY_AFTER_RANDOM     1
+#define BLE_SM_TEST_UTIL_DHKEY_FAIL             2
+#define BLE_SM_TEST_UTIL_DHKEY_AFTER_TIMEOUT    3
+#define BLE_SM_TEST_UTIL_DHKEY_AFTER_DISCONNECT 4
+#define BLE_SM_TEST_UTIL_DHKEY_AFTER_RESTART    5
+
+/* Legacy and secure connections, times the four pairing algorithms. */
+#define BLE_SM_TEST_UTIL_BENCH_NUM_METHODS      8
+
 struct ble_sm_test_passkey_info {
     struct ble_sm_io passkey;
     uint32_t exp_numcmp;
@@ -73,6 +97,18 @@ struct ble_sm_test_params {
     struct ble_sm_master_id master_id_rsp;
 };
 
+struct ble_sm_test_util_bench_method {
+    clock_t phase_clocks[BLE_SM_TEST_UTIL_PHASE_CNT];
+    int num_pairings;
+    int max_stack;
+    int max_msys_used;
+};
+
+struct ble_sm_test_util_bench {
+    struct ble_sm_test_util_bench_method
+        methods[BLE_SM_TEST_UTIL_BENCH_NUM_METHODS];
+};
+
 extern int ble_sm_test_gap_event;
 extern int ble_sm_test_gap_status;
 extern struct ble_gap_sec_state ble_sm_test_sec_state;
@@ -82,6 +118,11 @@ extern union ble_store_key ble_sm_test_store_key;
 extern union ble_store_value ble_sm_test_store_value;
 
 void ble_sm_test_util_init(void);
+void ble_sm_test_util_bench_start(struct ble_sm_test_util_bench *bench);
+void ble_sm_test_util_bench_stop(void);
+void ble_sm_test_util_bench_report(const struct ble_sm_test_util_bench *bench);
+void ble_sm_test_util_bench_store_begin(void);
+void ble_sm_test_util_bench_store_end(void);
 int ble_sm_test_util_conn_cb(struct ble_gap_event *ctxt, void *arg);
 void ble_sm_test_util_io_inject(struct ble_sm_test_passkey_info *passkey_info,
                                 uint8_t cur_sm_state);
@@ -120,6 +161,8 @@ void ble_sm_test_util_peer_bonding_bad(uint16_t ediv, uint64_t rand_num);
 void ble_sm_test_util_peer_sc_good(struct ble_sm_test_params *params);
 void ble_sm_test_util_us_sc_good(struct ble_sm_test_params *params);
 void ble_sm_test_util_us_fail_inval(struct ble_sm_test_params *params);
+void ble_sm_test_util_us_sc_dhkey_job(struct ble_sm_test_params *params,
+                                      int when);
 
 #ifdef __cplusplus
 }
@@ -17,10 +17,19 @@
  * under the License.
  */
 
+#include <stdio.h>
+#include <string.h>
 #include "testutil/testutil.h"
 #include "host/ble_hs_test.h"
 #include "ble_hs_test_util.h"
 
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
+#include <stdlib.h>
+#include "config/config.h"
+#include "config/config_store.h"
+#include "base64/base64.h"
+#endif
+
 static struct ble_store_status_event ble_store_test_status_event;
 
 static void
@@ -415,6 +424,596 @@ TEST_CASE(ble_store_test_clear)
     TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_CCCD) == 0);
 }
 
+struct ble_store_test_cccd_set {
+    struct ble_store_value_cccd cccds[5];
+    int num_cccds;
+};
+
+static int
+ble_store_test_util_iter_cccd(int obj_type, union ble_store_value *val,
+                              void *cookie)
+{
+    struct ble_store_test_cccd_set *set;
+
+    TEST_ASSERT(obj_type == BLE_STORE_OBJ_TYPE_CCCD);
+
+    set = cookie;
+    TEST_ASSERT_FATAL(set->num_cccds < 5);
+    set->cccds[set->num_cccds++] = val->cccd;
+
+    return 0;
+}
+
+TEST_CASE(ble_store_test_index)
+{
+    struct ble_store_value_sec secs[3] = {
+        {
+            .peer_addr = { BLE_ADDR_PUBLIC,     { 1, 2, 3, 4, 5, 6 } },
+            .ediv = 0x1234,
+            .rand_num = 0x1122334455667788,
+            .ltk_present = 1,
+        },
+        {
+            .peer_addr = { BLE_ADDR_RANDOM,     { 1, 2, 3, 4, 5, 6 } },
+            .ediv = 0x1234,
+            .rand_num = 0x8877665544332211,
+            .ltk_present = 1,
+        },
+        {
+            .peer_addr = { BLE_ADDR_PUBLIC,     { 2, 3, 4, 5, 6, 7 } },
+            .ediv = 0x4321,
+            .rand_num = 0x1122334455667788,
+            .ltk_present = 1,
+        },
+    };
+    struct ble_store_value_cccd cccds[5] = {
+        { .peer_addr = secs[0].peer_addr, .chr_val_handle = 5 },
+        { .peer_addr = secs[0].peer_addr, .chr_val_handle = 8 },
+        { .peer_addr = secs[1].peer_addr, .chr_val_handle = 5 },
+        { .peer_addr = secs[2].peer_addr, .chr_val_handle = 8 },
+        { .peer_addr = secs[2].peer_addr, .chr_val_handle = 5 },
+    };
+    struct ble_store_test_cccd_set found;
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_cccd key_cccd;
+    struct ble_store_key_sec key_sec;
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+
+    for (i = 0; i < sizeof secs / sizeof secs[0]; i++) {
+        rc = ble_store_write_peer_sec(secs + i);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+    for (i = 0; i < sizeof cccds / sizeof cccds[0]; i++) {
+        rc = ble_store_write_cccd(cccds + i);
+        TEST_ASSERT_FATAL(rc == 0);
+    }
+
+    /*** Lookups by EDIV and rand only match both fields. */
+    memset(&key_sec, 0, sizeof key_sec);
+    key_sec.peer_addr = *BLE_ADDR_ANY;
+    key_sec.ediv = secs[1].ediv;
+    key_sec.rand_num = secs[1].rand_num;
+    key_sec.ediv_rand_present = 1;
+
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(&value_sec, secs + 1, sizeof value_sec) == 0);
+
+    key_sec.ediv = 0x4321;
+    key_sec.rand_num = secs[1].rand_num;
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    TEST_ASSERT(rc == BLE_HS_ENOENT);
+
+    /*** Iteration visits matches in insertion order. */
+    memset(&key_cccd, 0, sizeof key_cccd);
+    key_cccd.peer_addr = *BLE_ADDR_ANY;
+    key_cccd.chr_val_handle = 5;
+
+    found.num_cccds = 0;
+    rc = ble_store_iterate_cccd(&key_cccd, ble_store_test_util_iter_cccd,
+                                &found);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(found.num_cccds == 3);
+    TEST_ASSERT(memcmp(found.cccds + 0, cccds + 0, sizeof *cccds) == 0);
+    TEST_ASSERT(memcmp(found.cccds + 1, cccds + 2, sizeof *cccds) == 0);
+    TEST_ASSERT(memcmp(found.cccds + 2, cccds + 4, sizeof *cccds) == 0);
+
+    /*** Indices remain consistent after a deletion shifts entries. */
+    rc = ble_store_util_delete_peer(&secs[0].peer_addr);
+    TEST_ASSERT_FATAL(rc == 0);
+
+    found.num_cccds = 0;
+    rc = ble_store_iterate_cccd(&key_cccd, ble_store_test_util_iter_cccd,
+                                &found);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT_FATAL(found.num_cccds == 2);
+    TEST_ASSERT(memcmp(found.cccds + 0, cccds + 2, sizeof *cccds) == 0);
+    TEST_ASSERT(memcmp(found.cccds + 1, cccds + 4, sizeof *cccds) == 0);
+
+    key_sec.ediv = secs[2].ediv;
+    key_sec.rand_num = secs[2].rand_num;
+    rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(&value_sec, secs + 2, sizeof value_sec) == 0);
+
+    key_cccd.peer_addr = secs[2].peer_addr;
+    key_cccd.chr_val_handle = 0;
+    key_cccd.idx = 1;
+    rc = ble_store_read_cccd(&key_cccd, &found.cccds[0]);
+    TEST_ASSERT_FATAL(rc == 0);
+    TEST_ASSERT(memcmp(found.cccds + 0, cccds + 4, sizeof *cccds) == 0);
+}
+
+/* Lock statistics are disabled in this package; the enabled behavior is
+ * covered by nimble/host/test-lock-stats.
+ */
+TEST_CASE(ble_store_test_lock_stats)
+{
+    struct ble_hs_lock_stats stats;
+
+    TEST_ASSERT(ble_hs_lock_stats_get(0, &stats) == BLE_HS_ENOTSUP);
+}
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
+
+#define BLE_STORE_TEST_NUM_BONDS    MYNEWT_VAL(BLE_STORE_MAX_BONDS)
+
+static struct ble_store_value_sec
+    ble_store_test_legacy_secs[BLE_STORE_TEST_NUM_BONDS];
+
+static void
+ble_store_test_util_conf_set(const char *name, const char *val)
+{
+    char name_buf[32];
+    char val_buf[BASE64_ENCODE_SIZE(sizeof ble_store_test_legacy_secs) + 1];
+    int rc;
+
+    strcpy(name_buf, name);
+    if (val != NULL) {
+        strcpy(val_buf, val);
+    }
+
+    rc = conf_set_value(name_buf, val != NULL ? val_buf : NULL);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+static void
+ble_store_test_util_conf_set_record(int slot, const char *val)
+{
+    char name[32];
+
+    sprintf(name, "ble_hs/peer_sec/%d", slot);
+    ble_store_test_util_conf_set(name, val);
+}
+
+/**
+ * Simulates a reset: forgets the entries loaded into RAM without touching
+ * persistent storage.  Assumes the entries occupy the lowest record slots.
+ */
+static void
+ble_store_test_util_conf_forget(void)
+{
+    int i;
+
+    for (i = 0; i < BLE_STORE_TEST_NUM_BONDS; i++) {
+        ble_store_test_util_conf_set_record(i, NULL);
+    }
+    TEST_ASSERT_FATAL(ble_store_test_util_count(
+                          BLE_STORE_OBJ_TYPE_PEER_SEC) == 0);
+}
+
+static void
+ble_store_test_util_conf_verify(void)
+{
+    struct ble_store_value_sec value_sec;
+    struct ble_store_key_sec key_sec;
+    int rc;
+    int i;
+
+    TEST_ASSERT(ble_store_test_util_count(BLE_STORE_OBJ_TYPE_PEER_SEC) ==
+                BLE_STORE_TEST_NUM_BONDS);
+
+    for (i = 0; i < BLE_STORE_TEST_NUM_BONDS; i++) {
+        ble_store_key_from_value_sec(&key_sec, ble_store_test_legacy_secs + i);
+        rc = ble_store_read_peer_sec(&key_sec, &value_sec);
+        TEST_ASSERT_FATAL(rc == 0);
+        TEST_ASSERT(memcmp(value_sec.ltk, ble_store_test_legacy_secs[i].ltk,
+                           sizeof value_sec.ltk) == 0);
+    }
+}
+
+TEST_CASE(ble_store_test_legacy_migration)
+{
+    char records[BLE_STORE_TEST_NUM_BONDS][
+        BASE64_ENCODE_SIZE(sizeof (struct ble_store_value_sec)) + 1];
+    char legacy[BASE64_ENCODE_SIZE(sizeof ble_store_test_legacy_secs) + 1];
+    int rc;
+    int i;
+
+    ble_hs_test_util_init();
+
+    /* Fill the store to capacity; the bug this guards against loses bonds
+     * whenever the legacy array is more than half full.
+     */
+    memset(ble_store_test_legacy_secs, 0, sizeof ble_store_test_legacy_secs);
+    for (i = 0; i < BLE_STORE_TEST_NUM_BONDS; i++) {
+        ble_store_test_legacy_secs[i].peer_addr =
+            (ble_addr_t){ BLE_ADDR_PUBLIC, { i + 1, 2, 3, 4, 5, 6 } };
+        ble_store_test_legacy_secs[i].key_size = 16;
+        memset(ble_store_test_legacy_secs[i].ltk, i + 0x10, 16);
+        ble_store_test_legacy_secs[i].ltk_present = 1;
+
+        base64_encode(ble_store_test_legacy_secs + i,
+                      sizeof ble_store_test_legacy_secs[i], records[i], 1);
+    }
+    base64_encode(ble_store_test_legacy_secs,
+                  sizeof ble_store_test_legacy_secs, legacy, 1);
+
+    /*** First boot after the upgrade: only the legacy array exists. */
+    ble_store_test_util_conf_set("ble_hs/peer_sec", legacy);
+    rc = conf_commit("ble_hs");
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_conf_verify();
+
+    /*** Second boot: the log replays the array, the records it was converted
+     * to, and finally the deletion of the array.
+     */
+    ble_store_test_util_conf_forget();
+    ble_store_test_util_conf_set("ble_hs/peer_sec", legacy);
+    for (i = 0; i < BLE_STORE_TEST_NUM_BONDS; i++) {
+        ble_store_test_util_conf_set_record(i, records[i]);
+    }
+    ble_store_test_util_conf_set("ble_hs/peer_sec", NULL);
+    rc = conf_commit("ble_hs");
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_conf_verify();
+
+    /*** Conversion interrupted before the array was deleted; the log was
+     * compacted so the records precede the array.
+     */
+    ble_store_test_util_conf_forget();
+    ble_store_test_util_conf_set_record(0, records[0]);
+    ble_store_test_util_conf_set("ble_hs/peer_sec", legacy);
+    rc = conf_commit("ble_hs");
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_conf_verify();
+
+    /*** A record for a bond created after the conversion displaces a stale
+     * legacy entry rather than being dropped.
+     */
+    ble_store_test_util_conf_forget();
+    ble_store_test_util_conf_set("ble_hs/peer_sec", legacy);
+    ble_store_test_legacy_secs[0].peer_addr.val[0] = 0xaa;
+    base64_encode(ble_store_test_legacy_secs,
+                  sizeof ble_store_test_legacy_secs[0], records[0], 1);
+    ble_store_test_util_conf_set_record(0, records[0]);
+    for (i = 1; i < BLE_STORE_TEST_NUM_BONDS; i++) {
+        ble_store_test_util_conf_set_record(i, records[i]);
+    }
+    ble_store_test_util_conf_set("ble_hs/peer_sec", NULL);
+    rc = conf_commit("ble_hs");
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_conf_verify();
+}
+
+#if MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_FLUSH_DELAY) > 0
+
+#define BLE_STORE_TEST_CCCD_PREFIX  "ble_hs/cccd/"
+
+/** The CCCD records written to persistent storage, by slot. */
+static struct {
+    struct ble_store_value_cccd value;
+    int num_saves;
+    int present;
+} ble_store_test_cccd_records[MYNEWT_VAL(BLE_STORE_MAX_CCCDS)];
+
+/** Number of upcoming CCCD record writes that fail. */
+static int ble_store_test_cccd_save_fail;
+
+static int
+ble_store_test_conf_load(struct conf_store *cs, load_cb cb, void *cb_arg)
+{
+    return 0;
+}
+
+/**
+ * Config destination standing in for flash; records each CCCD record the
+ * store writes.
+ */
+static int
+ble_store_test_conf_save(struct conf_store *cs, const char *name,
+                         const char *value)
+{
+    int slot;
+    int rc;
+
+    if (strncmp(name, BLE_STORE_TEST_CCCD_PREFIX,
+                strlen(BLE_STORE_TEST_CCCD_PREFIX)) != 0) {
+
+        return 0;
+    }
+
+    if (ble_store_test_cccd_save_fail > 0) {
+        ble_store_test_cccd_save_fail--;
+        return OS_EINVAL;
+    }
+
+    slot = atoi(name + strlen(BLE_STORE_TEST_CCCD_PREFIX));
+    TEST_ASSERT_FATAL(slot >= 0 && slot < MYNEWT_VAL(BLE_STORE_MAX_CCCDS));
+
+    if (value == NULL) {
+        ble_store_test_cccd_records[slot].present = 0;
+    } else {
+        rc = base64_decode(value, &ble_store_test_cccd_records[slot].value);
+        TEST_ASSERT_FATAL(rc == sizeof (struct ble_store_value_cccd));
+        ble_store_test_cccd_records[slot].present = 1;
+        ble_store_test_cccd_records[slot].num_saves++;
+    }
+
+    return 0;
+}
+
+static const struct conf_store_itf ble_store_test_conf_itf = {
+    .csi_load = ble_store_test_conf_load,
+    .csi_save = ble_store_test_conf_save,
+};
+
+static struct conf_store ble_store_test_conf_store = {
+    .cs_itf = &ble_store_test_conf_itf,
+};
+
+static void
+ble_store_test_util_flush_init(void)
+{
+    ble_hs_test_util_init();
+
+    conf_dst_register(&ble_store_test_conf_store);
+    memset(ble_store_test_cccd_records, 0,
+           sizeof ble_store_test_cccd_records);
+    ble_store_test_cccd_save_fail = 0;
+}
+
+static void
+ble_store_test_util_write_cccd(uint8_t addr_id, uint16_t flags)
+{
+    struct ble_store_value_cccd cccd;
+    int rc;
+
+    memset(&cccd, 0, sizeof cccd);
+    cccd.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC,
+                                   { addr_id, 2, 3, 4, 5, 6 } };
+    cccd.chr_val_handle = 10;
+    cccd.flags = flags;
+
+    rc = ble_store_write_cccd(&cccd);
+    TEST_ASSERT_FATAL(rc == 0);
+}
+
+/**
+ * @return                      The number of CCCD records written to
+ *                                  storage, counting rewrites.
+ */
+static int
+ble_store_test_util_num_cccd_saves(void)
+{
+    int count;
+    int i;
+
+    count = 0;
+    for (i = 0; i < MYNEWT_VAL(BLE_STORE_MAX_CCCDS); i++) {
+        count += ble_store_test_cccd_records[i].num_saves;
+    }
+
+    return count;
+}
+
+/**
+ * Verifies the stored record for the specified peer; flags of 0 means
+ * no record is expected.
+ */
+static void
+ble_store_test_util_verify_cccd_record(uint8_t addr_id, uint16_t flags)
+{
+    const struct ble_store_value_cccd *cccd;
+    int found;
+    int i;
+
+    found = 0;
+    for (i = 0; i < MYNEWT_VAL(BLE_STORE_MAX_CCCDS); i++) {
+        cccd = &ble_store_test_cccd_records[i].value;
+        if (ble_store_test_cccd_records[i].present &&
+            cccd->peer_addr.val[0] == addr_id) {
+
+            TEST_ASSERT(!found);
+            TEST_ASSERT(cccd->flags == flags);
+            found = 1;
+        }
+    }
+
+    TEST_ASSERT(found == (flags != 0));
+}
+
+/**
+ * Advances time and runs the events this queues for the default task,
+ * including the flush timer's.
+ */
+static void
+ble_store_test_util_advance(uint32_t ticks)
+{
+    struct os_event *ev;
+
+    /* Expired callouts are only enqueued by the tick handler once the OS is
+     * running; process them explicitly.
+     */
+    os_time_advance(ticks);
+    os_callout_tick();
+
+    while ((ev = os_eventq_get_no_wait(os_eventq_dflt_get())) != NULL) {
+        ev->ev_cb(ev);
+    }
+}
+
+TEST_CASE(ble_store_test_flush_coalesce)
+{
+    int rc;
+
+    ble_store_test_util_flush_init();
+
+    /* Repeated changes to a record cost a single write. */
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_INDICATE);
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 0);
+
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+    ble_store_test_util_verify_cccd_record(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+
+    /* Nothing left to write. */
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+
+    /* Rewriting an unchanged record doesn't dirty it. */
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+}
+
+TEST_CASE(ble_store_test_flush_max_dirty)
+{
+    int i;
+
+    ble_store_test_util_flush_init();
+
+    for (i = 1; i < MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_MAX_DIRTY); i++) {
+        ble_store_test_util_write_cccd(i, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    }
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 0);
+
+    /* Reaching the limit writes all pending records. */
+    ble_store_test_util_write_cccd(i, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() ==
+                MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_MAX_DIRTY));
+    for (i = 1; i <= MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_MAX_DIRTY); i++) {
+        ble_store_test_util_verify_cccd_record(i, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    }
+}
+
+TEST_CASE(ble_store_test_flush_timer)
+{
+    uint32_t ticks;
+
+    ble_store_test_util_flush_init();
+
+    ticks = os_time_ms_to_ticks32(
+        MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_FLUSH_DELAY));
+
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+
+    /* Another change doesn't push the deadline back. */
+    ble_store_test_util_advance(ticks / 2);
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_INDICATE);
+
+    ble_store_test_util_advance(ticks - ticks / 2 - 1);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 0);
+
+    ble_store_test_util_advance(1);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+    ble_store_test_util_verify_cccd_record(1, BLE_GATTS_CLT_CFG_F_INDICATE);
+}
+
+TEST_CASE(ble_store_test_flush_disconnect)
+{
+    ble_store_test_util_flush_init();
+
+    ble_hs_test_util_create_conn(2, ((uint8_t[6]){ 1, 2, 3, 4, 5, 6 }),
+                                 NULL, NULL);
+
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 0);
+
+    /* Pending writes are flushed when a peer disconnects. */
+    ble_hs_test_util_conn_disconnect(2);
+
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+    ble_store_test_util_verify_cccd_record(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+}
+
+TEST_CASE(ble_store_test_flush_delete_dirty)
+{
+    struct ble_store_key_cccd key;
+    int rc;
+
+    ble_store_test_util_flush_init();
+
+    /* Persist a record, then modify it and delete it before the modification
+     * is written.
+     */
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    rc = ble_store_flush();
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_verify_cccd_record(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_INDICATE);
+
+    memset(&key, 0, sizeof key);
+    key.peer_addr = (ble_addr_t){ BLE_ADDR_PUBLIC, { 1, 2, 3, 4, 5, 6 } };
+    key.chr_val_handle = 10;
+    rc = ble_store_delete_cccd(&key);
+    TEST_ASSERT_FATAL(rc == 0);
+    ble_store_test_util_verify_cccd_record(1, 0);
+
+    /* The pending write must not bring the record back. */
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+    ble_store_test_util_verify_cccd_record(1, 0);
+
+    /* A new record reusing the slot is written normally. */
+    ble_store_test_util_write_cccd(2, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    ble_store_test_util_verify_cccd_record(1, 0);
+    ble_store_test_util_verify_cccd_record(2, BLE_GATTS_CLT_CFG_F_NOTIFY);
+}
+
+TEST_CASE(ble_store_test_flush_retry)
+{
+    int rc;
+
+    ble_store_test_util_flush_init();
+
+    ble_store_test_util_write_cccd(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    ble_store_test_util_write_cccd(2, BLE_GATTS_CLT_CFG_F_NOTIFY);
+
+    /* The first record fails to persist; the second is still written. */
+    ble_store_test_cccd_save_fail = 1;
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == BLE_HS_ESTORE_FAIL);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 1);
+
+    /* The failed record stays pending and is retried. */
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 2);
+    ble_store_test_util_verify_cccd_record(1, BLE_GATTS_CLT_CFG_F_NOTIFY);
+    ble_store_test_util_verify_cccd_record(2, BLE_GATTS_CLT_CFG_F_NOTIFY);
+
+    rc = ble_store_flush();
+    TEST_ASSERT(rc == 0);
+    TEST_ASSERT(ble_store_test_util_num_cccd_saves() == 2);
+}
+
+#endif
+
+#endif
+
 TEST_SUITE(ble_store_suite)
 {
     tu_suite_set_post_test_cb(ble_hs_test_util_post_test, NULL);
@@ -424,6 +1023,19 @@ TEST_SUITE(ble_store_suite)
     ble_store_test_count();
     ble_store_test_overflow();
     ble_store_test_clear();
+    ble_store_test_index();
+    ble_store_test_lock_stats();
+#if MYNEWT_VAL(BLE_STORE_CONFIG_PERSIST)
+    ble_store_test_legacy_migration();
+#if MYNEWT_VAL(BLE_STORE_CONFIG_CCCD_FLUSH_DELAY) > 0
+    ble_store_test_flush_coalesce();
+    ble_store_test_flush_max_dirty();
+    ble_store_test_flush_timer();
+    ble_store_test_flush_disconnect();
+    ble_store_test_flush_delete_dirty();
+    ble_store_test_flush_retry();
+#endif
+#endif
 }
 
 int
@@ -548,8 +548,12 @@ extern "C" {
 
 /* --- LE set periodic advertising parameters (OCF 0x003E) */
 #define BLE_HCI_LE_SET_PER_ADV_PARAMS_LEN           (7)
+#define BLE_HCI_PERIODIC_ADV_ITVL_MIN               (0x0006)
 
 /* --- LE set periodic advertising data (OCF 0x003F) */
+#define BLE_HCI_MAX_PER_ADV_DATA_LEN                (252)
+#define BLE_HCI_SET_PER_ADV_DATA_HDR_LEN            (3)
+
 #define BLE_HCI_LE_SET_PER_ADV_DATA_LEN             BLE_HCI_VARIABLE_LEN
 
 /* --- LE periodic advertising enable (OCF 0x0040) */
@@ -772,6 +776,15 @@ extern "C" {
 /* LE PHY update complete event (sub event 0x0C) */
 #define BLE_HCI_LE_PHY_UPD_LEN              (6)
 
+/* LE Periodic Advertising Sync Established event (sub event 0x0E) */
+#define BLE_HCI_LE_SUBEV_PER_ADV_SYNC_ESTAB_LEN (16)
+
+/* LE Periodic Advertising Report event (sub event 0x0F) */
+#define BLE_HCI_LE_SUBEV_PER_ADV_RPT_LEN        (8)
+
+/* LE Periodic Advertising Sync Lost event (sub event 0x10) */
+#define BLE_HCI_LE_SUBEV_PER_ADV_SYNC_LOST_LEN  (3)
+
 /*  LE Advertising Set Terminated Event (sub event 0x12) */
 #define BLE_HCI_LE_SUBEV_ADV_SET_TERMINATED_LEN   (6)
 
@@ -1102,6 +1115,36 @@ struct hci_le_adv_set_terminated
     uint8_t completed_events;
 };
 
+struct hci_le_periodic_adv_sync_estab
+{
+    uint8_t subevent_code;
+    uint8_t status;
+    uint16_t sync_handle;
+    uint8_t sid;
+    uint8_t adv_addr_type;
+    uint8_t adv_addr[BLE_DEV_ADDR_LEN];
+    uint8_t adv_phy;
+    uint16_t per_adv_itvl;
+    uint8_t adv_clk_accuracy;
+};
+
+struct hci_le_periodic_adv_rpt
+{
+    uint8_t subevent_code;
+    uint16_t sync_handle;
+    int8_t tx_power;
+    int8_t rssi;
+    uint8_t data_status;
+    uint8_t data_len;
+    uint8_t *data;
+};
+
+struct hci_le_periodic_adv_sync_lost
+{
+    uint8_t subevent_code;
+    uint16_t sync_handle;
+};
+
 #define BLE_HCI_DATA_HDR_SZ                 4
 #define BLE_HCI_DATA_HANDLE(handle_pb_bc)   (((handle_pb_bc) & 0x0fff) >> 0)
 #define BLE_HCI_DATA_PB(handle_pb_bc)       (((handle_pb_bc) & 0x3000) >> 12)
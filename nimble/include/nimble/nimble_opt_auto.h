@@ -89,6 +89,10 @@ extern "C" {
 #define NIMBLE_BLE_ATT_CLT_WRITE_NO_RSP         \
     (MYNEWT_VAL(BLE_GATT_WRITE_NO_RSP))
 
+#undef NIMBLE_BLE_ATT_CLT_SIGNED_WRITE
+#define NIMBLE_BLE_ATT_CLT_SIGNED_WRITE         \
+    (MYNEWT_VAL(BLE_GATT_SIGNED_WRITE))
+
 #undef NIMBLE_BLE_ATT_CLT_PREP_WRITE
 #define NIMBLE_BLE_ATT_CLT_PREP_WRITE           \
     (MYNEWT_VAL(BLE_GATT_WRITE_LONG))
@@ -191,11 +191,22 @@ ble_hci_trans_acl_buf_alloc(void)
     return m;
 }
 
+/*
+ * ACL data packets are sent with scatter/gather I/O, one iovec per mbuf, so
+ * that the host's fragments are not copied.  Chains longer than this are
+ * flattened into a bounce buffer.
+ */
+#define BLE_HCI_SOCK_ACL_IOV_MAX    16
+
+static uint8_t ble_hci_sock_acl_flat_buf[BLE_HCI_DATA_HDR_SZ +
+                                         MYNEWT_VAL(BLE_ACL_BUF_SIZE)];
+
 static int
 ble_hci_sock_acl_tx(struct os_mbuf *om)
 {
     struct msghdr msg;
-    struct iovec iov[8];
+    struct iovec iov[BLE_HCI_SOCK_ACL_IOV_MAX];
+    uint16_t pktlen;
     int i;
     struct os_mbuf *m;
     uint8_t ch;
@@ -205,23 +216,41 @@ ble_hci_sock_acl_tx(struct os_mbuf *om)
 
     msg.msg_iov = iov;
 
+    pktlen = OS_MBUF_PKTLEN(om);
+
     ch = BLE_HCI_UART_H4_ACL;
     iov[0].iov_len = 1;
     iov[0].iov_base = &ch;
     i = 1;
     for (m = om; m; m = SLIST_NEXT(m, om_next)) {
+        if (i >= BLE_HCI_SOCK_ACL_IOV_MAX) {
+            break;
+        }
         iov[i].iov_base = m->om_data;
         iov[i].iov_len = m->om_len;
         i++;
     }
+
+    if (m != NULL) {
+        /* Too many mbufs to gather; send a flattened copy instead. */
+        if (pktlen > sizeof ble_hci_sock_acl_flat_buf) {
+            os_mbuf_free_chain(om);
+            STATS_INC(hci_sock_stats, oerr);
+            return BLE_ERR_MEM_CAPACITY;
+        }
+        os_mbuf_copydata(om, 0, pktlen, ble_hci_sock_acl_flat_buf);
+        iov[1].iov_base = ble_hci_sock_acl_flat_buf;
+        iov[1].iov_len = pktlen;
+        i = 2;
+    }
     msg.msg_iovlen = i;
 
     STATS_INC(hci_sock_stats, omsg);
     STATS_INC(hci_sock_stats, oacl);
-    STATS_INCN(hci_sock_stats, obytes, OS_MBUF_PKTLEN(om) + 1);
+    STATS_INCN(hci_sock_stats, obytes, pktlen + 1);
     i = sendmsg(ble_hci_sock_state.sock, &msg, 0);
     os_mbuf_free_chain(om);
-    if (i != OS_MBUF_PKTLEN(om) + 1) {
+    if (i != pktlen + 1) {
         if (i < 0) {
             dprintf(1, "sendmsg() failed : %d\n", errno);
         } else {